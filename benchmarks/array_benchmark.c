@@ -3,7 +3,140 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include "array.h"
+#include "array_ops.h"
+#include "random.h"
+#include "simd.h"
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	long s = end->tv_sec - start->tv_sec;
+	long ns = end->tv_nsec - start->tv_nsec;
+	return ns / 1000000000.0 + s;
+}
+
+// many tiny temporary arrays (like a parser creates them)
+static void tiny_arrays(bool use_small)
+{
+	size_t n = 10000000;
+	long sum = 0;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < n; i++) {
+		array_small_storage(int, 8) storage;
+		array_t(int) arr = use_small ? array_new_small(storage) : NULL;
+		for (size_t k = 0; k < i % 8; k++) {
+			array_add(arr, (int)k);
+		}
+		array_foreach_value(arr, v) {
+			sum += v;
+		}
+		array_free(arr);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double t = elapsed(&start, &end);
+	printf("%-12s %.2fs %.2fns/array (%ld)\n", use_small ? "small array" : "array", t, 1e9 * t / n, sum);
+}
+
+#define BULK_N 10000000
+#define BULK_REPEAT 20
+
+#define TIME_BULK(label, expr)						\
+	do {								\
+		struct timespec start, end;				\
+		double result = 0;					\
+		clock_gettime(CLOCK_MONOTONIC, &start);			\
+		for (int r = 0; r < BULK_REPEAT; r++) {			\
+			result += (double)(expr);			\
+		}							\
+		clock_gettime(CLOCK_MONOTONIC, &end);			\
+		double t = elapsed(&start, &end) / BULK_REPEAT;		\
+		printf("%-24s %8.2fms %6.2f GB/s (%g)\n", label, 1e3 * t, BULK_N * sizeof(float) / t / 1e9, result); \
+	} while (0)
+
+static size_t naive_find_ge(const int32_t *a, int32_t v)
+{
+	for (size_t i = 0; i < array_length(a); i++) {
+		if (a[i] >= v) {
+			return i;
+		}
+	}
+	return array_length(a);
+}
+
+static size_t naive_count_eq(const int32_t *a, int32_t v)
+{
+	size_t count = 0;
+	for (size_t i = 0; i < array_length(a); i++) {
+		count += a[i] == v;
+	}
+	return count;
+}
+
+static float naive_min(const float *a)
+{
+	float min = a[0];
+	for (size_t i = 1; i < array_length(a); i++) {
+		min = a[i] < min ? a[i] : min;
+	}
+	return min;
+}
+
+static double naive_sum(const float *a)
+{
+	double sum = 0;
+	for (size_t i = 0; i < array_length(a); i++) {
+		sum += a[i];
+	}
+	return sum;
+}
+
+static size_t naive_filter_gt(int32_t *a, int32_t v)
+{
+	size_t out = 0;
+	for (size_t i = 0; i < array_length(a); i++) {
+		if (a[i] > v) {
+			a[out++] = a[i];
+		}
+	}
+	array_truncate(a, out);
+	return out;
+}
+
+static void bulk_operations(void)
+{
+	static const char *levels[] = {"scalar", "sse2", "avx2"};
+	struct random_state rng;
+	random_state_init(&rng, 42);
+	array_t(int32_t) ints = NULL;
+	array_t(float) floats = NULL;
+	for (size_t i = 0; i < BULK_N; i++) {
+		array_add(ints, (int32_t)(random_next_u32(&rng) % 1000000));
+		array_add(floats, (float)(random_next_u32(&rng) % 1000000));
+	}
+	array_t(int32_t) tmp = array_new(int32_t, BULK_N);
+
+	// the filter keeps every second element (unpredictable branches), its time includes copying the input
+	TIME_BULK("naive find_ge", naive_find_ge(ints, 1000000));
+	TIME_BULK("naive count_eq", naive_count_eq(ints, 1234));
+	TIME_BULK("naive min (float)", naive_min(floats));
+	TIME_BULK("naive sum (float)", naive_sum(floats));
+	TIME_BULK("naive filter_gt", (array_clear(tmp), array_add_array(tmp, ints), naive_filter_gt(tmp, 500000)));
+	for (int level = _SIMD_NONE; level <= _SIMD_AVX2; level++) {
+		_simd_limit(level);
+		printf("%s:\n", levels[level]);
+		TIME_BULK("array_find_ge", array_find_ge(ints, 1000000));
+		TIME_BULK("array_count_eq", array_count_eq(ints, 1234));
+		TIME_BULK("array_min (float)", array_min(floats));
+		TIME_BULK("array_sum (float)", array_sum(floats));
+		TIME_BULK("array_filter", (array_clear(tmp), array_add_array(tmp, ints),
+					   array_filter(tmp, ARRAY_CMP_GT, 500000)));
+	}
+	array_free(tmp);
+	array_free(ints);
+	array_free(floats);
+}
 
 int main(void)
 {
@@ -29,6 +162,11 @@ int main(void)
 	// printf("array capacity: %zu\n", array_capacity(arr1));
 	array_free(arr1);
 
+	tiny_arrays(false);
+	tiny_arrays(true);
+
+	bulk_operations();
+
 #if 0
 	int K = 10000;
 	double o[3] = {0};
@@ -8,6 +8,7 @@
 #include <time.h>
 #include "charconv.h"
 #include "heap.h"
+#include "radix_heap.h"
 
 static size_t comparisons;
 
@@ -328,6 +329,157 @@ static void structheap_benchmark(void)
 	free(arr);
 }
 
+DEFINE_BINHEAP(u64heap2, uint64_t, *a < *b)
+DEFINE_DHEAP(u64heap4, uint64_t, 4, *a < *b)
+DEFINE_DHEAP(u64heap8, uint64_t, 8, *a < *b)
+
+#define ARITY_BENCHMARK(heap, arr, n)					\
+	do {								\
+		printf("[arity %s]\n", #heap + strlen("u64heap"));	\
+		struct timespec start, end;				\
+		srand(12345);						\
+		for (size_t i = 0; i < (n); i++) {			\
+			(arr)[i] = rand();				\
+		}							\
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);		\
+		heap##_heapify((arr), (n));				\
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);		\
+		double t = elapsed(&start, &end);			\
+		printf("heapify       %.2fs %.2fns/n\n", t, 1000000000 * t / (n)); \
+		assert(heap##_is_heap((arr), (n)));			\
+									\
+		/* pop the minimum and push a later deadline (like a scheduler) */ \
+		size_t ops = (n) / 4;					\
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);		\
+		for (size_t i = 0; i < ops; i++) {			\
+			uint64_t min = heap##_extract_first((arr), (n));	\
+			(arr)[(n) - 1] = min + rand() % 65536;		\
+			heap##_insert((arr), (n) - 1);			\
+		}							\
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);		\
+		t = elapsed(&start, &end);				\
+		printf("pop + push    %.2fs %.2fns/n\n", t, 1000000000 * t / ops); \
+									\
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);		\
+		for (size_t i = 0; i < ops; i++) {			\
+			(arr)[(n) - 1 - i] = heap##_extract_first((arr), (n) - i); \
+		}							\
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);		\
+		t = elapsed(&start, &end);				\
+		printf("extract       %.2fs %.2fns/n\n", t, 1000000000 * t / ops); \
+									\
+		srand(12345);						\
+		for (size_t i = 0; i < (n); i++) {			\
+			(arr)[i] = rand();				\
+		}							\
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);		\
+		for (size_t i = 0; i < (n); i++) {			\
+			heap##_insert((arr), i);			\
+		}							\
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);		\
+		t = elapsed(&start, &end);				\
+		printf("insert        %.2fs %.2fns/n\n", t, 1000000000 * t / (n)); \
+	} while (0)
+
+static void arity_benchmark(void)
+{
+	size_t n = 32 * 1024 * 1024;
+	// aligned so that the children of a node are in one cache line for arity 4 and 8
+	uint64_t *arr = u64heap8_alloc(n);
+	assert(arr);
+	ARITY_BENCHMARK(u64heap2, arr, n);
+	puts("");
+	ARITY_BENCHMARK(u64heap4, arr, n);
+	puts("");
+	ARITY_BENCHMARK(u64heap8, arr, n);
+	u64heap8_free(arr);
+}
+
+DEFINE_RADIX_HEAP(u64radixheap, uint32_t)
+
+static void radix_heap_benchmark(void)
+{
+	printf("[radix heap]\n");
+
+	size_t n = 8 * 1024 * 1024;
+	size_t ops = 4 * n;
+	struct timespec start, end;
+	struct u64radixheap heap;
+	u64radixheap_init(&heap);
+
+	srand(12345);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+	for (size_t i = 0; i < n; i++) {
+		u64radixheap_insert(&heap, rand(), i);
+	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	double t = elapsed(&start, &end);
+	printf("insert        %.2fs %.2fns/n\n", t, 1000000000 * t / n);
+
+	// pop the next event and schedule a later one (keys are monotone)
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+	for (size_t i = 0; i < ops; i++) {
+		uint64_t key;
+		uint32_t value;
+		if (!u64radixheap_extract_first(&heap, &key, &value)) {
+			abort();
+		}
+		u64radixheap_insert(&heap, key + rand() % 65536, value);
+	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	t = elapsed(&start, &end);
+	printf("pop + push    %.2fs %.2fns/n\n", t, 1000000000 * t / ops);
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+	uint64_t prev = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t key;
+		if (!u64radixheap_extract_first(&heap, &key, NULL)) {
+			abort();
+		}
+		assert(key >= prev);
+		prev = key;
+	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	t = elapsed(&start, &end);
+	printf("extract       %.2fs %.2fns/n\n", t, 1000000000 * t / n);
+	assert(u64radixheap_empty(&heap));
+	u64radixheap_destroy(&heap);
+
+	puts("");
+	printf("[binary heap (same workload)]\n");
+	uint64_t *arr = malloc(n * sizeof(arr[0]));
+	assert(arr);
+	srand(12345);
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+	for (size_t i = 0; i < n; i++) {
+		arr[i] = rand();
+		u64heap2_insert(arr, i);
+	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	t = elapsed(&start, &end);
+	printf("insert        %.2fs %.2fns/n\n", t, 1000000000 * t / n);
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+	for (size_t i = 0; i < ops; i++) {
+		uint64_t min = u64heap2_extract_first(arr, n);
+		arr[n - 1] = min + rand() % 65536;
+		u64heap2_insert(arr, n - 1);
+	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	t = elapsed(&start, &end);
+	printf("pop + push    %.2fs %.2fns/n\n", t, 1000000000 * t / ops);
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+	for (size_t i = 0; i < n; i++) {
+		u64heap2_extract_first(arr, n - i);
+	}
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+	t = elapsed(&start, &end);
+	printf("extract       %.2fs %.2fns/n\n", t, 1000000000 * t / n);
+	free(arr);
+}
+
 int main(void)
 {
 	intheap_benchmark();
@@ -335,4 +487,8 @@ int main(void)
 	stringheap_benchmark();
 	puts("");
 	structheap_benchmark();
+	puts("");
+	arity_benchmark();
+	puts("");
+	radix_heap_benchmark();
 }
@@ -0,0 +1,73 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "dstring.h"
+#include "random.h"
+#include "rope.h"
+
+#define TEXT_SIZE (8 * 1024 * 1024)
+#define NUM_EDITS 20000
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	long s = end->tv_sec - start->tv_sec;
+	long ns = end->tv_nsec - start->tv_nsec;
+	return ns / 1000000000.0 + s;
+}
+
+// small edits at random positions of a large text (like typing in an editor), returns the final length
+static size_t edits(bool use_rope, double *t)
+{
+	static char text[TEXT_SIZE];
+	struct random_state rng;
+	random_state_init(&rng, 12345);
+	for (size_t i = 0; i < TEXT_SIZE; i++) {
+		text[i] = 'a' + random_next_u32(&rng) % 26;
+	}
+	struct rope rope;
+	rope_init(&rope);
+	rope_append_chars(&rope, text, TEXT_SIZE);
+	dstr_t dstr = dstr_from_chars(text, TEXT_SIZE);
+
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	size_t length = TEXT_SIZE;
+	for (size_t i = 0; i < NUM_EDITS; i++) {
+		uint32_t r = random_next_u32(&rng);
+		size_t pos = random_next_u64(&rng) % length;
+		size_t n = 1 + (r >> 8) % 16;
+		if (r % 4 == 0 && pos + n <= length) {
+			if (use_rope) {
+				rope_erase(&rope, pos, n);
+			} else {
+				dstr_erase(&dstr, pos, n);
+			}
+			length -= n;
+		} else {
+			if (use_rope) {
+				rope_insert_chars(&rope, pos, text, n);
+			} else {
+				dstr_insert_chars(&dstr, pos, text, n);
+			}
+			length += n;
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	*t = elapsed(&start, &end);
+	assert(length == (use_rope ? rope_length(&rope) : dstr_length(dstr)));
+	rope_destroy(&rope);
+	dstr_free(&dstr);
+	return length;
+}
+
+int main(void)
+{
+	for (int use_rope = 0; use_rope <= 1; use_rope++) {
+		double t;
+		size_t length = edits(use_rope, &t);
+		printf("%-4s %zu edits of a %zuMB string: %.3fs %.2fus/op\n", use_rope ? "rope" : "dstr",
+		       (size_t)NUM_EDITS, length >> 20, t, 1e6 * t / NUM_EDITS);
+	}
+}
@@ -0,0 +1,162 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+#include <time.h>
+#include "btree.h"
+#include "random.h"
+#include "slab.h"
+
+#define NUM_OBJECTS (1024 * 1024)
+#define NUM_PAIRS (16 * 1024 * 1024)
+#define NUM_THREADS 4
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	long s = end->tv_sec - start->tv_sec;
+	long ns = end->tv_nsec - start->tv_nsec;
+	return ns / 1000000000.0 + s;
+}
+
+static inline void *bench_alloc(bool use_slab, size_t size)
+{
+	if (use_slab) {
+		return slab_alloc(size);
+	}
+	void *p = malloc(size);
+	assert(p);
+	return p;
+}
+
+static inline void bench_free(bool use_slab, void *p, size_t size)
+{
+	if (use_slab) {
+		slab_free(p, size);
+	} else {
+		free(p);
+	}
+}
+
+static size_t random_size(struct random_state *rng)
+{
+	// mostly tiny objects, some bigger ones (like hashtable entries, strings and B-tree nodes)
+	uint32_t r = random_next_u32(rng);
+	return r % 8 == 0 ? 16 + (r >> 8) % 1024 : 16 + (r >> 8) % 112;
+}
+
+// allocate and immediately free an object (e.g. temporary strings)
+static double pairs(bool use_slab)
+{
+	struct random_state rng;
+	random_state_init(&rng, 12345);
+	size_t sizes[256];
+	for (size_t i = 0; i < 256; i++) {
+		sizes[i] = random_size(&rng);
+	}
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < NUM_PAIRS; i++) {
+		size_t size = sizes[i % 256];
+		char *p = bench_alloc(use_slab, size);
+		p[0] = (char)i;
+		__asm__ volatile("" : : "r"(p) : "memory");
+		bench_free(use_slab, p, size);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return elapsed(&start, &end);
+}
+
+struct batch_arg {
+	bool use_slab;
+	uint64_t seed;
+};
+
+// allocate many objects and free them in random order
+static int batch(void *_arg)
+{
+	struct batch_arg *arg = _arg;
+	struct random_state rng;
+	random_state_init(&rng, arg->seed);
+	void **ptrs = malloc(NUM_OBJECTS * sizeof(ptrs[0]));
+	uint32_t *sizes = malloc(NUM_OBJECTS * sizeof(sizes[0]));
+	assert(ptrs && sizes);
+	for (size_t round = 0; round < 4; round++) {
+		for (size_t i = 0; i < NUM_OBJECTS; i++) {
+			sizes[i] = random_size(&rng);
+			ptrs[i] = bench_alloc(arg->use_slab, sizes[i]);
+			*(char *)ptrs[i] = (char)i;
+		}
+		for (size_t i = NUM_OBJECTS - 1; i > 0; i--) {
+			size_t j = random_next_u32(&rng) % (i + 1);
+			void *p = ptrs[i];
+			uint32_t size = sizes[i];
+			ptrs[i] = ptrs[j];
+			sizes[i] = sizes[j];
+			ptrs[j] = p;
+			sizes[j] = size;
+		}
+		for (size_t i = 0; i < NUM_OBJECTS; i++) {
+			bench_free(arg->use_slab, ptrs[i], sizes[i]);
+		}
+	}
+	free(ptrs);
+	free(sizes);
+	return 0;
+}
+
+static double threads(bool use_slab, unsigned int num_threads)
+{
+	thrd_t threads[NUM_THREADS];
+	struct batch_arg args[NUM_THREADS];
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned int i = 0; i < num_threads; i++) {
+		args[i] = (struct batch_arg){use_slab, i + 1};
+		int err = thrd_create(&threads[i], batch, &args[i]);
+		assert(err == thrd_success);
+	}
+	for (unsigned int i = 0; i < num_threads; i++) {
+		thrd_join(threads[i], NULL);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return elapsed(&start, &end);
+}
+
+DEFINE_BTREE_SET(u64set, uint64_t, NULL, 31, (a < b) ? -1 : (a > b))
+
+// B-tree with small nodes (the node allocations dominate)
+static double btree(bool use_slab)
+{
+	struct random_state rng;
+	random_state_init(&rng, 12345);
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t round = 0; round < 4; round++) {
+		struct u64set set;
+		u64set_init_with_allocator(&set, use_slab ? slab_allocator() : NULL);
+		for (size_t i = 0; i < NUM_OBJECTS; i++) {
+			u64set_insert(&set, random_next_u64(&rng));
+		}
+		u64set_destroy(&set);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return elapsed(&start, &end);
+}
+
+int main(void)
+{
+	for (int use_slab = 0; use_slab <= 1; use_slab++) {
+		const char *name = use_slab ? "slab" : "malloc";
+		double t = pairs(use_slab);
+		printf("%-6s alloc/free pairs      %.2fs %.2fns/op\n", name, t, 1e9 * t / NUM_PAIRS);
+		t = threads(use_slab, 1);
+		printf("%-6s random order          %.2fs %.2fns/op\n", name, t, 1e9 * t / (4 * NUM_OBJECTS));
+		t = threads(use_slab, NUM_THREADS);
+		printf("%-6s random order %u threads %.2fs %.2fns/op\n", name, NUM_THREADS, t,
+		       1e9 * t / (4 * NUM_OBJECTS * NUM_THREADS));
+		t = btree(use_slab);
+		printf("%-6s btree insert          %.2fs %.2fns/op\n", name, t, 1e9 * t / (4 * NUM_OBJECTS));
+	}
+}
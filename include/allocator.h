@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// Allocator interface for the containers (array, dstring, dbuf, hashtable and btree)
+// A NULL allocator means the default (malloc/realloc/free). To implement a custom allocator, embed struct
+// allocator in your own struct (use container_of in the callbacks to get to it) and pass a pointer to it when
+// creating a container. The allocator must outlive all containers using it.
+//
+// Requirements for the callbacks:
+//   allocate(allocator, size): size is never zero, returns memory aligned to _Alignof(max_align_t) or NULL
+//   reallocate(allocator, ptr, old_size, new_size): like realloc, ptr is never NULL and both sizes are nonzero
+//                                                   (can be NULL, then allocate + memcpy + deallocate is used)
+//   deallocate(allocator, ptr, size): ptr is never NULL, size is the size which was used to allocate ptr
+// The containers abort() if an allocation fails.
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+
+struct allocator {
+	void *(*allocate)(struct allocator *allocator, size_t size);
+	void *(*reallocate)(struct allocator *allocator, void *ptr, size_t old_size, size_t new_size);
+	void (*deallocate)(struct allocator *allocator, void *ptr, size_t size);
+};
+
+// allocate size bytes (size must not be zero)
+static inline _attr_unused _attr_nodiscard void *allocator_alloc(struct allocator *allocator, size_t size)
+{
+	void *p = likely(!allocator) ? malloc(size) : allocator->allocate(allocator, size);
+	if (unlikely(!p)) {
+		abort();
+	}
+	return p;
+}
+
+// release ptr (which was allocated with a size of size bytes), ptr can be NULL
+static inline _attr_unused void allocator_free(struct allocator *allocator, void *ptr, size_t size)
+{
+	if (likely(!allocator)) {
+		free(ptr);
+	} else if (ptr) {
+		allocator->deallocate(allocator, ptr, size);
+	}
+}
+
+// resize ptr from old_size to new_size bytes (ptr can be NULL if old_size is zero, a new_size of zero frees ptr
+// and returns NULL)
+static inline _attr_unused _attr_nodiscard void *allocator_realloc(struct allocator *allocator, void *ptr,
+								   size_t old_size, size_t new_size)
+{
+	if (unlikely(new_size == 0)) {
+		allocator_free(allocator, ptr, old_size);
+		return NULL;
+	}
+	if (unlikely(!ptr)) {
+		return allocator_alloc(allocator, new_size);
+	}
+	void *p;
+	if (likely(!allocator)) {
+		p = realloc(ptr, new_size);
+	} else if (allocator->reallocate) {
+		p = allocator->reallocate(allocator, ptr, old_size, new_size);
+	} else {
+		p = allocator->allocate(allocator, new_size);
+		if (likely(p)) {
+			memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+			allocator->deallocate(allocator, ptr, old_size);
+		}
+	}
+	if (unlikely(!p)) {
+		abort();
+	}
+	return p;
+}
@@ -41,14 +41,20 @@
 //
 
 // Alignment: The first array element is aligned to 8/16 bytes on 32/64-bit architectures (2*sizeof(size_t))
+// Memory: Every array has a header of 2*sizeof(size_t) bytes (length and capacity) in front of the elements.
+// Arrays created with array_new_with_allocator store the allocator in front of that header, which costs another
+// _Alignof(max_align_t) bytes; arrays without an allocator do not pay for this. The capacity of an array is limited
+// to SIZE_MAX / 4 elements (the two highest bits of the capacity field are flags).
 
 // TODO array_set_all, array_addn_repeat, array_at, array_map, array_filter, array_byte_size, array_copy_to/from
 
 #pragma once
 
+#include <limits.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <string.h>
+#include "allocator.h"
 #include "config.h"
 #include "compiler.h"
 #include "fortify.h"
@@ -86,13 +92,39 @@ _Static_assert(ARRAY_GROWTH_FACTOR_DENOMINATOR > 0, "");
 //   (this provides a shorthand for "array_t(T) a = NULL; array_reserve(a, n);")
 #define array_new(T, n)                 ((array_t(T))_arr_resize_internal(NULL, sizeof(T), (n)))
 
+// array_t(T) array_new_with_allocator(<type> T, size_t n, struct allocator *allocator)
+//   like array_new but all (re)allocations of the array use allocator (NULL means malloc/realloc/free)
+//   (the returned array is never NULL, even if n is zero and it keeps the allocator when it is shrunk to a
+//    capacity of zero; array_copy uses the allocator of the source array, once the array is freed it is NULL
+//    again and uses the default allocator)
+#define array_new_with_allocator(T, n, allocator) \
+	((array_t(T))_arr_new_with_allocator(sizeof(T), (n), (allocator)))
+
+// array_small_storage(<type> T, N)
+//   the type of inline storage for a small array of up to N elements, which can be declared on the stack or
+//   embedded in a struct (like SmallVector in LLVM), e.g.
+//         array_small_storage(int, 8) storage;
+//         array_t(int) a = array_new_small(storage);
+//   the array only allocates memory once it grows beyond N elements (the elements are moved to the heap then and
+//   the storage is not used anymore), all array functions work as usual and array_free must still be called
+//   (the storage must outlive the array and must not be moved or copied while the array uses it)
+#define array_small_storage(T, N)       struct { _arr _head; T _items[N]; }
+
+// array_t(T) array_new_small(array_small_storage(T, N) &storage)
+//   return a new empty array with the inline storage as its initial memory (capacity N)
+#define array_new_small(storage)					\
+	((typeof(&(storage)._items[0]))_arr_init_small(&(storage)._head, \
+						       sizeof((storage)._items) / sizeof((storage)._items[0]) + \
+						       0 * sizeof(char[offsetof(typeof(storage), _items) == \
+								       sizeof(_arr) ? 1 : -1])))
+
 // size_t array_capacity(array_t(T) a)
 //   get allocated capacity in elements (as size_t)
 #define array_capacity(a)               _arr_capacity(a)
 
 // void array_free(array_t(T) &a)
 //   release all resources of the array (will be set to NULL)
-#define array_free(a)                   _arr_free((void **)&(a))
+#define array_free(a)                   _arr_free((void **)&(a), sizeof((a)[0]))
 
 // array_t(T) array_copy(array_t(T) a)
 //   make an exact copy of the array
@@ -239,6 +271,11 @@ _Static_assert(ARRAY_GROWTH_FACTOR_DENOMINATOR > 0, "");
 //   sort array with qsort using compare function (see qsort documentation)
 #define array_sort(a, compare)          _arr_sort((a), sizeof((a)[0]), (compare))
 
+// void array_sort_typed(array_t(T) a, sortfunc)
+//   sort array with a sort function for element type T defined with DEFINE_SORTFUNC (see sort.h)
+//   (the comparison is inlined, which is usually much faster than array_sort)
+#define array_sort_typed(a, sortfunc)   ((sortfunc)((a), _arr_length(a)))
+
 // bool array_bsearch_index(array_t(T) a, T *key, int (*compare)(const void *, const void *), size_t *index_pointer)
 //   binary search the sorted array for the key, store the final index in index_pointer (size_t *)
 //   and return whether or not a matching element was found as a bool
@@ -327,9 +364,16 @@ _Static_assert(ARRAY_GROWTH_FACTOR_DENOMINATOR > 0, "");
 # define ARRAY_MAGIC2 ((size_t)0xdeadbabebeefcafe)
 #endif
 
+// flags in the two highest bits of the capacity field
+// An array with a custom allocator stores it in front of the header (padded to keep the element alignment):
+// [struct allocator *][_arr][elements]
+#define _ARR_FLAG_ALLOCATOR ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 1))
+#define _ARR_FLAG_INLINE    ((size_t)1 << (sizeof(size_t) * CHAR_BIT - 2)) // memory of a small array, not freed
+#define _ARR_CAPACITY_MASK  (_ARR_FLAG_INLINE - 1)
+
 typedef struct {
 	size_t length;
-	size_t capacity;
+	size_t capacity; // use _arrhead_capacity to get the capacity without the flags
 #ifdef __FORTIFY_ENABLED
 	size_t magic1;
 	size_t magic2;
@@ -346,11 +390,21 @@ static _attr_always_inline _attr_nonnull(1) _arr *_arrhead(const void *p)
 
 #define _arrhead_const(a) ((const _arr *)_arrhead(a))
 
+static _attr_always_inline _attr_nonnull(1) _attr_pure size_t _arrhead_capacity(const _arr *head)
+{
+	return head->capacity & _ARR_CAPACITY_MASK;
+}
+
 #define _arr_attr_assume_aligned					\
 	_attr_assume_aligned(_Alignof(max_align_t), sizeof(_arr) % _Alignof(max_align_t))
 
 void *_arr_resize_internal(void *arr, size_t elem_size, size_t capacity) _attr_nodiscard _arr_attr_assume_aligned;
+void *_arr_free_internal(void *arr, size_t elem_size) _attr_nodiscard;
+void *_arr_new_with_allocator(size_t elem_size, size_t capacity,
+			      struct allocator *allocator) _attr_nodiscard _arr_attr_assume_aligned;
 void *_arr_copy(const void *arr, size_t elem_size) _attr_nodiscard _arr_attr_assume_aligned;
+// capacity after growing an array of the given capacity by at least n elements (the growth policy of all arrays)
+size_t _arr_grow_capacity(size_t capacity, size_t n);
 void _arr_grow(void **arrp, size_t elem_size, size_t n);
 void _arr_make_valid(void **arrp, size_t elem_size, size_t i);
 void *_arr_addn(void **arrp, size_t elem_size, size_t n);
@@ -366,6 +420,17 @@ bool _arr_bsearch_index(const void *arr, size_t elem_size,
 			size_t *ret_index) _attr_nonnull(4, 5);
 bool _arr_equal(const void *arr1, size_t elem_size, const void *arr2) _attr_nodiscard _attr_pure;
 
+static inline _attr_nonnull(1) void *_arr_init_small(_arr *head, size_t capacity)
+{
+	head->length = 0;
+	head->capacity = capacity | _ARR_FLAG_INLINE;
+#ifdef __FORTIFY_ENABLED
+	head->magic1 = ARRAY_MAGIC1;
+	head->magic2 = ARRAY_MAGIC2;
+#endif
+	return head + 1;
+}
+
 static inline _attr_pure size_t _arr_length(const void *arr)
 {
 	return arr ? _arrhead_const(arr)->length : 0;
@@ -380,7 +445,7 @@ static inline _attr_nonnull(1) _attr_pure size_t _arr_lasti(const void *arr)
 
 static inline _attr_pure size_t _arr_capacity(const void *arr)
 {
-	return arr ? _arrhead_const(arr)->capacity : 0;
+	return arr ? _arrhead_capacity(_arrhead_const(arr)) : 0;
 }
 
 static inline void _arr_clear(void *arr)
@@ -397,9 +462,9 @@ static inline void _arr_truncate(void *arr, size_t newlen)
 	}
 }
 
-static inline void _arr_free(void **arrp)
+static inline void _arr_free(void **arrp, size_t elem_size)
 {
-	*arrp = _arr_resize_internal(*arrp, 0, 0);
+	*arrp = _arr_free_internal(*arrp, elem_size);
 }
 
 static inline void _arr_resize(void **arrp, size_t elem_size, size_t capacity)
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+// Bulk operations for arrays (array.h) of int32_t, uint32_t, int64_t, uint64_t, float and double.
+// The loops use SSE2 or AVX2 (selected at runtime by the CPU features) on x86 and plain C elsewhere.
+//
+//         array_t(int32_t) values = ...;
+//         size_t first_big = array_find(values, ARRAY_CMP_GE, 1000);
+//         size_t num_zeros = array_count(values, ARRAY_CMP_EQ, 0);
+//         int64_t sum = array_sum(values);
+//         array_filter(values, ARRAY_CMP_GT, 0); // keep only the positive values
+//
+// Comparisons with NaN follow the C operators (only ARRAY_CMP_NE is true), array_min and array_max
+// return an unspecified element of the array if it contains NaN.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "array.h"
+#include "compiler.h"
+
+enum array_cmp {
+	ARRAY_CMP_EQ, // ==
+	ARRAY_CMP_NE, // !=
+	ARRAY_CMP_LT, // <
+	ARRAY_CMP_LE, // <=
+	ARRAY_CMP_GT, // >
+	ARRAY_CMP_GE, // >=
+};
+
+// size_t array_find(array_t(T) a, enum array_cmp cmp, T value)
+//   index of the first element e for which (e cmp value) is true, array_length(a) if there is none
+#define array_find(a, cmp, value)       _arr_ops_generic(a, _arr_find)((a), (cmp), (value))
+
+// size_t array_find_eq(array_t(T) a, T value)
+#define array_find_eq(a, value)         array_find(a, ARRAY_CMP_EQ, value)
+
+// size_t array_find_ge(array_t(T) a, T value)
+//   (the lower bound if a is sorted, but without a binary search)
+#define array_find_ge(a, value)         array_find(a, ARRAY_CMP_GE, value)
+
+// size_t array_count(array_t(T) a, enum array_cmp cmp, T value)
+//   number of elements e for which (e cmp value) is true
+#define array_count(a, cmp, value)      _arr_ops_generic(a, _arr_count)((a), (cmp), (value))
+
+// size_t array_count_eq(array_t(T) a, T value)
+#define array_count_eq(a, value)        array_count(a, ARRAY_CMP_EQ, value)
+
+// T array_min(array_t(T) a)
+//   smallest element (the array must not be empty)
+#define array_min(a)                    _arr_ops_generic(a, _arr_min)(a)
+
+// T array_max(array_t(T) a)
+//   largest element (the array must not be empty)
+#define array_max(a)                    _arr_ops_generic(a, _arr_max)(a)
+
+// int64_t/uint64_t/double array_sum(array_t(T) a)
+//   sum of all elements as int64_t (signed integers), uint64_t (unsigned integers) or double (float and double)
+//   (integer sums wrap around on overflow, the order of floating point additions is unspecified)
+#define array_sum(a)                    _arr_ops_generic(a, _arr_sum)(a)
+
+// size_t array_filter(array_t(T) a, enum array_cmp cmp, T value)
+//   remove all elements e for which (e cmp value) is false while keeping the order of the remaining elements,
+//   returns the new length (the capacity is unchanged)
+#define array_filter(a, cmp, value)     _arr_ops_generic(a, _arr_filter)((a), (cmp), (value))
+
+// void array_gather(array_t(T) &dst, array_t(T) src, array_t(uint32_t or uint64_t) indices)
+//   add src[indices[i]] to dst for every index (works for any element type T)
+//   (reallocates array dst if array_length(dst) + array_length(indices) > array_capacity(dst))
+#define array_gather(dst, src, indices)					\
+	_Generic((indices)[0],						\
+		 uint32_t : _arr_gather_u32,				\
+		 uint64_t : _arr_gather_u64)((void **)&(dst), sizeof((dst)[0]), 1 ? (src) : (dst), (indices))
+
+
+// internal
+
+#define _arr_ops_generic(a, f)						\
+	_Generic((a)[0],						\
+		 int32_t : f##_i32,					\
+		 uint32_t : f##_u32,					\
+		 int64_t : f##_i64,					\
+		 uint64_t : f##_u64,					\
+		 float : f##_f32,					\
+		 double : f##_f64)
+
+#define __ARRAY_OPS_FOREACH_TYPE(f)		\
+	f(i32, int32_t, int64_t)		\
+	f(u32, uint32_t, uint64_t)		\
+	f(i64, int64_t, int64_t)		\
+	f(u64, uint64_t, uint64_t)		\
+	f(f32, float, double)			\
+	f(f64, double, double)
+
+#define _arr_ops_declare(name, type, sum_type)				\
+	size_t _arr_find_##name(const type *arr, enum array_cmp cmp, type value) _attr_pure; \
+	size_t _arr_count_##name(const type *arr, enum array_cmp cmp, type value) _attr_pure; \
+	type _arr_min_##name(const type *arr) _attr_pure;		\
+	type _arr_max_##name(const type *arr) _attr_pure;		\
+	sum_type _arr_sum_##name(const type *arr) _attr_pure;		\
+	size_t _arr_filter_##name(type *arr, enum array_cmp cmp, type value);
+
+__ARRAY_OPS_FOREACH_TYPE(_arr_ops_declare)
+#undef _arr_ops_declare
+
+void _arr_gather_u32(void **dstp, size_t elem_size, const void *src, const uint32_t *indices);
+void _arr_gather_u64(void **dstp, size_t elem_size, const void *src, const uint64_t *indices);
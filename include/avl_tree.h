@@ -19,8 +19,10 @@
 
 #pragma once
 
-// TODO documentation, high-level API (see tests/avl_tree.c)
+// TODO documentation
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "config.h"
 #include "compiler.h"
@@ -49,11 +51,160 @@ struct avl_tree {
 
 #define AVL_EMPTY_TREE ((struct avl_tree){NULL})
 
+// tree that also keeps track of the leftmost (minimum) node
+struct avl_tree_cached {
+	struct avl_tree tree;
+	struct avl_node *leftmost;
+};
+
+#define AVL_EMPTY_TREE_CACHED ((struct avl_tree_cached){{NULL}, NULL})
+
 #define avl_foreach(root, itername)					\
 	for (struct avl_node *(itername) = avl_first(root); (itername); (itername) = avl_next(cur))
 
 void avl_insert_node(struct avl_tree *root, struct avl_node *node, struct avl_node *parent, enum avl_direction dir);
 void avl_remove_node(struct avl_tree *root, struct avl_node *node);
+void avl_insert_node_cached(struct avl_tree_cached *root, struct avl_node *node, struct avl_node *parent,
+			   enum avl_direction dir);
+void avl_remove_node_cached(struct avl_tree_cached *root, struct avl_node *node);
+
+// replaces the contents of the tree with the n nodes (which have to be sorted) in O(n)
+void avl_build_sorted(struct avl_tree *root, struct avl_node **nodes, size_t n);
+/*
+ * Moves all nodes of src into dest in O(n + m) (both trees have to be ordered by cmp).
+ * If duplicate is NULL, nodes with equal keys are all kept (the ones from dest first), otherwise the nodes from
+ * src that are equal to a node in dest are passed to duplicate instead.
+ */
+void avl_union(struct avl_tree *dest, struct avl_tree *src,
+	       int (*cmp)(const struct avl_node *a, const struct avl_node *b),
+	       void (*duplicate)(struct avl_node *node));
+
+static inline struct avl_node *avl_first_cached(const struct avl_tree_cached *root)
+{
+	return root->leftmost;
+}
 struct avl_node *avl_parent(const struct avl_node *node);
 struct avl_node *avl_first(const struct avl_tree *root) _attr_pure;
 struct avl_node *avl_next(const struct avl_node *node) _attr_pure;
+
+/*
+ * DEFINE_AVL_TREE generates type-safe functions for a tree of "type" entries that embed a struct avl_node
+ * (node_member) and are ordered by their key (key_member). The last argument is a comparison expression of the
+ * keys a and b (like for DEFINE_BTREE_SET), it gets inlined into the descent loops. Keys have to be unique.
+ */
+#define DEFINE_AVL_TREE(name, type, node_member, key_type, key_member, ...) \
+	typedef key_type name##_key_t;					\
+									\
+	static inline int _##name##_compare(const name##_key_t a, const name##_key_t b) \
+	{								\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	static _attr_unused type *name##_entry(const struct avl_node *node) \
+	{								\
+		return node ? container_of(node, type, node_member) : NULL; \
+	}								\
+									\
+	/* returns the node with the key or NULL and the position where it would be inserted */ \
+	static inline struct avl_node *_##name##_descend(const struct avl_tree *tree, const name##_key_t key, \
+							struct avl_node **ret_parent, \
+							enum avl_direction *ret_dir) \
+	{								\
+		struct avl_node *parent = NULL;				\
+		struct avl_node *cur = tree->root;			\
+		enum avl_direction dir = AVL_LEFT;			\
+		while (cur) {						\
+			int cmp = _##name##_compare(key, container_of(cur, type, node_member)->key_member); \
+			if (cmp == 0) {					\
+				break;					\
+			}						\
+			dir = cmp < 0 ? AVL_LEFT : AVL_RIGHT;		\
+			parent = cur;					\
+			cur = cur->children[dir];			\
+		}							\
+		*ret_parent = parent;					\
+		*ret_dir = dir;						\
+		return cur;						\
+	}								\
+									\
+	static _attr_unused type *name##_find(const struct avl_tree *tree, const name##_key_t key) \
+	{								\
+		struct avl_node *parent;					\
+		enum avl_direction dir;					\
+		return name##_entry(_##name##_descend(tree, key, &parent, &dir)); \
+	}								\
+									\
+	/* returns the entry with the same key if there is one, otherwise inserts entry and returns it */ \
+	static _attr_unused type *name##_find_or_insert(struct avl_tree *tree, type *entry) \
+	{								\
+		struct avl_node *parent;					\
+		enum avl_direction dir;					\
+		struct avl_node *node = _##name##_descend(tree, entry->key_member, &parent, &dir); \
+		if (node) {						\
+			return container_of(node, type, node_member);	\
+		}							\
+		avl_insert_node(tree, &entry->node_member, parent, dir); \
+		return entry;						\
+	}								\
+									\
+	/* returns false (and does not insert entry) if the key already exists */ \
+	static _attr_unused bool name##_insert(struct avl_tree *tree, type *entry) \
+	{								\
+		return name##_find_or_insert(tree, entry) == entry;	\
+	}								\
+									\
+	/* returns the first entry with a key >= key (inclusive) or > key (!inclusive) */ \
+	static inline type *_##name##_bound(const struct avl_tree *tree, const name##_key_t key, bool inclusive) \
+	{								\
+		struct avl_node *result = NULL;				\
+		struct avl_node *cur = tree->root;			\
+		while (cur) {						\
+			int cmp = _##name##_compare(key, container_of(cur, type, node_member)->key_member); \
+			if (cmp < 0 || (inclusive && cmp == 0)) {	\
+				result = cur;				\
+				cur = cur->left;			\
+			} else {					\
+				cur = cur->right;			\
+			}						\
+		}							\
+		return name##_entry(result);				\
+	}								\
+									\
+	/* first entry with a key >= key */				\
+	static _attr_unused type *name##_lower_bound(const struct avl_tree *tree, const name##_key_t key) \
+	{								\
+		return _##name##_bound(tree, key, true);		\
+	}								\
+									\
+	/* first entry with a key > key */				\
+	static _attr_unused type *name##_upper_bound(const struct avl_tree *tree, const name##_key_t key) \
+	{								\
+		return _##name##_bound(tree, key, false);		\
+	}								\
+									\
+	/* removes and returns the entry with the key (or NULL) */	\
+	static _attr_unused type *name##_delete(struct avl_tree *tree, const name##_key_t key) \
+	{								\
+		struct avl_node *parent;					\
+		enum avl_direction dir;					\
+		struct avl_node *node = _##name##_descend(tree, key, &parent, &dir); \
+		if (node) {						\
+			avl_remove_node(tree, node);			\
+		}							\
+		return name##_entry(node);				\
+	}								\
+									\
+	static _attr_unused void name##_remove(struct avl_tree *tree, type *entry) \
+	{								\
+		avl_remove_node(tree, &entry->node_member);		\
+	}								\
+									\
+	static _attr_unused type *name##_first(const struct avl_tree *tree) \
+	{								\
+		return name##_entry(avl_first(tree));			\
+	}								\
+									\
+	static _attr_unused type *name##_next(const type *entry)	\
+	{								\
+		return name##_entry(avl_next(&entry->node_member));	\
+	}
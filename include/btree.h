@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "allocator.h"
 #include "compiler.h"
 #include <stdbool.h>
 #include <stddef.h>
@@ -35,6 +36,7 @@ struct _btree_node {
 struct _btree {
 	struct _btree_node *root;
 	unsigned char height; // 0 means root is NULL, 1 means root is leaf
+	struct allocator *allocator; // used for the nodes (NULL means malloc/free)
 };
 
 struct btree_iter {
@@ -88,7 +90,7 @@ enum _btree_deletion_mode {
 						       const char *:  8, \
 						       default: 0)
 
-#define BTREE_EMPTY {{.root = NULL, .height = 0}}
+#define BTREE_EMPTY {{.root = NULL, .height = 0, .allocator = NULL}}
 
 #define DEFINE_BTREE_SET(name, key_type, key_destructor, max_items_per_node, ...) \
 	typedef key_type name##_key_t;					\
@@ -160,7 +162,13 @@ enum _btree_deletion_mode {
 									\
 	static _attr_unused void name##_init(struct name *tree)		\
 	{								\
-		_btree_init(&tree->_impl);				\
+		_btree_init(&tree->_impl, NULL);			\
+	}								\
+									\
+	/* like name##_init but the nodes are allocated with allocator */ \
+	static _attr_unused void name##_init_with_allocator(struct name *tree, struct allocator *allocator) \
+	{								\
+		_btree_init(&tree->_impl, allocator);			\
 	}								\
 									\
 	static _attr_unused void name##_destroy(struct name *tree)	\
@@ -213,6 +221,12 @@ enum _btree_deletion_mode {
 	static _attr_unused bool name##_insert_sequential(struct name *tree, name##_key_t key) \
 	{								\
 		return _btree_insert_sequential(&tree->_impl, &key, &name##_info); \
+	}								\
+									\
+	/* keys should be sorted (but may be interleaved with existing keys), returns the number of new keys */ \
+	static _attr_unused size_t name##_insert_batch(struct name *tree, const name##_key_t *keys, size_t n) \
+	{								\
+		return _btree_insert_batch(&tree->_impl, keys, n, &name##_info); \
 	}
 
 #define __BTREE_MAP_RETURN_KEY_AND_VALUE	\
@@ -241,6 +255,7 @@ enum _btree_deletion_mode {
 	typedef void (*name##_key_destructor)(name##_key_t key);	\
 	typedef void (*name##_value_destructor)(name##_value_t *value);	\
 	typedef struct { name##_key_t key; name##_value_t value; } _##name##_item_t; \
+	typedef _##name##_item_t name##_item_t;				\
 									\
 	struct name {							\
 		struct _btree _impl;					\
@@ -319,7 +334,13 @@ enum _btree_deletion_mode {
 									\
 	static _attr_unused void name##_init(struct name *tree)		\
 	{								\
-		_btree_init(&tree->_impl);				\
+		_btree_init(&tree->_impl, NULL);			\
+	}								\
+									\
+	/* like name##_init but the nodes are allocated with allocator */ \
+	static _attr_unused void name##_init_with_allocator(struct name *tree, struct allocator *allocator) \
+	{								\
+		_btree_init(&tree->_impl, allocator);			\
 	}								\
 									\
 	static _attr_unused void name##_destroy(struct name *tree)	\
@@ -389,6 +410,13 @@ enum _btree_deletion_mode {
 	{								\
 		return _btree_insert_sequential(&tree->_impl, &(_##name##_item_t){.key = key, .value = value}, \
 						&name##_info);		\
+	}								\
+									\
+	/* items should be sorted by key (but may be interleaved with existing keys), */ \
+	/* returns the number of new items */				\
+	static _attr_unused size_t name##_insert_batch(struct name *tree, const name##_item_t *items, size_t n) \
+	{								\
+		return _btree_insert_batch(&tree->_impl, items, n, &name##_info); \
 	}
 
 void *_btree_iter_start(struct btree_iter *iter, const struct _btree *tree, bool rightmost,
@@ -397,7 +425,7 @@ void *_btree_iter_next(struct btree_iter *iter, const struct btree_info *info);
 void *_btree_iter_prev(struct btree_iter *iter, const struct btree_info *info);
 void *_btree_iter_start_at(struct btree_iter *iter, const struct _btree *tree, void *key,
 			   enum btree_iter_start_at_mode mode, const struct btree_info *info);
-void _btree_init(struct _btree *tree);
+void _btree_init(struct _btree *tree, struct allocator *allocator);
 void _btree_destroy(struct _btree *tree, const struct btree_info *info);
 void *_btree_find(const struct _btree *tree, const void *key, const struct btree_info *info);
 void *_btree_get_leftmost_rightmost(const struct _btree *tree, bool leftmost, const struct btree_info *info) _attr_pure;
@@ -405,6 +433,7 @@ bool _btree_delete(struct _btree *tree, enum _btree_deletion_mode mode, const vo
 		   const struct btree_info *info);
 bool _btree_insert(struct _btree *tree, void *item, bool update, const struct btree_info *info);
 bool _btree_insert_sequential(struct _btree *tree, void *item, const struct btree_info *info);
+size_t _btree_insert_batch(struct _btree *tree, const void *items, size_t num_items, const struct btree_info *info);
 
 // TODO should these be public API?
 void *_btree_debug_node_item(struct _btree_node *node, unsigned int idx, const struct btree_info *info);
@@ -143,6 +143,12 @@
 #if !defined(HAVE_BUILTIN_CHOOSE_EXPR) && __has_builtin(__builtin_choose_expr)
 # define HAVE_BUILTIN_CHOOSE_EXPR 1
 #endif
+#if !defined(HAVE_BUILTIN_CONVERTVECTOR) && __has_builtin(__builtin_convertvector)
+# define HAVE_BUILTIN_CONVERTVECTOR 1
+#endif
+#if !defined(HAVE_BUILTIN_CPU_SUPPORTS) && __has_builtin(__builtin_cpu_supports)
+# define HAVE_BUILTIN_CPU_SUPPORTS 1
+#endif
 #if !defined(HAVE_BUILTIN_SUB_OVERFLOW) && __has_builtin(__builtin_sub_overflow)
 # define HAVE_BUILTIN_SUB_OVERFLOW 1
 #endif
@@ -19,6 +19,7 @@
 
 #pragma once
 
+#include "allocator.h"
 #include "config.h"
 #include "compiler.h"
 #include "fortify.h"
@@ -31,17 +32,22 @@ struct dbuf {
 	char *_buf;
 	size_t _size; // size of the valid contents of _buf
 	size_t _capacity; // total size of _buf
+	struct allocator *_allocator; // NULL means malloc/realloc/free
 };
 
 #define DBUF_INITIALIZER ((struct dbuf){0})
 
 // initialize a dynamic buffer (you can also use DBUF_INITIALIZER, this does not allocate any memory)
 void dbuf_init(struct dbuf *dbuf);
+// initialize a dynamic buffer which uses allocator for its internal buffer (does not allocate any memory)
+void dbuf_init_with_allocator(struct dbuf *dbuf, struct allocator *allocator);
 // release all resources associated with dbuf (you should reinitialize dbuf before using it again)
 void dbuf_destroy(struct dbuf *dbuf);
 // return the internal buffer (which you need to free() eventually) and reinitialize dbuf
+// (if dbuf has an allocator, release the buffer with allocator_free(allocator, buffer, dbuf_capacity(dbuf)) instead
+//  and query the capacity before calling this function; dbuf keeps its allocator)
 void *dbuf_finalize(struct dbuf *dbuf) _attr_nodiscard;
-// make an exact copy of dbuf (same content, same capacity, different memory)
+// make an exact copy of dbuf (same content, same capacity, same allocator, different memory)
 struct dbuf dbuf_copy(const struct dbuf *dbuf) _attr_nodiscard;
 // return the internal buffer (which is still owned by dbuf after calling this function)
 // Warning: modifications to dbuf may invalidate the returned pointer (due to realloc)
@@ -0,0 +1,300 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "btree.h" // enum btree_iter_start_at_mode
+#include "compiler.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Read-only B+-tree stored in a file that is accessed through mmap, so only the pages that are actually
+ * touched by lookups get loaded. Every node is a fixed-size page, children are referenced by page number.
+ * The file is written once from sorted items (builder API) and can then be opened and queried any number of
+ * times. The leaves are stored in consecutive pages (in key order) directly after the header page.
+ * Items are copied into the file as raw bytes, so keys and values must not contain pointers. The file format
+ * uses the native byte order and is only readable on machines with the same byte order.
+ * The pages are only checked when they are used, so lookups and iterators in a corrupt file stop (return NULL)
+ * instead of reading outside of the file.
+ * To update the tree, merge the old tree (iterator) with the new items into a new file and rename it over the
+ * old one (never rebuild a file in place while it is open).
+ */
+
+#define DISK_BTREE_PAGE_SIZE 4096
+
+struct _disk_btree_header {
+	char magic[8];
+	uint32_t byte_order;
+	uint32_t page_size;
+	uint32_t item_size;
+	uint32_t key_size;
+	uint32_t height;
+	uint32_t root;
+	uint32_t num_leaves;
+	uint32_t num_pages;
+	uint64_t num_items;
+};
+
+struct _disk_btree_page {
+	uint16_t num_items;
+	uint16_t unused[3];
+	unsigned char data[];
+	/* leaf: item_t items[info->leaf_capacity]; */
+	/* inner: key_t keys[info->inner_capacity]; (padding) uint32_t children[info->inner_capacity + 1]; */
+};
+
+struct _disk_btree {
+	const unsigned char *map;
+	size_t map_size;
+	uint64_t num_items;
+	uint32_t root;
+	uint32_t num_leaves;
+	unsigned char height; // 0 means the tree is empty, 1 means root is leaf
+};
+
+struct disk_btree_iter {
+	const struct _disk_btree *tree;
+	uint32_t page; // 0 means the iterator is not positioned on an item
+	unsigned int idx;
+};
+
+struct disk_btree_builder {
+	int fd;
+	bool failed;
+	uint64_t num_items;
+	uint32_t num_pages;
+	struct _disk_btree_page *page;
+	unsigned char *keys; // first key of every leaf
+	size_t keys_capacity;
+};
+
+struct disk_btree_info {
+	size_t item_size;
+	size_t key_size;
+	unsigned short leaf_capacity;
+	unsigned short inner_capacity;
+	int (*cmp)(const void *a, const void *b);
+};
+
+#define __DISK_BTREE_LEAF_CAPACITY(item_size) \
+	((DISK_BTREE_PAGE_SIZE - sizeof(struct _disk_btree_page)) / (item_size))
+// worst case: 3 bytes of padding between keys and children
+#define __DISK_BTREE_INNER_CAPACITY(key_size) \
+	((DISK_BTREE_PAGE_SIZE - sizeof(struct _disk_btree_page) - sizeof(uint32_t) - 3) / ((key_size) + sizeof(uint32_t)))
+
+#define DISK_BTREE_EMPTY {{.map = NULL, .map_size = 0, .num_items = 0, .root = 0, .num_leaves = 0, .height = 0}}
+
+#define __DEFINE_DISK_BTREE_COMMON(name, item_type, key_type, ...)	\
+	struct name {							\
+		struct _disk_btree _impl;				\
+	};								\
+									\
+	typedef struct disk_btree_iter name##_iter_t;			\
+	typedef struct disk_btree_builder name##_builder_t;		\
+									\
+	static int _##name##_compare(const void *_a, const void *_b)	\
+	{								\
+		const key_type a = *(const key_type *)_a;		\
+		const key_type b = *(const key_type *)_b;		\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	_Static_assert(_Alignof(item_type) <= 8, "item type cannot have an alignment larger than 8"); \
+	_Static_assert(__DISK_BTREE_LEAF_CAPACITY(sizeof(item_type)) >= 2, "item type is too large"); \
+	_Static_assert(__DISK_BTREE_INNER_CAPACITY(sizeof(key_type)) >= 2, "key type is too large"); \
+									\
+	static _Alignas(32) const struct disk_btree_info name##_info = { \
+		.item_size = sizeof(item_type),				\
+		.key_size = sizeof(key_type),				\
+		.leaf_capacity = __DISK_BTREE_LEAF_CAPACITY(sizeof(item_type)), \
+		.inner_capacity = __DISK_BTREE_INNER_CAPACITY(sizeof(key_type)), \
+		.cmp = _##name##_compare,				\
+	};								\
+									\
+	/* returns false and sets errno if the file could not be opened or has the wrong format */ \
+	static _attr_unused bool name##_open(struct name *tree, const char *path) \
+	{								\
+		return _disk_btree_open(&tree->_impl, path, &name##_info); \
+	}								\
+									\
+	static _attr_unused void name##_close(struct name *tree)	\
+	{								\
+		_disk_btree_close(&tree->_impl);			\
+	}								\
+									\
+	static _attr_unused size_t name##_num_items(const struct name *tree) \
+	{								\
+		return tree->_impl.num_items;				\
+	}								\
+									\
+	/* the items have to be added in strictly ascending order (otherwise errno is set to EINVAL), */ \
+	/* if anything fails all following calls fail and finish returns false */ \
+	static _attr_unused bool name##_builder_start(name##_builder_t *builder, const char *path) \
+	{								\
+		return _disk_btree_builder_start(builder, path, &name##_info); \
+	}								\
+									\
+	static _attr_unused bool name##_builder_finish(name##_builder_t *builder) \
+	{								\
+		return _disk_btree_builder_finish(builder, &name##_info); \
+	}								\
+									\
+	/* items must be sorted and unique */				\
+	static _attr_unused bool name##_build(const char *path, const item_type *items, size_t n) \
+	{								\
+		name##_builder_t builder;				\
+		if (!_disk_btree_builder_start(&builder, path, &name##_info)) { \
+			return false;					\
+		}							\
+		for (size_t i = 0; i < n; i++) {			\
+			_disk_btree_builder_add(&builder, &items[i], &name##_info); \
+		}							\
+		return _disk_btree_builder_finish(&builder, &name##_info); \
+	}
+
+#define DEFINE_DISK_BTREE_SET(name, key_type, ...)			\
+	typedef key_type name##_key_t;					\
+									\
+	__DEFINE_DISK_BTREE_COMMON(name, name##_key_t, name##_key_t, __VA_ARGS__) \
+									\
+	static _attr_unused const name##_key_t *name##_find(const struct name *tree, name##_key_t key) \
+	{								\
+		return _disk_btree_find(&tree->_impl, &key, &name##_info); \
+	}								\
+									\
+	static _attr_unused bool name##_builder_add(name##_builder_t *builder, name##_key_t key) \
+	{								\
+		return _disk_btree_builder_add(builder, &key, &name##_info); \
+	}								\
+									\
+	static _attr_unused const name##_key_t *name##_iter_start_leftmost(name##_iter_t *iter, \
+									   const struct name *tree) \
+	{								\
+		return _disk_btree_iter_start(iter, &tree->_impl, false, &name##_info); \
+	}								\
+									\
+	static _attr_unused const name##_key_t *name##_iter_start_rightmost(name##_iter_t *iter, \
+									    const struct name *tree) \
+	{								\
+		return _disk_btree_iter_start(iter, &tree->_impl, true, &name##_info); \
+	}								\
+									\
+	static _attr_unused const name##_key_t *name##_iter_start_at(name##_iter_t *iter, \
+								     const struct name *tree, \
+								     name##_key_t key, \
+								     enum btree_iter_start_at_mode mode) \
+	{								\
+		return _disk_btree_iter_start_at(iter, &tree->_impl, &key, mode, &name##_info); \
+	}								\
+									\
+	static _attr_unused const name##_key_t *name##_iter_next(name##_iter_t *iter) \
+	{								\
+		return _disk_btree_iter_next(iter, &name##_info);	\
+	}								\
+									\
+	static _attr_unused const name##_key_t *name##_iter_prev(name##_iter_t *iter) \
+	{								\
+		return _disk_btree_iter_prev(iter, &name##_info);	\
+	}
+
+#define __DISK_BTREE_MAP_RETURN_KEY_AND_VALUE	\
+	if (!item) {				\
+		return NULL;			\
+	}					\
+	if (ret_key) {				\
+		*ret_key = item->key;		\
+	}					\
+	return &item->value
+
+#define DEFINE_DISK_BTREE_MAP(name, key_type, value_type, ...)		\
+	typedef key_type name##_key_t;					\
+	typedef value_type name##_value_t;				\
+	typedef struct { name##_key_t key; name##_value_t value; } _##name##_item_t; \
+	typedef _##name##_item_t name##_item_t;				\
+									\
+	__DEFINE_DISK_BTREE_COMMON(name, name##_item_t, name##_key_t, __VA_ARGS__) \
+									\
+	static _attr_unused const name##_value_t *name##_find(const struct name *tree, name##_key_t key) \
+	{								\
+		const _##name##_item_t *item = _disk_btree_find(&tree->_impl, &key, &name##_info); \
+		return item ? &item->value : NULL;			\
+	}								\
+									\
+	static _attr_unused bool name##_builder_add(name##_builder_t *builder, name##_key_t key, \
+						    name##_value_t value) \
+	{								\
+		return _disk_btree_builder_add(builder, &(_##name##_item_t){.key = key, .value = value}, \
+					       &name##_info);		\
+	}								\
+									\
+	static _attr_unused const name##_value_t *name##_iter_start_leftmost(name##_iter_t *iter, \
+									     const struct name *tree, \
+									     name##_key_t *ret_key) \
+	{								\
+		const _##name##_item_t *item = _disk_btree_iter_start(iter, &tree->_impl, false, &name##_info); \
+		__DISK_BTREE_MAP_RETURN_KEY_AND_VALUE;			\
+	}								\
+									\
+	static _attr_unused const name##_value_t *name##_iter_start_rightmost(name##_iter_t *iter, \
+									      const struct name *tree, \
+									      name##_key_t *ret_key) \
+	{								\
+		const _##name##_item_t *item = _disk_btree_iter_start(iter, &tree->_impl, true, &name##_info); \
+		__DISK_BTREE_MAP_RETURN_KEY_AND_VALUE;			\
+	}								\
+									\
+	static _attr_unused const name##_value_t *name##_iter_start_at(name##_iter_t *iter, \
+								       const struct name *tree, \
+								       name##_key_t key, name##_key_t *ret_key, \
+								       enum btree_iter_start_at_mode mode) \
+	{								\
+		const _##name##_item_t *item = _disk_btree_iter_start_at(iter, &tree->_impl, &key, mode, \
+									 &name##_info);	\
+		__DISK_BTREE_MAP_RETURN_KEY_AND_VALUE;			\
+	}								\
+									\
+	static _attr_unused const name##_value_t *name##_iter_next(name##_iter_t *iter, name##_key_t *ret_key) \
+	{								\
+		const _##name##_item_t *item = _disk_btree_iter_next(iter, &name##_info); \
+		__DISK_BTREE_MAP_RETURN_KEY_AND_VALUE;			\
+	}								\
+									\
+	static _attr_unused const name##_value_t *name##_iter_prev(name##_iter_t *iter, name##_key_t *ret_key) \
+	{								\
+		const _##name##_item_t *item = _disk_btree_iter_prev(iter, &name##_info); \
+		__DISK_BTREE_MAP_RETURN_KEY_AND_VALUE;			\
+	}
+
+bool _disk_btree_open(struct _disk_btree *tree, const char *path, const struct disk_btree_info *info);
+void _disk_btree_close(struct _disk_btree *tree);
+const void *_disk_btree_find(const struct _disk_btree *tree, const void *key, const struct disk_btree_info *info);
+const void *_disk_btree_iter_start(struct disk_btree_iter *iter, const struct _disk_btree *tree, bool rightmost,
+				   const struct disk_btree_info *info);
+const void *_disk_btree_iter_start_at(struct disk_btree_iter *iter, const struct _disk_btree *tree,
+				      const void *key, enum btree_iter_start_at_mode mode,
+				      const struct disk_btree_info *info);
+const void *_disk_btree_iter_next(struct disk_btree_iter *iter, const struct disk_btree_info *info);
+const void *_disk_btree_iter_prev(struct disk_btree_iter *iter, const struct disk_btree_info *info);
+bool _disk_btree_builder_start(struct disk_btree_builder *builder, const char *path,
+			       const struct disk_btree_info *info);
+bool _disk_btree_builder_add(struct disk_btree_builder *builder, const void *item,
+			     const struct disk_btree_info *info);
+bool _disk_btree_builder_finish(struct disk_btree_builder *builder, const struct disk_btree_info *info);
@@ -28,6 +28,7 @@
 #include <stdarg.h> // va_list
 #include <stdbool.h> // bool
 #include <stddef.h> // size_t
+#include "allocator.h"
 #include "compiler.h"
 #include "fortify.h"
 
@@ -58,6 +59,9 @@ struct strview_list {
 
 dstr_t dstr_new(void) _attr_nodiscard;
 dstr_t dstr_with_capacity(size_t capacity) _attr_nodiscard;
+// all (re)allocations of the returned string (and of its copies) use allocator (NULL means malloc/realloc/free)
+// (the string keeps the allocator when it is resized to a capacity of zero)
+dstr_t dstr_with_allocator(struct allocator *allocator, size_t capacity) _attr_nodiscard;
 dstr_t dstr_from_chars(const char *chars, size_t n) _attr_nodiscard;
 dstr_t dstr_from_cstr(const char *cstr) _attr_nodiscard;
 dstr_t dstr_from_view(struct strview view) _attr_nodiscard;
@@ -136,10 +140,11 @@ bool dstr_startswith_cstr(const dstr_t dstr, const char *prefix) _attr_pure;
 bool dstr_endswith_dstr(const dstr_t dstr, const dstr_t suffix) _attr_pure;
 bool dstr_endswith_view(const dstr_t dstr, struct strview suffix) _attr_pure;
 bool dstr_endswith_cstr(const dstr_t dstr, const char *suffix) _attr_pure;
-// TODO should these take multiple delimiters?
 struct dstr_list dstr_split(const dstr_t dstr, char c, size_t max) _attr_nodiscard;
 struct dstr_list dstr_rsplit(const dstr_t dstr, char c, size_t max) _attr_nodiscard;
 struct strview_list dstr_split_views(const dstr_t dstr, char c, size_t max) _attr_nodiscard;
+// splits at every character in delimiters (like strtok but empty strings between delimiters are kept)
+struct strview_list dstr_split_views_any(const dstr_t dstr, const char *delimiters, size_t max) _attr_nodiscard;
 struct strview_list dstr_rsplit_views(const dstr_t dstr, char c, size_t max) _attr_nodiscard;
 void dstr_list_free(struct dstr_list *list);
 
@@ -169,6 +174,7 @@ bool strview_startswith_cstr(struct strview view, const char *prefix) _attr_pure
 bool strview_endswith(struct strview view, struct strview suffix) _attr_pure;
 bool strview_endswith_cstr(struct strview view, const char *suffix) _attr_pure;
 struct strview_list strview_split(struct strview view, char c, size_t max) _attr_nodiscard;
+struct strview_list strview_split_any(struct strview view, const char *delimiters, size_t max) _attr_nodiscard;
 struct strview_list strview_rsplit(struct strview view, char c, size_t max) _attr_nodiscard;
 void strview_list_free(struct strview_list *list);
 
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include "allocator.h"
 #include "config.h"
 #include "compiler.h"
 
@@ -55,14 +56,21 @@
 		.keys_match = _##name##_keys_match,			\
 	};								\
 									\
-	static void name##_init(struct name *table, name##_uint_t initial_capacity) \
+	static _attr_unused void name##_init(struct name *table, name##_uint_t initial_capacity) \
 	{								\
-		_hashtable_init(&table->impl, initial_capacity, &_##name##_info); \
+		_hashtable_init(&table->impl, initial_capacity, NULL, &_##name##_info); \
+	}								\
+									\
+	/* like name##_init but the storage is (re)allocated with allocator */ \
+	static _attr_unused void name##_init_with_allocator(struct name *table, name##_uint_t initial_capacity, \
+							    struct allocator *allocator) \
+	{								\
+		_hashtable_init(&table->impl, initial_capacity, allocator, &_##name##_info); \
 	}								\
 									\
 	static _attr_unused void name##_destroy(struct name *table)	\
 	{								\
-		_hashtable_destroy(&table->impl);			\
+		_hashtable_destroy(&table->impl, &_##name##_info);	\
 	}								\
 									\
 	static _attr_unused void name##_clear(struct name *table)	\
@@ -173,10 +181,12 @@ struct _hashtable {
 	_hashtable_uint_t capacity;
 	unsigned char *storage;
 	struct _hashtable_metadata *metadata;
+	struct allocator *allocator;
 };
 
-void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity, const struct _hashtable_info *info);
-void _hashtable_destroy(struct _hashtable *table);
+void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity, struct allocator *allocator,
+		     const struct _hashtable_info *info);
+void _hashtable_destroy(struct _hashtable *table, const struct _hashtable_info *info);
 bool _hashtable_lookup(struct _hashtable *table, void *key, _hashtable_hash_t hash, _hashtable_idx_t *ret_index,
 		       const struct _hashtable_info *info) _attr_nodiscard;
 _hashtable_idx_t _hashtable_get_next(struct _hashtable *table, _hashtable_idx_t start,
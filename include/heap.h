@@ -2,6 +2,8 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include "fortify.h"
 
 // TODO document public API
@@ -155,6 +157,319 @@
 	}
 
 
+#define DHEAP_CACHE_LINE_SIZE 64
+#define _DHEAP_ALLOC_OFFSET(type) \
+	((DHEAP_CACHE_LINE_SIZE - sizeof(type) % DHEAP_CACHE_LINE_SIZE) % DHEAP_CACHE_LINE_SIZE)
+
+// Same API as DEFINE_BINHEAP but every node has 'arity' children (arity should be small, e.g. 4 or 8).
+// This makes the heap flatter (fewer cache misses for sift down) at the cost of more comparisons per level.
+// The children of node i are stored at indices arity * i + 1 to arity * i + arity. name##_alloc allocates an
+// array (use name##_free to free it) where the children of a node never straddle cache lines if
+// arity * sizeof(type) divides the cache line size.
+#define DEFINE_DHEAP(name, type, arity, ...)				\
+									\
+	_Static_assert((arity) >= 2, "arity must be at least 2");	\
+									\
+	static bool _##name##_less_than(type const *a, type const *b)	\
+	{								\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	static void _##name##_sift_up(type *arr, size_t start, size_t i) \
+	{								\
+		type tmp = arr[i];					\
+		while (i != start) {					\
+			size_t parent = _dheap_get_parent(i, (arity));	\
+			if (!_##name##_less_than(&tmp, &arr[parent])) { \
+				break;					\
+			}						\
+			arr[i] = arr[parent];				\
+			i = parent;					\
+		}							\
+		arr[i] = tmp;						\
+	}								\
+									\
+	/* returns the smallest child of i (or n if i has no children) */ \
+	static size_t _##name##_smallest_child(type const *arr, size_t n, size_t i) \
+	{								\
+		size_t first = _dheap_get_first_child(i, (arity));	\
+		if (first >= n) {					\
+			return n;					\
+		}							\
+		size_t smallest = first;				\
+		if (likely(n - first >= (arity))) {			\
+			/* constant trip count (unrolled, branchless) for full sibling groups */ \
+			for (size_t j = 1; j < (arity); j++) {		\
+				bool less = _##name##_less_than(&arr[first + j], &arr[smallest]); \
+				smallest = less ? first + j : smallest;	\
+			}						\
+			return smallest;				\
+		}							\
+		for (size_t child = first + 1; child < n; child++) {	\
+			if (_##name##_less_than(&arr[child], &arr[smallest])) { \
+				smallest = child;			\
+			}						\
+		}							\
+		return smallest;					\
+	}								\
+									\
+	static void _##name##_sift_down_bottom_up(type *arr, size_t n, size_t i) \
+	{								\
+		size_t start = i;					\
+		type tmp = arr[i];					\
+		for (;;) {						\
+			size_t smallest = _##name##_smallest_child(arr, n, i); \
+			if (smallest == n) {				\
+				break;					\
+			}						\
+			arr[i] = arr[smallest];				\
+			i = smallest;					\
+		}							\
+		arr[i] = tmp;						\
+		_##name##_sift_up(arr, start, i);			\
+	}								\
+									\
+	static void _##name##_sift_down(type *arr, size_t n, size_t i)	\
+	{								\
+		type tmp = arr[i];					\
+		for (;;) {						\
+			size_t smallest = _##name##_smallest_child(arr, n, i); \
+			if (smallest == n || !_##name##_less_than(&arr[smallest], &tmp)) { \
+				break;					\
+			}						\
+			arr[i] = arr[smallest];				\
+			i = smallest;					\
+		}							\
+		arr[i] = tmp;						\
+	}								\
+									\
+	static _attr_unused void name##_heapify(type *arr, size_t n)	\
+	{								\
+		if (n < 2) {						\
+			return;						\
+		}							\
+		for (size_t i = _dheap_get_parent(n - 1, (arity)) + 1; i-- > 0;) { \
+			_##name##_sift_down_bottom_up(arr, n, i);	\
+		}							\
+	}								\
+									\
+	static _attr_unused void name##_insert(type *arr, size_t i)	\
+	{								\
+		_##name##_sift_up(arr, 0, i);				\
+	}								\
+									\
+	static _attr_unused void name##_delete(type *arr, size_t n, size_t i) \
+	{								\
+		_fortify_check(i < n);					\
+		if (i == n - 1) {					\
+			return;						\
+		}							\
+		arr[i] = arr[n - 1];					\
+		_##name##_sift_down_bottom_up(arr, n - 1, i);		\
+		_##name##_sift_up(arr, 0, i);				\
+	}								\
+									\
+	static _attr_unused void name##_delete_first(type *arr, size_t n) \
+	{								\
+		_fortify_check(n != 0);					\
+		arr[0] = arr[n - 1];					\
+		_##name##_sift_down_bottom_up(arr, n - 1, 0);		\
+	}								\
+									\
+	static _attr_unused type name##_extract_first(type *arr, size_t n) \
+	{								\
+		_fortify_check(n != 0);					\
+		type result = arr[0];					\
+		name##_delete_first(arr, n);				\
+		return result;						\
+	}								\
+									\
+	static _attr_unused void name##_sift_up(type *arr, size_t n, size_t i) \
+	{								\
+		(void)n;						\
+		_fortify_check(i < n);					\
+		_##name##_sift_up(arr, 0, i);				\
+	}								\
+									\
+	static _attr_unused void name##_sift_down(type *arr, size_t n, size_t i) \
+	{								\
+		_fortify_check(i < n);					\
+		_##name##_sift_down(arr, n, i);				\
+	}								\
+									\
+	static _attr_unused size_t name##_is_heap_until(type const *arr, size_t n) \
+	{								\
+		for (size_t i = 1; i < n; i++) {			\
+			if (_##name##_less_than(&arr[i], &arr[_dheap_get_parent(i, (arity))])) { \
+				return i;				\
+			}						\
+		}							\
+		return n;						\
+	}								\
+									\
+	static _attr_unused bool name##_is_heap(type const *arr, size_t n) \
+	{								\
+		return name##_is_heap_until(arr, n) == n;		\
+	}								\
+									\
+	static _attr_unused void name##_sort(type *arr, size_t n)	\
+	{								\
+		for (size_t i = 0; i < n; i++) {			\
+			arr[n - 1 - i] = name##_extract_first(arr, n - i); \
+		}							\
+	}								\
+									\
+	/* element 1 (the first child of the root) starts a cache line, so all sibling groups start at */ \
+	/* a multiple of arity * sizeof(type) from the cache line boundary */ \
+	static _attr_unused type *name##_alloc(size_t n)		\
+	{								\
+		if (n > (SIZE_MAX - 2 * DHEAP_CACHE_LINE_SIZE) / sizeof(type)) { \
+			return NULL;					\
+		}							\
+		size_t size = _DHEAP_ALLOC_OFFSET(type) + n * sizeof(type); \
+		size = (size + DHEAP_CACHE_LINE_SIZE - 1) & ~(size_t)(DHEAP_CACHE_LINE_SIZE - 1); \
+		char *mem = aligned_alloc(DHEAP_CACHE_LINE_SIZE, size); \
+		return mem ? (type *)(mem + _DHEAP_ALLOC_OFFSET(type)) : NULL; \
+	}								\
+									\
+	static _attr_unused void name##_free(type *arr)			\
+	{								\
+		if (arr) {						\
+			free((char *)arr - _DHEAP_ALLOC_OFFSET(type));	\
+		}							\
+	}
+
+// Binary heap that calls 'set_position(type *element, size_t index)' whenever an element is stored at a new
+// index (e.g. to store the index in the element), which allows changing the priority of or removing any
+// element in O(log n) if its index is known.
+// decrease_key/increase_key must be called after the key of arr[i] was made smaller/larger ("smaller" means
+// higher priority, i.e. as defined by the less than expression).
+#define DEFINE_ADDRESSABLE_HEAP(name, type, set_position, ...)		\
+									\
+	static bool _##name##_less_than(type const *a, type const *b)	\
+	{								\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	static void _##name##_move(type *arr, size_t dest, type const *value) \
+	{								\
+		arr[dest] = *value;					\
+		set_position(&arr[dest], dest);				\
+	}								\
+									\
+	/* moves arr[i] up (the element is moved to its final position only once) */ \
+	static size_t _##name##_sift_up(type *arr, size_t i)		\
+	{								\
+		type tmp = arr[i];					\
+		while (i != 0) {					\
+			size_t parent = _heap_get_parent(i);		\
+			if (!_##name##_less_than(&tmp, &arr[parent])) {	\
+				break;					\
+			}						\
+			_##name##_move(arr, i, &arr[parent]);		\
+			i = parent;					\
+		}							\
+		_##name##_move(arr, i, &tmp);				\
+		return i;						\
+	}								\
+									\
+	static void _##name##_sift_down(type *arr, size_t n, size_t i)	\
+	{								\
+		type tmp = arr[i];					\
+		for (;;) {						\
+			size_t smallest = _heap_get_left_child(i);	\
+			if (smallest >= n) {				\
+				break;					\
+			}						\
+			size_t right = _heap_get_right_child(i);	\
+			if (right < n && _##name##_less_than(&arr[right], &arr[smallest])) { \
+				smallest = right;			\
+			}						\
+			if (!_##name##_less_than(&arr[smallest], &tmp)) { \
+				break;					\
+			}						\
+			_##name##_move(arr, i, &arr[smallest]);		\
+			i = smallest;					\
+		}							\
+		_##name##_move(arr, i, &tmp);				\
+	}								\
+									\
+	static _attr_unused void name##_heapify(type *arr, size_t n)	\
+	{								\
+		for (size_t i = n / 2; i < n; i++) {			\
+			set_position(&arr[i], i);			\
+		}							\
+		for (size_t i = n / 2; i-- > 0;) {			\
+			_##name##_sift_down(arr, n, i);			\
+		}							\
+	}								\
+									\
+	/* arr[i] is the new element */				\
+	static _attr_unused void name##_insert(type *arr, size_t i)	\
+	{								\
+		_##name##_sift_up(arr, i);				\
+	}								\
+									\
+	static _attr_unused void name##_decrease_key(type *arr, size_t n, size_t i) \
+	{								\
+		(void)n;						\
+		_fortify_check(i < n);					\
+		_##name##_sift_up(arr, i);				\
+	}								\
+									\
+	static _attr_unused void name##_increase_key(type *arr, size_t n, size_t i) \
+	{								\
+		_fortify_check(i < n);					\
+		_##name##_sift_down(arr, n, i);				\
+	}								\
+									\
+	/* the key of arr[i] was changed in any direction */		\
+	static _attr_unused void name##_update(type *arr, size_t n, size_t i) \
+	{								\
+		_fortify_check(i < n);					\
+		if (_##name##_sift_up(arr, i) == i) {			\
+			_##name##_sift_down(arr, n, i);			\
+		}							\
+	}								\
+									\
+	/* removes arr[i] (the heap has n - 1 elements afterwards) */	\
+	static _attr_unused type name##_delete(type *arr, size_t n, size_t i) \
+	{								\
+		_fortify_check(i < n);					\
+		type result = arr[i];					\
+		if (i != n - 1) {					\
+			_##name##_move(arr, i, &arr[n - 1]);		\
+			name##_update(arr, n - 1, i);			\
+		}							\
+		return result;						\
+	}								\
+									\
+	static _attr_unused type name##_extract_first(type *arr, size_t n) \
+	{								\
+		_fortify_check(n != 0);					\
+		type result = arr[0];					\
+		if (n > 1) {						\
+			_##name##_move(arr, 0, &arr[n - 1]);		\
+			_##name##_sift_down(arr, n - 1, 0);		\
+		}							\
+		return result;						\
+	}								\
+									\
+	static _attr_unused size_t name##_is_heap_until(type const *arr, size_t n) \
+	{								\
+		for (size_t i = 1; i < n; i++) {			\
+			if (_##name##_less_than(&arr[i], &arr[_heap_get_parent(i)])) { \
+				return i;				\
+			}						\
+		}							\
+		return n;						\
+	}								\
+									\
+	static _attr_unused bool name##_is_heap(type const *arr, size_t n) \
+	{								\
+		return name##_is_heap_until(arr, n) == n;		\
+	}
+
 // TODO put _Static_assert(1, "") at the end of this macro (and other macros like this) to allow/force a
 // semicolon after macro instantiation?
 
@@ -172,3 +487,13 @@ static inline size_t _heap_get_right_child(size_t index)
 {
 	return 2 * index + 2;
 }
+
+static inline size_t _dheap_get_parent(size_t index, size_t arity)
+{
+	return (index - 1) / arity;
+}
+
+static inline size_t _dheap_get_first_child(size_t index, size_t arity)
+{
+	return arity * index + 1;
+}
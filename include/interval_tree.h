@@ -0,0 +1,62 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "compiler.h"
+#include "rb_tree.h"
+
+/*
+ * Intrusive interval tree (augmented red-black tree ordered by start) for closed intervals [start, last].
+ * Every node also stores the maximum last of its subtree, so overlap queries only visit the subtrees that can
+ * contain overlapping intervals (O(log n + k) for k results). Intervals do not have to be unique.
+ */
+
+struct interval_tree_node {
+	struct rb_node rb_node;
+	uint64_t start;
+	uint64_t last;
+	uint64_t _subtree_last;
+};
+
+struct interval_tree {
+	struct rb_tree tree;
+};
+
+#define INTERVAL_TREE_EMPTY ((struct interval_tree){RB_EMPTY_TREE})
+
+// node->start and node->last have to be set
+void interval_tree_insert(struct interval_tree *tree, struct interval_tree_node *node);
+void interval_tree_remove(struct interval_tree *tree, struct interval_tree_node *node);
+// replaces the contents of the tree with the n nodes (which have to be sorted by start) in O(n)
+void interval_tree_build_sorted(struct interval_tree *tree, struct interval_tree_node **nodes, size_t n);
+// moves all intervals of src into dest in O(n + m)
+void interval_tree_union(struct interval_tree *dest, struct interval_tree *src);
+
+// iterate over all intervals that overlap with [start, last] (ordered by start)
+struct interval_tree_node *interval_tree_iter_first(const struct interval_tree *tree, uint64_t start,
+						    uint64_t last) _attr_pure;
+struct interval_tree_node *interval_tree_iter_next(const struct interval_tree_node *node, uint64_t start,
+						   uint64_t last) _attr_pure;
+
+#define interval_tree_foreach_overlap(tree, start, last, itername)	\
+	for (struct interval_tree_node *(itername) = interval_tree_iter_first((tree), (start), (last)); \
+	     (itername); (itername) = interval_tree_iter_next((itername), (start), (last)))
@@ -0,0 +1,122 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// Arena (bump) allocator
+// Allocations are carved out of big chunks and are released all at once with mem_arena_reset (which keeps the
+// chunks for reuse), mem_arena_rewind (back to a savepoint) or mem_arena_destroy. Chunks grow geometrically from
+// MEM_ARENA_MIN_CHUNK_SIZE to MEM_ARENA_MAX_CHUNK_SIZE, allocations bigger than MEM_ARENA_LARGE_THRESHOLD get
+// their own chunk (which is released immediately by the allocator interface). An arena is not thread-safe.
+//
+// The arena can be used as an allocator for the containers (see allocator.h), e.g. for one arena per request:
+//         array_t(int) arr = array_new_with_allocator(int, 0, mem_arena_allocator(&arena));
+//         ...
+//         mem_arena_reset(&arena); // instead of freeing the containers
+// Freeing or shrinking the most recent allocation gives the memory back to the arena, reallocating the most
+// recent allocation grows it in place if possible (which is the common case for a growing array or string).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "allocator.h"
+#include "compiler.h"
+
+#ifndef MEM_ARENA_MIN_CHUNK_SIZE
+#define MEM_ARENA_MIN_CHUNK_SIZE 4096
+#endif
+#ifndef MEM_ARENA_MAX_CHUNK_SIZE
+#define MEM_ARENA_MAX_CHUNK_SIZE (1024 * 1024)
+#endif
+#ifndef MEM_ARENA_LARGE_THRESHOLD
+#define MEM_ARENA_LARGE_THRESHOLD (128 * 1024)
+#endif
+#define MEM_ARENA_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+_Static_assert(MEM_ARENA_MIN_CHUNK_SIZE <= MEM_ARENA_MAX_CHUNK_SIZE, "");
+_Static_assert(MEM_ARENA_LARGE_THRESHOLD <= MEM_ARENA_MAX_CHUNK_SIZE / 2, "");
+
+enum mem_arena_flags {
+	// back the chunks with transparent huge pages (mmap + madvise, only where available)
+	// (all chunks are MEM_ARENA_HUGE_PAGE_SIZE big, as are large allocations which are at least that size)
+	MEM_ARENA_HUGE_PAGES = 1,
+};
+
+struct mem_arena {
+	struct allocator allocator;
+	// do not access these fields directly
+	char *_ptr; // start of the free space in the current chunk
+	char *_end;
+	struct _mem_arena_chunk *_current; // linked to the older chunks
+	struct _mem_arena_chunk *_spare; // chunks which are reused after a reset or rewind
+	struct _mem_arena_chunk *_large; // large allocations (newest first)
+	uint64_t _large_seq;
+	size_t _next_chunk_size;
+	unsigned int _flags;
+};
+
+struct mem_arena_savepoint {
+	// do not access these fields directly
+	struct _mem_arena_chunk *_chunk;
+	char *_ptr;
+	uint64_t _large_seq;
+};
+
+// initialize an arena (does not allocate any memory), flags is a combination of enum mem_arena_flags (or 0)
+void mem_arena_init(struct mem_arena *arena, unsigned int flags);
+// release all memory of the arena (you need to reinitialize it before using it again)
+void mem_arena_destroy(struct mem_arena *arena);
+// release all allocations, but keep the chunks for the following allocations (except for large allocations)
+void mem_arena_reset(struct mem_arena *arena);
+// return a savepoint which can be used to release all allocations which are made after this call
+struct mem_arena_savepoint mem_arena_save(const struct mem_arena *arena) _attr_pure;
+// release all allocations made since the savepoint was created
+// (the savepoint becomes invalid if the arena is rewound to an older savepoint or reset)
+void mem_arena_rewind(struct mem_arena *arena, struct mem_arena_savepoint savepoint);
+
+void *_mem_arena_alloc_slow(struct mem_arena *arena, size_t size, size_t alignment) _attr_nodiscard;
+
+// allocate size bytes aligned to alignment (which must be a power of two), aborts if out of memory (never returns
+// NULL, also not for a size of 0)
+static inline _attr_unused _attr_nodiscard void *mem_arena_alloc_aligned(struct mem_arena *arena, size_t size,
+									 size_t alignment)
+{
+	size_t padding = -(uintptr_t)arena->_ptr & (alignment - 1);
+	// _ptr is NULL if the arena has no current chunk (which would return NULL for a size of 0)
+	if (likely(size <= MEM_ARENA_LARGE_THRESHOLD && size + padding <= (size_t)(arena->_end - arena->_ptr) &&
+		   arena->_ptr)) {
+		void *p = arena->_ptr + padding;
+		arena->_ptr += padding + size;
+		return p;
+	}
+	return _mem_arena_alloc_slow(arena, size, alignment);
+}
+
+// allocate size bytes aligned to _Alignof(max_align_t), aborts if out of memory
+static inline _attr_unused _attr_nodiscard void *mem_arena_alloc(struct mem_arena *arena, size_t size)
+{
+	return mem_arena_alloc_aligned(arena, size, _Alignof(max_align_t));
+}
+
+// the arena as an allocator for the containers (see allocator.h)
+static inline _attr_unused struct allocator *mem_arena_allocator(struct mem_arena *arena)
+{
+	return &arena->allocator;
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// Allocator for large, growing buffers (arrays, dstrings and dbufs of many megabytes)
+// Allocations bigger than the threshold are backed by their own anonymous memory mapping (optionally with
+// transparent huge pages, which reduces the TLB pressure). Growing them uses mremap, which moves the page table
+// entries instead of copying the content, and shrinking them unmaps the pages at the end, which returns the memory
+// to the operating system right away. Smaller allocations use malloc. Where mmap is not available (or with
+// disabled feature detection) all allocations use malloc, where mremap is not available a mapping is grown by
+// mapping new memory and copying the content.
+//
+// Use it like any other allocator (see allocator.h):
+//         struct page_allocator pages;
+//         page_allocator_init(&pages, 0, PAGE_ALLOCATOR_HUGE_PAGES);
+//         array_t(struct event) events = array_new_with_allocator(struct event, 0, page_allocator(&pages));
+//         struct dbuf buf;
+//         dbuf_init_with_allocator(&buf, page_allocator(&pages));
+// The page allocator does not have any state besides its configuration, so one instance can be shared by any
+// number of containers and threads.
+
+#include <stddef.h>
+#include "allocator.h"
+#include "compiler.h"
+
+#ifndef PAGE_ALLOCATOR_DEFAULT_THRESHOLD
+#define PAGE_ALLOCATOR_DEFAULT_THRESHOLD (1024 * 1024)
+#endif
+#define PAGE_ALLOCATOR_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+enum page_allocator_flags {
+	// use transparent huge pages for the mappings (mmap + madvise, only where available)
+	// (the mappings are aligned to and sized in multiples of PAGE_ALLOCATOR_HUGE_PAGE_SIZE)
+	PAGE_ALLOCATOR_HUGE_PAGES = 1,
+};
+
+struct page_allocator {
+	struct allocator allocator;
+	// do not access these fields directly
+	size_t _threshold;
+	unsigned int _flags;
+};
+
+// allocations bigger than threshold bytes (0 means PAGE_ALLOCATOR_DEFAULT_THRESHOLD) get their own mapping,
+// flags is a combination of enum page_allocator_flags (or 0)
+void page_allocator_init(struct page_allocator *pages, size_t threshold, unsigned int flags);
+
+// the page allocator as an allocator for the containers (see allocator.h)
+static inline _attr_unused struct allocator *page_allocator(struct page_allocator *pages)
+{
+	return &pages->allocator;
+}
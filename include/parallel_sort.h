@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "compiler.h"
+#include "sort.h"
+
+// Parallel sort with POSIX threads (link with -pthread).
+// The array is split into one run per thread, each thread sorts its run with pdqsort (see DEFINE_SORTFUNC).
+// Then splitters are chosen from a sample of the sorted runs, which divides every run into one slice per
+// thread. Each thread merges its slices (one from every run) into a temporary buffer with a k-way merge
+// (see DEFINE_K_WAY_MERGE) and copies the result back. If several splitters are equal (few distinct keys), the
+// elements equal to them are divided between the corresponding slices, so the merge phase stays balanced.
+// The sort is not stable and needs a temporary buffer of the same size as the array.
+//
+// 'name' is the identifier of the sort function.
+// 'type' is the element type of the array to sort.
+// The last argument is a comparison expression like for DEFINE_SORTFUNC.
+// Example:
+//   DEFINE_PARALLEL_SORTFUNC(parallel_integer_sort, int, (*a > *b) - (*a < *b))
+//   parallel_integer_sort(array, n, 0); // use one thread per online CPU
+
+// arrays with less than this number of elements per thread are sorted with fewer threads
+#define PARALLEL_SORT_MIN_RUN_SIZE    65536
+// number of samples per run for choosing the splitters
+#define _PARALLEL_SORT_OVERSAMPLING   64
+#define _PARALLEL_SORT_MAX_THREADS    1024
+
+static inline unsigned int _parallel_sort_num_threads(size_t n, unsigned int num_threads)
+{
+	if (num_threads == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		num_threads = cpus > 0 ? (unsigned int)cpus : 1;
+	}
+	if (num_threads > _PARALLEL_SORT_MAX_THREADS) {
+		num_threads = _PARALLEL_SORT_MAX_THREADS;
+	}
+	size_t max_threads = n / PARALLEL_SORT_MIN_RUN_SIZE;
+	if (num_threads > max_threads) {
+		num_threads = max_threads > 0 ? (unsigned int)max_threads : 1;
+	}
+	return num_threads;
+}
+
+#define DEFINE_PARALLEL_SORTFUNC(name, type, ...)			\
+	DEFINE_SORTFUNC(_##name##_seq, type, __VA_ARGS__)		\
+									\
+	DEFINE_K_WAY_MERGE(_##name##_merge, type, __VA_ARGS__)		\
+									\
+	struct _##name##_ctx {						\
+		type *arr;						\
+		type *buffer;						\
+		unsigned int num_threads;				\
+		size_t *bounds; /* run r is [bounds[r], bounds[r + 1]) */ \
+		size_t *splits; /* slice p of run r starts at splits[p * num_threads + r] */ \
+		pthread_barrier_t barrier;				\
+	};								\
+									\
+	struct _##name##_thread {					\
+		struct _##name##_ctx *ctx;				\
+		unsigned int idx;					\
+		pthread_t thread;					\
+	};								\
+									\
+	/* first position in [begin, end) that is not less than key */	\
+	static size_t _##name##_lower_bound(const type *arr, size_t begin, size_t end, const type *key) \
+	{								\
+		while (begin < end) {					\
+			size_t mid = begin + (end - begin) / 2;		\
+			if (__##name##_seq_cmp(&arr[mid], key) < 0) {	\
+				begin = mid + 1;			\
+			} else {					\
+				end = mid;				\
+			}						\
+		}							\
+		return begin;						\
+	}								\
+									\
+	/* first position in [begin, end) that is greater than key */	\
+	static size_t _##name##_upper_bound(const type *arr, size_t begin, size_t end, const type *key) \
+	{								\
+		while (begin < end) {					\
+			size_t mid = begin + (end - begin) / 2;		\
+			if (__##name##_seq_cmp(key, &arr[mid]) >= 0) {	\
+				begin = mid + 1;			\
+			} else {					\
+				end = mid;				\
+			}						\
+		}							\
+		return begin;						\
+	}								\
+									\
+	static void _##name##_compute_splits(struct _##name##_ctx *ctx) \
+	{								\
+		unsigned int t = ctx->num_threads;			\
+		size_t num_samples = (size_t)t * _PARALLEL_SORT_OVERSAMPLING; \
+		type *samples = malloc(num_samples * sizeof(samples[0])); \
+		if (!samples) {						\
+			abort();					\
+		}							\
+		for (unsigned int r = 0; r < t; r++) {			\
+			size_t size = ctx->bounds[r + 1] - ctx->bounds[r]; \
+			for (size_t s = 0; s < _PARALLEL_SORT_OVERSAMPLING; s++) { \
+				size_t i = ctx->bounds[r] + (2 * s + 1) * size / (2 * _PARALLEL_SORT_OVERSAMPLING); \
+				samples[r * _PARALLEL_SORT_OVERSAMPLING + s] = ctx->arr[i]; \
+			}						\
+		}							\
+		_##name##_seq(samples, num_samples);			\
+		for (unsigned int r = 0; r < t; r++) {			\
+			ctx->splits[r] = ctx->bounds[r];		\
+			ctx->splits[(size_t)t * t + r] = ctx->bounds[r + 1]; \
+		}							\
+		for (unsigned int p = 1; p < t;) {			\
+			const type *splitter = &samples[(size_t)p * _PARALLEL_SORT_OVERSAMPLING]; \
+			/* the splitters p to q - 1 are equal (a frequent key), the elements equal to it are */ \
+			/* divided evenly between the slices p to q - 1 instead of all going to slice q - 1 */ \
+			unsigned int q = p + 1;				\
+			while (q < t && __##name##_seq_cmp(&samples[(size_t)q * _PARALLEL_SORT_OVERSAMPLING], \
+							    splitter) == 0) { \
+				q++;					\
+			}						\
+			for (unsigned int r = 0; r < t; r++) {		\
+				size_t lo = _##name##_lower_bound(ctx->arr, ctx->bounds[r], ctx->bounds[r + 1], \
+								  splitter); \
+				size_t hi = q - p == 1 ? lo : _##name##_upper_bound(ctx->arr, lo, ctx->bounds[r + 1], \
+											splitter); \
+				for (unsigned int j = 0; j < q - p; j++) { \
+					ctx->splits[(size_t)(p + j) * t + r] = lo + (hi - lo) * j / (q - p); \
+				}					\
+			}						\
+			p = q;						\
+		}							\
+		free(samples);						\
+	}								\
+									\
+	static void *_##name##_thread_main(void *arg)			\
+	{								\
+		struct _##name##_thread *thread = arg;			\
+		struct _##name##_ctx *ctx = thread->ctx;		\
+		unsigned int t = ctx->num_threads;			\
+		unsigned int p = thread->idx;				\
+		_##name##_seq(ctx->arr + ctx->bounds[p], ctx->bounds[p + 1] - ctx->bounds[p]); \
+		pthread_barrier_wait(&ctx->barrier);			\
+		if (p == 0) {						\
+			_##name##_compute_splits(ctx);			\
+		}							\
+		pthread_barrier_wait(&ctx->barrier);			\
+		/* merge slice p of every run, the output starts after the smaller slices of all runs */ \
+		const size_t *start = &ctx->splits[(size_t)p * t];	\
+		const size_t *end = &ctx->splits[(size_t)(p + 1) * t]; \
+		size_t out_begin = 0;					\
+		for (unsigned int r = 0; r < t; r++) {			\
+			out_begin += start[r] - ctx->bounds[r];		\
+		}							\
+		type **runs = malloc(t * sizeof(runs[0]));		\
+		size_t *lengths = malloc(t * sizeof(lengths[0]));	\
+		if (!runs || !lengths) {				\
+			abort();					\
+		}							\
+		for (unsigned int r = 0; r < t; r++) {			\
+			runs[r] = ctx->arr + start[r];			\
+			lengths[r] = end[r] - start[r];			\
+		}							\
+		size_t out_size = _##name##_merge(ctx->buffer + out_begin, runs, lengths, t); \
+		free(lengths);						\
+		free(runs);						\
+		pthread_barrier_wait(&ctx->barrier);			\
+		memcpy(ctx->arr + out_begin, ctx->buffer + out_begin, out_size * sizeof(type)); \
+		return NULL;						\
+	}								\
+									\
+	/* sorts with up to num_threads threads (0 means one per online CPU) */ \
+	static _attr_unused void name(type *arr, size_t n, unsigned int num_threads) \
+	{								\
+		unsigned int t = _parallel_sort_num_threads(n, num_threads); \
+		if (t == 1) {						\
+			_##name##_seq(arr, n);				\
+			return;						\
+		}							\
+		struct _##name##_ctx ctx = {				\
+			.arr = arr,					\
+			.buffer = malloc(n * sizeof(arr[0])),		\
+			.num_threads = t,				\
+			.bounds = malloc((t + 1) * sizeof(size_t)),	\
+			.splits = malloc(((size_t)t + 1) * t * sizeof(size_t)), \
+		};							\
+		struct _##name##_thread *threads = malloc(t * sizeof(threads[0])); \
+		if (!ctx.buffer || !ctx.bounds || !ctx.splits || !threads) { \
+			abort();					\
+		}							\
+		for (unsigned int r = 0; r <= t; r++) {			\
+			ctx.bounds[r] = n / t * r + (r < n % t ? r : n % t); \
+		}							\
+		pthread_barrier_init(&ctx.barrier, NULL, t);		\
+		for (unsigned int i = 0; i < t; i++) {			\
+			threads[i].ctx = &ctx;				\
+			threads[i].idx = i;				\
+			if (i != 0 && pthread_create(&threads[i].thread, NULL, _##name##_thread_main, &threads[i])) { \
+				abort();				\
+			}						\
+		}							\
+		_##name##_thread_main(&threads[0]);			\
+		for (unsigned int i = 1; i < t; i++) {			\
+			pthread_join(threads[i].thread, NULL);		\
+		}							\
+		pthread_barrier_destroy(&ctx.barrier);			\
+		free(threads);						\
+		free(ctx.splits);					\
+		free(ctx.bounds);					\
+		free(ctx.buffer);					\
+	}
@@ -0,0 +1,147 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "array.h"
+#include "compiler.h"
+#include "fortify.h"
+#include "utils.h"
+
+// Radix heap: priority queue for unsigned integer keys where the keys are monotone, i.e. a new key must never
+// be smaller than the last extracted key (e.g. timestamps in an event scheduler or distances in Dijkstra's
+// algorithm). Insert is O(1), extract_first is amortized O(log C) (C is the largest difference between keys)
+// because each item moves to a smaller bucket at most 64 times.
+// The buckets are arrays that are only appended to and scanned sequentially.
+// Bucket 0 contains the items with key == last, bucket i > 0 contains the items where the highest bit that
+// differs between key and last is bit i - 1.
+
+static inline unsigned int _radix_heap_bucket(uint64_t key, uint64_t last)
+{
+	return 64 - _clzll(key ^ last);
+}
+
+#define DEFINE_RADIX_HEAP(name, value_type)				\
+	typedef value_type name##_value_t;				\
+									\
+	struct _##name##_item {						\
+		uint64_t key;						\
+		name##_value_t value;					\
+	};								\
+									\
+	struct name {							\
+		uint64_t last; /* all keys in the heap are >= last */	\
+		uint64_t nonempty; /* bit i - 1 is set if bucket i (i > 0) is not empty */ \
+		size_t num_items;					\
+		array_t(struct _##name##_item) buckets[65];		\
+	};								\
+									\
+	static _attr_unused void name##_init(struct name *heap)		\
+	{								\
+		memset(heap, 0, sizeof(*heap));				\
+	}								\
+									\
+	static _attr_unused void name##_destroy(struct name *heap)	\
+	{								\
+		for (unsigned int i = 0; i < 65; i++) {			\
+			array_free(heap->buckets[i]);			\
+		}							\
+		heap->num_items = 0;					\
+		heap->nonempty = 0;					\
+	}								\
+									\
+	static _attr_unused size_t name##_num_items(const struct name *heap) \
+	{								\
+		return heap->num_items;					\
+	}								\
+									\
+	static _attr_unused bool name##_empty(const struct name *heap)	\
+	{								\
+		return heap->num_items == 0;				\
+	}								\
+									\
+	static inline void _##name##_add_to_bucket(struct name *heap, struct _##name##_item item) \
+	{								\
+		unsigned int bucket = _radix_heap_bucket(item.key, heap->last); \
+		array_add(heap->buckets[bucket], item);			\
+		if (bucket != 0) {					\
+			heap->nonempty |= (uint64_t)1 << (bucket - 1);	\
+		}							\
+	}								\
+									\
+	/* key must be >= the last extracted key */			\
+	static _attr_unused void name##_insert(struct name *heap, uint64_t key, name##_value_t value) \
+	{								\
+		_fortify_check(key >= heap->last);			\
+		_##name##_add_to_bucket(heap, (struct _##name##_item){.key = key, .value = value}); \
+		heap->num_items++;					\
+	}								\
+									\
+	/* makes sure that bucket 0 contains the minimum (the heap must not be empty) */ \
+	static void _##name##_refill(struct name *heap)			\
+	{								\
+		if (!array_empty(heap->buckets[0])) {			\
+			return;						\
+		}							\
+		unsigned int bucket = _ctzll(heap->nonempty) + 1;	\
+		struct _##name##_item *items = heap->buckets[bucket];	\
+		size_t n = array_length(items);				\
+		uint64_t min = items[0].key;				\
+		for (size_t i = 1; i < n; i++) {			\
+			min = items[i].key < min ? items[i].key : min;	\
+		}							\
+		heap->last = min;					\
+		heap->nonempty &= ~((uint64_t)1 << (bucket - 1));	\
+		/* all items go to smaller buckets */			\
+		for (size_t i = 0; i < n; i++) {			\
+			_##name##_add_to_bucket(heap, items[i]);	\
+		}							\
+		array_clear(heap->buckets[bucket]);			\
+	}								\
+									\
+	/* returns the smallest key (the heap must not be empty) */	\
+	static _attr_unused uint64_t name##_first_key(struct name *heap) \
+	{								\
+		_fortify_check(heap->num_items != 0);			\
+		_##name##_refill(heap);					\
+		return heap->last;					\
+	}								\
+									\
+	/* returns false if the heap is empty (ret_key and ret_value may be NULL) */ \
+	static _attr_unused bool name##_extract_first(struct name *heap, uint64_t *ret_key, \
+						      name##_value_t *ret_value) \
+	{								\
+		if (heap->num_items == 0) {				\
+			return false;					\
+		}							\
+		_##name##_refill(heap);					\
+		struct _##name##_item item = array_pop(heap->buckets[0]); \
+		heap->num_items--;					\
+		if (ret_key) {						\
+			*ret_key = item.key;				\
+		}							\
+		if (ret_value) {					\
+			*ret_value = item.value;			\
+		}							\
+		return true;						\
+	}
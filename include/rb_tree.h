@@ -19,11 +19,14 @@
 
 #pragma once
 
-// TODO documentation, high-level API (see tests/rb_tree.c)
+// TODO documentation
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "config.h"
 #include "compiler.h"
+#include "macros.h"
 
 enum rb_direction {
 	RB_LEFT = 0,
@@ -48,11 +51,227 @@ struct rb_tree {
 
 #define RB_EMPTY_TREE ((struct rb_tree){NULL})
 
+// tree that also keeps track of the leftmost (minimum) node
+struct rb_tree_cached {
+	struct rb_tree tree;
+	struct rb_node *leftmost;
+};
+
+#define RB_EMPTY_TREE_CACHED ((struct rb_tree_cached){{NULL}, NULL})
+
 #define rb_foreach(rb_root, itername)					\
 	for (struct rb_node *(itername) = rb_first(rb_root); (itername); (itername) = rb_next(cur))
 
 void rb_remove_node(struct rb_tree *root, struct rb_node *node);
 void rb_insert_node(struct rb_tree *root, struct rb_node *node, struct rb_node *parent, enum rb_direction dir);
+void rb_insert_node_cached(struct rb_tree_cached *root, struct rb_node *node, struct rb_node *parent,
+			  enum rb_direction dir);
+void rb_remove_node_cached(struct rb_tree_cached *root, struct rb_node *node);
+
+/*
+ * Replaces the contents of the tree with the n nodes (which have to be sorted) in O(n).
+ * This and rb_union do not compute augmented values, use the _augmented versions for augmented trees.
+ */
+void rb_build_sorted(struct rb_tree *root, struct rb_node **nodes, size_t n);
+/*
+ * Moves all nodes of src into dest in O(n + m) (both trees have to be ordered by cmp).
+ * If duplicate is NULL, nodes with equal keys are all kept (the ones from dest first), otherwise the nodes from
+ * src that are equal to a node in dest are passed to duplicate instead.
+ */
+void rb_union(struct rb_tree *dest, struct rb_tree *src,
+	      int (*cmp)(const struct rb_node *a, const struct rb_node *b),
+	      void (*duplicate)(struct rb_node *node));
+
+static inline struct rb_node *rb_first_cached(const struct rb_tree_cached *root)
+{
+	return root->leftmost;
+}
+
+/*
+ * Augmented trees store an additional value in each node that is computed from the node and its children
+ * (e.g. the maximum end of all intervals in the subtree or the size of the subtree).
+ * propagate: recompute the value for node and its ancestors until stop is reached
+ *            (it may stop early if the value of a node does not change)
+ * copy:      copy the value from old to new (new takes the place of old in the tree)
+ * rotate:    new took the place of old through a rotation, so the value of new is the old value of old,
+ *            the value of old has to be recomputed
+ * The value of a new node has to be initialized (as if it had no children) before it is inserted.
+ */
+struct rb_augment_callbacks {
+	void (*propagate)(struct rb_node *node, struct rb_node *stop);
+	void (*copy)(struct rb_node *old, struct rb_node *new);
+	void (*rotate)(struct rb_node *old, struct rb_node *new);
+};
+
+void rb_remove_node_augmented(struct rb_tree *root, struct rb_node *node, const struct rb_augment_callbacks *augment);
+void rb_insert_node_augmented(struct rb_tree *root, struct rb_node *node, struct rb_node *parent,
+			      enum rb_direction dir, const struct rb_augment_callbacks *augment);
+// like rb_build_sorted and rb_union, the augmented values are computed bottom-up (propagate is called once per node)
+void rb_build_sorted_augmented(struct rb_tree *root, struct rb_node **nodes, size_t n,
+			       const struct rb_augment_callbacks *augment);
+void rb_union_augmented(struct rb_tree *dest, struct rb_tree *src,
+			int (*cmp)(const struct rb_node *a, const struct rb_node *b),
+			void (*duplicate)(struct rb_node *node), const struct rb_augment_callbacks *augment);
 struct rb_node *rb_first(const struct rb_tree *root) _attr_pure;
 struct rb_node *rb_parent(const struct rb_node *node) _attr_pure;
 struct rb_node *rb_next(const struct rb_node *node) _attr_pure;
+struct rb_node *rb_prev(const struct rb_node *node) _attr_pure;
+
+/*
+ * DEFINE_RB_TREE generates type-safe functions for a tree of "type" entries that embed a struct rb_node
+ * (node_member) and are ordered by their key (key_member). The last argument is a comparison expression of the
+ * keys a and b (like for DEFINE_BTREE_SET), it gets inlined into the descent loops. Keys have to be unique.
+ */
+#define DEFINE_RB_TREE(name, type, node_member, key_type, key_member, ...) \
+	typedef key_type name##_key_t;					\
+									\
+	static inline int _##name##_compare(const name##_key_t a, const name##_key_t b) \
+	{								\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	static _attr_unused type *name##_entry(const struct rb_node *node) \
+	{								\
+		return node ? container_of(node, type, node_member) : NULL; \
+	}								\
+									\
+	/* returns the node with the key or NULL and the position where it would be inserted */ \
+	static inline struct rb_node *_##name##_descend(const struct rb_tree *tree, const name##_key_t key, \
+							struct rb_node **ret_parent, \
+							enum rb_direction *ret_dir) \
+	{								\
+		struct rb_node *parent = NULL;				\
+		struct rb_node *cur = tree->root;			\
+		enum rb_direction dir = RB_LEFT;			\
+		while (cur) {						\
+			int cmp = _##name##_compare(key, container_of(cur, type, node_member)->key_member); \
+			if (cmp == 0) {					\
+				break;					\
+			}						\
+			dir = cmp < 0 ? RB_LEFT : RB_RIGHT;		\
+			parent = cur;					\
+			cur = cur->children[dir];			\
+		}							\
+		*ret_parent = parent;					\
+		*ret_dir = dir;						\
+		return cur;						\
+	}								\
+									\
+	static _attr_unused type *name##_find(const struct rb_tree *tree, const name##_key_t key) \
+	{								\
+		struct rb_node *parent;					\
+		enum rb_direction dir;					\
+		return name##_entry(_##name##_descend(tree, key, &parent, &dir)); \
+	}								\
+									\
+	/* returns the entry with the same key if there is one, otherwise inserts entry and returns it */ \
+	static _attr_unused type *name##_find_or_insert(struct rb_tree *tree, type *entry) \
+	{								\
+		struct rb_node *parent;					\
+		enum rb_direction dir;					\
+		struct rb_node *node = _##name##_descend(tree, entry->key_member, &parent, &dir); \
+		if (node) {						\
+			return container_of(node, type, node_member);	\
+		}							\
+		rb_insert_node(tree, &entry->node_member, parent, dir); \
+		return entry;						\
+	}								\
+									\
+	/* returns false (and does not insert entry) if the key already exists */ \
+	static _attr_unused bool name##_insert(struct rb_tree *tree, type *entry) \
+	{								\
+		return name##_find_or_insert(tree, entry) == entry;	\
+	}								\
+									\
+	/* returns the first entry with a key >= key (inclusive) or > key (!inclusive) */ \
+	static inline type *_##name##_bound(const struct rb_tree *tree, const name##_key_t key, bool inclusive) \
+	{								\
+		struct rb_node *result = NULL;				\
+		struct rb_node *cur = tree->root;			\
+		while (cur) {						\
+			int cmp = _##name##_compare(key, container_of(cur, type, node_member)->key_member); \
+			if (cmp < 0 || (inclusive && cmp == 0)) {	\
+				result = cur;				\
+				cur = cur->left;			\
+			} else {					\
+				cur = cur->right;			\
+			}						\
+		}							\
+		return name##_entry(result);				\
+	}								\
+									\
+	/* first entry with a key >= key */				\
+	static _attr_unused type *name##_lower_bound(const struct rb_tree *tree, const name##_key_t key) \
+	{								\
+		return _##name##_bound(tree, key, true);		\
+	}								\
+									\
+	/* first entry with a key > key */				\
+	static _attr_unused type *name##_upper_bound(const struct rb_tree *tree, const name##_key_t key) \
+	{								\
+		return _##name##_bound(tree, key, false);		\
+	}								\
+									\
+	/* removes and returns the entry with the key (or NULL) */	\
+	static _attr_unused type *name##_delete(struct rb_tree *tree, const name##_key_t key) \
+	{								\
+		struct rb_node *parent;					\
+		enum rb_direction dir;					\
+		struct rb_node *node = _##name##_descend(tree, key, &parent, &dir); \
+		if (node) {						\
+			rb_remove_node(tree, node);			\
+		}							\
+		return name##_entry(node);				\
+	}								\
+									\
+	static _attr_unused void name##_remove(struct rb_tree *tree, type *entry) \
+	{								\
+		rb_remove_node(tree, &entry->node_member);		\
+	}								\
+									\
+	static _attr_unused type *name##_first(const struct rb_tree *tree) \
+	{								\
+		return name##_entry(rb_first(tree));			\
+	}								\
+									\
+	static _attr_unused type *name##_next(const type *entry)	\
+	{								\
+		return name##_entry(rb_next(&entry->node_member));	\
+	}
+
+/*
+ * Defines the callbacks (name) for an augmented tree of "type" entries where aug_member is computed by
+ * compute(const type *entry) from the entry and the aug_member of its children.
+ */
+#define DEFINE_RB_AUGMENT_CALLBACKS(name, type, node_member, aug_type, aug_member, compute) \
+	static void _##name##_propagate(struct rb_node *node, struct rb_node *stop) \
+	{								\
+		while (node != stop) {					\
+			type *entry = container_of(node, type, node_member); \
+			aug_type value = compute(entry);		\
+			if (entry->aug_member == value) {		\
+				break;					\
+			}						\
+			entry->aug_member = value;			\
+			node = rb_parent(node);				\
+		}							\
+	}								\
+									\
+	static void _##name##_copy(struct rb_node *old, struct rb_node *new) \
+	{								\
+		container_of(new, type, node_member)->aug_member =	\
+			container_of(old, type, node_member)->aug_member; \
+	}								\
+									\
+	static void _##name##_rotate(struct rb_node *old, struct rb_node *new) \
+	{								\
+		type *old_entry = container_of(old, type, node_member);	\
+		container_of(new, type, node_member)->aug_member = old_entry->aug_member; \
+		old_entry->aug_member = compute(old_entry);		\
+	}								\
+									\
+	static const struct rb_augment_callbacks name = {		\
+		.propagate = _##name##_propagate,			\
+		.copy = _##name##_copy,					\
+		.rotate = _##name##_rotate,				\
+	};
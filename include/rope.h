@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+// Rope for large strings that are edited in the middle
+// The characters are stored in chunks of up to ROPE_CHUNK_SIZE bytes which are the nodes of a red-black tree
+// ordered by position, every node also stores the number of characters in its subtree (see rb_tree.h). Finding a
+// position, inserting and erasing are O(log n) plus the number of characters that are copied (one chunk at most
+// for the existing text), instead of moving the whole tail of the string like dstr_insert_* and dstr_erase.
+// Adjacent chunks are merged when they fit into one, so a rope uses at most about twice the memory of its text.
+//
+// Usage:
+//         struct rope doc;
+//         rope_init(&doc);
+//         rope_append_cstr(&doc, "Hello {name}!");
+//         rope_replace_cstr(&doc, 6, 6, "World");
+//         struct rope_iter iter;
+//         struct strview piece;
+//         rope_iter_start(&iter, &doc, 0, ROPE_NPOS);
+//         while (rope_iter_next(&iter, &piece)) {
+//                 fwrite(piece.characters, 1, piece.length, stdout);
+//         }
+//         rope_destroy(&doc);
+//
+// Positions must be <= rope_length(), lengths are cut off at the end of the rope (ROPE_NPOS means until the end).
+// The inserted characters must not point into the rope itself (e.g. a piece from rope_iter_next).
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "allocator.h"
+#include "compiler.h"
+#include "dstring.h"
+#include "fortify.h"
+#include "rb_tree.h"
+
+#define ROPE_NPOS STRVIEW_NPOS
+// size of the chunk allocations (including a small header)
+#define ROPE_CHUNK_SIZE 2048
+
+struct rope {
+	struct rb_tree _tree;
+	struct allocator *_allocator; // used for the chunks (NULL means malloc/free)
+};
+
+struct rope_iter {
+	const struct rb_node *_node;
+	size_t _offset;
+	size_t _remaining;
+};
+
+void rope_init(struct rope *rope);
+void rope_init_with_allocator(struct rope *rope, struct allocator *allocator);
+void rope_destroy(struct rope *rope);
+void rope_clear(struct rope *rope);
+size_t rope_length(const struct rope *rope) _attr_pure;
+char rope_char_at(const struct rope *rope, size_t pos) _attr_pure;
+void rope_append_chars(struct rope *rope, const char *chars, size_t n);
+void rope_append_view(struct rope *rope, struct strview view);
+void rope_append_cstr(struct rope *rope, const char *cstr);
+void rope_insert_chars(struct rope *rope, size_t pos, const char *chars, size_t n);
+void rope_insert_view(struct rope *rope, size_t pos, struct strview view);
+void rope_insert_cstr(struct rope *rope, size_t pos, const char *cstr);
+void rope_replace_chars(struct rope *rope, size_t pos, size_t len, const char *chars, size_t n);
+void rope_replace_view(struct rope *rope, size_t pos, size_t len, struct strview view);
+void rope_replace_cstr(struct rope *rope, size_t pos, size_t len, const char *cstr);
+void rope_erase(struct rope *rope, size_t pos, size_t len);
+dstr_t rope_substring(const struct rope *rope, size_t start, size_t length) _attr_nodiscard;
+dstr_t rope_to_dstr(const struct rope *rope) _attr_nodiscard;
+
+// iterates over the characters in [start, start + length) as pieces which point into the chunks
+// (the pieces are invalidated by any modification of the rope)
+void rope_iter_start(struct rope_iter *iter, const struct rope *rope, size_t start, size_t length);
+bool rope_iter_next(struct rope_iter *iter, struct strview *piece);
+
+#ifdef __FORTIFY_ENABLED
+
+static _attr_always_inline void _rope_append_chars_fortified(struct rope *rope, const char *chars, size_t n)
+{
+	_fortify_check(_fortify_bos(chars) >= n);
+	rope_append_chars(rope, chars, n);
+}
+#define rope_append_chars(rope, chars, n) _rope_append_chars_fortified(rope, chars, n)
+
+static _attr_always_inline void _rope_insert_chars_fortified(struct rope *rope, size_t pos, const char *chars,
+							     size_t n)
+{
+	_fortify_check(_fortify_bos(chars) >= n);
+	rope_insert_chars(rope, pos, chars, n);
+}
+#define rope_insert_chars(rope, pos, chars, n) _rope_insert_chars_fortified(rope, pos, chars, n)
+
+static _attr_always_inline void _rope_replace_chars_fortified(struct rope *rope, size_t pos, size_t len,
+							      const char *chars, size_t n)
+{
+	_fortify_check(_fortify_bos(chars) >= n);
+	rope_replace_chars(rope, pos, len, chars, n);
+}
+#define rope_replace_chars(rope, pos, len, chars, n) _rope_replace_chars_fortified(rope, pos, len, chars, n)
+
+#endif
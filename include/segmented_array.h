@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// Segmented array (deque) with stable element addresses
+// The elements are stored in segments whose sizes grow geometrically (the first segment holds about
+// SEGMENTED_ARRAY_FIRST_SEGMENT_SIZE bytes, each following segment twice as many elements as the previous one).
+// Growing the array only allocates a new segment, the elements are never moved or copied, so pointers to elements
+// stay valid until the element is removed. There are two independent lists of segments, one for the elements
+// added at the back and one (growing in the other direction) for the elements added at the front, so adding and
+// removing elements at both ends is O(1), as is indexed access (one ilog2 to find the segment).
+//
+// Segments at the back end are kept when elements are removed (call shrink_to_fit to release them), segments
+// which were emptied from the other end (e.g. pop_front removing elements which were added with push_back) are
+// released right away. All positions are reset when the array becomes empty. Because of this, a FIFO queue which
+// never becomes empty keeps allocating bigger segments, use a ring buffer for that.
+//
+// Usage:
+//         DEFINE_SEGMENTED_ARRAY(event_log, struct event)
+//         struct event_log log;
+//         event_log_init(&log);
+//         struct event *e = event_log_add_back(&log); // stays valid
+//         ...
+//         for (size_t i = 0; i < event_log_length(&log); i++) {
+//                 struct event *e = event_log_at(&log, i);
+//         }
+//         event_log_destroy(&log);
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "allocator.h"
+#include "compiler.h"
+#include "fortify.h"
+#include "utils.h"
+
+#ifndef SEGMENTED_ARRAY_FIRST_SEGMENT_SIZE
+#define SEGMENTED_ARRAY_FIRST_SEGMENT_SIZE 256
+#endif
+// enough for more than 2^47 elements at each end
+#define SEGMENTED_ARRAY_MAX_SEGMENTS 48
+
+struct _segmented_array {
+	// positions of the elements in the back/front segments (the front positions are in reverse order)
+	size_t back_begin;
+	size_t back_end;
+	size_t front_begin;
+	size_t front_end;
+	unsigned int shift; // the first segment holds 1 << shift elements
+	struct allocator *allocator;
+	void *back[SEGMENTED_ARRAY_MAX_SEGMENTS];
+	void *front[SEGMENTED_ARRAY_MAX_SEGMENTS];
+};
+
+void _segmented_array_init(struct _segmented_array *arr, size_t elem_size, struct allocator *allocator);
+void _segmented_array_destroy(struct _segmented_array *arr, size_t elem_size);
+void _segmented_array_shrink_to_fit(struct _segmented_array *arr, size_t elem_size);
+void _segmented_array_alloc_segment(struct _segmented_array *arr, void **segments, size_t k, size_t elem_size);
+void *_segmented_array_pop_other_side(struct _segmented_array *arr, bool back, size_t elem_size);
+void *_segmented_array_contiguous(const struct _segmented_array *arr, size_t i, size_t elem_size, size_t *n);
+
+static _attr_always_inline _attr_pure size_t _segmented_array_length(const struct _segmented_array *arr)
+{
+	return (arr->back_end - arr->back_begin) + (arr->front_end - arr->front_begin);
+}
+
+// segment index of a position
+static _attr_always_inline _attr_pure size_t _segmented_array_segment(const struct _segmented_array *arr,
+								       size_t pos)
+{
+	return ilog2((pos >> arr->shift) + 1);
+}
+
+static _attr_always_inline _attr_pure size_t _segmented_array_segment_start(const struct _segmented_array *arr,
+									     size_t k)
+{
+	return (((size_t)1 << k) - 1) << arr->shift;
+}
+
+// address of a position in the back or front segments (the front segments are filled from their end, so
+// consecutive elements are contiguous in memory on both sides)
+static _attr_always_inline _attr_pure void *_segmented_array_pos(const struct _segmented_array *arr, bool back,
+								  size_t pos, size_t elem_size)
+{
+	size_t k = _segmented_array_segment(arr, pos);
+	size_t offset = pos - _segmented_array_segment_start(arr, k);
+	if (!back) {
+		offset = ((size_t)1 << (k + arr->shift)) - 1 - offset;
+	}
+	return (char *)(back ? arr->back : arr->front)[k] + offset * elem_size;
+}
+
+static _attr_always_inline _attr_pure void *_segmented_array_at(const struct _segmented_array *arr, size_t i,
+								 size_t elem_size)
+{
+	_fortify_check(i < _segmented_array_length(arr));
+	size_t front_length = arr->front_end - arr->front_begin;
+	if (i < front_length) {
+		return _segmented_array_pos(arr, false, arr->front_end - 1 - i, elem_size);
+	}
+	return _segmented_array_pos(arr, true, arr->back_begin + (i - front_length), elem_size);
+}
+
+// add an element at the back (back == true) or front
+static _attr_always_inline void *_segmented_array_add(struct _segmented_array *arr, bool back, size_t elem_size)
+{
+	void **segments = back ? arr->back : arr->front;
+	size_t *end = back ? &arr->back_end : &arr->front_end;
+	size_t pos = (*end)++;
+	size_t k = _segmented_array_segment(arr, pos);
+	if (unlikely(!segments[k])) {
+		_segmented_array_alloc_segment(arr, segments, k, elem_size);
+	}
+	return _segmented_array_pos(arr, back, pos, elem_size);
+}
+
+// remove the element at the back (back == true) or front, the returned pointer is valid until the next
+// modification of the array
+static _attr_always_inline void *_segmented_array_pop(struct _segmented_array *arr, bool back, size_t elem_size)
+{
+	_fortify_check(_segmented_array_length(arr) != 0);
+	size_t *begin = back ? &arr->back_begin : &arr->front_begin;
+	size_t *end = back ? &arr->back_end : &arr->front_end;
+	void *p;
+	if (likely(*end != *begin)) {
+		p = _segmented_array_pos(arr, back, --(*end), elem_size);
+	} else {
+		p = _segmented_array_pop_other_side(arr, back, elem_size);
+	}
+	if (unlikely(_segmented_array_length(arr) == 0)) {
+		arr->back_begin = arr->back_end = arr->front_begin = arr->front_end = 0;
+	}
+	return p;
+}
+
+#define DEFINE_SEGMENTED_ARRAY(name, type)				\
+	typedef type name##_type_t;					\
+									\
+	struct name {							\
+		struct _segmented_array _impl;				\
+	};								\
+									\
+	static _attr_unused void name##_init(struct name *arr)		\
+	{								\
+		_segmented_array_init(&arr->_impl, sizeof(name##_type_t), NULL); \
+	}								\
+									\
+	/* like name##_init but the segments are allocated with allocator */ \
+	static _attr_unused void name##_init_with_allocator(struct name *arr, struct allocator *allocator) \
+	{								\
+		_segmented_array_init(&arr->_impl, sizeof(name##_type_t), allocator); \
+	}								\
+									\
+	static _attr_unused void name##_destroy(struct name *arr)	\
+	{								\
+		_segmented_array_destroy(&arr->_impl, sizeof(name##_type_t)); \
+	}								\
+									\
+	static _attr_unused _attr_pure size_t name##_length(const struct name *arr) \
+	{								\
+		return _segmented_array_length(&arr->_impl);		\
+	}								\
+									\
+	/* i must be less than the length */				\
+	static _attr_unused _attr_pure name##_type_t *name##_at(const struct name *arr, size_t i) \
+	{								\
+		return _segmented_array_at(&arr->_impl, i, sizeof(name##_type_t)); \
+	}								\
+									\
+	static _attr_unused _attr_pure name##_type_t *name##_first(const struct name *arr) \
+	{								\
+		return name##_at(arr, 0);				\
+	}								\
+									\
+	static _attr_unused _attr_pure name##_type_t *name##_last(const struct name *arr) \
+	{								\
+		return name##_at(arr, name##_length(arr) - 1);		\
+	}								\
+									\
+	/* return a pointer to element i and store the number of elements which follow it contiguously in memory */ \
+	/* (including element i) in *n (for bulk processing) */	\
+	static _attr_unused name##_type_t *name##_contiguous(const struct name *arr, size_t i, size_t *n) \
+	{								\
+		return _segmented_array_contiguous(&arr->_impl, i, sizeof(name##_type_t), n); \
+	}								\
+									\
+	/* add an uninitialized element at the back and return a pointer to it */ \
+	static _attr_unused name##_type_t *name##_add_back(struct name *arr) \
+	{								\
+		return _segmented_array_add(&arr->_impl, true, sizeof(name##_type_t)); \
+	}								\
+									\
+	/* add an uninitialized element at the front and return a pointer to it */ \
+	static _attr_unused name##_type_t *name##_add_front(struct name *arr) \
+	{								\
+		return _segmented_array_add(&arr->_impl, false, sizeof(name##_type_t)); \
+	}								\
+									\
+	static _attr_unused void name##_push_back(struct name *arr, name##_type_t value) \
+	{								\
+		*name##_add_back(arr) = value;				\
+	}								\
+									\
+	static _attr_unused void name##_push_front(struct name *arr, name##_type_t value) \
+	{								\
+		*name##_add_front(arr) = value;				\
+	}								\
+									\
+	/* the array must not be empty */				\
+	static _attr_unused name##_type_t name##_pop_back(struct name *arr) \
+	{								\
+		return *(name##_type_t *)_segmented_array_pop(&arr->_impl, true, sizeof(name##_type_t)); \
+	}								\
+									\
+	/* the array must not be empty */				\
+	static _attr_unused name##_type_t name##_pop_front(struct name *arr) \
+	{								\
+		return *(name##_type_t *)_segmented_array_pop(&arr->_impl, false, sizeof(name##_type_t)); \
+	}								\
+									\
+	/* remove all elements (but keep the segments) */		\
+	static _attr_unused void name##_clear(struct name *arr)		\
+	{								\
+		arr->_impl.back_begin = arr->_impl.back_end = 0;	\
+		arr->_impl.front_begin = arr->_impl.front_end = 0;	\
+	}								\
+									\
+	/* release all segments which do not contain any elements */	\
+	static _attr_unused void name##_shrink_to_fit(struct name *arr)	\
+	{								\
+		_segmented_array_shrink_to_fit(&arr->_impl, sizeof(name##_type_t)); \
+	}
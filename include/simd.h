@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#pragma once
+
+#include "compiler.h"
+#include "config.h"
+
+// runtime selection of the instruction set extensions for the vectorized functions (array_ops.c, dstring.c)
+
+enum _simd_level {
+	_SIMD_NONE,
+	_SIMD_SSE2,
+	_SIMD_AVX2,
+};
+
+#if (defined(__x86_64__) || defined(__i386__)) && __has_attribute(target) && defined(HAVE_BUILTIN_CPU_SUPPORTS)
+#define SIMD_X86 1
+// functions with these attributes may only be called if _simd_level() returned at least the level
+#define SSE2_TARGET __attribute__((target("sse2")))
+#define AVX2_TARGET __attribute__((target("avx2,popcnt")))
+#endif
+
+// the best level supported by the CPU (always _SIMD_NONE on other architectures), but at most the limit
+enum _simd_level _simd_level(void);
+// limit the level (to test all implementations), returns the previous limit
+enum _simd_level _simd_limit(enum _simd_level limit);
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// Size-class slab allocator for small objects (e.g. hashtable and B-tree nodes or small strings)
+// Allocations of up to SLAB_MAX_SIZE bytes are rounded up to one of the size classes (multiples of 16 up to 128,
+// of 32 up to 512 and of 64 up to SLAB_MAX_SIZE). Each size class owns a list of spans (SLAB_SPAN_SIZE bytes
+// which are split into slots of the same size). The spans are carved out of SLAB_SUPERPAGE_SIZE aligned
+// superpages, whose first span holds the metadata of all other spans (free list and allocation bitmap) followed
+// by guard pages, so the metadata is never next to user data. Bigger allocations are passed to malloc.
+//
+// Every thread caches a few free slots per size class, allocating and freeing from that cache does not take any
+// locks. The cache is refilled from (or half of it returned to) the spans of the size class in batches, which
+// takes a spinlock per size class. Memory can be freed by a different thread than the one that allocated it.
+// Spans which become empty are decommitted and can be reused for any size class. The cached slots of a thread are
+// returned when the thread exits (or with slab_thread_flush).
+//
+// The allocator is global (like malloc), slab_allocator() returns it as an allocator for the containers (see
+// allocator.h):
+//         struct hashmap map;
+//         hashmap_init_with_allocator(&map, 0, slab_allocator());
+
+#include <stddef.h>
+#include "allocator.h"
+#include "compiler.h"
+
+#define SLAB_MAX_SIZE 4096
+#define SLAB_SPAN_SIZE (64 * 1024)
+#define SLAB_SUPERPAGE_SIZE (2 * 1024 * 1024)
+#define SLAB_NUM_SIZE_CLASSES 76
+
+// allocate size bytes (aligned to _Alignof(max_align_t)), aborts if out of memory
+void *slab_alloc(size_t size) _attr_nodiscard;
+// release ptr, size must be the size which was used to allocate it (ptr can be NULL)
+void slab_free(void *ptr, size_t size);
+// resize ptr from old_size to new_size bytes (ptr can be NULL if old_size is zero), aborts if out of memory
+void *slab_realloc(void *ptr, size_t old_size, size_t new_size) _attr_nodiscard;
+// return the free slots cached by the calling thread to the shared spans
+void slab_thread_flush(void);
+// the slab allocator as an allocator for the containers (see allocator.h)
+struct allocator *slab_allocator(void) _attr_pure;
@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+// Struct-of-arrays container (macro template)
+// DEFINE_SOA_ARRAY(name, (type, field)...) defines a growable container which stores each field in its own
+// contiguous array (column), so loops which only touch a few fields only load those fields from memory and can be
+// vectorized. The columns are public members of struct name (soa.field[i]), the other members are internal.
+// The growth policy is the same as for array_t (ARRAY_INITIAL_SIZE and ARRAY_GROWTH_FACTOR_*).
+// Up to 32 fields are supported.
+//
+// Example:
+//         DEFINE_SOA_ARRAY(particles, (float, x), (float, y), (float, mass), (uint32_t, id))
+//         struct particles p;
+//         particles_init(&p);
+//         particles_push(&p, 1.0f, 2.0f, 0.5f, 42);
+//         for (size_t i = 0; i < particles_length(&p); i++) {
+//                 p.x[i] += 1.0f;
+//         }
+//         particles_destroy(&p);
+//
+// DEFINE_SOA_SORT(sort_name, name, field, ...) defines void sort_name(struct name *soa), which sorts all rows by
+// a field (stable). The last argument is a comparison expression like for DEFINE_SORTFUNC, which receives two
+// pointers to field values called 'a' and 'b':
+//         DEFINE_SOA_SORT(particles_sort_by_mass, particles, mass, (*a > *b) - (*a < *b))
+// Every column is permuted once after sorting (key, index) pairs, so this needs a temporary copy of the sort key
+// column and of the largest column, which come from the allocator of the array.
+
+#include <stddef.h>
+#include <stdlib.h>
+#include "allocator.h"
+#include "array.h"
+#include "compiler.h"
+#include "fortify.h"
+#include "sort.h"
+
+#define _SOA_NARGS(...) _SOA_NARGS_(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, \
+					16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1)
+#define _SOA_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, \
+		    _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, n, ...) n
+#define _SOA_CONCAT(a, b) _SOA_CONCAT_(a, b)
+#define _SOA_CONCAT_(a, b) a##b
+// apply m(arg, field) to each field
+#define _SOA_FOREACH(m, arg, ...) _SOA_CONCAT(_SOA_FOREACH_, _SOA_NARGS(__VA_ARGS__))(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_1(m, arg, f) m(arg, f)
+#define _SOA_FOREACH_2(m, arg, f, ...) m(arg, f) _SOA_FOREACH_1(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_3(m, arg, f, ...) m(arg, f) _SOA_FOREACH_2(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_4(m, arg, f, ...) m(arg, f) _SOA_FOREACH_3(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_5(m, arg, f, ...) m(arg, f) _SOA_FOREACH_4(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_6(m, arg, f, ...) m(arg, f) _SOA_FOREACH_5(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_7(m, arg, f, ...) m(arg, f) _SOA_FOREACH_6(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_8(m, arg, f, ...) m(arg, f) _SOA_FOREACH_7(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_9(m, arg, f, ...) m(arg, f) _SOA_FOREACH_8(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_10(m, arg, f, ...) m(arg, f) _SOA_FOREACH_9(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_11(m, arg, f, ...) m(arg, f) _SOA_FOREACH_10(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_12(m, arg, f, ...) m(arg, f) _SOA_FOREACH_11(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_13(m, arg, f, ...) m(arg, f) _SOA_FOREACH_12(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_14(m, arg, f, ...) m(arg, f) _SOA_FOREACH_13(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_15(m, arg, f, ...) m(arg, f) _SOA_FOREACH_14(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_16(m, arg, f, ...) m(arg, f) _SOA_FOREACH_15(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_17(m, arg, f, ...) m(arg, f) _SOA_FOREACH_16(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_18(m, arg, f, ...) m(arg, f) _SOA_FOREACH_17(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_19(m, arg, f, ...) m(arg, f) _SOA_FOREACH_18(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_20(m, arg, f, ...) m(arg, f) _SOA_FOREACH_19(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_21(m, arg, f, ...) m(arg, f) _SOA_FOREACH_20(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_22(m, arg, f, ...) m(arg, f) _SOA_FOREACH_21(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_23(m, arg, f, ...) m(arg, f) _SOA_FOREACH_22(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_24(m, arg, f, ...) m(arg, f) _SOA_FOREACH_23(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_25(m, arg, f, ...) m(arg, f) _SOA_FOREACH_24(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_26(m, arg, f, ...) m(arg, f) _SOA_FOREACH_25(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_27(m, arg, f, ...) m(arg, f) _SOA_FOREACH_26(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_28(m, arg, f, ...) m(arg, f) _SOA_FOREACH_27(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_29(m, arg, f, ...) m(arg, f) _SOA_FOREACH_28(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_30(m, arg, f, ...) m(arg, f) _SOA_FOREACH_29(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_31(m, arg, f, ...) m(arg, f) _SOA_FOREACH_30(m, arg, __VA_ARGS__)
+#define _SOA_FOREACH_32(m, arg, f, ...) m(arg, f) _SOA_FOREACH_31(m, arg, __VA_ARGS__)
+
+#define _SOA_TYPE(f) _SOA_TYPE_ f
+#define _SOA_TYPE_(type, field) type
+#define _SOA_FIELD(f) _SOA_FIELD_ f
+#define _SOA_FIELD_(type, field) field
+
+#define _SOA_TYPEDEF(name, f) typedef _SOA_TYPE(f) _SOA_CONCAT(name##_, _SOA_CONCAT(_SOA_FIELD(f), _t));
+#define _SOA_COLUMN(name, f) _SOA_TYPE(f) *_SOA_FIELD(f);
+#define _SOA_PARAM_NAME(f) _SOA_CONCAT(_value_, _SOA_FIELD(f))
+#define _SOA_PARAM(name, f) , _SOA_TYPE(f) _SOA_PARAM_NAME(f)
+#define _SOA_INIT_COLUMN(soa, f) (soa)->_SOA_FIELD(f) = NULL;
+#define _SOA_STORE(soa, f) (soa)->_SOA_FIELD(f)[_i] = _SOA_PARAM_NAME(f);
+#define _SOA_MOVE(soa, f) (soa)->_SOA_FIELD(f)[_dst] = (soa)->_SOA_FIELD(f)[_src];
+#define _SOA_RESIZE_COLUMN(soa, f)					\
+	(soa)->_SOA_FIELD(f) = allocator_realloc((soa)->_allocator, (soa)->_SOA_FIELD(f), \
+						 (soa)->_capacity * sizeof(_SOA_TYPE(f)), \
+						 _capacity * sizeof(_SOA_TYPE(f)));
+#define _SOA_PERMUTE_COLUMN(soa, f)					\
+	{								\
+		_SOA_TYPE(f) *_column = allocator_alloc((soa)->_allocator, (soa)->_capacity * sizeof(_SOA_TYPE(f))); \
+		for (size_t _i = 0; _i < (soa)->_length; _i++) {	\
+			_column[_i] = (soa)->_SOA_FIELD(f)[_perm[_i]];	\
+		}							\
+		allocator_free((soa)->_allocator, (soa)->_SOA_FIELD(f), (soa)->_capacity * sizeof(_SOA_TYPE(f))); \
+		(soa)->_SOA_FIELD(f) = _column;				\
+	}
+
+#define DEFINE_SOA_ARRAY(name, ...)					\
+	_SOA_FOREACH(_SOA_TYPEDEF, name, __VA_ARGS__)			\
+									\
+	struct name {							\
+		_SOA_FOREACH(_SOA_COLUMN, name, __VA_ARGS__)		\
+		/* do not access these fields directly */		\
+		size_t _length;						\
+		size_t _capacity;					\
+		struct allocator *_allocator;				\
+	};								\
+									\
+	static _attr_unused void name##_init_with_allocator(struct name *soa, struct allocator *allocator) \
+	{								\
+		_SOA_FOREACH(_SOA_INIT_COLUMN, soa, __VA_ARGS__)	\
+		soa->_length = 0;					\
+		soa->_capacity = 0;					\
+		soa->_allocator = allocator;				\
+	}								\
+									\
+	static _attr_unused void name##_init(struct name *soa)		\
+	{								\
+		name##_init_with_allocator(soa, NULL);			\
+	}								\
+									\
+	static _attr_unused _attr_pure size_t name##_length(const struct name *soa) \
+	{								\
+		return soa->_length;					\
+	}								\
+									\
+	static _attr_unused _attr_pure size_t name##_capacity(const struct name *soa) \
+	{								\
+		return soa->_capacity;					\
+	}								\
+									\
+	/* set the capacity (truncates the length if necessary) */	\
+	static _attr_unused void name##_resize(struct name *soa, size_t _capacity) \
+	{								\
+		if (_capacity == soa->_capacity) {			\
+			return;						\
+		}							\
+		_SOA_FOREACH(_SOA_RESIZE_COLUMN, soa, __VA_ARGS__)	\
+		soa->_capacity = _capacity;				\
+		if (soa->_length > _capacity) {				\
+			soa->_length = _capacity;			\
+		}							\
+	}								\
+									\
+	static _attr_unused void name##_destroy(struct name *soa)	\
+	{								\
+		name##_resize(soa, 0);					\
+	}								\
+									\
+	/* make room for n more rows */				\
+	static _attr_unused void name##_reserve(struct name *soa, size_t n) \
+	{								\
+		if (n > soa->_capacity - soa->_length) {		\
+			name##_resize(soa, _arr_grow_capacity(soa->_capacity, n - (soa->_capacity - soa->_length))); \
+		}							\
+	}								\
+									\
+	static _attr_unused void name##_shrink_to_fit(struct name *soa) \
+	{								\
+		name##_resize(soa, soa->_length);			\
+	}								\
+									\
+	/* add an uninitialized row and return its index */		\
+	static _attr_unused size_t name##_add(struct name *soa)	\
+	{								\
+		if (unlikely(soa->_length == soa->_capacity)) {		\
+			name##_reserve(soa, 1);				\
+		}							\
+		return soa->_length++;					\
+	}								\
+									\
+	/* add a row (the arguments are the values of all fields in order) */ \
+	static _attr_unused void name##_push(struct name *soa _SOA_FOREACH(_SOA_PARAM, name, __VA_ARGS__)) \
+	{								\
+		size_t _i = name##_add(soa);				\
+		_SOA_FOREACH(_SOA_STORE, soa, __VA_ARGS__)		\
+	}								\
+									\
+	/* remove the last row */					\
+	static _attr_unused void name##_pop(struct name *soa)		\
+	{								\
+		_fortify_check(soa->_length != 0);			\
+		soa->_length--;						\
+	}								\
+									\
+	/* reduce the number of rows to length (does nothing if length is greater than the current length) */ \
+	static _attr_unused void name##_truncate(struct name *soa, size_t length) \
+	{								\
+		if (length < soa->_length) {				\
+			soa->_length = length;				\
+		}							\
+	}								\
+									\
+	static _attr_unused void name##_clear(struct name *soa)		\
+	{								\
+		soa->_length = 0;					\
+	}								\
+									\
+	/* delete row i WITHOUT keeping the order of the rows (the last row is moved to i) */ \
+	static _attr_unused void name##_fast_delete(struct name *soa, size_t i) \
+	{								\
+		_fortify_check(i < soa->_length);			\
+		size_t _dst = i;					\
+		size_t _src = --soa->_length;				\
+		_SOA_FOREACH(_SOA_MOVE, soa, __VA_ARGS__)		\
+		(void)_dst;						\
+		(void)_src;						\
+	}								\
+									\
+	/* row i of the result is row _perm[i] of the original */	\
+	static _attr_unused void _##name##_permute(struct name *soa, const size_t *_perm) \
+	{								\
+		_SOA_FOREACH(_SOA_PERMUTE_COLUMN, soa, __VA_ARGS__)	\
+	}
+
+#define DEFINE_SOA_SORT(sort_name, name, field, ...)			\
+	struct _##sort_name##_pair {					\
+		name##_##field##_t key;					\
+		size_t index;						\
+	};								\
+									\
+	static inline int _##sort_name##_cmp(const name##_##field##_t *a, const name##_##field##_t *b) \
+	{								\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	DEFINE_STABLE_SORTFUNC(_##sort_name##_pairs, struct _##sort_name##_pair, \
+			       _##sort_name##_cmp(&a->key, &b->key))	\
+									\
+	static _attr_unused void sort_name(struct name *soa)		\
+	{								\
+		size_t n = soa->_length;				\
+		if (n < 2) {						\
+			return;						\
+		}							\
+		struct _##sort_name##_pair *pairs = allocator_alloc(soa->_allocator, n * sizeof(pairs[0])); \
+		size_t *perm = allocator_alloc(soa->_allocator, n * sizeof(perm[0])); \
+		for (size_t i = 0; i < n; i++) {			\
+			pairs[i].key = soa->field[i];			\
+			pairs[i].index = i;				\
+		}							\
+		_##sort_name##_pairs(pairs, n);				\
+		for (size_t i = 0; i < n; i++) {			\
+			perm[i] = pairs[i].index;			\
+		}							\
+		allocator_free(soa->_allocator, pairs, n * sizeof(pairs[0])); \
+		_##name##_permute(soa, perm);				\
+		allocator_free(soa->_allocator, perm, n * sizeof(perm[0])); \
+	}
@@ -0,0 +1,768 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "heap.h"
+#include "utils.h"
+
+// Pattern-defeating quicksort (pdqsort, https://github.com/orlp/pdqsort) with an inlined comparison.
+// - Block partitioning without branches on comparison results (fast for cheap comparisons)
+// - Sorted (and almost sorted) inputs are detected after partitioning and finished with insertion sort: O(n)
+// - Strictly descending inputs are detected up front and reversed: O(n)
+// - Partitions with many elements equal to the pivot are handled in one pass: O(n * k) for k distinct values
+// - Unbalanced partitions shuffle a few elements to break patterns and fall back to heapsort after too many of
+//   them, so the worst case is O(n log n)
+// The sort is not stable.
+//
+// 'name' is the identifier of the sort function.
+// 'type' is the element type of the array to sort.
+// The last argument should be a code expression that compares two elements:
+// The expression receives two pointers to array elements called 'a' and 'b' and
+// "must return an integer less than, equal to, or greater than zero if the first argument (a)
+// is considered to be respectively less than, equal to, or greater than the second (b)" (see qsort manpage).
+// Examples:
+//   DEFINE_SORTFUNC(integer_sort, int, (*a > *b) - (*a < *b))
+//   DEFINE_SORTFUNC(string_sort, char *, strcmp(*a, *b))
+// To sort an array with the defined functions do:
+//   int array[N] = {1, 3, 2, ...};
+//   integer_sort(array, N);
+// or
+//   char *array[N] = {"abc", "ghi", "def", ...}
+//   string_sort(array, N);
+// or for an array_t(int) arr:
+//   array_sort_typed(arr, integer_sort);
+
+#define _SORT_INSERTION_SORT_THRESHOLD      24
+#define _SORT_NINTHER_THRESHOLD             128
+#define _SORT_PARTIAL_INSERTION_SORT_LIMIT  8
+#define _SORT_BLOCK_SIZE                    64
+
+#define DEFINE_SORTFUNC(name, type, ...)				\
+	static inline int _##name##_cmp(type const *a, type const *b)	\
+	{								\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	static inline bool _##name##_less(type const *a, type const *b)	\
+	{								\
+		return _##name##_cmp(a, b) < 0;				\
+	}								\
+									\
+	DEFINE_BINHEAP(_##name##_heap, type, _##name##_cmp(a, b) > 0)	\
+									\
+	static inline void _##name##_swap(type *a, type *b)		\
+	{								\
+		type tmp = *a;						\
+		*a = *b;						\
+		*b = tmp;						\
+	}								\
+									\
+	static inline void _##name##_sort2(type *a, type *b)		\
+	{								\
+		if (_##name##_less(b, a)) {				\
+			_##name##_swap(a, b);				\
+		}							\
+	}								\
+									\
+	static inline void _##name##_sort3(type *a, type *b, type *c)	\
+	{								\
+		_##name##_sort2(a, b);					\
+		_##name##_sort2(b, c);					\
+		_##name##_sort2(a, b);					\
+	}								\
+									\
+	static void _##name##_insertion_sort(type *begin, type *end)	\
+	{								\
+		if (begin == end) {					\
+			return;						\
+		}							\
+		for (type *cur = begin + 1; cur != end; cur++) {	\
+			type *sift = cur;				\
+			type *sift_1 = cur - 1;				\
+			if (_##name##_less(sift, sift_1)) {		\
+				type tmp = *sift;			\
+				do {					\
+					*sift-- = *sift_1;		\
+				} while (sift != begin && _##name##_less(&tmp, --sift_1)); \
+				*sift = tmp;				\
+			}						\
+		}							\
+	}								\
+									\
+	/* requires an element before begin that is not greater than any element in [begin, end) */ \
+	static void _##name##_unguarded_insertion_sort(type *begin, type *end) \
+	{								\
+		if (begin == end) {					\
+			return;						\
+		}							\
+		for (type *cur = begin + 1; cur != end; cur++) {	\
+			type *sift = cur;				\
+			type *sift_1 = cur - 1;				\
+			if (_##name##_less(sift, sift_1)) {		\
+				type tmp = *sift;			\
+				do {					\
+					*sift-- = *sift_1;		\
+				} while (_##name##_less(&tmp, --sift_1)); \
+				*sift = tmp;				\
+			}						\
+		}							\
+	}								\
+									\
+	/* gives up (returns false) if more than a few elements had to be moved */ \
+	static bool _##name##_partial_insertion_sort(type *begin, type *end) \
+	{								\
+		if (begin == end) {					\
+			return true;					\
+		}							\
+		size_t limit = 0;					\
+		for (type *cur = begin + 1; cur != end; cur++) {	\
+			type *sift = cur;				\
+			type *sift_1 = cur - 1;				\
+			if (_##name##_less(sift, sift_1)) {		\
+				type tmp = *sift;			\
+				do {					\
+					*sift-- = *sift_1;		\
+				} while (sift != begin && _##name##_less(&tmp, --sift_1)); \
+				*sift = tmp;				\
+				limit += cur - sift;			\
+			}						\
+			if (limit > _SORT_PARTIAL_INSERTION_SORT_LIMIT) { \
+				return false;				\
+			}						\
+		}							\
+		return true;						\
+	}								\
+									\
+	static inline void _##name##_swap_offsets(type *first, type *last, const unsigned char *offsets_l, \
+						  const unsigned char *offsets_r, size_t num, bool use_swaps) \
+	{								\
+		if (use_swaps) {					\
+			/* needed if the number of elements is equal, otherwise an element would be duplicated */ \
+			for (size_t i = 0; i < num; i++) {		\
+				_##name##_swap(first + offsets_l[i], last - offsets_r[i]); \
+			}						\
+		} else if (num > 0) {					\
+			type *l = first + offsets_l[0];			\
+			type *r = last - offsets_r[0];			\
+			type tmp = *l;					\
+			*l = *r;					\
+			for (size_t i = 1; i < num; i++) {		\
+				l = first + offsets_l[i];		\
+				*r = *l;				\
+				r = last - offsets_r[i];		\
+				*l = *r;				\
+			}						\
+			*r = tmp;					\
+		}							\
+	}								\
+									\
+	/* partitions [begin, end) around the pivot *begin, elements equal to the pivot go to the right */ \
+	/* returns the position of the pivot, *already_partitioned is true if no elements were swapped */ \
+	static type *_##name##_partition_right(type *begin, type *end, bool *already_partitioned) \
+	{								\
+		type pivot = *begin;					\
+		type *first = begin;					\
+		type *last = end;					\
+		/* find the first element >= pivot (there is one because the median of 3 was used) */ \
+		while (_##name##_less(++first, &pivot));		\
+		/* find the first element < pivot from the right (guarded if there was no element before first) */ \
+		if (first - 1 == begin) {				\
+			while (first < last && !_##name##_less(--last, &pivot)); \
+		} else {						\
+			while (!_##name##_less(--last, &pivot));	\
+		}							\
+		*already_partitioned = first >= last;			\
+		if (!*already_partitioned) {				\
+			_##name##_swap(first, last);			\
+			first++;					\
+			_Alignas(64) unsigned char offsets_l[_SORT_BLOCK_SIZE]; \
+			_Alignas(64) unsigned char offsets_r[_SORT_BLOCK_SIZE]; \
+			type *offsets_l_base = first;			\
+			type *offsets_r_base = last;			\
+			size_t num_l = 0, num_r = 0, start_l = 0, start_r = 0; \
+			while (first < last) {				\
+				/* fill the offset blocks with the positions of misplaced elements */ \
+				size_t num_unknown = last - first;	\
+				size_t left_split = num_l == 0 ? (num_r == 0 ? num_unknown / 2 : num_unknown) : 0; \
+				size_t right_split = num_r == 0 ? (num_unknown - left_split) : 0; \
+				if (left_split >= _SORT_BLOCK_SIZE) {	\
+					left_split = _SORT_BLOCK_SIZE;	\
+				}					\
+				if (right_split >= _SORT_BLOCK_SIZE) {	\
+					right_split = _SORT_BLOCK_SIZE;	\
+				}					\
+				for (size_t i = 0; i < left_split; i++) { \
+					offsets_l[num_l] = i;		\
+					num_l += !_##name##_less(first, &pivot); \
+					first++;			\
+				}					\
+				for (size_t i = 0; i < right_split;) { \
+					offsets_r[num_r] = ++i;		\
+					num_r += _##name##_less(--last, &pivot); \
+				}					\
+				/* swap misplaced elements and update the block sizes and boundaries */ \
+				size_t num = num_l < num_r ? num_l : num_r; \
+				_##name##_swap_offsets(offsets_l_base, offsets_r_base, offsets_l + start_l, \
+						       offsets_r + start_r, num, num_l == num_r); \
+				num_l -= num;				\
+				num_r -= num;				\
+				start_l += num;				\
+				start_r += num;				\
+				if (num_l == 0) {			\
+					start_l = 0;			\
+					offsets_l_base = first;		\
+				}					\
+				if (num_r == 0) {			\
+					start_r = 0;			\
+					offsets_r_base = last;		\
+				}					\
+			}						\
+			/* move the remaining misplaced elements of one block to the middle */ \
+			if (num_l) {					\
+				while (num_l--) {			\
+					_##name##_swap(offsets_l_base + offsets_l[start_l + num_l], --last); \
+				}					\
+				first = last;				\
+			}						\
+			if (num_r) {					\
+				while (num_r--) {			\
+					_##name##_swap(offsets_r_base - offsets_r[start_r + num_r], first); \
+					first++;			\
+				}					\
+				last = first;				\
+			}						\
+		}							\
+		type *pivot_pos = first - 1;				\
+		*begin = *pivot_pos;					\
+		*pivot_pos = pivot;					\
+		return pivot_pos;					\
+	}								\
+									\
+	/* partitions [begin, end) around the pivot *begin, elements equal to the pivot go to the left */ \
+	/* (used if the pivot is equal to the element before begin, then no element in [begin, end) is smaller) */ \
+	static type *_##name##_partition_left(type *begin, type *end)	\
+	{								\
+		type pivot = *begin;					\
+		type *first = begin;					\
+		type *last = end;					\
+		while (_##name##_less(&pivot, --last));			\
+		if (last + 1 == end) {					\
+			while (first < last && !_##name##_less(&pivot, ++first)); \
+		} else {						\
+			while (!_##name##_less(&pivot, ++first));	\
+		}							\
+		while (first < last) {					\
+			_##name##_swap(first, last);			\
+			while (_##name##_less(&pivot, --last));		\
+			while (!_##name##_less(&pivot, ++first));	\
+		}							\
+		type *pivot_pos = last;					\
+		*begin = *pivot_pos;					\
+		*pivot_pos = pivot;					\
+		return pivot_pos;					\
+	}								\
+									\
+	static void _##name##_loop(type *begin, type *end, unsigned int bad_allowed, bool leftmost) \
+	{								\
+		for (;;) {						\
+			size_t size = end - begin;			\
+			if (size < _SORT_INSERTION_SORT_THRESHOLD) {	\
+				if (leftmost) {				\
+					_##name##_insertion_sort(begin, end); \
+				} else {				\
+					_##name##_unguarded_insertion_sort(begin, end); \
+				}					\
+				return;					\
+			}						\
+			/* move the pivot (median of 3 or pseudomedian of 9) to begin */ \
+			size_t s2 = size / 2;				\
+			if (size > _SORT_NINTHER_THRESHOLD) {		\
+				_##name##_sort3(begin, begin + s2, end - 1); \
+				_##name##_sort3(begin + 1, begin + (s2 - 1), end - 2); \
+				_##name##_sort3(begin + 2, begin + (s2 + 1), end - 3); \
+				_##name##_sort3(begin + (s2 - 1), begin + s2, begin + (s2 + 1)); \
+				_##name##_swap(begin, begin + s2);	\
+			} else {					\
+				_##name##_sort3(begin + s2, begin, end - 1); \
+			}						\
+			/* if the pivot is equal to the pivot of the parent partition (the element before begin), */ \
+			/* there are many equal elements, which all end up to the left and don't need to be sorted */ \
+			if (!leftmost && !_##name##_less(begin - 1, begin)) { \
+				begin = _##name##_partition_left(begin, end) + 1; \
+				continue;				\
+			}						\
+			bool already_partitioned;			\
+			type *pivot_pos = _##name##_partition_right(begin, end, &already_partitioned); \
+			size_t l_size = pivot_pos - begin;		\
+			size_t r_size = end - (pivot_pos + 1);		\
+			if (l_size < size / 8 || r_size < size / 8) {	\
+				/* highly unbalanced: fall back to heapsort if this happens too often */ \
+				if (--bad_allowed == 0) {		\
+					_##name##_heap_heapify(begin, size); \
+					_##name##_heap_sort(begin, size); \
+					return;				\
+				}					\
+				/* otherwise swap some elements to break patterns */ \
+				if (l_size >= _SORT_INSERTION_SORT_THRESHOLD) { \
+					_##name##_swap(begin, begin + l_size / 4); \
+					_##name##_swap(pivot_pos - 1, pivot_pos - l_size / 4); \
+					if (l_size > _SORT_NINTHER_THRESHOLD) { \
+						_##name##_swap(begin + 1, begin + (l_size / 4 + 1)); \
+						_##name##_swap(begin + 2, begin + (l_size / 4 + 2)); \
+						_##name##_swap(pivot_pos - 2, pivot_pos - (l_size / 4 + 1)); \
+						_##name##_swap(pivot_pos - 3, pivot_pos - (l_size / 4 + 2)); \
+					}				\
+				}					\
+				if (r_size >= _SORT_INSERTION_SORT_THRESHOLD) { \
+					_##name##_swap(pivot_pos + 1, pivot_pos + (1 + r_size / 4)); \
+					_##name##_swap(end - 1, end - r_size / 4); \
+					if (r_size > _SORT_NINTHER_THRESHOLD) { \
+						_##name##_swap(pivot_pos + 2, pivot_pos + (2 + r_size / 4)); \
+						_##name##_swap(pivot_pos + 3, pivot_pos + (3 + r_size / 4)); \
+						_##name##_swap(end - 2, end - (1 + r_size / 4)); \
+						_##name##_swap(end - 3, end - (2 + r_size / 4)); \
+					}				\
+				}					\
+			} else if (already_partitioned &&		\
+				   _##name##_partial_insertion_sort(begin, pivot_pos) && \
+				   _##name##_partial_insertion_sort(pivot_pos + 1, end)) { \
+				/* the partition was (almost) sorted already */ \
+				return;					\
+			}						\
+			/* recurse into the left part, loop for the right part */ \
+			_##name##_loop(begin, pivot_pos, bad_allowed, leftmost); \
+			begin = pivot_pos + 1;				\
+			leftmost = false;				\
+		}							\
+	}								\
+									\
+	static _attr_unused void name(type *arr, size_t n)		\
+	{								\
+		if (n < 2) {						\
+			return;						\
+		}							\
+		/* reverse strictly descending inputs (this stops at the first ascending pair otherwise) */ \
+		size_t i = 1;						\
+		while (i < n && _##name##_less(&arr[i], &arr[i - 1])) { \
+			i++;						\
+		}							\
+		if (i == n) {						\
+			for (size_t l = 0, r = n - 1; l < r; l++, r--) { \
+				_##name##_swap(&arr[l], &arr[r]);	\
+			}						\
+			return;						\
+		}							\
+		_##name##_loop(arr, arr + n, ilog2(n), true);		\
+	}
+
+// LSD radix sort with 11-bit digits (3 passes for 32-bit keys, 6 passes for 64-bit keys).
+// The histograms of all digits are computed in a single pass over the array, passes where all keys have the same
+// digit are skipped (e.g. the high bits of timestamps). The elements are moved back and forth between the array
+// and a temporary buffer of the same size. Each pass collects the elements of a digit in a small cache line
+// sized buffer first and writes them out together, which avoids most of the cache and TLB misses of scattering
+// single elements to 2048 different places.
+// Small arrays (less than RADIX_SORT_THRESHOLD elements) are sorted with pdqsort (see DEFINE_SORTFUNC), so the
+// sort is only stable for larger arrays.
+//
+// 'name' is the identifier of the sort function.
+// 'type' is the element type of the array to sort.
+// 'key_type' is the type of the sort key (uint32_t or uint64_t).
+// The last argument should be a code expression that receives a pointer to an array element called 'a' and
+// returns its key. Use the radix_key_* functions to map signed integers and floats to unsigned keys.
+// Examples:
+//   DEFINE_RADIX_SORTFUNC(event_sort, struct event, uint64_t, a->timestamp)
+//   DEFINE_RADIX_SORTFUNC(offset_sort, struct item, uint32_t, radix_key_i32(a->offset))
+// For arrays of integers and floats, use the radix_sort_* functions below.
+
+#define RADIX_SORT_THRESHOLD     256
+#define _RADIX_SORT_DIGIT_BITS   11
+#define _RADIX_SORT_NUM_DIGITS   (1 << _RADIX_SORT_DIGIT_BITS)
+#define _RADIX_SORT_WC_BYTES     64
+
+// order preserving maps from signed integers and floats to unsigned integers
+// (negative NaNs sort before -inf, positive NaNs after inf)
+static inline uint32_t radix_key_i32(int32_t x)
+{
+	return (uint32_t)x ^ ((uint32_t)1 << 31);
+}
+
+static inline uint64_t radix_key_i64(int64_t x)
+{
+	return (uint64_t)x ^ ((uint64_t)1 << 63);
+}
+
+static inline uint32_t radix_key_float(float x)
+{
+	uint32_t u;
+	memcpy(&u, &x, sizeof(u));
+	// flip all bits of negative numbers, only the sign bit of positive numbers
+	return u ^ ((uint32_t)-(int32_t)(u >> 31) | ((uint32_t)1 << 31));
+}
+
+static inline uint64_t radix_key_double(double x)
+{
+	uint64_t u;
+	memcpy(&u, &x, sizeof(u));
+	return u ^ ((uint64_t)-(int64_t)(u >> 63) | ((uint64_t)1 << 63));
+}
+
+#define DEFINE_RADIX_SORTFUNC(name, type, key_type, ...)		\
+	static inline key_type _##name##_key(type const *a)		\
+	{								\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	DEFINE_SORTFUNC(_##name##_small, type,				\
+			(_##name##_key(a) > _##name##_key(b)) - (_##name##_key(a) < _##name##_key(b))) \
+									\
+	static _attr_unused void name(type *arr, size_t n)		\
+	{								\
+		enum {							\
+			passes = (8 * sizeof(key_type) + _RADIX_SORT_DIGIT_BITS - 1) / _RADIX_SORT_DIGIT_BITS, \
+			wc_size = sizeof(type) < _RADIX_SORT_WC_BYTES ? _RADIX_SORT_WC_BYTES / sizeof(type) : 1, \
+		};							\
+		const key_type mask = _RADIX_SORT_NUM_DIGITS - 1;	\
+		if (n < RADIX_SORT_THRESHOLD) {				\
+			_##name##_small(arr, n);			\
+			return;						\
+		}							\
+		size_t (*counts)[_RADIX_SORT_NUM_DIGITS] = calloc(passes, sizeof(counts[0])); \
+		type (*wc)[wc_size] = malloc(_RADIX_SORT_NUM_DIGITS * sizeof(wc[0])); \
+		type *buffer = malloc(n * sizeof(arr[0]));		\
+		if (!counts || !wc || !buffer) {			\
+			abort();					\
+		}							\
+		for (size_t i = 0; i < n; i++) {			\
+			key_type key = _##name##_key(&arr[i]);		\
+			for (unsigned int p = 0; p < passes; p++) {	\
+				counts[p][(key >> (p * _RADIX_SORT_DIGIT_BITS)) & mask]++; \
+			}						\
+		}							\
+		type *src = arr;					\
+		type *dst = buffer;					\
+		for (unsigned int p = 0; p < passes; p++) {		\
+			unsigned int shift = p * _RADIX_SORT_DIGIT_BITS; \
+			size_t *count = counts[p];			\
+			if (count[(_##name##_key(&src[0]) >> shift) & mask] == n) { \
+				/* all keys have the same digit */	\
+				continue;				\
+			}						\
+			size_t sum = 0;					\
+			for (size_t d = 0; d < _RADIX_SORT_NUM_DIGITS; d++) { \
+				size_t c = count[d];			\
+				count[d] = sum;				\
+				sum += c;				\
+			}						\
+			/* collect the elements of each digit in a cache line before writing them to dst */ \
+			unsigned char fill[_RADIX_SORT_NUM_DIGITS] = {0}; \
+			for (size_t i = 0; i < n; i++) {		\
+				size_t d = (_##name##_key(&src[i]) >> shift) & mask; \
+				wc[d][fill[d]++] = src[i];		\
+				if (fill[d] == wc_size) {		\
+					memcpy(&dst[count[d]], wc[d], sizeof(wc[d])); \
+					count[d] += wc_size;		\
+					fill[d] = 0;			\
+				}					\
+			}						\
+			for (size_t d = 0; d < _RADIX_SORT_NUM_DIGITS; d++) { \
+				memcpy(&dst[count[d]], wc[d], fill[d] * sizeof(type)); \
+			}						\
+			type *tmp = src;				\
+			src = dst;					\
+			dst = tmp;					\
+		}							\
+		if (src != arr) {					\
+			memcpy(arr, src, n * sizeof(arr[0]));		\
+		}							\
+		free(buffer);						\
+		free(wc);						\
+		free(counts);						\
+	}
+
+// sort arrays of integers and floats in ascending order with radix sort
+// (these can also be used with array_sort_typed)
+void radix_sort_u32(uint32_t *arr, size_t n);
+void radix_sort_u64(uint64_t *arr, size_t n);
+void radix_sort_i32(int32_t *arr, size_t n);
+void radix_sort_i64(int64_t *arr, size_t n);
+void radix_sort_float(float *arr, size_t n);
+void radix_sort_double(double *arr, size_t n);
+
+// Stable adaptive merge sort (like timsort).
+// The array is split into natural runs (non-descending or strictly descending, which are reversed), short runs
+// are extended to a minimum length with binary insertion sort. The runs are merged with the merge policy of
+// timsort, which keeps the merges balanced. Before each merge, the elements that are already in place at the
+// start of the first run and at the end of the second run are skipped with binary searches.
+// Sorted, reversed and concatenated sorted inputs take O(n) time, the worst case is O(n log n).
+// Needs a temporary buffer of n / 2 elements.
+//
+// The arguments are the same as for DEFINE_SORTFUNC:
+//   DEFINE_STABLE_SORTFUNC(stable_integer_sort, int, (*a > *b) - (*a < *b))
+//   stable_integer_sort(array, N);
+
+#define _STABLE_SORT_MIN_MERGE   64
+#define _STABLE_SORT_MAX_RUNS    96
+
+#define DEFINE_STABLE_SORTFUNC(name, type, ...)			\
+	static inline bool _##name##_less(type const *a, type const *b)	\
+	{								\
+		return (__VA_ARGS__) < 0;				\
+	}								\
+									\
+	/* first position in [begin, end) that is greater than key */	\
+	static size_t _##name##_upper_bound(const type *arr, size_t begin, size_t end, const type *key) \
+	{								\
+		while (begin < end) {					\
+			size_t mid = begin + (end - begin) / 2;		\
+			if (_##name##_less(key, &arr[mid])) {		\
+				end = mid;				\
+			} else {					\
+				begin = mid + 1;			\
+			}						\
+		}							\
+		return begin;						\
+	}								\
+									\
+	/* first position in [begin, end) that is not less than key */	\
+	static size_t _##name##_lower_bound(const type *arr, size_t begin, size_t end, const type *key) \
+	{								\
+		while (begin < end) {					\
+			size_t mid = begin + (end - begin) / 2;		\
+			if (_##name##_less(&arr[mid], key)) {		\
+				begin = mid + 1;			\
+			} else {					\
+				end = mid;				\
+			}						\
+		}							\
+		return begin;						\
+	}								\
+									\
+	/* [begin, start) is already sorted */				\
+	static void _##name##_binary_insertion_sort(type *arr, size_t begin, size_t start, size_t end) \
+	{								\
+		for (size_t i = start; i < end; i++) {			\
+			size_t pos = _##name##_upper_bound(arr, begin, i, &arr[i]); \
+			if (pos != i) {					\
+				type tmp = arr[i];			\
+				memmove(&arr[pos + 1], &arr[pos], (i - pos) * sizeof(type)); \
+				arr[pos] = tmp;				\
+			}						\
+		}							\
+	}								\
+									\
+	/* returns the length of the run starting at begin (descending runs are reversed) */ \
+	static size_t _##name##_count_run(type *arr, size_t begin, size_t n) \
+	{								\
+		size_t i = begin + 1;					\
+		if (i == n) {						\
+			return 1;					\
+		}							\
+		if (_##name##_less(&arr[i], &arr[begin])) {		\
+			/* strictly descending, so reversing keeps the sort stable */ \
+			while (i + 1 < n && _##name##_less(&arr[i + 1], &arr[i])) { \
+				i++;					\
+			}						\
+			for (size_t l = begin, r = i; l < r; l++, r--) { \
+				type tmp = arr[l];			\
+				arr[l] = arr[r];			\
+				arr[r] = tmp;				\
+			}						\
+		} else {						\
+			while (i + 1 < n && !_##name##_less(&arr[i + 1], &arr[i])) { \
+				i++;					\
+			}						\
+		}							\
+		return i + 1 - begin;					\
+	}								\
+									\
+	/* merges the adjacent sorted runs [a, a + a_len) and [a + a_len, a + a_len + b_len) */ \
+	static void _##name##_merge(type *a, size_t a_len, size_t b_len, type *tmp) \
+	{								\
+		type *b = a + a_len;					\
+		/* elements of a that are not greater than b[0] are already in place */ \
+		size_t k = _##name##_upper_bound(a, 0, a_len, &b[0]);	\
+		a += k;							\
+		a_len -= k;						\
+		if (a_len == 0) {					\
+			return;						\
+		}							\
+		/* elements of b that are not less than the last element of a are already in place */ \
+		b_len = _##name##_lower_bound(b, 0, b_len, &a[a_len - 1]); \
+		if (b_len == 0) {					\
+			return;						\
+		}							\
+		if (a_len <= b_len) {					\
+			/* merge from the front, a is moved to tmp */	\
+			memcpy(tmp, a, a_len * sizeof(type));		\
+			type *out = a;					\
+			size_t i = 0, j = 0;				\
+			while (i < a_len && j < b_len) {		\
+				if (_##name##_less(&b[j], &tmp[i])) {	\
+					*out++ = b[j++];		\
+				} else {				\
+					*out++ = tmp[i++];		\
+				}					\
+			}						\
+			memcpy(out, &tmp[i], (a_len - i) * sizeof(type)); \
+		} else {						\
+			/* merge from the back, b is moved to tmp */	\
+			memcpy(tmp, b, b_len * sizeof(type));		\
+			type *out = b + b_len;				\
+			size_t i = a_len, j = b_len;			\
+			while (i > 0 && j > 0) {			\
+				if (_##name##_less(&tmp[j - 1], &a[i - 1])) { \
+					*--out = a[--i];		\
+				} else {				\
+					*--out = tmp[--j];		\
+				}					\
+			}						\
+			memcpy(out - j, tmp, j * sizeof(type));		\
+		}							\
+	}								\
+									\
+	static _attr_unused void name(type *arr, size_t n)		\
+	{								\
+		if (n < _STABLE_SORT_MIN_MERGE) {			\
+			if (n > 1) {					\
+				size_t run = _##name##_count_run(arr, 0, n); \
+				_##name##_binary_insertion_sort(arr, 0, run, n); \
+			}						\
+			return;						\
+		}							\
+		/* minimum run length between 32 and 64 such that n / min_run is close to a power of 2 */ \
+		size_t min_run = n;					\
+		size_t r = 0;						\
+		while (min_run >= _STABLE_SORT_MIN_MERGE) {		\
+			r |= min_run & 1;				\
+			min_run >>= 1;					\
+		}							\
+		min_run += r;						\
+		type *tmp = malloc((n / 2 + 1) * sizeof(type));		\
+		if (!tmp) {						\
+			abort();					\
+		}							\
+		size_t run_start[_STABLE_SORT_MAX_RUNS];		\
+		size_t run_len[_STABLE_SORT_MAX_RUNS];			\
+		size_t sp = 0;						\
+		size_t begin = 0;					\
+		while (begin < n) {					\
+			size_t len = _##name##_count_run(arr, begin, n); \
+			if (len < min_run) {				\
+				size_t forced = n - begin < min_run ? n - begin : min_run; \
+				_##name##_binary_insertion_sort(arr, begin, begin + len, begin + forced); \
+				len = forced;				\
+			}						\
+			run_start[sp] = begin;				\
+			run_len[sp] = len;				\
+			sp++;						\
+			begin += len;					\
+			/* restore the invariants of the run lengths (or merge all runs at the end) */ \
+			while (sp > 1) {				\
+				size_t i = sp - 2;			\
+				if (begin < n &&			\
+				    !(i > 0 && run_len[i - 1] <= run_len[i] + run_len[i + 1]) && \
+				    !(i > 1 && run_len[i - 2] <= run_len[i - 1] + run_len[i]) && \
+				    run_len[i] > run_len[i + 1]) {	\
+					break;				\
+				}					\
+				if (i > 0 && run_len[i - 1] < run_len[i + 1]) { \
+					i--;				\
+				}					\
+				_##name##_merge(&arr[run_start[i]], run_len[i], run_len[i + 1], tmp); \
+				run_len[i] += run_len[i + 1];		\
+				if (i + 2 < sp) {			\
+					run_start[i + 1] = run_start[i + 2]; \
+					run_len[i + 1] = run_len[i + 2]; \
+				}					\
+				sp--;					\
+			}						\
+		}							\
+		free(tmp);						\
+	}
+
+// k-way merge of sorted arrays with a binary heap of the current heads (see DEFINE_BINHEAP), O(n log k).
+// The merge is stable: equal elements are taken from the runs in the order of the runs (and within each run in
+// their original order).
+// Generates: size_t name(type *out, type *const runs[], const size_t lengths[], size_t k)
+// which writes all elements of the k runs to out in sorted order and returns the number of elements.
+// 'out' must not overlap with the runs.
+// Example:
+//   DEFINE_K_WAY_MERGE(integer_merge, int, (*a > *b) - (*a < *b))
+//   size_t n = integer_merge(out, runs, lengths, k);
+
+#define DEFINE_K_WAY_MERGE(name, type, ...)				\
+	struct _##name##_head {						\
+		type const *cur;					\
+		type const *end;					\
+		size_t run;						\
+	};								\
+									\
+	static inline int _##name##_cmp(type const *a, type const *b)	\
+	{								\
+		return (__VA_ARGS__);					\
+	}								\
+									\
+	static inline bool _##name##_head_less(struct _##name##_head const *a, struct _##name##_head const *b) \
+	{								\
+		int cmp = _##name##_cmp(a->cur, b->cur);		\
+		return cmp < 0 || (cmp == 0 && a->run < b->run);	\
+	}								\
+									\
+	DEFINE_BINHEAP(_##name##_heap, struct _##name##_head, _##name##_head_less(a, b)) \
+									\
+	static _attr_unused size_t name(type *out, type *const runs[], const size_t lengths[], size_t k) \
+	{								\
+		struct _##name##_head *heap = malloc((k ? k : 1) * sizeof(heap[0])); \
+		if (!heap) {						\
+			abort();					\
+		}							\
+		size_t total = 0;					\
+		size_t num_heads = 0;					\
+		for (size_t r = 0; r < k; r++) {			\
+			total += lengths[r];				\
+			if (lengths[r] != 0) {				\
+				heap[num_heads].cur = runs[r];		\
+				heap[num_heads].end = runs[r] + lengths[r]; \
+				heap[num_heads].run = r;		\
+				num_heads++;				\
+			}						\
+		}							\
+		_##name##_heap_heapify(heap, num_heads);		\
+		while (num_heads > 1) {					\
+			*out++ = *heap[0].cur++;			\
+			if (heap[0].cur == heap[0].end) {		\
+				_##name##_heap_delete_first(heap, num_heads); \
+				num_heads--;				\
+			} else {					\
+				_##name##_heap_sift_down(heap, num_heads, 0); \
+			}						\
+		}							\
+		if (num_heads == 1) {					\
+			memcpy(out, heap[0].cur, (heap[0].end - heap[0].cur) * sizeof(type)); \
+		}							\
+		free(heap);						\
+		return total;						\
+	}
@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include "btree.h" // enum btree_iter_start_at_mode
+#include "compiler.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * B+-tree for string keys (arbitrary bytes with a length) that stores the key bytes inline in fixed-size nodes.
+ * Every node stores the lower and upper bound (fence keys) of the key range it covers. All keys in a node share
+ * the common prefix of the fence keys, so only the remaining suffix is stored for each key. The first four bytes
+ * of each suffix are also stored in the slot array (as big-endian integer), which decides most comparisons
+ * without touching the key bytes.
+ * Keys can be at most STRING_BTREE_MAX_KEY_SIZE bytes long. Longer keys are never found and are not inserted
+ * (insert and set return false without modifying the tree).
+ */
+
+#define STRING_BTREE_NODE_SIZE      4096
+#define STRING_BTREE_MAX_KEY_SIZE   512
+#define STRING_BTREE_MAX_VALUE_SIZE 256
+
+struct _string_btree_slot {
+	uint32_t head; // first four bytes of the key suffix
+	unsigned short offset;
+	unsigned short length; // length of the key suffix
+};
+
+struct _string_btree_node {
+	unsigned short num_items;
+	unsigned short prefix_length;
+	unsigned short heap_start;
+	unsigned short heap_size;
+	unsigned short lower_fence_offset;
+	unsigned short lower_fence_length; // 0 means -inf
+	unsigned short upper_fence_offset;
+	unsigned short upper_fence_length; // 0 means +inf
+	bool leaf;
+	struct _string_btree_node *upper; // rightmost child (inner nodes only)
+	struct _string_btree_slot slots[];
+	/* unused space */
+	/* heap: value/child pointer + key suffix for each slot, fence keys */
+};
+
+struct _string_btree {
+	struct _string_btree_node *root;
+	unsigned char height; // 0 means root is NULL, 1 means root is leaf
+};
+
+struct string_btree_iter {
+	const struct _string_btree *tree;
+	unsigned int depth;
+	struct _string_btree_pos {
+		struct _string_btree_node *node;
+		unsigned int idx;
+	} path[32];
+	size_t key_length;
+	char key[STRING_BTREE_MAX_KEY_SIZE + 1]; // current key (null-terminated)
+};
+
+struct string_btree_info {
+	size_t value_size;
+	void (*destroy_value)(void *value);
+};
+
+#define STRING_BTREE_EMPTY {{.root = NULL, .height = 0}}
+
+#define __DEFINE_STRING_BTREE_COMMON(name)				\
+	struct name {							\
+		struct _string_btree _impl;				\
+	};								\
+									\
+	typedef struct string_btree_iter name##_iter_t;		\
+									\
+	static _attr_unused void name##_init(struct name *tree)		\
+	{								\
+		_string_btree_init(&tree->_impl);			\
+	}								\
+									\
+	static _attr_unused void name##_destroy(struct name *tree)	\
+	{								\
+		_string_btree_destroy(&tree->_impl, &name##_info);	\
+	}
+
+#define DEFINE_STRING_BTREE_SET(name)					\
+	static _Alignas(32) const struct string_btree_info name##_info = { \
+		.value_size = 0,					\
+		.destroy_value = NULL,					\
+	};								\
+									\
+	__DEFINE_STRING_BTREE_COMMON(name)				\
+									\
+	static _attr_unused bool name##_find(const struct name *tree, const char *key, size_t length) \
+	{								\
+		return _string_btree_find(&tree->_impl, key, length, &name##_info); \
+	}								\
+									\
+	static _attr_unused bool name##_insert(struct name *tree, const char *key, size_t length) \
+	{								\
+		return _string_btree_insert(&tree->_impl, key, length, NULL, false, &name##_info); \
+	}								\
+									\
+	static _attr_unused bool name##_delete(struct name *tree, const char *key, size_t length) \
+	{								\
+		return _string_btree_delete(&tree->_impl, key, length, NULL, &name##_info); \
+	}								\
+									\
+	/* the iterator functions return the current key (null-terminated, length in iter->key_length) */ \
+	static _attr_unused const char *name##_iter_start_leftmost(name##_iter_t *iter, const struct name *tree) \
+	{								\
+		return _string_btree_iter_start(iter, &tree->_impl, false, &name##_info) ? iter->key : NULL; \
+	}								\
+									\
+	static _attr_unused const char *name##_iter_start_rightmost(name##_iter_t *iter, const struct name *tree) \
+	{								\
+		return _string_btree_iter_start(iter, &tree->_impl, true, &name##_info) ? iter->key : NULL; \
+	}								\
+									\
+	static _attr_unused const char *name##_iter_start_at(name##_iter_t *iter, const struct name *tree, \
+							     const char *key, size_t length, \
+							     enum btree_iter_start_at_mode mode) \
+	{								\
+		return _string_btree_iter_start_at(iter, &tree->_impl, key, length, mode, &name##_info) ? \
+			iter->key : NULL;				\
+	}								\
+									\
+	static _attr_unused const char *name##_iter_next(name##_iter_t *iter) \
+	{								\
+		return _string_btree_iter_next(iter, &name##_info) ? iter->key : NULL; \
+	}								\
+									\
+	static _attr_unused const char *name##_iter_prev(name##_iter_t *iter) \
+	{								\
+		return _string_btree_iter_prev(iter, &name##_info) ? iter->key : NULL; \
+	}
+
+#define DEFINE_STRING_BTREE_MAP(name, value_type, value_destructor)	\
+	typedef value_type name##_value_t;				\
+	typedef void (*name##_value_destructor)(name##_value_t *value);	\
+									\
+	_Static_assert(sizeof(name##_value_t) <= STRING_BTREE_MAX_VALUE_SIZE, "value type is too large"); \
+	_Static_assert(_Alignof(name##_value_t) <= 8, "value type cannot have an alignment larger than 8"); \
+									\
+	static void _##name##_destroy_value(void *value)		\
+	{								\
+		name##_value_destructor destructor = (value_destructor); \
+		if (destructor) {					\
+			destructor(value);				\
+		}							\
+	}								\
+									\
+	static _Alignas(32) const struct string_btree_info name##_info = { \
+		.value_size = sizeof(name##_value_t),			\
+		.destroy_value = _##name##_destroy_value,		\
+	};								\
+									\
+	__DEFINE_STRING_BTREE_COMMON(name)				\
+									\
+	static _attr_unused name##_value_t *name##_find(const struct name *tree, const char *key, size_t length) \
+	{								\
+		return _string_btree_find(&tree->_impl, key, length, &name##_info); \
+	}								\
+									\
+	static _attr_unused bool name##_insert(struct name *tree, const char *key, size_t length, \
+					       name##_value_t value) \
+	{								\
+		return _string_btree_insert(&tree->_impl, key, length, &value, false, &name##_info); \
+	}								\
+									\
+	static _attr_unused bool name##_set(struct name *tree, const char *key, size_t length, \
+					    name##_value_t value)	\
+	{								\
+		return _string_btree_insert(&tree->_impl, key, length, &value, true, &name##_info); \
+	}								\
+									\
+	static _attr_unused bool name##_delete(struct name *tree, const char *key, size_t length, \
+					       name##_value_t *ret_value) \
+	{								\
+		return _string_btree_delete(&tree->_impl, key, length, ret_value, &name##_info); \
+	}								\
+									\
+	/* the iterator functions return the current value, the key is in iter->key and iter->key_length */ \
+	static _attr_unused name##_value_t *name##_iter_start_leftmost(name##_iter_t *iter, \
+								       const struct name *tree) \
+	{								\
+		return _string_btree_iter_start(iter, &tree->_impl, false, &name##_info); \
+	}								\
+									\
+	static _attr_unused name##_value_t *name##_iter_start_rightmost(name##_iter_t *iter, \
+									const struct name *tree) \
+	{								\
+		return _string_btree_iter_start(iter, &tree->_impl, true, &name##_info); \
+	}								\
+									\
+	static _attr_unused name##_value_t *name##_iter_start_at(name##_iter_t *iter, const struct name *tree, \
+								 const char *key, size_t length, \
+								 enum btree_iter_start_at_mode mode) \
+	{								\
+		return _string_btree_iter_start_at(iter, &tree->_impl, key, length, mode, &name##_info); \
+	}								\
+									\
+	static _attr_unused name##_value_t *name##_iter_next(name##_iter_t *iter) \
+	{								\
+		return _string_btree_iter_next(iter, &name##_info);	\
+	}								\
+									\
+	static _attr_unused name##_value_t *name##_iter_prev(name##_iter_t *iter) \
+	{								\
+		return _string_btree_iter_prev(iter, &name##_info);	\
+	}
+
+void _string_btree_init(struct _string_btree *tree);
+void _string_btree_destroy(struct _string_btree *tree, const struct string_btree_info *info);
+void *_string_btree_find(const struct _string_btree *tree, const char *key, size_t length,
+			 const struct string_btree_info *info);
+bool _string_btree_insert(struct _string_btree *tree, const char *key, size_t length, const void *value,
+			  bool update, const struct string_btree_info *info);
+bool _string_btree_delete(struct _string_btree *tree, const char *key, size_t length, void *ret_value,
+			  const struct string_btree_info *info);
+void *_string_btree_iter_start(struct string_btree_iter *iter, const struct _string_btree *tree, bool rightmost,
+			       const struct string_btree_info *info);
+void *_string_btree_iter_start_at(struct string_btree_iter *iter, const struct _string_btree *tree,
+				  const char *key, size_t length, enum btree_iter_start_at_mode mode,
+				  const struct string_btree_info *info);
+void *_string_btree_iter_next(struct string_btree_iter *iter, const struct string_btree_info *info);
+void *_string_btree_iter_prev(struct string_btree_iter *iter, const struct string_btree_info *info);
+
+bool _string_btree_debug_check(const struct _string_btree *tree, const struct string_btree_info *info);
@@ -23,54 +23,138 @@
 #include "array.h"
 #include "macros.h"
 
-void *_arr_resize_internal(void *arr, size_t elem_size, size_t capacity)
+// size of the allocator in front of the header (see _ARR_FLAG_ALLOCATOR), a multiple of _Alignof(max_align_t) so the
+// header and the elements have the same alignment as without an allocator
+#define ARR_ALLOCATOR_SIZE							\
+	((sizeof(struct allocator *) + _Alignof(max_align_t) - 1) / _Alignof(max_align_t) * _Alignof(max_align_t))
+
+static size_t _arr_prefix_size(const _arr *head)
 {
-	if (unlikely(capacity == 0)) {
-		if (arr) {
-			free(_arrhead(arr));
-		}
+	return unlikely(head->capacity & _ARR_FLAG_ALLOCATOR) ? ARR_ALLOCATOR_SIZE : 0;
+}
+
+static struct allocator *_arr_get_allocator(const _arr *head)
+{
+	if (likely(!(head->capacity & _ARR_FLAG_ALLOCATOR))) {
 		return NULL;
 	}
-	size_t new_size = sizeof(_arr) + (capacity * elem_size);
+	struct allocator *allocator;
+	memcpy(&allocator, (const char *)head - ARR_ALLOCATOR_SIZE, sizeof(allocator));
+	return allocator;
+}
+
+// size of the whole allocation (allocator, header and elements)
+static size_t _arr_allocation_size(size_t prefix_size, size_t elem_size, size_t capacity)
+{
+	if (unlikely(capacity > _ARR_CAPACITY_MASK)) {
+		abort();
+	}
+	size_t size = prefix_size + sizeof(_arr) + (capacity * elem_size);
 	// TODO should this check always be enabled even without fortify?
-	_fortify_check(((capacity * elem_size) / elem_size == capacity) && new_size > sizeof(_arr));
-	_arr *head;
-	if (unlikely(!arr)) {
-		head = malloc(new_size);
-		if (unlikely(!head)) {
-			abort();
-		}
-		head->length = 0;
+	_fortify_check(((capacity * elem_size) / elem_size == capacity) && size >= prefix_size + sizeof(_arr));
+	return size;
+}
+
+static _arr *_arr_allocate(size_t elem_size, size_t capacity, struct allocator *allocator)
+{
+	size_t prefix_size = allocator ? ARR_ALLOCATOR_SIZE : 0;
+	char *p = allocator_alloc(allocator, _arr_allocation_size(prefix_size, elem_size, capacity));
+	size_t flags = 0;
+	if (unlikely(allocator)) {
+		memcpy(p, &allocator, sizeof(allocator));
+		flags = _ARR_FLAG_ALLOCATOR;
+	}
+	_arr *head = (_arr *)(p + prefix_size);
+	head->length = 0;
+	head->capacity = capacity | flags;
 #ifdef __FORTIFY_ENABLED
-		head->magic1 = ARRAY_MAGIC1;
-		head->magic2 = ARRAY_MAGIC2;
+	head->magic1 = ARRAY_MAGIC1;
+	head->magic2 = ARRAY_MAGIC2;
 #endif
-	} else {
-		head = _arrhead(arr);
-		if (unlikely(capacity == head->capacity)) {
-			return arr;
+	return head;
+}
+
+void *_arr_free_internal(void *arr, size_t elem_size)
+{
+	if (arr && !(_arrhead(arr)->capacity & _ARR_FLAG_INLINE)) {
+		_arr *head = _arrhead(arr);
+		size_t prefix_size = _arr_prefix_size(head);
+		allocator_free(_arr_get_allocator(head), (char *)head - prefix_size,
+			       _arr_allocation_size(prefix_size, elem_size, _arrhead_capacity(head)));
+	}
+	return NULL;
+}
+
+void *_arr_resize_internal(void *arr, size_t elem_size, size_t capacity)
+{
+	if (unlikely(capacity == 0)) {
+		// an array with an allocator keeps an empty header, so later allocations still use the allocator
+		// (small arrays never have an allocator)
+		if (!arr || !(_arrhead(arr)->capacity & _ARR_FLAG_ALLOCATOR)) {
+			return _arr_free_internal(arr, elem_size);
 		}
-		head = realloc(head, new_size);
-		if (unlikely(!head)) {
-			abort();
+		_arr *head = _arrhead(arr);
+		if (_arrhead_capacity(head) != 0) {
+			char *p = allocator_realloc(_arr_get_allocator(head), (char *)head - ARR_ALLOCATOR_SIZE,
+						    _arr_allocation_size(ARR_ALLOCATOR_SIZE, elem_size,
+									 _arrhead_capacity(head)),
+						    ARR_ALLOCATOR_SIZE + sizeof(_arr));
+			head = (_arr *)(p + ARR_ALLOCATOR_SIZE);
+			head->length = 0;
+			head->capacity = _ARR_FLAG_ALLOCATOR;
 		}
-		if (unlikely(head->length > capacity)) {
-			head->length = capacity;
+		return head + 1;
+	}
+	if (unlikely(!arr)) {
+		return _arr_allocate(elem_size, capacity, NULL) + 1;
+	}
+	_arr *head = _arrhead(arr);
+	size_t old_capacity = _arrhead_capacity(head);
+	if (unlikely(capacity == old_capacity)) {
+		return arr;
+	}
+	if (head->capacity & _ARR_FLAG_INLINE) {
+		// the inline storage cannot shrink, move the elements to the heap if they do not fit anymore
+		if (capacity < old_capacity) {
+			if (head->length > capacity) {
+				head->length = capacity;
+			}
+			return arr;
 		}
+		// (_arr_addn increases the length before growing the array)
+		size_t n = head->length < old_capacity ? head->length : old_capacity;
+		_arr *new_head = _arr_allocate(elem_size, capacity, NULL);
+		new_head->length = head->length < capacity ? head->length : capacity;
+		memcpy(new_head + 1, arr, n * elem_size);
+		return new_head + 1;
 	}
-	head->capacity = capacity;
+	size_t prefix_size = _arr_prefix_size(head);
+	size_t flags = head->capacity & ~_ARR_CAPACITY_MASK;
+	char *p = allocator_realloc(_arr_get_allocator(head), (char *)head - prefix_size,
+				   _arr_allocation_size(prefix_size, elem_size, old_capacity),
+				   _arr_allocation_size(prefix_size, elem_size, capacity));
+	head = (_arr *)(p + prefix_size);
+	if (unlikely(head->length > capacity)) {
+		head->length = capacity;
+	}
+	head->capacity = capacity | flags;
 	return head + 1;
 }
 
+void *_arr_new_with_allocator(size_t elem_size, size_t capacity, struct allocator *allocator)
+{
+	return _arr_allocate(elem_size, capacity, allocator) + 1;
+}
+
 void *_arr_copy(const void *arr, size_t elem_size)
 {
-	void *new_arr = _arr_resize_internal(NULL, elem_size, _arr_capacity(arr));
-	if (unlikely(!new_arr)) {
+	if (unlikely(!arr)) {
 		return NULL;
 	}
-	_arrhead(new_arr)->length = _arr_length(arr);
-	memcpy(new_arr, arr, elem_size * _arr_length(arr));
-	return new_arr;
+	_arr *head = _arr_allocate(elem_size, _arr_capacity(arr), _arr_get_allocator(_arrhead_const(arr)));
+	head->length = _arr_length(arr);
+	memcpy(head + 1, arr, elem_size * _arr_length(arr));
+	return head + 1;
 }
 
 bool _arr_equal(const void *arr1, size_t elem_size, const void *arr2)
@@ -86,12 +170,8 @@ bool _arr_equal(const void *arr1, size_t elem_size, const void *arr2)
 	return memcmp(arr1, arr2, len * elem_size) == 0;
 }
 
-void _arr_grow(void **arrp, size_t elem_size, size_t n)
+size_t _arr_grow_capacity(size_t capacity, size_t n)
 {
-	if (unlikely(n == 0)) {
-		return;
-	}
-	size_t capacity = _arr_capacity(*arrp);
 	// TODO should this check always be enabled even without fortify?
 	_fortify_check(SIZE_MAX - n >= capacity);
 	const size_t numerator = ARRAY_GROWTH_FACTOR_NUMERATOR;
@@ -103,7 +183,15 @@ void _arr_grow(void **arrp, size_t elem_size, size_t n)
 	if (unlikely(new_capacity < ARRAY_INITIAL_SIZE)) {
 		new_capacity = ARRAY_INITIAL_SIZE;
 	}
-	*arrp = _arr_resize_internal(*arrp, elem_size, new_capacity);
+	return new_capacity;
+}
+
+void _arr_grow(void **arrp, size_t elem_size, size_t n)
+{
+	if (unlikely(n == 0)) {
+		return;
+	}
+	*arrp = _arr_resize_internal(*arrp, elem_size, _arr_grow_capacity(_arr_capacity(*arrp), n));
 }
 
 void _arr_make_valid(void **arrp, size_t elem_size, size_t i)
@@ -131,8 +219,8 @@ void *_arr_addn(void **arrp, size_t elem_size, size_t n)
 	_arr *head = _arrhead(*arrp);
 	size_t old_len = head->length;
 	head->length += n;
-	if (unlikely(head->length > head->capacity)) {
-		_arr_grow(arrp, elem_size, head->length - head->capacity);
+	if (unlikely(head->length > _arrhead_capacity(head))) {
+		_arr_grow(arrp, elem_size, head->length - _arrhead_capacity(head));
 	}
 	return (char *)(*arrp) + (old_len * elem_size);
 }
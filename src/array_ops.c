@@ -0,0 +1,509 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include "array_ops.h"
+#include "compiler.h"
+#include "config.h"
+#include "fortify.h"
+#include "simd.h"
+
+// The SIMD kernels are written with the vector extensions of GCC and clang and compiled twice with different target
+// attributes, only the movemask (vector to bitmask) and the shuffle of the filter need intrinsics. The scalar versions
+// are used on other architectures and compilers.
+#if defined(SIMD_X86) && __has_attribute(vector_size) && defined(HAVE_BUILTIN_CONVERTVECTOR)
+#define ARRAY_OPS_X86 1
+#include <immintrin.h>
+#endif
+
+#define SCALAR_CMP(cmp, x, y)						\
+	((cmp) == ARRAY_CMP_EQ ? (x) == (y) :				\
+	 (cmp) == ARRAY_CMP_NE ? (x) != (y) :				\
+	 (cmp) == ARRAY_CMP_LT ? (x) < (y) :				\
+	 (cmp) == ARRAY_CMP_LE ? (x) <= (y) :				\
+	 (cmp) == ARRAY_CMP_GT ? (x) > (y) :				\
+	 (x) >= (y))
+
+// calls the always inlined kernel f with a constant comparison so that every comparison gets its own loop
+#define CMP_SWITCH(cmp, f, ...)						\
+	switch (cmp) {							\
+	case ARRAY_CMP_EQ: return f(ARRAY_CMP_EQ, __VA_ARGS__);		\
+	case ARRAY_CMP_NE: return f(ARRAY_CMP_NE, __VA_ARGS__);		\
+	case ARRAY_CMP_LT: return f(ARRAY_CMP_LT, __VA_ARGS__);		\
+	case ARRAY_CMP_LE: return f(ARRAY_CMP_LE, __VA_ARGS__);		\
+	case ARRAY_CMP_GT: return f(ARRAY_CMP_GT, __VA_ARGS__);		\
+	case ARRAY_CMP_GE: return f(ARRAY_CMP_GE, __VA_ARGS__);		\
+	}								\
+	abort()
+
+#define DEFINE_SCALAR_KERNELS(name, type, acc_type)			\
+	static _attr_always_inline size_t name##_scalar_find_cmp(enum array_cmp cmp, const type *arr, size_t n, \
+								 type value) \
+	{								\
+		for (size_t i = 0; i < n; i++) {			\
+			if (SCALAR_CMP(cmp, arr[i], value)) {		\
+				return i;				\
+			}						\
+		}							\
+		return n;						\
+	}								\
+									\
+	static _attr_always_inline size_t name##_scalar_count_cmp(enum array_cmp cmp, const type *arr, size_t n, \
+								  type value) \
+	{								\
+		size_t count = 0;					\
+		for (size_t i = 0; i < n; i++) {			\
+			count += SCALAR_CMP(cmp, arr[i], value);	\
+		}							\
+		return count;						\
+	}								\
+									\
+	static _attr_always_inline size_t name##_scalar_filter_cmp(enum array_cmp cmp, type *arr, size_t n, \
+								   type value) \
+	{								\
+		size_t out = 0;						\
+		for (size_t i = 0; i < n; i++) {			\
+			type x = arr[i];				\
+			arr[out] = x;					\
+			out += SCALAR_CMP(cmp, x, value);		\
+		}							\
+		return out;						\
+	}								\
+									\
+	static size_t name##_scalar_find(const type *arr, size_t n, enum array_cmp cmp, type value) \
+	{								\
+		CMP_SWITCH(cmp, name##_scalar_find_cmp, arr, n, value);	\
+	}								\
+									\
+	static size_t name##_scalar_count(const type *arr, size_t n, enum array_cmp cmp, type value) \
+	{								\
+		CMP_SWITCH(cmp, name##_scalar_count_cmp, arr, n, value); \
+	}								\
+									\
+	static size_t name##_scalar_filter(type *arr, size_t n, enum array_cmp cmp, type value) \
+	{								\
+		CMP_SWITCH(cmp, name##_scalar_filter_cmp, arr, n, value); \
+	}								\
+									\
+	static type name##_scalar_min(const type *arr, size_t n)	\
+	{								\
+		type result = arr[0];					\
+		for (size_t i = 1; i < n; i++) {			\
+			result = arr[i] < result ? arr[i] : result;	\
+		}							\
+		return result;						\
+	}								\
+									\
+	static type name##_scalar_max(const type *arr, size_t n)	\
+	{								\
+		type result = arr[0];					\
+		for (size_t i = 1; i < n; i++) {			\
+			result = arr[i] > result ? arr[i] : result;	\
+		}							\
+		return result;						\
+	}								\
+									\
+	static acc_type name##_scalar_sum(const type *arr, size_t n)	\
+	{								\
+		acc_type sum = 0;					\
+		for (size_t i = 0; i < n; i++) {			\
+			sum += (acc_type)arr[i];			\
+		}							\
+		return sum;						\
+	}
+
+#ifdef ARRAY_OPS_X86
+
+#define SSE2_BYTES 16
+#define SSE2_MOVEMASK(m) ((unsigned int)_mm_movemask_epi8((__m128i)(m)))
+
+#define AVX2_BYTES 32
+#define AVX2_MOVEMASK(m) ((unsigned int)_mm256_movemask_epi8((__m256i)(m)))
+
+// vpermd lane indices that move the selected 32-bit lanes (or pairs of lanes for 64-bit elements) to the front
+static uint8_t compress_lut32[256][8];
+static uint8_t compress_lut64[16][8];
+
+// stores the elements of x for which the mask is set at dst and returns their number (overwrites a whole vector)
+static AVX2_TARGET _attr_always_inline size_t avx2_compress_store(void *dst, __m256i x, __m256i mask,
+								   size_t elem_size)
+{
+	unsigned int bits;
+	const uint8_t *indices;
+	if (elem_size == 4) {
+		bits = (unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(mask));
+		indices = compress_lut32[bits];
+	} else {
+		bits = (unsigned int)_mm256_movemask_pd(_mm256_castsi256_pd(mask));
+		indices = compress_lut64[bits];
+	}
+	__m256i permutation = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)indices));
+	_mm256_storeu_si256((__m256i *)dst, _mm256_permutevar8x32_epi32(x, permutation));
+	return (size_t)__builtin_popcount(bits);
+}
+
+// name##_##level##_half holds the elements that are converted to one accumulator vector in the sum
+// (mask_type must be the signed integer type with the size of type, acc_type must have 64 bits)
+#define DEFINE_SIMD_KERNELS(name, type, mask_type, acc_type, level, LEVEL) \
+	typedef type name##_##level##_vec __attribute__((vector_size(LEVEL##_BYTES))); \
+	typedef mask_type name##_##level##_mask __attribute__((vector_size(LEVEL##_BYTES))); \
+	typedef type name##_##level##_half __attribute__((vector_size(LEVEL##_BYTES * sizeof(type) / 8))); \
+	typedef acc_type name##_##level##_acc __attribute__((vector_size(LEVEL##_BYTES))); \
+									\
+	static LEVEL##_TARGET _attr_always_inline name##_##level##_vec name##_##level##_load(const type *p) \
+	{								\
+		name##_##level##_vec v;					\
+		memcpy(&v, p, sizeof(v));				\
+		return v;						\
+	}								\
+									\
+	static LEVEL##_TARGET _attr_always_inline name##_##level##_mask	\
+	name##_##level##_compare(enum array_cmp cmp, name##_##level##_vec x, name##_##level##_vec y) \
+	{								\
+		switch (cmp) {						\
+		case ARRAY_CMP_EQ: return (name##_##level##_mask)(x == y); \
+		case ARRAY_CMP_NE: return (name##_##level##_mask)(x != y); \
+		case ARRAY_CMP_LT: return (name##_##level##_mask)(x < y); \
+		case ARRAY_CMP_LE: return (name##_##level##_mask)(x <= y); \
+		case ARRAY_CMP_GT: return (name##_##level##_mask)(x > y); \
+		case ARRAY_CMP_GE: return (name##_##level##_mask)(x >= y); \
+		}							\
+		abort();						\
+	}								\
+									\
+	/* the elements of x where mask is set, the elements of y otherwise */ \
+	static LEVEL##_TARGET _attr_always_inline name##_##level##_vec	\
+	name##_##level##_select(name##_##level##_mask mask, name##_##level##_vec x, name##_##level##_vec y) \
+	{								\
+		return (name##_##level##_vec)((mask & (name##_##level##_mask)x) | \
+					      (~mask & (name##_##level##_mask)y)); \
+	}								\
+									\
+	static LEVEL##_TARGET _attr_always_inline size_t name##_##level##_find_cmp(enum array_cmp cmp, \
+										   const type *arr, size_t n, \
+										   type value) \
+	{								\
+		const size_t width = LEVEL##_BYTES / sizeof(type);	\
+		name##_##level##_vec v = (name##_##level##_vec){0} + value; \
+		size_t i = 0;						\
+		for (; i + 2 * width <= n; i += 2 * width) {		\
+			name##_##level##_mask m0 = name##_##level##_compare(cmp, name##_##level##_load(&arr[i]), v); \
+			name##_##level##_mask m1 = name##_##level##_compare(cmp, name##_##level##_load(&arr[i + width]), v); \
+			if (LEVEL##_MOVEMASK(m0 | m1) != 0) {		\
+				unsigned int bits = LEVEL##_MOVEMASK(m0); \
+				if (bits == 0) {			\
+					i += width;			\
+					bits = LEVEL##_MOVEMASK(m1);	\
+				}					\
+				return i + (unsigned int)__builtin_ctz(bits) / sizeof(type); \
+			}						\
+		}							\
+		for (; i < n; i++) {					\
+			if (SCALAR_CMP(cmp, arr[i], value)) {		\
+				return i;				\
+			}						\
+		}							\
+		return n;						\
+	}								\
+									\
+	static LEVEL##_TARGET _attr_always_inline size_t name##_##level##_count_cmp(enum array_cmp cmp, \
+										    const type *arr, size_t n, \
+										    type value) \
+	{								\
+		const size_t width = LEVEL##_BYTES / sizeof(type);	\
+		name##_##level##_vec v = (name##_##level##_vec){0} + value; \
+		size_t count = 0;					\
+		size_t i = 0;						\
+		while (i + width <= n) {				\
+			/* the lanes count down from 0 (a set mask is -1), flush them before they can overflow */ \
+			size_t block_end = n - i < (width << 16) ? n - (n - i) % width : i + (width << 16); \
+			name##_##level##_mask acc = {0};		\
+			for (; i < block_end; i += width) {		\
+				acc += name##_##level##_compare(cmp, name##_##level##_load(&arr[i]), v); \
+			}						\
+			for (size_t k = 0; k < width; k++) {		\
+				count -= (size_t)acc[k];		\
+			}						\
+		}							\
+		for (; i < n; i++) {					\
+			count += SCALAR_CMP(cmp, arr[i], value);	\
+		}							\
+		return count;						\
+	}								\
+									\
+	static LEVEL##_TARGET size_t name##_##level##_find(const type *arr, size_t n, enum array_cmp cmp, type value) \
+	{								\
+		CMP_SWITCH(cmp, name##_##level##_find_cmp, arr, n, value); \
+	}								\
+									\
+	static LEVEL##_TARGET size_t name##_##level##_count(const type *arr, size_t n, enum array_cmp cmp, type value) \
+	{								\
+		CMP_SWITCH(cmp, name##_##level##_count_cmp, arr, n, value); \
+	}								\
+									\
+	static LEVEL##_TARGET _attr_always_inline type name##_##level##_min_max(const type *arr, size_t n, bool max) \
+	{								\
+		const size_t width = LEVEL##_BYTES / sizeof(type);	\
+		const enum array_cmp cmp = max ? ARRAY_CMP_GT : ARRAY_CMP_LT; \
+		type result = arr[0];					\
+		size_t i = 0;						\
+		if (n >= 2 * width) {					\
+			/* two accumulators to hide the latency of compare and select */ \
+			name##_##level##_vec r0 = name##_##level##_load(&arr[0]); \
+			name##_##level##_vec r1 = name##_##level##_load(&arr[width]); \
+			for (i = 2 * width; i + 2 * width <= n; i += 2 * width) { \
+				name##_##level##_vec x0 = name##_##level##_load(&arr[i]); \
+				name##_##level##_vec x1 = name##_##level##_load(&arr[i + width]); \
+				r0 = name##_##level##_select(name##_##level##_compare(cmp, x0, r0), x0, r0); \
+				r1 = name##_##level##_select(name##_##level##_compare(cmp, x1, r1), x1, r1); \
+			}						\
+			r0 = name##_##level##_select(name##_##level##_compare(cmp, r1, r0), r1, r0); \
+			for (size_t k = 0; k < width; k++) {		\
+				result = SCALAR_CMP(cmp, r0[k], result) ? r0[k] : result; \
+			}						\
+		}							\
+		for (; i < n; i++) {					\
+			result = SCALAR_CMP(cmp, arr[i], result) ? arr[i] : result; \
+		}							\
+		return result;						\
+	}								\
+									\
+	static LEVEL##_TARGET type name##_##level##_min(const type *arr, size_t n) \
+	{								\
+		return name##_##level##_min_max(arr, n, false);		\
+	}								\
+									\
+	static LEVEL##_TARGET type name##_##level##_max(const type *arr, size_t n) \
+	{								\
+		return name##_##level##_min_max(arr, n, true);		\
+	}								\
+									\
+	static LEVEL##_TARGET acc_type name##_##level##_sum(const type *arr, size_t n) \
+	{								\
+		const size_t width = LEVEL##_BYTES / sizeof(acc_type);	\
+		name##_##level##_acc acc0 = {0};			\
+		name##_##level##_acc acc1 = {0};			\
+		size_t i = 0;						\
+		for (; i + 2 * width <= n; i += 2 * width) {		\
+			name##_##level##_half x0, x1;			\
+			memcpy(&x0, &arr[i], sizeof(x0));		\
+			memcpy(&x1, &arr[i + width], sizeof(x1));	\
+			acc0 += __builtin_convertvector(x0, name##_##level##_acc); \
+			acc1 += __builtin_convertvector(x1, name##_##level##_acc); \
+		}							\
+		acc0 += acc1;						\
+		acc_type sum = 0;					\
+		for (size_t k = 0; k < width; k++) {			\
+			sum += acc0[k];					\
+		}							\
+		for (; i < n; i++) {					\
+			sum += (acc_type)arr[i];			\
+		}							\
+		return sum;						\
+	}
+
+// the filter needs a variable shuffle (vpermd), so it has no SSE2 version
+#define DEFINE_AVX2_FILTER(name, type)					\
+	static AVX2_TARGET _attr_always_inline size_t name##_avx2_filter_cmp(enum array_cmp cmp, type *arr, size_t n, \
+									     type value) \
+	{								\
+		const size_t width = AVX2_BYTES / sizeof(type);		\
+		name##_avx2_vec v = (name##_avx2_vec){0} + value;	\
+		size_t out = 0;						\
+		size_t i = 0;						\
+		for (; i + width <= n; i += width) {			\
+			name##_avx2_vec x = name##_avx2_load(&arr[i]);	\
+			name##_avx2_mask m = name##_avx2_compare(cmp, x, v); \
+			unsigned int bits = AVX2_MOVEMASK(m);		\
+			if (bits == UINT32_MAX) {			\
+				memcpy(&arr[out], &x, sizeof(x));	\
+				out += width;				\
+			} else if (bits != 0) {				\
+				/* out <= i, so this only overwrites elements that were already loaded */ \
+				out += avx2_compress_store(&arr[out], (__m256i)x, (__m256i)m, sizeof(type)); \
+			}						\
+		}							\
+		for (; i < n; i++) {					\
+			type x = arr[i];				\
+			arr[out] = x;					\
+			out += SCALAR_CMP(cmp, x, value);		\
+		}							\
+		return out;						\
+	}								\
+									\
+	static AVX2_TARGET size_t name##_avx2_filter(type *arr, size_t n, enum array_cmp cmp, type value) \
+	{								\
+		CMP_SWITCH(cmp, name##_avx2_filter_cmp, arr, n, value);	\
+	}
+
+#define DEFINE_KERNELS(name, type, mask_type, acc_type)			\
+	DEFINE_SCALAR_KERNELS(name, type, acc_type)			\
+	DEFINE_SIMD_KERNELS(name, type, mask_type, acc_type, sse2, SSE2) \
+	DEFINE_SIMD_KERNELS(name, type, mask_type, acc_type, avx2, AVX2) \
+	DEFINE_AVX2_FILTER(name, type)
+
+static once_flag compress_luts_once = ONCE_FLAG_INIT;
+
+static void init_compress_luts(void)
+{
+	for (unsigned int bits = 0; bits < 256; bits++) {
+		unsigned int n = 0;
+		for (unsigned int k = 0; k < 8; k++) {
+			if (bits & (1u << k)) {
+				compress_lut32[bits][n++] = k;
+			}
+		}
+	}
+	for (unsigned int bits = 0; bits < 16; bits++) {
+		unsigned int n = 0;
+		for (unsigned int k = 0; k < 4; k++) {
+			if (bits & (1u << k)) {
+				compress_lut64[bits][n++] = 2 * k;
+				compress_lut64[bits][n++] = 2 * k + 1;
+			}
+		}
+	}
+}
+
+#define DISPATCH(name, op, ...)						\
+	switch (_simd_level()) {					\
+	case _SIMD_AVX2:						\
+		return name##_avx2_##op(__VA_ARGS__);			\
+	case _SIMD_SSE2:						\
+		return name##_sse2_##op(__VA_ARGS__);			\
+	case _SIMD_NONE:						\
+		break;							\
+	}								\
+	return name##_scalar_##op(__VA_ARGS__)
+
+#define DISPATCH_FILTER(name, ...)					\
+	if (_simd_level() == _SIMD_AVX2) {				\
+		call_once(&compress_luts_once, init_compress_luts);	\
+		return name##_avx2_filter(__VA_ARGS__);			\
+	}								\
+	return name##_scalar_filter(__VA_ARGS__)
+
+#else
+
+#define DEFINE_KERNELS(name, type, mask_type, acc_type)	\
+	DEFINE_SCALAR_KERNELS(name, type, acc_type)
+
+#define DISPATCH(name, op, ...) return name##_scalar_##op(__VA_ARGS__)
+#define DISPATCH_FILTER(name, ...) return name##_scalar_filter(__VA_ARGS__)
+
+#endif
+
+#define DEFINE_ARRAY_OPS(name, type, sum_type, mask_type, acc_type)	\
+	DEFINE_KERNELS(name, type, mask_type, acc_type)			\
+									\
+	size_t _arr_find_##name(const type *arr, enum array_cmp cmp, type value) \
+	{								\
+		DISPATCH(name, find, arr, _arr_length(arr), cmp, value); \
+	}								\
+									\
+	size_t _arr_count_##name(const type *arr, enum array_cmp cmp, type value) \
+	{								\
+		DISPATCH(name, count, arr, _arr_length(arr), cmp, value); \
+	}								\
+									\
+	type _arr_min_##name(const type *arr)				\
+	{								\
+		_fortify_check(_arr_length(arr) != 0);			\
+		DISPATCH(name, min, arr, _arr_length(arr));		\
+	}								\
+									\
+	type _arr_max_##name(const type *arr)				\
+	{								\
+		_fortify_check(_arr_length(arr) != 0);			\
+		DISPATCH(name, max, arr, _arr_length(arr));		\
+	}								\
+									\
+	sum_type _arr_sum_##name(const type *arr)			\
+	{								\
+		DISPATCH(name, sum, arr, _arr_length(arr));		\
+	}								\
+									\
+	static size_t _arr_filter_##name##_dispatch(type *arr, size_t n, enum array_cmp cmp, type value) \
+	{								\
+		DISPATCH_FILTER(name, arr, n, cmp, value);		\
+	}								\
+									\
+	size_t _arr_filter_##name(type *arr, enum array_cmp cmp, type value) \
+	{								\
+		size_t n = _arr_filter_##name##_dispatch(arr, _arr_length(arr), cmp, value); \
+		_arr_truncate(arr, n);					\
+		return n;						\
+	}
+
+DEFINE_ARRAY_OPS(i32, int32_t, int64_t, int32_t, uint64_t)
+DEFINE_ARRAY_OPS(u32, uint32_t, uint64_t, int32_t, uint64_t)
+DEFINE_ARRAY_OPS(i64, int64_t, int64_t, int64_t, uint64_t)
+DEFINE_ARRAY_OPS(u64, uint64_t, uint64_t, int64_t, uint64_t)
+DEFINE_ARRAY_OPS(f32, float, double, int32_t, double)
+DEFINE_ARRAY_OPS(f64, double, double, int64_t, double)
+
+// Hardware gather instructions still load one element at a time, so a plain loop is just as fast.
+#define GATHER_LOOP(type, src, out, indices, n, src_length)		\
+	do {								\
+		const type *_src = (const type *)(src);			\
+		type *_out = (type *)(out);				\
+		for (size_t i = 0; i < (n); i++) {			\
+			_fortify_check((indices)[i] < (src_length));	\
+			_out[i] = _src[(indices)[i]];			\
+		}							\
+	} while (0)
+
+#define DEFINE_GATHER(name, index_type)					\
+	void _arr_gather_##name(void **dstp, size_t elem_size, const void *src, const index_type *indices) \
+	{								\
+		size_t n = _arr_length(indices);			\
+		if (n == 0) {						\
+			return;						\
+		}							\
+		size_t src_length = _arr_length(src);			\
+		(void)src_length; /* only used by the fortify checks */	\
+		bool same = src == *dstp;				\
+		char *out = _arr_addn(dstp, elem_size, n);		\
+		if (same) {						\
+			/* src was reallocated */			\
+			src = *dstp;					\
+		}							\
+		switch (elem_size) {					\
+		case 4:							\
+			GATHER_LOOP(uint32_t, src, out, indices, n, src_length); \
+			break;						\
+		case 8:							\
+			GATHER_LOOP(uint64_t, src, out, indices, n, src_length); \
+			break;						\
+		default:						\
+			for (size_t i = 0; i < n; i++) {		\
+				_fortify_check(indices[i] < src_length); \
+				memcpy(out + i * elem_size, (const char *)src + indices[i] * elem_size, elem_size); \
+			}						\
+			break;						\
+		}							\
+	}
+
+DEFINE_GATHER(u32, uint32_t)
+DEFINE_GATHER(u64, uint64_t)
@@ -338,3 +338,105 @@ void avl_insert_node(struct avl_tree *root, struct avl_node *node, struct avl_no
 		dir = _avl_dir_of_child(node, parent);
 	}
 }
+
+void avl_insert_node_cached(struct avl_tree_cached *root, struct avl_node *node, struct avl_node *parent,
+			   enum avl_direction dir)
+{
+	if (!parent || (parent == root->leftmost && dir == AVL_LEFT)) {
+		root->leftmost = node;
+	}
+	avl_insert_node(&root->tree, node, parent, dir);
+}
+
+void avl_remove_node_cached(struct avl_tree_cached *root, struct avl_node *node)
+{
+	if (node == root->leftmost) {
+		// the leftmost node has no left child, so this is just one step in most cases
+		root->leftmost = avl_next(node);
+	}
+	avl_remove_node(&root->tree, node);
+}
+
+static struct avl_node *_avl_build_sorted(struct avl_node **nodes, size_t n, struct avl_node *parent,
+					  unsigned int *ret_height)
+{
+	if (n == 0) {
+		*ret_height = 0;
+		return NULL;
+	}
+	// the left subtree gets the extra node if there is one
+	size_t mid = n / 2;
+	struct avl_node *node = nodes[mid];
+	unsigned int left_height, right_height;
+	node->children[AVL_LEFT] = _avl_build_sorted(nodes, mid, node, &left_height);
+	node->children[AVL_RIGHT] = _avl_build_sorted(nodes + mid + 1, n - mid - 1, node, &right_height);
+	node->_parent_balance = 0;
+	_avl_set_parent(node, parent);
+	_avl_set_balance(node, (int)right_height - (int)left_height);
+	*ret_height = left_height + 1;
+	return node;
+}
+
+void avl_build_sorted(struct avl_tree *root, struct avl_node **nodes, size_t n)
+{
+	unsigned int height;
+	root->root = _avl_build_sorted(nodes, n, NULL, &height);
+}
+
+static struct avl_node **_avl_flatten(const struct avl_tree *root, struct avl_node **nodes)
+{
+	for (struct avl_node *node = avl_first(root); node; node = avl_next(node)) {
+		*nodes++ = node;
+	}
+	return nodes;
+}
+
+static size_t _avl_count(const struct avl_tree *root)
+{
+	size_t n = 0;
+	for (struct avl_node *node = avl_first(root); node; node = avl_next(node)) {
+		n++;
+	}
+	return n;
+}
+
+void avl_union(struct avl_tree *dest, struct avl_tree *src,
+	       int (*cmp)(const struct avl_node *a, const struct avl_node *b),
+	       void (*duplicate)(struct avl_node *node))
+{
+	size_t n1 = _avl_count(dest);
+	size_t n2 = _avl_count(src);
+	if (n2 == 0) {
+		return;
+	}
+	struct avl_node **nodes = malloc((2 * n1 + n2) * sizeof(nodes[0]));
+	if (!nodes) {
+		abort();
+	}
+	// flatten both trees into the back of the array and merge them into the front
+	struct avl_node **a = nodes + n1 + n2;
+	struct avl_node **b = nodes + n1;
+	struct avl_node **a_end = _avl_flatten(dest, a);
+	struct avl_node **b_end = _avl_flatten(src, b);
+	struct avl_node **out = nodes;
+	while (a != a_end && b != b_end) {
+		int c = cmp(*a, *b);
+		if (c < 0 || (c == 0 && !duplicate)) {
+			*out++ = *a++;
+		} else if (c > 0) {
+			*out++ = *b++;
+		} else {
+			duplicate(*b++);
+		}
+	}
+	// out never overtakes b
+	while (b != b_end) {
+		*out++ = *b++;
+	}
+	while (a != a_end) {
+		*out++ = *a++;
+	}
+	avl_build_sorted(dest, nodes, out - nodes);
+	src->root = NULL;
+	free(nodes);
+}
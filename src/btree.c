@@ -264,18 +264,30 @@ void *_btree_iter_start_at(struct btree_iter *iter, const struct _btree *tree, v
 	return btree_node_item(pos->node, pos->idx, info);
 }
 
-static struct _btree_node *btree_new_node(bool leaf, const struct btree_info *info)
+static size_t btree_node_size(bool leaf, const struct btree_info *info)
 {
 	size_t items_size = info->max_items * info->item_size;
 	size_t children_size = leaf ? 0 : (info->max_items + 1) * sizeof(struct _btree_node *);
-	struct _btree_node *node = malloc(sizeof(*node) + info->alignment_offset + items_size + children_size);
+	return sizeof(struct _btree_node) + info->alignment_offset + items_size + children_size;
+}
+
+static struct _btree_node *btree_new_node(struct _btree *tree, bool leaf, const struct btree_info *info)
+{
+	struct _btree_node *node = allocator_alloc(tree->allocator, btree_node_size(leaf, info));
 	node->num_items = 0;
 	return node;
 }
 
-void _btree_init(struct _btree *tree)
+static void btree_free_node(struct _btree *tree, struct _btree_node *node, bool leaf,
+			    const struct btree_info *info)
+{
+	allocator_free(tree->allocator, node, btree_node_size(leaf, info));
+}
+
+void _btree_init(struct _btree *tree, struct allocator *allocator)
 {
 	memset(tree, 0, sizeof(*tree));
+	tree->allocator = allocator;
 }
 
 void _btree_destroy(struct _btree *tree, const struct btree_info *info)
@@ -304,7 +316,7 @@ void _btree_destroy(struct _btree *tree, const struct btree_info *info)
 					info->destroy_item(btree_node_item(pos->node, i, info));
 				}
 			}
-			free(pos->node);
+			btree_free_node(tree, pos->node, depth == tree->height, info);
 			if (--depth == 0) {
 				tree->root = NULL;
 				tree->height = 0;
@@ -483,7 +495,7 @@ bool _btree_delete(struct _btree *tree, enum _btree_deletion_mode mode, const vo
 				       (right->num_items + 1) * sizeof(struct _btree_node *));
 			}
 			left->num_items += right->num_items;
-			free(right);
+			btree_free_node(tree, right, leaf, info);
 		} else if (left->num_items > right->num_items) {
 			btree_node_shift_items_right(right, 0, info);
 			btree_node_copy_item(right, 0, node, idx, info);
@@ -517,19 +529,19 @@ bool _btree_delete(struct _btree *tree, enum _btree_deletion_mode mode, const vo
 			tree->root = btree_node_get_child(node, 0, info);
 		}
 		tree->height--;
-		free(node);
+		btree_free_node(tree, node, tree->height == 0, info);
 	}
 
 	return true;
 }
 
 /* item will be inserted and then set to the median */
-static struct _btree_node *btree_node_split_and_insert(struct _btree_node *node, unsigned int idx,
-						      void *item, struct _btree_node *right,
+static struct _btree_node *btree_node_split_and_insert(struct _btree *tree, struct _btree_node *node,
+						      unsigned int idx, void *item, struct _btree_node *right,
 						      const struct btree_info *info)
 {
 	// assert(node->num_items == info->max_items);
-	struct _btree_node *new_node = btree_new_node(!right, info);
+	struct _btree_node *new_node = btree_new_node(tree, !right, info);
 	node->num_items = info->min_items;
 	if (idx < info->min_items) {
 		memcpy(btree_node_item(new_node, 0, info),
@@ -604,7 +616,7 @@ static void _btree_insert_and_rebalance_even(struct _btree *tree, void *item, un
 			return;
 		}
 
-		right = btree_node_split_and_insert(node, idx, item, right, info);
+		right = btree_node_split_and_insert(tree, node, idx, item, right, info);
 
 		if (--depth == 0) {
 			break;
@@ -612,7 +624,7 @@ static void _btree_insert_and_rebalance_even(struct _btree *tree, void *item, un
 		idx = path[depth - 1].idx;
 		node = path[depth - 1].node;
 	}
-	struct _btree_node *new_root = btree_new_node(false, info);
+	struct _btree_node *new_root = btree_new_node(tree, false, info);
 	btree_node_set_item(new_root, 0, item, info);
 	new_root->num_items = 1;
 	btree_node_set_child(new_root, 0, node, info);
@@ -621,11 +633,11 @@ static void _btree_insert_and_rebalance_even(struct _btree *tree, void *item, un
 	tree->height++;
 }
 
-static struct _btree_node *btree_node_split(struct _btree_node *node, void *median, bool leaf,
-					   const struct btree_info *info)
+static struct _btree_node *btree_node_split(struct _btree *tree, struct _btree_node *node, void *median,
+					   bool leaf, const struct btree_info *info)
 {
 	// assert(node->num_items == info->max_items);
-	struct _btree_node *new_node = btree_new_node(leaf, info);
+	struct _btree_node *new_node = btree_new_node(tree, leaf, info);
 	node->num_items = info->min_items;
 	btree_node_get_item(median, node, info->min_items, info);
 	memcpy(btree_node_item(new_node, 0, info),
@@ -648,7 +660,7 @@ static void _btree_insert_and_rebalance_odd(struct _btree *tree, void *item, uns
 	if (last_nonfull_node_depth != depth) {
 		unsigned int d = last_nonfull_node_depth;
 		if (d == 0) {
-			struct _btree_node *new_root = btree_new_node(false, info);
+			struct _btree_node *new_root = btree_new_node(tree, false, info);
 			btree_node_set_child(new_root, 0, tree->root, info);
 			tree->root = new_root;
 			tree->height++;
@@ -662,7 +674,7 @@ static void _btree_insert_and_rebalance_odd(struct _btree *tree, void *item, uns
 		do {
 			d++;
 			void *median = alloca(info->item_size);
-			struct _btree_node *right = btree_node_split(btree_node_get_child(node, idx, info),
+			struct _btree_node *right = btree_node_split(tree, btree_node_get_child(node, idx, info),
 								    median, d == depth, info);
 			btree_node_shift_items_right(node, idx, info);
 			btree_node_set_item(node, idx, median, info);
@@ -696,7 +708,7 @@ static void _btree_insert_and_rebalance(struct _btree *tree, void *item, unsigne
 bool _btree_insert(struct _btree *tree, void *item, bool update, const struct btree_info *info)
 {
 	if (tree->height == 0) {
-		tree->root = btree_new_node(true, info);
+		tree->root = btree_new_node(tree, true, info);
 		tree->height = 1;
 	}
 	struct _btree_node *node = tree->root;
@@ -759,10 +771,157 @@ bool _btree_insert_sequential(struct _btree *tree, void *item, const struct btre
 	return true;
 }
 
-static struct _btree_node *btree_node_copy(struct _btree_node *node, unsigned int depth,
+/* merges the sorted items [items, items_end) into the leaf starting at idx, the caller has to make sure that the
+ * leaf has room for num_new items (num_new excludes items that are already in the leaf or appear twice) */
+static void btree_leaf_merge_run(struct _btree_node *leaf, unsigned int idx, const unsigned char *items,
+				 const unsigned char *items_end, unsigned int num_new, const struct btree_info *info)
+{
+	unsigned int src = leaf->num_items;
+	unsigned int dest = src + num_new;
+	const unsigned char *item = items_end;
+	while (item != items) {
+		item -= info->item_size;
+		if (item != items && info->cmp(item, item - info->item_size) == 0) {
+			continue;
+		}
+		int cmp = -1;
+		while (src > idx && (cmp = info->cmp(item, btree_node_item(leaf, src - 1, info))) < 0) {
+			btree_node_copy_item(leaf, --dest, leaf, --src, info);
+		}
+		if (src > idx && cmp == 0) {
+			continue;
+		}
+		btree_node_set_item(leaf, --dest, item, info);
+	}
+	// assert(dest == src);
+	leaf->num_items += num_new;
+}
+
+size_t _btree_insert_batch(struct _btree *tree, const void *items, size_t num_items, const struct btree_info *info)
+{
+	const unsigned char *item = items;
+	const unsigned char *items_end = item + num_items * info->item_size;
+	const unsigned char *prev_item = NULL;
+	void *tmp = alloca(info->item_size);
+	struct _btree_pos path[32];
+	unsigned int depth = 0; // number of valid entries in path
+	size_t num_inserted = 0;
+	while (item != items_end) {
+		if (tree->height == 0) {
+			memcpy(tmp, item, info->item_size);
+			num_inserted += _btree_insert(tree, tmp, false, info);
+			prev_item = item;
+			item += info->item_size;
+			depth = 0;
+			continue;
+		}
+
+		if (prev_item && info->cmp(item, prev_item) < 0) {
+			// the input is not sorted, we can only reuse the path for items that are larger than the last one
+			depth = 0;
+		}
+
+		// go up the previous path until we reach a subtree that contains the item
+		// (only the upper bounds need to be checked since the items are sorted)
+		unsigned int keep = depth;
+		const void *upper_bound = NULL;
+		for (unsigned int d = depth; d > 1; d--) {
+			struct _btree_pos *pos = &path[d - 2];
+			if (pos->idx == pos->node->num_items) {
+				continue;
+			}
+			void *separator = btree_node_item(pos->node, pos->idx, info);
+			if (info->cmp(item, separator) < 0) {
+				upper_bound = separator;
+				break;
+			}
+			keep = d - 1;
+		}
+		if (keep == 0) {
+			path[0].node = tree->root;
+			keep = 1;
+		}
+
+		depth = keep;
+		struct _btree_node *node = path[depth - 1].node;
+		bool found;
+		for (;;) {
+			struct _btree_pos *pos = &path[depth - 1];
+			found = btree_node_search(node, item, &pos->idx, info);
+			if (found || depth == tree->height) {
+				break;
+			}
+			if (pos->idx < node->num_items) {
+				upper_bound = btree_node_item(node, pos->idx, info);
+			}
+			node = btree_node_get_child(node, pos->idx, info);
+			path[depth++].node = node;
+		}
+		prev_item = item;
+		if (found) {
+			item += info->item_size;
+			continue;
+		}
+
+		unsigned int idx = path[depth - 1].idx;
+		unsigned int num_free = info->max_items - node->num_items;
+		if (num_free == 0) {
+			// the leaf is full, so do a regular insertion (with splits) and start over at the root
+			unsigned int last_nonfull_node_depth = 0;
+			for (unsigned int d = 1; d < depth; d++) {
+				if (path[d - 1].node->num_items < info->max_items) {
+					last_nonfull_node_depth = d;
+				}
+			}
+			memcpy(tmp, item, info->item_size);
+			_btree_insert_and_rebalance(tree, tmp, idx, node, path, depth, last_nonfull_node_depth,
+						    info);
+			num_inserted++;
+			item += info->item_size;
+			depth = 0;
+			continue;
+		}
+
+		// collect all following items that also belong into this leaf and merge them in one go
+		const unsigned char *run_end = item;
+		unsigned int num_new = 0;
+		unsigned int leaf_idx = idx;
+		while (run_end != items_end && num_new < num_free) {
+			if (upper_bound && info->cmp(run_end, upper_bound) >= 0) {
+				break;
+			}
+			if (run_end != item) {
+				int cmp = info->cmp(run_end, run_end - info->item_size);
+				if (cmp < 0) {
+					break;
+				}
+				if (cmp == 0) {
+					run_end += info->item_size;
+					continue;
+				}
+			}
+			int cmp = 1;
+			while (leaf_idx < node->num_items &&
+			       (cmp = info->cmp(run_end, btree_node_item(node, leaf_idx, info))) > 0) {
+				leaf_idx++;
+			}
+			if (leaf_idx == node->num_items || cmp != 0) {
+				num_new++;
+			}
+			run_end += info->item_size;
+		}
+		btree_leaf_merge_run(node, idx, item, run_end, num_new, info);
+		num_inserted += num_new;
+		prev_item = run_end - info->item_size;
+		item = run_end;
+	}
+	return num_inserted;
+}
+
+static struct _btree_node *btree_node_copy(struct _btree *tree, struct _btree_node *node, unsigned int depth,
 					  const struct btree_info *info)
 {
-	struct _btree_node *copy = btree_new_node(depth == 0, info);
+	struct _btree_node *copy = btree_new_node(tree, depth == 0, info);
 	memcpy(btree_node_item(copy, 0, info),
 	       btree_node_item(node, 0, info),
 	       node->num_items * info->item_size);
@@ -772,7 +931,7 @@ static struct _btree_node *btree_node_copy(struct _btree_node *node, unsigned in
 	}
 	for (unsigned int i = 0; i < node->num_items + 1u; i++) {
 		struct _btree_node *child = btree_node_get_child(node, i, info);
-		struct _btree_node *child_copy = btree_node_copy(child, depth - 1, info);
+		struct _btree_node *child_copy = btree_node_copy(tree, child, depth - 1, info);
 		btree_node_set_child(copy, i, child_copy, info);
 	}
 	return copy;
@@ -783,6 +942,7 @@ struct _btree _btree_debug_copy(const struct _btree *tree, const struct btree_in
 	unsigned int height = tree->height;
 	struct _btree copy;
 	copy.height = height;
-	copy.root = height == 0 ? NULL : btree_node_copy(tree->root, height - 1, info);
+	copy.allocator = tree->allocator;
+	copy.root = height == 0 ? NULL : btree_node_copy(&copy, tree->root, height - 1, info);
 	return copy;
 }
@@ -28,16 +28,22 @@ void dbuf_init(struct dbuf *dbuf)
 	*dbuf = DBUF_INITIALIZER;
 }
 
+void dbuf_init_with_allocator(struct dbuf *dbuf, struct allocator *allocator)
+{
+	*dbuf = DBUF_INITIALIZER;
+	dbuf->_allocator = allocator;
+}
+
 void dbuf_destroy(struct dbuf *dbuf)
 {
-	free(dbuf->_buf);
+	allocator_free(dbuf->_allocator, dbuf->_buf, dbuf->_capacity);
 	dbuf_init(dbuf);
 }
 
 void *dbuf_finalize(struct dbuf *dbuf)
 {
 	void *buf = dbuf->_buf;
-	dbuf_init(dbuf);
+	dbuf_init_with_allocator(dbuf, dbuf->_allocator);
 	return buf;
 }
 
@@ -47,13 +53,11 @@ struct dbuf dbuf_copy(const struct dbuf *dbuf)
 	copy._size = dbuf->_size;
 	copy._capacity = dbuf->_capacity;
 	copy._buf = NULL;
+	copy._allocator = dbuf->_allocator;
 	if (unlikely(dbuf->_capacity == 0)) {
 		return copy;
 	}
-	copy._buf = malloc(dbuf->_capacity);
-	if (unlikely(!copy._buf)) {
-		abort();
-	}
+	copy._buf = allocator_alloc(dbuf->_allocator, dbuf->_capacity);
 	memcpy(copy._buf, dbuf->_buf, dbuf->_size);
 	return copy;
 }
@@ -95,10 +99,7 @@ void dbuf_resize(struct dbuf *dbuf, size_t capacity)
 	if (unlikely(capacity == dbuf->_capacity)) {
 		return;
 	}
-	dbuf->_buf = realloc(dbuf->_buf, capacity);
-	if (unlikely(!dbuf->_buf && capacity != 0)) {
-		abort();
-	}
+	dbuf->_buf = allocator_realloc(dbuf->_allocator, dbuf->_buf, dbuf->_capacity, capacity);
 	if (unlikely(dbuf->_size > capacity)) {
 		dbuf->_size = capacity;
 	}
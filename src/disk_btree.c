@@ -0,0 +1,481 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "compiler.h"
+#include "disk_btree.h"
+
+#define PAGE_SIZE DISK_BTREE_PAGE_SIZE
+
+static const char disk_btree_magic[8] = "ADBTREE";
+static const uint32_t disk_btree_byte_order = 0x01020304;
+
+typedef struct _disk_btree_page page_t;
+
+static const page_t *disk_btree_get_page(const struct _disk_btree *tree, uint32_t page_number)
+{
+	return (const page_t *)(tree->map + (size_t)page_number * PAGE_SIZE);
+}
+
+// The file might be truncated or corrupt, so the page numbers and item counts are checked before a page is used
+// (the pages are not validated when the file is opened to keep loading them on demand).
+// The leaves are the pages 1 to num_leaves, the inner nodes are stored after them.
+static const page_t *disk_btree_get_leaf(const struct _disk_btree *tree, uint32_t page_number,
+					 const struct disk_btree_info *info)
+{
+	if (page_number == 0 || page_number > tree->num_leaves) {
+		return NULL;
+	}
+	const page_t *page = disk_btree_get_page(tree, page_number);
+	if (page->num_items == 0 || page->num_items > info->leaf_capacity) {
+		return NULL;
+	}
+	return page;
+}
+
+static const page_t *disk_btree_get_inner(const struct _disk_btree *tree, uint32_t page_number,
+					  const struct disk_btree_info *info)
+{
+	if (page_number <= tree->num_leaves || page_number >= tree->map_size / PAGE_SIZE) {
+		return NULL;
+	}
+	const page_t *page = disk_btree_get_page(tree, page_number);
+	if (page->num_items > info->inner_capacity) {
+		return NULL;
+	}
+	return page;
+}
+
+static const void *leaf_item(const page_t *page, unsigned int idx, const struct disk_btree_info *info)
+{
+	return page->data + idx * info->item_size;
+}
+
+static size_t inner_children_offset(const struct disk_btree_info *info)
+{
+	return (info->inner_capacity * info->key_size + sizeof(uint32_t) - 1) & ~(sizeof(uint32_t) - 1);
+}
+
+static uint32_t inner_get_child(const page_t *page, unsigned int idx, const struct disk_btree_info *info)
+{
+	uint32_t child;
+	memcpy(&child, page->data + inner_children_offset(info) + idx * sizeof(uint32_t), sizeof(child));
+	return child;
+}
+
+// returns the index of the first element that is >= key
+static unsigned int disk_btree_search(const unsigned char *elements, unsigned int num_elements, size_t size,
+				      const void *key, bool *found, const struct disk_btree_info *info)
+{
+	unsigned int start = 0;
+	unsigned int end = num_elements;
+	while (start < end) {
+		unsigned int mid = (start + end) / 2;
+		int cmp = info->cmp(key, elements + mid * size);
+		if (cmp == 0) {
+			*found = true;
+			return mid;
+		} else if (cmp > 0) {
+			start = mid + 1;
+		} else {
+			end = mid;
+		}
+	}
+	*found = false;
+	return start;
+}
+
+// returns NULL if the file is corrupt
+static const page_t *disk_btree_find_leaf(const struct _disk_btree *tree, const void *key, uint32_t *ret_page_number,
+					  const struct disk_btree_info *info)
+{
+	uint32_t page_number = tree->root;
+	for (unsigned int depth = 1; depth < tree->height; depth++) {
+		const page_t *page = disk_btree_get_inner(tree, page_number, info);
+		if (unlikely(!page)) {
+			return NULL;
+		}
+		// separators are the first keys of the right subtrees
+		bool found;
+		unsigned int idx = disk_btree_search(page->data, page->num_items, info->key_size, key, &found, info);
+		page_number = inner_get_child(page, found ? idx + 1 : idx, info);
+	}
+	*ret_page_number = page_number;
+	return disk_btree_get_leaf(tree, page_number, info);
+}
+
+bool _disk_btree_open(struct _disk_btree *tree, const char *path, const struct disk_btree_info *info)
+{
+	memset(tree, 0, sizeof(*tree));
+	int fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		return false;
+	}
+	if (st.st_size < PAGE_SIZE || st.st_size % PAGE_SIZE != 0) {
+		close(fd);
+		errno = EINVAL;
+		return false;
+	}
+	size_t size = st.st_size;
+	// nothing is read here (except for the header), pages get loaded on demand
+	void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return false;
+	}
+
+	const struct _disk_btree_header *header = map;
+	if (memcmp(header->magic, disk_btree_magic, sizeof(disk_btree_magic)) != 0 ||
+	    header->byte_order != disk_btree_byte_order ||
+	    header->page_size != PAGE_SIZE ||
+	    header->item_size != info->item_size ||
+	    header->key_size != info->key_size ||
+	    (size_t)header->num_pages * PAGE_SIZE != size ||
+	    header->height > 32 ||
+	    header->num_leaves >= header->num_pages ||
+	    (header->height == 0) != (header->num_items == 0) ||
+	    (header->height != 0 && (header->num_leaves == 0 || header->root == 0 ||
+				     (header->height == 1) != (header->root <= header->num_leaves) ||
+				     header->root >= header->num_pages))) {
+		munmap(map, size);
+		errno = EINVAL;
+		return false;
+	}
+
+	tree->map = map;
+	tree->map_size = size;
+	tree->num_items = header->num_items;
+	tree->root = header->root;
+	tree->num_leaves = header->num_leaves;
+	tree->height = header->height;
+	return true;
+}
+
+void _disk_btree_close(struct _disk_btree *tree)
+{
+	if (tree->map) {
+		munmap((void *)tree->map, tree->map_size);
+	}
+	memset(tree, 0, sizeof(*tree));
+}
+
+const void *_disk_btree_find(const struct _disk_btree *tree, const void *key, const struct disk_btree_info *info)
+{
+	if (tree->height == 0) {
+		return NULL;
+	}
+	uint32_t page_number;
+	const page_t *leaf = disk_btree_find_leaf(tree, key, &page_number, info);
+	if (unlikely(!leaf)) {
+		return NULL;
+	}
+	bool found;
+	unsigned int idx = disk_btree_search(leaf->data, leaf->num_items, info->item_size, key, &found, info);
+	return found ? leaf_item(leaf, idx, info) : NULL;
+}
+
+// the leaves are stored in order in the pages 1 to num_leaves, so the iterator doesn't need a path
+
+const void *_disk_btree_iter_start(struct disk_btree_iter *iter, const struct _disk_btree *tree, bool rightmost,
+				   const struct disk_btree_info *info)
+{
+	iter->tree = tree;
+	iter->page = 0;
+	iter->idx = 0;
+	if (tree->height == 0) {
+		return NULL;
+	}
+	iter->page = rightmost ? tree->num_leaves : 1;
+	const page_t *leaf = disk_btree_get_leaf(tree, iter->page, info);
+	if (unlikely(!leaf)) {
+		iter->page = 0;
+		return NULL;
+	}
+	iter->idx = rightmost ? leaf->num_items - 1 : 0;
+	return leaf_item(leaf, iter->idx, info);
+}
+
+const void *_disk_btree_iter_next(struct disk_btree_iter *iter, const struct disk_btree_info *info)
+{
+	if (iter->page == 0) {
+		return NULL;
+	}
+	// the current leaf was already checked
+	const page_t *leaf = disk_btree_get_page(iter->tree, iter->page);
+	if (++iter->idx >= leaf->num_items) {
+		iter->idx = 0;
+		leaf = disk_btree_get_leaf(iter->tree, iter->page + 1, info);
+		if (!leaf) {
+			// past the last leaf (or a corrupt leaf)
+			iter->page = 0;
+			return NULL;
+		}
+		iter->page++;
+	}
+	return leaf_item(leaf, iter->idx, info);
+}
+
+const void *_disk_btree_iter_prev(struct disk_btree_iter *iter, const struct disk_btree_info *info)
+{
+	if (iter->page == 0) {
+		return NULL;
+	}
+	const page_t *leaf;
+	if (iter->idx == 0) {
+		if (iter->page == 1) {
+			iter->page = 0;
+			return NULL;
+		}
+		iter->page--;
+		leaf = disk_btree_get_leaf(iter->tree, iter->page, info);
+		if (unlikely(!leaf)) {
+			iter->page = 0;
+			return NULL;
+		}
+		iter->idx = leaf->num_items - 1;
+	} else {
+		leaf = disk_btree_get_page(iter->tree, iter->page);
+		iter->idx--;
+	}
+	return leaf_item(leaf, iter->idx, info);
+}
+
+const void *_disk_btree_iter_start_at(struct disk_btree_iter *iter, const struct _disk_btree *tree,
+				      const void *key, enum btree_iter_start_at_mode mode,
+				      const struct disk_btree_info *info)
+{
+	iter->tree = tree;
+	iter->page = 0;
+	iter->idx = 0;
+	if (tree->height == 0) {
+		return NULL;
+	}
+	const page_t *leaf = disk_btree_find_leaf(tree, key, &iter->page, info);
+	if (unlikely(!leaf)) {
+		iter->page = 0;
+		return NULL;
+	}
+	bool found;
+	iter->idx = disk_btree_search(leaf->data, leaf->num_items, info->item_size, key, &found, info);
+	switch (mode) {
+	case BTREE_ITER_FIND_KEY:
+		if (!found) {
+			iter->page = 0;
+			return NULL;
+		}
+		break;
+	case BTREE_ITER_LOWER_BOUND_INCLUSIVE:
+	case BTREE_ITER_LOWER_BOUND_EXCLUSIVE:
+		if ((found && mode == BTREE_ITER_LOWER_BOUND_EXCLUSIVE) || iter->idx == leaf->num_items) {
+			if (!found) {
+				iter->idx--;
+			}
+			return _disk_btree_iter_next(iter, info);
+		}
+		break;
+	case BTREE_ITER_UPPER_BOUND_INCLUSIVE:
+	case BTREE_ITER_UPPER_BOUND_EXCLUSIVE:
+		if (!found || mode == BTREE_ITER_UPPER_BOUND_EXCLUSIVE) {
+			return _disk_btree_iter_prev(iter, info);
+		}
+		break;
+	}
+	return leaf_item(leaf, iter->idx, info);
+}
+
+static bool disk_btree_builder_write_page(struct disk_btree_builder *builder, const void *page,
+					  uint32_t page_number)
+{
+	const unsigned char *p = page;
+	size_t remaining = PAGE_SIZE;
+	off_t offset = (off_t)page_number * PAGE_SIZE;
+	while (remaining != 0) {
+		ssize_t n = pwrite(builder->fd, p, remaining, offset);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			builder->failed = true;
+			return false;
+		}
+		p += n;
+		offset += n;
+		remaining -= n;
+	}
+	return true;
+}
+
+static bool disk_btree_builder_flush_leaf(struct disk_btree_builder *builder)
+{
+	if (builder->num_pages == UINT32_MAX) {
+		builder->failed = true;
+		errno = EFBIG;
+		return false;
+	}
+	if (!disk_btree_builder_write_page(builder, builder->page, builder->num_pages)) {
+		return false;
+	}
+	builder->num_pages++;
+	memset(builder->page, 0, PAGE_SIZE);
+	return true;
+}
+
+bool _disk_btree_builder_start(struct disk_btree_builder *builder, const char *path,
+			       const struct disk_btree_info *info)
+{
+	(void)info;
+	memset(builder, 0, sizeof(*builder));
+	builder->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (builder->fd < 0) {
+		return false;
+	}
+	builder->page = calloc(1, PAGE_SIZE);
+	if (unlikely(!builder->page)) {
+		abort();
+	}
+	// page 0 is the header, which is written last (so incomplete files are never valid)
+	builder->num_pages = 1;
+	return true;
+}
+
+bool _disk_btree_builder_add(struct disk_btree_builder *builder, const void *item,
+			     const struct disk_btree_info *info)
+{
+	if (builder->failed) {
+		return false;
+	}
+	page_t *leaf = builder->page;
+	if (builder->num_items != 0) {
+		// the current leaf is only written when the next item does not fit, so it is never empty here
+		if (info->cmp(item, leaf_item(leaf, leaf->num_items - 1, info)) <= 0) {
+			builder->failed = true;
+			errno = EINVAL;
+			return false;
+		}
+		if (leaf->num_items == info->leaf_capacity && !disk_btree_builder_flush_leaf(builder)) {
+			return false;
+		}
+	}
+	if (leaf->num_items == 0) {
+		// remember the first key of each leaf to build the inner nodes later
+		size_t num_leaves = builder->num_pages; // including the current leaf
+		if (num_leaves > builder->keys_capacity) {
+			builder->keys_capacity = builder->keys_capacity == 0 ? 64 : 2 * builder->keys_capacity;
+			builder->keys = realloc(builder->keys, builder->keys_capacity * info->key_size);
+			if (unlikely(!builder->keys)) {
+				abort();
+			}
+		}
+		memcpy(builder->keys + (num_leaves - 1) * info->key_size, item, info->key_size);
+	}
+	memcpy(leaf->data + leaf->num_items * info->item_size, item, info->item_size);
+	leaf->num_items++;
+	builder->num_items++;
+	return true;
+}
+
+// builds one level of inner nodes, the children are the pages first_child to first_child + num_children - 1
+// and keys contains the first key of each child, returns the number of new nodes (pages)
+static uint32_t disk_btree_builder_build_level(struct disk_btree_builder *builder, uint32_t first_child,
+					       uint32_t num_children, const struct disk_btree_info *info)
+{
+	uint32_t max_children = info->inner_capacity + 1;
+	uint32_t num_nodes = (num_children + max_children - 1) / max_children;
+	size_t children_offset = inner_children_offset(info);
+	page_t *node = builder->page;
+	uint32_t child = 0;
+	for (uint32_t i = 0; i < num_nodes; i++) {
+		// distribute the children evenly
+		uint32_t n = num_children / num_nodes + (i < num_children % num_nodes);
+		memset(node, 0, PAGE_SIZE);
+		node->num_items = n - 1;
+		memcpy(node->data, builder->keys + (child + 1) * info->key_size, (n - 1) * info->key_size);
+		for (uint32_t j = 0; j < n; j++) {
+			uint32_t page_number = first_child + child + j;
+			memcpy(node->data + children_offset + j * sizeof(uint32_t), &page_number, sizeof(uint32_t));
+		}
+		// the first key of the new node is the first key of its first child (i <= child)
+		memmove(builder->keys + i * info->key_size, builder->keys + child * info->key_size, info->key_size);
+		if (builder->num_pages == UINT32_MAX) {
+			builder->failed = true;
+			errno = EFBIG;
+			return 0;
+		}
+		if (!disk_btree_builder_write_page(builder, node, builder->num_pages)) {
+			return 0;
+		}
+		builder->num_pages++;
+		child += n;
+	}
+	return num_nodes;
+}
+
+bool _disk_btree_builder_finish(struct disk_btree_builder *builder, const struct disk_btree_info *info)
+{
+	struct _disk_btree_header header = {
+		.byte_order = disk_btree_byte_order,
+		.page_size = PAGE_SIZE,
+		.item_size = info->item_size,
+		.key_size = info->key_size,
+		.num_items = builder->num_items,
+	};
+	memcpy(header.magic, disk_btree_magic, sizeof(header.magic));
+	if (!builder->failed && builder->num_items != 0 && disk_btree_builder_flush_leaf(builder)) {
+		header.num_leaves = builder->num_pages - 1;
+		header.height = 1;
+		uint32_t first_page = 1;
+		uint32_t num_pages = header.num_leaves;
+		while (num_pages > 1 && !builder->failed) {
+			uint32_t first_parent = builder->num_pages;
+			num_pages = disk_btree_builder_build_level(builder, first_page, num_pages, info);
+			first_page = first_parent;
+			header.height++;
+		}
+		header.root = first_page;
+	}
+	if (!builder->failed) {
+		header.num_pages = builder->num_pages;
+		memset(builder->page, 0, PAGE_SIZE);
+		memcpy(builder->page, &header, sizeof(header));
+		disk_btree_builder_write_page(builder, builder->page, 0);
+	}
+	int saved_errno = errno;
+	if (close(builder->fd) != 0 && !builder->failed) {
+		builder->failed = true;
+		saved_errno = errno;
+	}
+	free(builder->page);
+	free(builder->keys);
+	errno = saved_errno;
+	return !builder->failed;
+}
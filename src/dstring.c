@@ -28,9 +28,11 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "allocator.h"
 #include "compiler.h"
 #include "config.h"
 #include "dstring.h"
+#include "simd.h"
 #include "utils.h"
 
 static _attr_always_inline struct strview _strview_from_chars(const char *chars, size_t n)
@@ -128,33 +130,293 @@ bool strview_equal_cstr(struct strview view, const char *cstr)
 	return strncmp(view.characters, cstr, view.length) == 0 && cstr[view.length] == '\0';
 }
 
-size_t strview_find(struct strview haystack, struct strview needle, size_t pos)
+// memmem is linear in the worst case, the memchr loop is only used if it is not available
+static const char *_strview_find_generic(const char *haystack, size_t n, const char *needle, size_t m)
 {
-	haystack = strview_narrow(haystack, pos, 0);
 #if defined(HAVE_MEMMEM) && defined(_GNU_SOURCE)
-	const char *found = memmem(haystack.characters, haystack.length, needle.characters, needle.length);
+	return memmem(haystack, n, needle, m);
 #else
-	if (unlikely(needle.length == 0)) {
-		return 0;
+	if (unlikely(m == 0)) {
+		return haystack;
 	}
-	if (unlikely(needle.length > haystack.length)) {
-		return DSTR_NPOS;
+	if (unlikely(m > n)) {
+		return NULL;
 	}
-	const char *found = NULL;
-	const char *p = haystack.characters;
-	const char *end = haystack.characters + haystack.length - needle.length;
+	const char *p = haystack;
+	const char *end = haystack + n - m;
 	for (;;) {
-		p = memchr(p, needle.characters[0], end - p + 1);
+		p = memchr(p, needle[0], end - p + 1);
 		if (!p) {
-			break;
+			return NULL;
 		}
-		if (memcmp(p + 1, needle.characters + 1, needle.length - 1) == 0) {
-			found = p;
-			break;
+		if (memcmp(p + 1, needle + 1, m - 1) == 0) {
+			return p;
 		}
 		p++;
 	}
 #endif
+}
+
+// set of bytes for the find_first_of family
+// The vector versions build their lookup tables from the bitmap, so short strings only pay for the bitmap.
+struct byte_set {
+	uint64_t bitmap[4];
+};
+
+// shorter strings are scanned by the scalar loop, longer ones check a few bytes before setting up the vectors
+#define BYTE_SET_SIMD_MIN_LENGTH 64
+#define BYTE_SET_SCALAR_PREFIX 16
+
+static void _byte_set_init(struct byte_set *set, const unsigned char *chars)
+{
+	memset(set, 0, sizeof(*set));
+	for (const unsigned char *c = chars; *c != '\0'; c++) {
+		set->bitmap[*c / 64] |= (uint64_t)1 << (*c % 64);
+	}
+}
+
+static _attr_always_inline bool _byte_set_contains(const struct byte_set *set, unsigned char c)
+{
+	return (set->bitmap[c / 64] >> (c % 64)) & 1;
+}
+
+// returns the index of the first (or last if reverse) character in chars[0, n) which is (not if reject) in the set
+static _attr_always_inline size_t _byte_set_scalar_find(const struct byte_set *set, const char *chars, size_t n,
+							bool reject, bool reverse)
+{
+	for (size_t i = reverse ? n : 0; reverse ? i-- > 0 : i < n; reverse ? 0 : i++) {
+		if (_byte_set_contains(set, (unsigned char)chars[i]) != reject) {
+			return i;
+		}
+	}
+	return STRVIEW_NPOS;
+}
+
+#ifdef SIMD_X86
+
+#include <immintrin.h>
+
+// runs the statement for every byte c in the set
+#define BYTE_SET_FOREACH(set, c, ...)					\
+	for (unsigned int _word = 0; _word < 4; _word++) {		\
+		for (uint64_t _bits = (set)->bitmap[_word]; _bits != 0; _bits &= _bits - 1) { \
+			unsigned char c = (unsigned char)(_word * 64 + (unsigned int)__builtin_ctzll(_bits)); \
+			__VA_ARGS__;					\
+		}							\
+	}
+
+// the SSE2 version compares with every byte of the set, so it is only used for small sets
+#define SSE2_MAX_CHARS 8
+
+static _attr_always_inline unsigned int _byte_set_size(const struct byte_set *set)
+{
+	return (unsigned int)(__builtin_popcountll(set->bitmap[0]) + __builtin_popcountll(set->bitmap[1]) +
+			      __builtin_popcountll(set->bitmap[2]) + __builtin_popcountll(set->bitmap[3]));
+}
+
+struct _strview_sse2_set {
+	__m128i chars[SSE2_MAX_CHARS];
+	unsigned int num_chars;
+};
+
+static SSE2_TARGET _attr_always_inline void _strview_sse2_set_init(struct _strview_sse2_set *vset,
+								   const struct byte_set *set)
+{
+	vset->num_chars = 0;
+	BYTE_SET_FOREACH(set, c, vset->chars[vset->num_chars++] = _mm_set1_epi8((char)c));
+}
+
+// bit i of the result is set if p[i] is in the set
+static SSE2_TARGET _attr_always_inline unsigned int _strview_sse2_match(const struct _strview_sse2_set *vset,
+									const char *p)
+{
+	__m128i x = _mm_loadu_si128((const __m128i *)p);
+	__m128i matched = _mm_setzero_si128();
+	for (unsigned int i = 0; i < vset->num_chars; i++) {
+		matched = _mm_or_si128(matched, _mm_cmpeq_epi8(x, vset->chars[i]));
+	}
+	return (unsigned int)_mm_movemask_epi8(matched);
+}
+
+// the AVX2 version looks up the bytes in two tables with the low nibble as the index (pshufb), the rows contain
+// one bit for every high nibble
+struct _strview_avx2_set {
+	__m256i low_table;  // c < 128
+	__m256i high_table; // c >= 128
+	__m256i bit_table;
+};
+
+static AVX2_TARGET _attr_always_inline void _strview_avx2_set_init(struct _strview_avx2_set *vset,
+								   const struct byte_set *set)
+{
+	uint8_t tables[2][16] = {{0}};
+	BYTE_SET_FOREACH(set, c, tables[c / 128][c % 16] |= (uint8_t)(1u << (c / 16 % 8)));
+	vset->low_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables[0]));
+	vset->high_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)tables[1]));
+	vset->bit_table = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+					   1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+}
+
+static AVX2_TARGET _attr_always_inline unsigned int _strview_avx2_match(const struct _strview_avx2_set *vset,
+									const char *p)
+{
+	__m256i x = _mm256_loadu_si256((const __m256i *)p);
+	// pshufb returns 0 if the high bit of the index is set, so every byte selects its row from one of the tables
+	__m256i rows = _mm256_or_si256(_mm256_shuffle_epi8(vset->low_table, x),
+				       _mm256_shuffle_epi8(vset->high_table,
+							   _mm256_xor_si256(x, _mm256_set1_epi8(-128))));
+	__m256i high_nibbles = _mm256_and_si256(_mm256_srli_epi16(x, 4), _mm256_set1_epi8(0x0f));
+	__m256i bits = _mm256_shuffle_epi8(vset->bit_table, high_nibbles);
+	__m256i matched = _mm256_cmpeq_epi8(_mm256_and_si256(rows, bits), bits);
+	return (unsigned int)_mm256_movemask_epi8(matched);
+}
+
+// The last (partial) block is loaded so that it ends at the end of the characters and overlaps with the previous
+// block, the bits of the characters that were already checked are cleared.
+#define DEFINE_BYTE_SET_FIND(level, LEVEL, width)			\
+	static LEVEL##_TARGET _attr_always_inline size_t _strview_##level##_find_characters( \
+		const struct byte_set *set, const char *chars, size_t n, bool reject, bool reverse) \
+	{								\
+		if (n < (width)) {					\
+			return _byte_set_scalar_find(set, chars, n, reject, reverse); \
+		}							\
+		const unsigned int all = (unsigned int)(((uint64_t)1 << (width)) - 1); \
+		struct _strview_##level##_set vset;			\
+		_strview_##level##_set_init(&vset, set);		\
+		if (!reverse) {						\
+			size_t i = 0;					\
+			for (; i + (width) <= n; i += (width)) {	\
+				unsigned int bits = _strview_##level##_match(&vset, chars + i); \
+				bits = reject ? ~bits & all : bits;	\
+				if (bits != 0) {			\
+					return i + (unsigned int)__builtin_ctz(bits); \
+				}					\
+			}						\
+			if (i < n) {					\
+				size_t start = n - (width);		\
+				unsigned int bits = _strview_##level##_match(&vset, chars + start); \
+				bits = (reject ? ~bits & all : bits) >> (i - start); \
+				if (bits != 0) {			\
+					return i + (unsigned int)__builtin_ctz(bits); \
+				}					\
+			}						\
+			return STRVIEW_NPOS;				\
+		}							\
+		size_t i = n;						\
+		for (; i >= (width); i -= (width)) {			\
+			unsigned int bits = _strview_##level##_match(&vset, chars + i - (width)); \
+			bits = reject ? ~bits & all : bits;		\
+			if (bits != 0) {				\
+				return i - (width) + 31 - (unsigned int)__builtin_clz(bits); \
+			}						\
+		}							\
+		if (i > 0) {						\
+			unsigned int bits = _strview_##level##_match(&vset, chars); \
+			bits = (reject ? ~bits & all : bits) & ((1u << i) - 1); \
+			if (bits != 0) {				\
+				return 31 - (unsigned int)__builtin_clz(bits); \
+			}						\
+		}							\
+		return STRVIEW_NPOS;					\
+	}								\
+									\
+	static LEVEL##_TARGET size_t _strview_##level##_find_first(const struct byte_set *set, const char *chars, \
+								   size_t n, bool reject) \
+	{								\
+		return _strview_##level##_find_characters(set, chars, n, reject, false); \
+	}								\
+									\
+	static LEVEL##_TARGET size_t _strview_##level##_find_last(const struct byte_set *set, const char *chars, \
+								  size_t n, bool reject) \
+	{								\
+		return _strview_##level##_find_characters(set, chars, n, reject, true); \
+	}
+
+DEFINE_BYTE_SET_FIND(sse2, SSE2, 16)
+DEFINE_BYTE_SET_FIND(avx2, AVX2, 32)
+
+// Substring search which only compares the positions where the first and the last byte of the needle match.
+// This is much faster than memmem for typical text, but a needle like "aaab" in "aaaa..." produces a candidate at
+// every position, so the rest is searched with the generic version once the candidates cost more than the scan.
+// (mm and si are the prefix and suffix of the intrinsics)
+#define DEFINE_FIND(level, LEVEL, width, vec, mm, si)			\
+	static LEVEL##_TARGET const char *_strview_##level##_find(const char *haystack, size_t n, const char *needle, \
+								  size_t m) \
+	{								\
+		vec first = mm##_set1_epi8(needle[0]);			\
+		vec last = mm##_set1_epi8(needle[m - 1]);		\
+		size_t verified = 0;					\
+		size_t i = 0;						\
+		for (; i + (m - 1) + (width) <= n; i += (width)) {	\
+			vec a = mm##_loadu_si##si((const vec *)(haystack + i)); \
+			vec b = mm##_loadu_si##si((const vec *)(haystack + i + m - 1)); \
+			unsigned int bits = (unsigned int)mm##_movemask_epi8(mm##_and_si##si(mm##_cmpeq_epi8(a, first), \
+										 mm##_cmpeq_epi8(b, last))); \
+			while (bits != 0) {				\
+				size_t k = i + (unsigned int)__builtin_ctz(bits); \
+				if (memcmp(haystack + k + 1, needle + 1, m - 2) == 0) { \
+					return haystack + k;		\
+				}					\
+				verified += m;				\
+				bits &= bits - 1;			\
+			}						\
+			if (unlikely(verified > 2 * i + 1024)) {	\
+				break;					\
+			}						\
+		}							\
+		return _strview_find_generic(haystack + i, n - i, needle, m); \
+	}
+
+DEFINE_FIND(sse2, SSE2, 16, __m128i, _mm, 128)
+DEFINE_FIND(avx2, AVX2, 32, __m256i, _mm256, 256)
+
+#endif
+
+static size_t _byte_set_find(const struct byte_set *set, const char *chars, size_t n, bool reject, bool reverse)
+{
+#ifdef SIMD_X86
+	// setting up the vector tables costs more than scanning a few bytes, so short strings and matches close to
+	// the start are handled by the scalar loop
+	enum _simd_level level = n < BYTE_SET_SIMD_MIN_LENGTH ? _SIMD_NONE : _simd_level();
+	if (level == _SIMD_SSE2 && _byte_set_size(set) > SSE2_MAX_CHARS) {
+		level = _SIMD_NONE;
+	}
+	if (level != _SIMD_NONE) {
+		size_t skip = BYTE_SET_SCALAR_PREFIX;
+		const char *rest = chars + (reverse ? 0 : skip);
+		size_t found = reverse ? _byte_set_scalar_find(set, chars + n - skip, skip, reject, true) :
+			_byte_set_scalar_find(set, chars, skip, reject, false);
+		if (found != STRVIEW_NPOS) {
+			return reverse ? found + n - skip : found;
+		}
+		if (level == _SIMD_AVX2) {
+			found = reverse ? _strview_avx2_find_last(set, rest, n - skip, reject) :
+				_strview_avx2_find_first(set, rest, n - skip, reject);
+		} else {
+			found = reverse ? _strview_sse2_find_last(set, rest, n - skip, reject) :
+				_strview_sse2_find_first(set, rest, n - skip, reject);
+		}
+		return found == STRVIEW_NPOS || reverse ? found : found + skip;
+	}
+#endif
+	return reverse ? _byte_set_scalar_find(set, chars, n, reject, true) :
+		_byte_set_scalar_find(set, chars, n, reject, false);
+}
+
+size_t strview_find(struct strview haystack, struct strview needle, size_t pos)
+{
+	haystack = strview_narrow(haystack, pos, 0);
+	const char *found;
+#ifdef SIMD_X86
+	enum _simd_level level = _simd_level();
+	if (needle.length >= 2 && needle.length <= haystack.length && level != _SIMD_NONE) {
+		found = (level == _SIMD_AVX2 ? _strview_avx2_find : _strview_sse2_find)(
+			haystack.characters, haystack.length, needle.characters, needle.length);
+	} else
+#endif
+	{
+		found = _strview_find_generic(haystack.characters, haystack.length, needle.characters, needle.length);
+	}
 	return found ? (size_t)(found - haystack.characters) + pos : STRVIEW_NPOS;
 }
 
@@ -225,21 +487,10 @@ size_t _strview_find_characters(struct strview view, const unsigned char *chars,
 	} else if (!reverse) {
 		view = strview_narrow(view, pos, 0);
 	}
-	unsigned char accept_table[UCHAR_MAX];
-	memset(accept_table, reject, sizeof(accept_table));
-	for (const unsigned char *c = chars; *c != '\0'; c++) {
-		accept_table[*c] = !reject;
-	}
-	const char *found = NULL;
-	for (size_t i = reverse ? view.length : 0;
-	     reverse ? i-- > 0 : i < view.length;
-	     reverse ? 0 : i++) {
-		if (accept_table[(unsigned char)view.characters[i]]) {
-			found = &view.characters[i];
-			break;
-		}
-	}
-	return found ? (size_t)(found - start) : STRVIEW_NPOS;
+	struct byte_set set;
+	_byte_set_init(&set, chars);
+	size_t found = _byte_set_find(&set, view.characters, view.length, reject, reverse);
+	return found != STRVIEW_NPOS ? (size_t)(view.characters - start) + found : STRVIEW_NPOS;
 }
 
 size_t strview_find_first_of(struct strview view, const char *accept, size_t pos)
@@ -272,13 +523,11 @@ size_t strview_find_last_of(struct strview view, const char *accept, size_t pos)
 
 size_t strview_find_first_not_of(struct strview view, const char *reject, size_t pos)
 {
-	// TODO optimized version for single character reject?
 	return _strview_find_characters(view, (const unsigned char *)reject, true, false, pos);
 }
 
 size_t strview_find_last_not_of(struct strview view, const char *reject, size_t pos)
 {
-	// TODO optimized version for single character reject?
 	return _strview_find_characters(view, (const unsigned char *)reject, true, true, pos);
 }
 
@@ -399,6 +648,46 @@ struct strview_list strview_split(struct strview view, char c, size_t max)
 	return (struct strview_list){ .strings = list, .count = count };
 }
 
+struct strview_list strview_split_any(struct strview view, const char *delimiters, size_t max)
+{
+	struct byte_set set;
+	_byte_set_init(&set, (const unsigned char *)delimiters);
+	struct strview *list = NULL;
+	size_t allocated = 0;
+	size_t start = 0;
+	size_t count = 0;
+	while (count < max) {
+		// tokens are usually short, so check the first bytes before dispatching to the vector version
+		size_t remaining = view.length - start;
+		size_t prefix = remaining < BYTE_SET_SCALAR_PREFIX ? remaining : BYTE_SET_SCALAR_PREFIX;
+		size_t found = _byte_set_scalar_find(&set, &view.characters[start], prefix, false, false);
+		if (found == STRVIEW_NPOS && prefix < remaining) {
+			found = _byte_set_find(&set, &view.characters[start + prefix], remaining - prefix, false, false);
+			found = found == STRVIEW_NPOS ? found : found + prefix;
+		}
+		size_t pos = found != STRVIEW_NPOS ? start + found : view.length;
+		if (count == allocated) {
+			allocated = allocated == 0 ? 2 : 2 * allocated;
+			list = realloc(list, allocated * sizeof(list[0]));
+			if (unlikely(!list)) {
+				abort();
+			}
+		}
+		list[count++] = strview_substring(view, start, pos - start);
+		if (found == STRVIEW_NPOS) {
+			break;
+		}
+		start = pos + 1;
+	}
+	if (count != allocated) {
+		struct strview *list2 = realloc(list, count * sizeof(list[0]));
+		if (list2) {
+			list = list2;
+		}
+	}
+	return (struct strview_list){ .strings = list, .count = count };
+}
+
 struct strview_list strview_rsplit(struct strview view, char c, size_t max)
 {
 	struct strview *list = NULL;
@@ -494,6 +783,12 @@ enum _dstr_type {
 	__DSTR_BIG
 };
 
+// flags in the is_big byte of medium and big strings
+// A string with a custom allocator always has a medium or big header, the allocator is stored in front of it:
+// [struct allocator *][struct _dstr_medium/_dstr_big][characters]
+#define __DSTR_FLAG_BIG       1
+#define __DSTR_FLAG_ALLOCATOR 2
+
 static const uint8_t _dstr_empty_dstr_bytes[3] = { 0 /* length */, 0 /* capacity */, 0 /* null terminator */};
 static const dstr_t _dstr_empty_dstr = ((struct _dstr_small *)_dstr_empty_dstr_bytes)->characters;
 
@@ -503,7 +798,7 @@ static _attr_always_inline enum _dstr_type _dstr_get_type(const dstr_t dstr)
 	if (likely(header->small_length != UINT8_MAX)) {
 		return __DSTR_SMALL;
 	}
-	return unlikely(header->is_big) ? __DSTR_BIG : __DSTR_MEDIUM;
+	return unlikely(header->is_big & __DSTR_FLAG_BIG) ? __DSTR_BIG : __DSTR_MEDIUM;
 }
 
 size_t dstr_length(const dstr_t dstr)
@@ -591,14 +886,82 @@ static _attr_pure size_t _dstr_header_size(enum _dstr_type type)
 	unreachable();
 }
 
+static struct allocator *_dstr_get_allocator(const dstr_t dstr)
+{
+	const struct _dstr_common *header = (const struct _dstr_common *)dstr - 1;
+	if (likely(header->small_length != UINT8_MAX || !(header->is_big & __DSTR_FLAG_ALLOCATOR))) {
+		return NULL;
+	}
+	struct allocator *allocator;
+	const char *p = dstr - _dstr_header_size(_dstr_get_type(dstr)) - sizeof(allocator);
+	memcpy(&allocator, p, sizeof(allocator));
+	return allocator;
+}
+
+// size of everything in front of the characters (header and allocator)
+static size_t _dstr_allocation_header_size(const dstr_t dstr)
+{
+	size_t header_size = _dstr_header_size(_dstr_get_type(dstr));
+	if (unlikely(_dstr_get_allocator(dstr))) {
+		header_size += sizeof(struct allocator *);
+	}
+	return header_size;
+}
+
+// h points to the start of the allocation
+static dstr_t _dstr_init_header(uint8_t *h, enum _dstr_type type, size_t length, size_t capacity,
+				struct allocator *allocator)
+{
+	uint8_t flags = 0;
+	if (unlikely(allocator)) {
+		assert(type != __DSTR_SMALL);
+		memcpy(h, &allocator, sizeof(allocator));
+		h += sizeof(allocator);
+		flags = __DSTR_FLAG_ALLOCATOR;
+	}
+	switch (type) {
+	case __DSTR_SMALL: {
+		struct _dstr_small *header = (struct _dstr_small *)h;
+		header->length = length;
+		header->capacity = capacity;
+		return header->characters;
+	}
+	case __DSTR_MEDIUM: {
+		struct _dstr_medium *header = (struct _dstr_medium *)h;
+		header->length = length;
+		header->capacity = capacity;
+		header->is_big = flags;
+		header->_small_length = UINT8_MAX;
+		return header->characters;
+	}
+	case __DSTR_BIG: {
+		struct _dstr_big *header = (struct _dstr_big *)h;
+		header->length = length;
+		header->capacity = capacity;
+		header->is_big = flags | __DSTR_FLAG_BIG;
+		header->_small_length = UINT8_MAX;
+		return header->characters;
+	}
+	}
+	unreachable();
+	return NULL;
+}
+
+static void _dstr_free_allocation(dstr_t dstr)
+{
+	if (likely(dstr != _dstr_empty_dstr)) {
+		size_t header_size = _dstr_allocation_header_size(dstr);
+		allocator_free(_dstr_get_allocator(dstr), dstr - header_size, header_size + dstr_capacity(dstr) + 1);
+	}
+}
+
 void dstr_resize(dstr_t *dstrp, size_t new_capacity)
 {
-	if (unlikely(new_capacity == 0)) {
-		if (likely(*dstrp != _dstr_empty_dstr)) {
-			size_t header_size = _dstr_header_size(_dstr_get_type(*dstrp));
-			free((*dstrp) - header_size);
-			*dstrp = _dstr_empty_dstr;
-		}
+	struct allocator *allocator = _dstr_get_allocator(*dstrp);
+	// a string with an allocator keeps its (empty) allocation, so later allocations still use the allocator
+	if (unlikely(new_capacity == 0 && !allocator)) {
+		_dstr_free_allocation(*dstrp);
+		*dstrp = _dstr_empty_dstr;
 		return;
 	}
 
@@ -615,7 +978,7 @@ void dstr_resize(dstr_t *dstrp, size_t new_capacity)
 	}
 
 	enum _dstr_type new_type = __DSTR_SMALL;
-	if (unlikely(new_length >= UINT8_MAX || new_capacity > UINT8_MAX)) {
+	if (unlikely(new_length >= UINT8_MAX || new_capacity >= UINT8_MAX || allocator)) {
 		new_type = __DSTR_MEDIUM;
 		if (unlikely(new_length > UINT16_MAX || new_capacity > UINT16_MAX)) {
 			new_type = __DSTR_BIG;
@@ -623,26 +986,24 @@ void dstr_resize(dstr_t *dstrp, size_t new_capacity)
 	}
 
 	size_t new_header_size = _dstr_header_size(new_type);
+	if (unlikely(allocator)) {
+		new_header_size += sizeof(allocator);
+	}
 	size_t new_alloc_size = new_header_size + new_capacity + 1; // +1 for the null byte
 	uint8_t *h;
 	if (*dstrp == _dstr_empty_dstr) {
-		h = malloc(new_alloc_size);
-		if (unlikely(!h)) {
-			abort();
-		}
+		h = allocator_alloc(NULL, new_alloc_size);
 		h[new_header_size] = '\0';
 	} else {
-		size_t old_header_size = _dstr_header_size(_dstr_get_type(*dstrp));
+		size_t old_header_size = _dstr_allocation_header_size(*dstrp);
+		size_t old_alloc_size = old_header_size + dstr_capacity(*dstrp) + 1;
 		h = (uint8_t *)(*dstrp) - old_header_size;
 		if (unlikely(old_header_size > new_header_size)) {
 			uint8_t *src = h + old_header_size;
 			uint8_t *dst = h + new_header_size;
 			memmove(dst, src, new_length + 1); // +1 for the null byte
 		}
-		h = realloc(h, new_alloc_size);
-		if (unlikely(!h)) {
-			abort();
-		}
+		h = allocator_realloc(allocator, h, old_alloc_size, new_alloc_size);
 		if (unlikely(old_header_size < new_header_size)) {
 			uint8_t *src = h + old_header_size;
 			uint8_t *dst = h + new_header_size;
@@ -650,38 +1011,12 @@ void dstr_resize(dstr_t *dstrp, size_t new_capacity)
 		}
 	}
 
-	switch (new_type) {
-	case __DSTR_SMALL: {
-		struct _dstr_small *header = (struct _dstr_small *)h;
-		header->length = new_length;
-		header->capacity = new_capacity;
-		*dstrp = header->characters;
-		break;
-	}
-	case __DSTR_MEDIUM: {
-		struct _dstr_medium *header = (struct _dstr_medium *)h;
-		header->length = new_length;
-		header->capacity = new_capacity;
-		header->is_big = false;
-		header->_small_length = UINT8_MAX;
-		*dstrp = header->characters;
-		break;
-	}
-	case __DSTR_BIG: {
-		struct _dstr_big *header = (struct _dstr_big *)h;
-		header->length = new_length;
-		header->capacity = new_capacity;
-		header->is_big = true;
-		header->_small_length = UINT8_MAX;
-		*dstrp = header->characters;
-		break;
-	}
-	}
+	*dstrp = _dstr_init_header(h, new_type, new_length, new_capacity, allocator);
 }
 
 void dstr_free(dstr_t *dstrp)
 {
-	dstr_resize(dstrp, 0);
+	_dstr_free_allocation(*dstrp);
 	*dstrp = NULL;
 }
 
@@ -734,6 +1069,18 @@ dstr_t dstr_with_capacity(size_t capacity)
 	return dstr;
 }
 
+dstr_t dstr_with_allocator(struct allocator *allocator, size_t capacity)
+{
+	if (!allocator) {
+		return dstr_with_capacity(capacity);
+	}
+	enum _dstr_type type = capacity > UINT16_MAX ? __DSTR_BIG : __DSTR_MEDIUM;
+	size_t header_size = sizeof(allocator) + _dstr_header_size(type);
+	uint8_t *h = allocator_alloc(allocator, header_size + capacity + 1);
+	h[header_size] = '\0';
+	return _dstr_init_header(h, type, 0, capacity, allocator);
+}
+
 static _attr_always_inline char *_dstr_replace(dstr_t *dstrp, size_t pos, size_t len, size_t n)
 {
 	size_t length = dstr_length(*dstrp);
@@ -1069,12 +1416,29 @@ dstr_t dstr_from_fmtv(const char *fmt, va_list args)
 
 dstr_t dstr_copy(const dstr_t dstr)
 {
+	struct allocator *allocator = _dstr_get_allocator(dstr);
+	if (unlikely(allocator)) {
+		size_t length = dstr_length(dstr);
+		dstr_t copy = dstr_with_allocator(allocator, length);
+		_dstr_append_chars(&copy, dstr, length);
+		return copy;
+	}
 	return _dstr_from_chars(dstr, dstr_length(dstr));
 }
 
 char *dstr_to_cstr(dstr_t *dstrp)
 {
 	size_t length = dstr_length(*dstrp);
+	if (unlikely(_dstr_get_allocator(*dstrp))) {
+		// the result has to be released with free()
+		char *p = malloc(length + 1);
+		if (unlikely(!p)) {
+			abort();
+		}
+		memcpy(p, *dstrp, length + 1);
+		dstr_free(dstrp);
+		return p;
+	}
 	size_t header_size = _dstr_header_size(_dstr_get_type(*dstrp));
 	char *p = *dstrp - header_size;
 	*dstrp = NULL;
@@ -1374,6 +1738,11 @@ struct strview_list dstr_split_views(const dstr_t dstr, char c, size_t max)
 	return strview_split(dstr_view(dstr), c, max);
 }
 
+struct strview_list dstr_split_views_any(const dstr_t dstr, const char *delimiters, size_t max)
+{
+	return strview_split_any(dstr_view(dstr), delimiters, max);
+}
+
 struct strview_list dstr_rsplit_views(const dstr_t dstr, char c, size_t max)
 {
 	return strview_rsplit(dstr_view(dstr), c, max);
@@ -1396,5 +1765,5 @@ void *_dstr_debug_get_head_ptr(const dstr_t dstr)
 	if (dstr == _dstr_empty_dstr) {
 		return NULL;
 	}
-	return dstr - _dstr_header_size(_dstr_get_type(dstr));
+	return dstr - _dstr_allocation_header_size(dstr);
 }
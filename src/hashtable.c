@@ -178,22 +178,21 @@ static _hashtable_metadata_t *_hashtable_metadata(struct _hashtable *table, _has
 	return &table->metadata[index];
 }
 
-static void _hashtable_realloc_storage(struct _hashtable *table, const struct _hashtable_info *info)
+static void _hashtable_realloc_storage(struct _hashtable *table, _hashtable_uint_t old_capacity,
+				       const struct _hashtable_info *info)
 {
 	assert((table->capacity & (table->capacity - 1)) == 0);
 	_hashtable_uint_t size = info->entry_size + sizeof(_hashtable_metadata_t);
 	assert(((_hashtable_uint_t)-1) / size >= table->capacity);
+	size_t old_size = (size_t)size * old_capacity;
 	size *= table->capacity;
-	table->storage = realloc(table->storage, size);
-	if (unlikely(!table->storage && table->capacity != 0)) {
-		abort();
-	}
+	table->storage = allocator_realloc(table->allocator, table->storage, old_size, size);
 	table->metadata = (_hashtable_metadata_t *)(table->storage +
 						    _hashtable_metadata_offset(table->capacity, info));
 	table->max_entries = _hashtable_max_entries(table->capacity, info);
 }
 
-void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity,
+void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity, struct allocator *allocator,
 		     const struct _hashtable_info *info)
 {
 	if (capacity < 8) {
@@ -201,19 +200,21 @@ void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity,
 	}
 	capacity = _hashtable_round_capacity(capacity);
 	table->storage = NULL;
+	table->allocator = allocator;
 	table->capacity = capacity;
 	table->num_entries = 0;
 	table->num_tombstones = 0;
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, 0, info);
 	for (_hashtable_uint_t i = 0; i < capacity; i++) {
 		_hashtable_metadata_t *m = _hashtable_metadata(table, i, info);
 		m->hash = __HASHTABLE_EMPTY_HASH;
 	}
 }
 
-void _hashtable_destroy(struct _hashtable *table)
+void _hashtable_destroy(struct _hashtable *table, const struct _hashtable_info *info)
 {
-	free(table->storage);
+	size_t size = (size_t)table->capacity * (info->entry_size + sizeof(_hashtable_metadata_t));
+	allocator_free(table->allocator, table->storage, size);
 	memset(table, 0, sizeof(*table));
 }
 
@@ -416,7 +417,7 @@ static void _hashtable_shrink(struct _hashtable *table, _hashtable_uint_t new_ca
 	size_t new_metadata_offset = _hashtable_metadata_offset(table->capacity, info);
 	_hashtable_metadata_t *new_metadata = (_hashtable_metadata_t *)(table->storage + new_metadata_offset);
 	memmove(new_metadata, table->metadata, old_capacity * sizeof(table->metadata[0]));
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, old_capacity, info);
 }
 
 static void _hashtable_grow(struct _hashtable *table, _hashtable_uint_t new_capacity,
@@ -427,7 +428,7 @@ static void _hashtable_grow(struct _hashtable *table, _hashtable_uint_t new_capa
 	_hashtable_uint_t old_capacity = table->capacity;
 	table->capacity = new_capacity;
 	table->num_tombstones = 0;
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, old_capacity, info);
 	size_t old_metadata_offset = _hashtable_metadata_offset(old_capacity, info);
 	_hashtable_metadata_t *old_metadata = (_hashtable_metadata_t *)(table->storage + old_metadata_offset);
 
@@ -530,22 +531,21 @@ static _hashtable_metadata_t *_hashtable_metadata(struct _hashtable *table, _has
 	return &table->metadata[index];
 }
 
-static void _hashtable_realloc_storage(struct _hashtable *table, const struct _hashtable_info *info)
+static void _hashtable_realloc_storage(struct _hashtable *table, _hashtable_uint_t old_capacity,
+				       const struct _hashtable_info *info)
 {
 	assert((table->capacity & (table->capacity - 1)) == 0);
 	_hashtable_uint_t size = info->entry_size + sizeof(_hashtable_metadata_t);
 	assert(((_hashtable_uint_t)-1) / size >= table->capacity);
+	size_t old_size = (size_t)size * old_capacity;
 	size *= table->capacity;
-	table->storage = realloc(table->storage, size);
-	if (unlikely(!table->storage && table->capacity != 0)) {
-		abort();
-	}
+	table->storage = allocator_realloc(table->allocator, table->storage, old_size, size);
 	table->metadata = (_hashtable_metadata_t *)(table->storage +
 						    _hashtable_metadata_offset(table->capacity, info));
 	table->max_entries = _hashtable_max_entries(table->capacity, info);
 }
 
-void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity,
+void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity, struct allocator *allocator,
 		     const struct _hashtable_info *info)
 {
 	if (capacity < 8) {
@@ -553,9 +553,10 @@ void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity,
 	}
 	capacity = _hashtable_round_capacity(capacity);
 	table->storage = NULL;
+	table->allocator = allocator;
 	table->capacity = capacity;
 	table->num_entries = 0;
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, 0, info);
 	for (_hashtable_uint_t i = 0; i < capacity; i++) {
 		_hashtable_metadata_t *m = _hashtable_metadata(table, i, info);
 		m->hash = __HASHTABLE_EMPTY_HASH;
@@ -563,9 +564,10 @@ void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity,
 	}
 }
 
-void _hashtable_destroy(struct _hashtable *table)
+void _hashtable_destroy(struct _hashtable *table, const struct _hashtable_info *info)
 {
-	free(table->storage);
+	size_t size = (size_t)table->capacity * (info->entry_size + sizeof(_hashtable_metadata_t));
+	allocator_free(table->allocator, table->storage, size);
 	memset(table, 0, sizeof(*table));
 }
 
@@ -806,7 +808,7 @@ retry:
 	for (_hashtable_uint_t i = 0; i < old_capacity; i++) {
 		new_metadata[i] = table->metadata[i];
 	}
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, old_capacity, info);
 }
 
 static void _hashtable_grow(struct _hashtable *table, _hashtable_uint_t new_capacity,
@@ -816,7 +818,7 @@ static void _hashtable_grow(struct _hashtable *table, _hashtable_uint_t new_capa
 
 	_hashtable_uint_t old_capacity = table->capacity;
 	table->capacity = new_capacity;
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, old_capacity, info);
 	size_t old_metadata_offset = _hashtable_metadata_offset(old_capacity, info);
 	_hashtable_metadata_t *old_metadata = (_hashtable_metadata_t *)(table->storage + old_metadata_offset);
 
@@ -984,22 +986,21 @@ static _hashtable_uint_t _hashtable_get_distance(struct _hashtable *table, _hash
 	return (index - _hashtable_hash_to_index(table, hash)) & (table->capacity - 1);
 }
 
-static void _hashtable_realloc_storage(struct _hashtable *table, const struct _hashtable_info *info)
+static void _hashtable_realloc_storage(struct _hashtable *table, _hashtable_uint_t old_capacity,
+				       const struct _hashtable_info *info)
 {
 	assert((table->capacity & (table->capacity - 1)) == 0);
 	_hashtable_uint_t size = info->entry_size + sizeof(_hashtable_metadata_t);
 	assert(((_hashtable_uint_t)-1) / size >= table->capacity);
+	size_t old_size = (size_t)size * old_capacity;
 	size *= table->capacity;
-	table->storage = realloc(table->storage, size);
-	if (unlikely(!table->storage && table->capacity != 0)) {
-		abort();
-	}
+	table->storage = allocator_realloc(table->allocator, table->storage, old_size, size);
 	table->metadata = (_hashtable_metadata_t *)(table->storage +
 						    _hashtable_metadata_offset(table->capacity, info));
 	table->max_entries = _hashtable_max_entries(table->capacity, info);
 }
 
-void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity,
+void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity, struct allocator *allocator,
 		     const struct _hashtable_info *info)
 {
 	if (capacity < 8) {
@@ -1008,18 +1009,20 @@ void _hashtable_init(struct _hashtable *table, _hashtable_uint_t capacity,
 	capacity = _hashtable_round_capacity(capacity);
 	assert((capacity & (capacity - 1)) == 0);
 	table->storage = NULL;
+	table->allocator = allocator;
 	table->num_entries = 0;
 	table->capacity = capacity;
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, 0, info);
 	for (_hashtable_uint_t i = 0; i < capacity; i++) {
 		_hashtable_metadata_t *m = _hashtable_metadata(table, i, info);
 		m->hash = __HASHTABLE_EMPTY_HASH;
 	}
 }
 
-void _hashtable_destroy(struct _hashtable *table)
+void _hashtable_destroy(struct _hashtable *table, const struct _hashtable_info *info)
 {
-	free(table->storage);
+	size_t size = (size_t)table->capacity * (info->entry_size + sizeof(_hashtable_metadata_t));
+	allocator_free(table->allocator, table->storage, size);
 	memset(table, 0, sizeof(*table));
 }
 
@@ -1204,7 +1207,7 @@ static void _hashtable_shrink(struct _hashtable *table, _hashtable_uint_t new_ca
 	size_t new_metadata_offset = _hashtable_metadata_offset(table->capacity, info);
 	_hashtable_metadata_t *new_metadata = (_hashtable_metadata_t *)(table->storage + new_metadata_offset);
 	memmove(new_metadata, table->metadata, old_capacity * sizeof(table->metadata[0]));
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, old_capacity, info);
 }
 
 static void _hashtable_grow(struct _hashtable *table, _hashtable_uint_t new_capacity,
@@ -1214,7 +1217,7 @@ static void _hashtable_grow(struct _hashtable *table, _hashtable_uint_t new_capa
 
 	_hashtable_uint_t old_capacity = table->capacity;
 	table->capacity = new_capacity;
-	_hashtable_realloc_storage(table, info);
+	_hashtable_realloc_storage(table, old_capacity, info);
 	size_t old_metadata_offset = _hashtable_metadata_offset(old_capacity, info);
 	_hashtable_metadata_t *old_metadata = (_hashtable_metadata_t *)(table->storage + old_metadata_offset);
 
@@ -0,0 +1,154 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "interval_tree.h"
+#include "macros.h"
+#include "rb_tree.h"
+
+#define to_interval(ptr) container_of(ptr, struct interval_tree_node, rb_node)
+
+static uint64_t interval_tree_compute_subtree_last(const struct interval_tree_node *node)
+{
+	uint64_t max = node->last;
+	for (unsigned int i = 0; i < 2; i++) {
+		const struct rb_node *child = node->rb_node.children[i];
+		if (child && to_interval(child)->_subtree_last > max) {
+			max = to_interval(child)->_subtree_last;
+		}
+	}
+	return max;
+}
+
+DEFINE_RB_AUGMENT_CALLBACKS(interval_tree_augment, struct interval_tree_node, rb_node, uint64_t, _subtree_last,
+			    interval_tree_compute_subtree_last)
+
+void interval_tree_insert(struct interval_tree *tree, struct interval_tree_node *node)
+{
+	struct rb_node *parent = NULL;
+	struct rb_node *cur = tree->tree.root;
+	enum rb_direction dir = RB_LEFT;
+	while (cur) {
+		parent = cur;
+		dir = node->start < to_interval(cur)->start ? RB_LEFT : RB_RIGHT;
+		cur = cur->children[dir];
+	}
+	node->_subtree_last = node->last;
+	rb_insert_node_augmented(&tree->tree, &node->rb_node, parent, dir, &interval_tree_augment);
+}
+
+void interval_tree_remove(struct interval_tree *tree, struct interval_tree_node *node)
+{
+	rb_remove_node_augmented(&tree->tree, &node->rb_node, &interval_tree_augment);
+}
+
+void interval_tree_build_sorted(struct interval_tree *tree, struct interval_tree_node **nodes, size_t n)
+{
+	struct rb_node **rb_nodes = malloc(n * sizeof(rb_nodes[0]));
+	if (n != 0 && !rb_nodes) {
+		abort();
+	}
+	for (size_t i = 0; i < n; i++) {
+		nodes[i]->_subtree_last = nodes[i]->last;
+		rb_nodes[i] = &nodes[i]->rb_node;
+	}
+	rb_build_sorted_augmented(&tree->tree, rb_nodes, n, &interval_tree_augment);
+	free(rb_nodes);
+}
+
+static int interval_tree_compare(const struct rb_node *a, const struct rb_node *b)
+{
+	uint64_t start_a = to_interval(a)->start;
+	uint64_t start_b = to_interval(b)->start;
+	return (start_a > start_b) - (start_a < start_b);
+}
+
+void interval_tree_union(struct interval_tree *dest, struct interval_tree *src)
+{
+	rb_union_augmented(&dest->tree, &src->tree, interval_tree_compare, NULL, &interval_tree_augment);
+}
+
+// returns the leftmost node in the subtree of node that overlaps with [start, last]
+static struct interval_tree_node *interval_tree_subtree_search(struct interval_tree_node *node, uint64_t start,
+							       uint64_t last)
+{
+	for (;;) {
+		struct rb_node *left = node->rb_node.left;
+		if (left && start <= to_interval(left)->_subtree_last) {
+			// the leftmost overlapping interval has to be in the left subtree
+			node = to_interval(left);
+			continue;
+		}
+		if (node->start > last) {
+			// all intervals in the right subtree start after last as well
+			return NULL;
+		}
+		if (start <= node->last) {
+			return node;
+		}
+		struct rb_node *right = node->rb_node.right;
+		if (!right || start > to_interval(right)->_subtree_last) {
+			return NULL;
+		}
+		node = to_interval(right);
+	}
+}
+
+struct interval_tree_node *interval_tree_iter_first(const struct interval_tree *tree, uint64_t start,
+						    uint64_t last)
+{
+	struct rb_node *root = tree->tree.root;
+	if (!root || to_interval(root)->_subtree_last < start) {
+		return NULL;
+	}
+	return interval_tree_subtree_search(to_interval(root), start, last);
+}
+
+struct interval_tree_node *interval_tree_iter_next(const struct interval_tree_node *node, uint64_t start,
+						   uint64_t last)
+{
+	// node overlaps with [start, last], so node->start <= last
+	struct rb_node *cur = (struct rb_node *)&node->rb_node;
+	struct rb_node *right = cur->right;
+	for (;;) {
+		// search the right subtree first
+		if (right && start <= to_interval(right)->_subtree_last) {
+			return interval_tree_subtree_search(to_interval(right), start, last);
+		}
+		// go up until we come from a left child
+		struct rb_node *prev;
+		do {
+			prev = cur;
+			cur = rb_parent(cur);
+			if (!cur) {
+				return NULL;
+			}
+			right = cur->right;
+		} while (prev == right);
+		struct interval_tree_node *interval = to_interval(cur);
+		if (interval->start > last) {
+			return NULL;
+		}
+		if (start <= interval->last) {
+			return interval;
+		}
+	}
+}
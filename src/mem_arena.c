@@ -0,0 +1,292 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "config.h"
+#include "macros.h"
+#include "mem_arena.h"
+
+#ifdef HAVE_MADV_HUGEPAGE
+#include <sys/mman.h>
+#endif
+
+struct _mem_arena_chunk {
+	// older chunk (or the next chunk in the list of spare chunks)
+	_Alignas(max_align_t) struct _mem_arena_chunk *prev;
+	// newer chunk (large chunks only)
+	struct _mem_arena_chunk *next;
+	size_t size; // including this header
+	uint64_t seq; // large chunks only
+	bool mmapped;
+};
+
+#ifdef HAVE_MADV_HUGEPAGE
+// map size bytes (a multiple of MEM_ARENA_HUGE_PAGE_SIZE) aligned to MEM_ARENA_HUGE_PAGE_SIZE
+static void *mem_arena_map_huge(size_t size)
+{
+	char *p = mmap(NULL, size + MEM_ARENA_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+		       -1, 0);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+	size_t head = -(uintptr_t)p & (MEM_ARENA_HUGE_PAGE_SIZE - 1);
+	if (head != 0) {
+		munmap(p, head);
+	}
+	munmap(p + head + size, MEM_ARENA_HUGE_PAGE_SIZE - head);
+	p += head;
+	madvise(p, size, MADV_HUGEPAGE);
+	return p;
+}
+#endif
+
+static struct _mem_arena_chunk *mem_arena_chunk_new(struct mem_arena *arena, size_t size)
+{
+	struct _mem_arena_chunk *chunk = NULL;
+	bool mmapped = false;
+#ifdef HAVE_MADV_HUGEPAGE
+	if ((arena->_flags & MEM_ARENA_HUGE_PAGES) && size >= MEM_ARENA_HUGE_PAGE_SIZE) {
+		size = (size + MEM_ARENA_HUGE_PAGE_SIZE - 1) & ~(size_t)(MEM_ARENA_HUGE_PAGE_SIZE - 1);
+		chunk = mem_arena_map_huge(size);
+		mmapped = true;
+	} else
+#endif
+	{
+		chunk = malloc(size);
+	}
+	if (unlikely(!chunk)) {
+		abort();
+	}
+	chunk->size = size;
+	chunk->mmapped = mmapped;
+	return chunk;
+}
+
+static void mem_arena_chunk_free(struct _mem_arena_chunk *chunk)
+{
+#ifdef HAVE_MADV_HUGEPAGE
+	if (chunk->mmapped) {
+		munmap(chunk, chunk->size);
+		return;
+	}
+#endif
+	free(chunk);
+}
+
+static void *mem_arena_large_alloc(struct mem_arena *arena, size_t size, size_t alignment)
+{
+	size_t padding = alignment > _Alignof(max_align_t) ? alignment - _Alignof(max_align_t) : 0;
+	if (unlikely(size > SIZE_MAX - sizeof(struct _mem_arena_chunk) - padding)) {
+		abort();
+	}
+	struct _mem_arena_chunk *chunk = mem_arena_chunk_new(arena, sizeof(*chunk) + padding + size);
+	chunk->seq = ++arena->_large_seq;
+	chunk->prev = arena->_large;
+	chunk->next = NULL;
+	if (arena->_large) {
+		arena->_large->next = chunk;
+	}
+	arena->_large = chunk;
+	uintptr_t p = (uintptr_t)(chunk + 1);
+	return (void *)((p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+}
+
+// only for large allocations with the default alignment (which are the only ones the allocator interface makes)
+static struct _mem_arena_chunk *mem_arena_large_chunk(void *ptr)
+{
+	return (struct _mem_arena_chunk *)ptr - 1;
+}
+
+static void mem_arena_large_free(struct mem_arena *arena, struct _mem_arena_chunk *chunk)
+{
+	if (chunk->next) {
+		chunk->next->prev = chunk->prev;
+	} else {
+		arena->_large = chunk->prev;
+	}
+	if (chunk->prev) {
+		chunk->prev->next = chunk->next;
+	}
+	mem_arena_chunk_free(chunk);
+}
+
+void *_mem_arena_alloc_slow(struct mem_arena *arena, size_t size, size_t alignment)
+{
+	if (size > MEM_ARENA_LARGE_THRESHOLD) {
+		return mem_arena_large_alloc(arena, size, alignment);
+	}
+	size_t padding = alignment > _Alignof(max_align_t) ? alignment - _Alignof(max_align_t) : 0;
+	size_t needed = sizeof(struct _mem_arena_chunk) + padding + size;
+	struct _mem_arena_chunk *chunk;
+	struct _mem_arena_chunk **chunkp = &arena->_spare;
+	for (;;) {
+		chunk = *chunkp;
+		if (!chunk) {
+			size_t max_chunk_size = MEM_ARENA_MAX_CHUNK_SIZE;
+			if (arena->_flags & MEM_ARENA_HUGE_PAGES) {
+				max_chunk_size = MEM_ARENA_HUGE_PAGE_SIZE;
+			}
+			size_t chunk_size = arena->_next_chunk_size;
+			if (chunk_size < needed) {
+				chunk_size = needed;
+			}
+			chunk = mem_arena_chunk_new(arena, chunk_size);
+			if (arena->_next_chunk_size < max_chunk_size) {
+				arena->_next_chunk_size *= 2;
+			}
+			break;
+		}
+		if (chunk->size >= needed) {
+			*chunkp = chunk->prev;
+			break;
+		}
+		chunkp = &chunk->prev;
+	}
+	chunk->prev = arena->_current;
+	arena->_current = chunk;
+	arena->_ptr = (char *)(chunk + 1);
+	arena->_end = (char *)chunk + chunk->size;
+	return mem_arena_alloc_aligned(arena, size, alignment);
+}
+
+static void *mem_arena_allocate(struct allocator *allocator, size_t size)
+{
+	struct mem_arena *arena = container_of(allocator, struct mem_arena, allocator);
+	return mem_arena_alloc(arena, size);
+}
+
+static void mem_arena_deallocate(struct allocator *allocator, void *ptr, size_t size)
+{
+	struct mem_arena *arena = container_of(allocator, struct mem_arena, allocator);
+	if (size > MEM_ARENA_LARGE_THRESHOLD) {
+		mem_arena_large_free(arena, mem_arena_large_chunk(ptr));
+	} else if ((char *)ptr + size == arena->_ptr) {
+		// the most recent allocation
+		arena->_ptr = ptr;
+	}
+}
+
+static void *mem_arena_reallocate(struct allocator *allocator, void *ptr, size_t old_size, size_t new_size)
+{
+	struct mem_arena *arena = container_of(allocator, struct mem_arena, allocator);
+	if (old_size > MEM_ARENA_LARGE_THRESHOLD && new_size > MEM_ARENA_LARGE_THRESHOLD) {
+		struct _mem_arena_chunk *chunk = mem_arena_large_chunk(ptr);
+		if (!chunk->mmapped) {
+			chunk = realloc(chunk, sizeof(*chunk) + new_size);
+			if (unlikely(!chunk)) {
+				abort();
+			}
+			chunk->size = sizeof(*chunk) + new_size;
+			if (chunk->next) {
+				chunk->next->prev = chunk;
+			} else {
+				arena->_large = chunk;
+			}
+			if (chunk->prev) {
+				chunk->prev->next = chunk;
+			}
+			return chunk + 1;
+		}
+	} else if (old_size <= MEM_ARENA_LARGE_THRESHOLD && new_size <= MEM_ARENA_LARGE_THRESHOLD) {
+		if ((char *)ptr + old_size == arena->_ptr && new_size <= (size_t)(arena->_end - (char *)ptr)) {
+			// the most recent allocation can grow or shrink in place
+			arena->_ptr = (char *)ptr + new_size;
+			return ptr;
+		}
+		if (new_size <= old_size) {
+			return ptr;
+		}
+	}
+	void *p = mem_arena_alloc(arena, new_size);
+	memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+	mem_arena_deallocate(allocator, ptr, old_size);
+	return p;
+}
+
+void mem_arena_init(struct mem_arena *arena, unsigned int flags)
+{
+#ifndef HAVE_MADV_HUGEPAGE
+	flags &= ~(unsigned int)MEM_ARENA_HUGE_PAGES;
+#endif
+	arena->allocator.allocate = mem_arena_allocate;
+	arena->allocator.reallocate = mem_arena_reallocate;
+	arena->allocator.deallocate = mem_arena_deallocate;
+	arena->_ptr = NULL;
+	arena->_end = NULL;
+	arena->_current = NULL;
+	arena->_spare = NULL;
+	arena->_large = NULL;
+	arena->_large_seq = 0;
+	arena->_next_chunk_size = (flags & MEM_ARENA_HUGE_PAGES) ? MEM_ARENA_HUGE_PAGE_SIZE : MEM_ARENA_MIN_CHUNK_SIZE;
+	arena->_flags = flags;
+}
+
+void mem_arena_destroy(struct mem_arena *arena)
+{
+	mem_arena_reset(arena);
+	struct _mem_arena_chunk *chunk = arena->_spare;
+	while (chunk) {
+		struct _mem_arena_chunk *prev = chunk->prev;
+		mem_arena_chunk_free(chunk);
+		chunk = prev;
+	}
+	mem_arena_init(arena, arena->_flags);
+}
+
+void mem_arena_reset(struct mem_arena *arena)
+{
+	mem_arena_rewind(arena, (struct mem_arena_savepoint){0});
+}
+
+struct mem_arena_savepoint mem_arena_save(const struct mem_arena *arena)
+{
+	return (struct mem_arena_savepoint){
+		._chunk = arena->_current,
+		._ptr = arena->_ptr,
+		._large_seq = arena->_large_seq,
+	};
+}
+
+void mem_arena_rewind(struct mem_arena *arena, struct mem_arena_savepoint savepoint)
+{
+	while (arena->_current != savepoint._chunk) {
+		struct _mem_arena_chunk *chunk = arena->_current;
+		arena->_current = chunk->prev;
+		chunk->prev = arena->_spare;
+		arena->_spare = chunk;
+	}
+	arena->_ptr = savepoint._ptr;
+	arena->_end = savepoint._chunk ? (char *)savepoint._chunk + savepoint._chunk->size : NULL;
+	while (arena->_large && arena->_large->seq > savepoint._large_seq) {
+		struct _mem_arena_chunk *chunk = arena->_large;
+		arena->_large = chunk->prev;
+		if (arena->_large) {
+			arena->_large->next = NULL;
+		}
+		mem_arena_chunk_free(chunk);
+	}
+}
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "config.h"
+#include "macros.h"
+#include "page_allocator.h"
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static bool page_allocator_is_large(const struct page_allocator *pages, size_t size)
+{
+#ifdef HAVE_MMAP
+	return size > pages->_threshold;
+#else
+	(void)pages;
+	(void)size;
+	return false;
+#endif
+}
+
+#ifdef HAVE_MMAP
+static bool page_allocator_huge_pages(const struct page_allocator *pages)
+{
+#ifdef HAVE_MADV_HUGEPAGE
+	return pages->_flags & PAGE_ALLOCATOR_HUGE_PAGES;
+#else
+	(void)pages;
+	return false;
+#endif
+}
+
+// size of the mapping for an allocation of size bytes
+static size_t page_allocator_mapping_size(const struct page_allocator *pages, size_t size)
+{
+	size_t granularity = page_allocator_huge_pages(pages) ? PAGE_ALLOCATOR_HUGE_PAGE_SIZE :
+		(size_t)sysconf(_SC_PAGESIZE);
+	if (unlikely(size > SIZE_MAX - granularity)) {
+		return 0;
+	}
+	return (size + granularity - 1) & ~(granularity - 1);
+}
+
+static void *page_allocator_map(const struct page_allocator *pages, size_t size)
+{
+	if (unlikely(size == 0)) {
+		return NULL;
+	}
+#ifdef HAVE_MADV_HUGEPAGE
+	if (page_allocator_huge_pages(pages)) {
+		// map more than necessary to align the mapping to the huge page size
+		if (unlikely(size > SIZE_MAX - PAGE_ALLOCATOR_HUGE_PAGE_SIZE)) {
+			return NULL;
+		}
+		char *p = mmap(NULL, size + PAGE_ALLOCATOR_HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+			       MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			return NULL;
+		}
+		size_t head = -(uintptr_t)p & (PAGE_ALLOCATOR_HUGE_PAGE_SIZE - 1);
+		if (head != 0) {
+			munmap(p, head);
+		}
+		munmap(p + head + size, PAGE_ALLOCATOR_HUGE_PAGE_SIZE - head);
+		p += head;
+		madvise(p, size, MADV_HUGEPAGE);
+		return p;
+	}
+#endif
+	void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return p == MAP_FAILED ? NULL : p;
+}
+
+// resize a mapping (old_size and new_size are mapping sizes)
+static void *page_allocator_remap(const struct page_allocator *pages, void *ptr, size_t old_size, size_t new_size)
+{
+	if (new_size <= old_size) {
+		// unmapping the end returns the memory immediately
+		if (new_size < old_size) {
+			munmap((char *)ptr + new_size, old_size - new_size);
+		}
+		return ptr;
+	}
+#ifdef HAVE_MREMAP
+	if (page_allocator_huge_pages(pages)) {
+		// grow in place if possible, otherwise move the pages to a new aligned mapping
+		void *p = mremap(ptr, old_size, new_size, 0);
+		if (p != MAP_FAILED) {
+			return p;
+		}
+		void *target = page_allocator_map(pages, new_size);
+		if (!target) {
+			return NULL;
+		}
+		p = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+		if (p == MAP_FAILED) {
+			munmap(target, new_size);
+			return NULL;
+		}
+		return p;
+	}
+	void *p = mremap(ptr, old_size, new_size, MREMAP_MAYMOVE);
+	return p == MAP_FAILED ? NULL : p;
+#else
+	void *p = page_allocator_map(pages, new_size);
+	if (p) {
+		memcpy(p, ptr, old_size);
+		munmap(ptr, old_size);
+	}
+	return p;
+#endif
+}
+#endif
+
+static void *page_allocator_allocate(struct allocator *allocator, size_t size)
+{
+#ifdef HAVE_MMAP
+	struct page_allocator *pages = container_of(allocator, struct page_allocator, allocator);
+	if (page_allocator_is_large(pages, size)) {
+		return page_allocator_map(pages, page_allocator_mapping_size(pages, size));
+	}
+#else
+	(void)allocator;
+#endif
+	return malloc(size);
+}
+
+static void page_allocator_deallocate(struct allocator *allocator, void *ptr, size_t size)
+{
+#ifdef HAVE_MMAP
+	struct page_allocator *pages = container_of(allocator, struct page_allocator, allocator);
+	if (page_allocator_is_large(pages, size)) {
+		munmap(ptr, page_allocator_mapping_size(pages, size));
+		return;
+	}
+#else
+	(void)allocator;
+#endif
+	free(ptr);
+}
+
+static void *page_allocator_reallocate(struct allocator *allocator, void *ptr, size_t old_size, size_t new_size)
+{
+	struct page_allocator *pages = container_of(allocator, struct page_allocator, allocator);
+	bool old_large = page_allocator_is_large(pages, old_size);
+	bool new_large = page_allocator_is_large(pages, new_size);
+	if (!old_large && !new_large) {
+		return realloc(ptr, new_size);
+	}
+#ifdef HAVE_MMAP
+	if (old_large && new_large) {
+		size_t new_mapping_size = page_allocator_mapping_size(pages, new_size);
+		if (unlikely(new_mapping_size == 0)) {
+			return NULL;
+		}
+		return page_allocator_remap(pages, ptr, page_allocator_mapping_size(pages, old_size), new_mapping_size);
+	}
+#endif
+	// crossing the threshold
+	void *p = page_allocator_allocate(allocator, new_size);
+	if (p) {
+		memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+		page_allocator_deallocate(allocator, ptr, old_size);
+	}
+	return p;
+}
+
+void page_allocator_init(struct page_allocator *pages, size_t threshold, unsigned int flags)
+{
+	pages->allocator.allocate = page_allocator_allocate;
+	pages->allocator.reallocate = page_allocator_reallocate;
+	pages->allocator.deallocate = page_allocator_deallocate;
+	pages->_threshold = threshold == 0 ? PAGE_ALLOCATOR_DEFAULT_THRESHOLD : threshold;
+	pages->_flags = flags;
+}
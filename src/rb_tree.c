@@ -134,7 +134,29 @@ struct rb_node *rb_next(const struct rb_node *node)
 	return parent;
 }
 
-static void _rb_remove_repair(struct rb_tree *root, struct rb_node *parent)
+struct rb_node *rb_prev(const struct rb_node *node)
+{
+	if (node->children[RB_LEFT]) {
+		node = node->children[RB_LEFT];
+		while (node->children[RB_RIGHT]) {
+			node = node->children[RB_RIGHT];
+		}
+		return (struct rb_node *)node;
+	}
+
+	struct rb_node *parent = rb_parent(node);
+	while (parent && node == parent->children[RB_LEFT]) {
+		node = parent;
+		parent = rb_parent(node);
+	}
+
+	return parent;
+}
+
+// the augmented functions pass the callbacks, the normal ones pass NULL (and the calls get optimized out)
+
+static _attr_always_inline void _rb_remove_repair(struct rb_tree *root, struct rb_node *parent,
+						  const struct rb_augment_callbacks *augment)
 {
 	// we only use node at the start to figure out which child node is,
 	// since we are always the left child on the first iteration this is fine
@@ -161,6 +183,9 @@ static void _rb_remove_repair(struct rb_tree *root, struct rb_node *parent)
 			sibling->_parent_color = parent->_parent_color;
 			_rb_set_parent(parent, sibling);
 			_rb_set_color(parent, RB_RED);
+			if (augment) {
+				augment->rotate(parent, sibling);
+			}
 			sibling = tmp;
 			_rb_set_color(parent, RB_RED);
 		}
@@ -192,6 +217,9 @@ static void _rb_remove_repair(struct rb_tree *root, struct rb_node *parent)
 			tmp->children[right_dir] = sibling;
 			parent->children[right_dir] = tmp;
 			_rb_set_parent(sibling, tmp);
+			if (augment) {
+				augment->rotate(sibling, tmp);
+			}
 			sibling = tmp;
 		}
 		// rotate left at parent
@@ -206,16 +234,21 @@ static void _rb_remove_repair(struct rb_tree *root, struct rb_node *parent)
 		_rb_set_color(sibling->children[right_dir], RB_BLACK);
 		/* assert(rb_parent(sibling->children[right_dir]) == sibling); */
 		_rb_set_color(parent, RB_BLACK);
+		if (augment) {
+			augment->rotate(parent, sibling);
+		}
 
 		break;
 	}
 }
 
-void rb_remove_node(struct rb_tree *root, struct rb_node *node)
+static _attr_always_inline void _rb_remove_node(struct rb_tree *root, struct rb_node *node,
+						const struct rb_augment_callbacks *augment)
 {
 	struct rb_node *child = node->children[RB_RIGHT];
 	struct rb_node *tmp = node->children[RB_LEFT];
 	struct rb_node *rebalance;
+	struct rb_node *propagate_start;
 	uintptr_t pc;
 
 	// removal + trivial repairs
@@ -229,12 +262,14 @@ void rb_remove_node(struct rb_tree *root, struct rb_node *node)
 		} else {
 			rebalance = (_rb__color(pc) == RB_BLACK) ? parent : NULL;
 		}
+		propagate_start = parent;
 	} else if (!child) {
 		pc = node->_parent_color;
 		tmp->_parent_color = pc;
 		struct rb_node *parent = _rb__parent(pc);
 		_rb_change_child(node, tmp, parent, root);
 		rebalance = NULL;
+		propagate_start = parent;
 	} else {
 		struct rb_node *successor = child, *child2, *parent;
 
@@ -242,6 +277,9 @@ void rb_remove_node(struct rb_tree *root, struct rb_node *node)
 		if (!tmp) {
 			parent = successor;
 			child2 = successor->children[RB_RIGHT];
+			if (augment) {
+				augment->copy(node, successor);
+			}
 		} else {
 			do {
 				parent = successor;
@@ -252,6 +290,10 @@ void rb_remove_node(struct rb_tree *root, struct rb_node *node)
 			parent->children[RB_LEFT] = child2;
 			successor->children[RB_RIGHT] = child;
 			_rb_set_parent(child, successor);
+			if (augment) {
+				augment->copy(node, successor);
+				augment->propagate(parent, successor);
+			}
 		}
 
 		tmp = node->children[RB_LEFT];
@@ -270,14 +312,30 @@ void rb_remove_node(struct rb_tree *root, struct rb_node *node)
 			rebalance = _rb_is_black(successor) ? parent : NULL;
 		}
 		successor->_parent_color = pc;
+		propagate_start = successor;
+	}
+
+	if (augment && propagate_start) {
+		augment->propagate(propagate_start, NULL);
 	}
 
 	if (rebalance) {
-		_rb_remove_repair(root, rebalance);
+		_rb_remove_repair(root, rebalance, augment);
 	}
 }
 
-void rb_insert_node(struct rb_tree *root, struct rb_node *node, struct rb_node *parent, enum rb_direction dir)
+void rb_remove_node(struct rb_tree *root, struct rb_node *node)
+{
+	_rb_remove_node(root, node, NULL);
+}
+
+void rb_remove_node_augmented(struct rb_tree *root, struct rb_node *node, const struct rb_augment_callbacks *augment)
+{
+	_rb_remove_node(root, node, augment);
+}
+
+static _attr_always_inline void _rb_insert_node(struct rb_tree *root, struct rb_node *node, struct rb_node *parent,
+						enum rb_direction dir, const struct rb_augment_callbacks *augment)
 {
 	assert(((uintptr_t)node & 1) == 0);
 	node->children[RB_LEFT] = NULL;
@@ -291,6 +349,9 @@ void rb_insert_node(struct rb_tree *root, struct rb_node *node, struct rb_node *
 	}
 	_rb_set_color(node, RB_RED);
 	parent->children[dir] = node;
+	if (augment) {
+		augment->propagate(parent, NULL);
+	}
 
 	// repair (generic)
 	for (;;) {
@@ -319,6 +380,9 @@ void rb_insert_node(struct rb_tree *root, struct rb_node *node, struct rb_node *
 				grandparent->children[left_dir] = node;
 				// rb_set_parent(node, grandparent); we overwrite this later anyway
 				_rb_set_parent(parent, node);
+				if (augment) {
+					augment->rotate(parent, node);
+				}
 				parent = node;
 			}
 
@@ -337,6 +401,9 @@ void rb_insert_node(struct rb_tree *root, struct rb_node *node, struct rb_node *
 
 			_rb_set_parent(grandparent, parent);
 			_rb_set_color(grandparent, RB_RED);
+			if (augment) {
+				augment->rotate(grandparent, parent);
+			}
 
 			break;
 		}
@@ -353,3 +420,147 @@ void rb_insert_node(struct rb_tree *root, struct rb_node *node, struct rb_node *
 		}
 	}
 }
+
+void rb_insert_node(struct rb_tree *root, struct rb_node *node, struct rb_node *parent, enum rb_direction dir)
+{
+	_rb_insert_node(root, node, parent, dir, NULL);
+}
+
+void rb_insert_node_augmented(struct rb_tree *root, struct rb_node *node, struct rb_node *parent,
+			      enum rb_direction dir, const struct rb_augment_callbacks *augment)
+{
+	_rb_insert_node(root, node, parent, dir, augment);
+}
+
+void rb_insert_node_cached(struct rb_tree_cached *root, struct rb_node *node, struct rb_node *parent,
+			  enum rb_direction dir)
+{
+	if (!parent || (parent == root->leftmost && dir == RB_LEFT)) {
+		root->leftmost = node;
+	}
+	rb_insert_node(&root->tree, node, parent, dir);
+}
+
+void rb_remove_node_cached(struct rb_tree_cached *root, struct rb_node *node)
+{
+	if (node == root->leftmost) {
+		// the leftmost node has no left child, so this is just one step in most cases
+		root->leftmost = rb_next(node);
+	}
+	rb_remove_node(&root->tree, node);
+}
+
+static struct rb_node *_rb_build_sorted(struct rb_node **nodes, size_t n, struct rb_node *parent,
+					unsigned int depth, unsigned int red_depth,
+					const struct rb_augment_callbacks *augment)
+{
+	if (n == 0) {
+		return NULL;
+	}
+	// the left subtree gets the extra node if there is one
+	size_t mid = n / 2;
+	struct rb_node *node = nodes[mid];
+	node->_parent_color = (uintptr_t)parent | (depth == red_depth ? RB_RED : RB_BLACK);
+	node->children[RB_LEFT] = _rb_build_sorted(nodes, mid, node, depth + 1, red_depth, augment);
+	node->children[RB_RIGHT] = _rb_build_sorted(nodes + mid + 1, n - mid - 1, node, depth + 1, red_depth,
+						    augment);
+	if (augment) {
+		// both subtrees are complete, so this only recomputes the value of node (bottom-up)
+		augment->propagate(node, parent);
+	}
+	return node;
+}
+
+static void _rb_build_sorted_root(struct rb_tree *root, struct rb_node **nodes, size_t n,
+				  const struct rb_augment_callbacks *augment)
+{
+	// all levels except for the last one are full, only the nodes in the last (incomplete) level are red
+	unsigned int red_depth = 0;
+	while ((n + 1) >> (red_depth + 1)) {
+		red_depth++;
+	}
+	root->root = _rb_build_sorted(nodes, n, NULL, 0, red_depth, augment);
+}
+
+void rb_build_sorted(struct rb_tree *root, struct rb_node **nodes, size_t n)
+{
+	_rb_build_sorted_root(root, nodes, n, NULL);
+}
+
+void rb_build_sorted_augmented(struct rb_tree *root, struct rb_node **nodes, size_t n,
+			       const struct rb_augment_callbacks *augment)
+{
+	_rb_build_sorted_root(root, nodes, n, augment);
+}
+
+static struct rb_node **_rb_flatten(const struct rb_tree *root, struct rb_node **nodes)
+{
+	for (struct rb_node *node = rb_first(root); node; node = rb_next(node)) {
+		*nodes++ = node;
+	}
+	return nodes;
+}
+
+static size_t _rb_count(const struct rb_tree *root)
+{
+	size_t n = 0;
+	for (struct rb_node *node = rb_first(root); node; node = rb_next(node)) {
+		n++;
+	}
+	return n;
+}
+
+static void _rb_union(struct rb_tree *dest, struct rb_tree *src,
+		      int (*cmp)(const struct rb_node *a, const struct rb_node *b),
+		      void (*duplicate)(struct rb_node *node), const struct rb_augment_callbacks *augment)
+{
+	size_t n1 = _rb_count(dest);
+	size_t n2 = _rb_count(src);
+	if (n2 == 0) {
+		return;
+	}
+	struct rb_node **nodes = malloc((2 * n1 + n2) * sizeof(nodes[0]));
+	if (!nodes) {
+		abort();
+	}
+	// flatten both trees into the back of the array and merge them into the front
+	struct rb_node **a = nodes + n1 + n2;
+	struct rb_node **b = nodes + n1;
+	struct rb_node **a_end = _rb_flatten(dest, a);
+	struct rb_node **b_end = _rb_flatten(src, b);
+	struct rb_node **out = nodes;
+	while (a != a_end && b != b_end) {
+		int c = cmp(*a, *b);
+		if (c < 0 || (c == 0 && !duplicate)) {
+			*out++ = *a++;
+		} else if (c > 0) {
+			*out++ = *b++;
+		} else {
+			duplicate(*b++);
+		}
+	}
+	// out never overtakes b
+	while (b != b_end) {
+		*out++ = *b++;
+	}
+	while (a != a_end) {
+		*out++ = *a++;
+	}
+	_rb_build_sorted_root(dest, nodes, out - nodes, augment);
+	src->root = NULL;
+	free(nodes);
+}
+
+void rb_union(struct rb_tree *dest, struct rb_tree *src,
+	      int (*cmp)(const struct rb_node *a, const struct rb_node *b),
+	      void (*duplicate)(struct rb_node *node))
+{
+	_rb_union(dest, src, cmp, duplicate, NULL);
+}
+
+void rb_union_augmented(struct rb_tree *dest, struct rb_tree *src,
+			int (*cmp)(const struct rb_node *a, const struct rb_node *b),
+			void (*duplicate)(struct rb_node *node), const struct rb_augment_callbacks *augment)
+{
+	_rb_union(dest, src, cmp, duplicate, augment);
+}
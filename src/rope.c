@@ -0,0 +1,405 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "allocator.h"
+#include "dstring.h"
+#include "macros.h"
+#include "rb_tree.h"
+#include "rope.h"
+
+struct rope_chunk {
+	struct rb_node rb_node;
+	size_t subtree_length;
+	size_t length;
+	char data[];
+};
+
+#define CHUNK_CAPACITY (ROPE_CHUNK_SIZE - offsetof(struct rope_chunk, data))
+
+#define to_chunk(ptr) container_of(ptr, struct rope_chunk, rb_node)
+
+static inline size_t min_size(size_t a, size_t b)
+{
+	return a < b ? a : b;
+}
+
+static size_t rope_compute_subtree_length(const struct rope_chunk *chunk)
+{
+	size_t length = chunk->length;
+	for (unsigned int i = 0; i < 2; i++) {
+		const struct rb_node *child = chunk->rb_node.children[i];
+		if (child) {
+			length += to_chunk(child)->subtree_length;
+		}
+	}
+	return length;
+}
+
+DEFINE_RB_AUGMENT_CALLBACKS(rope_augment, struct rope_chunk, rb_node, size_t, subtree_length,
+			    rope_compute_subtree_length)
+
+static struct rope_chunk *rope_new_chunk(struct rope *rope)
+{
+	struct rope_chunk *chunk = allocator_alloc(rope->_allocator, ROPE_CHUNK_SIZE);
+	chunk->length = 0;
+	chunk->subtree_length = 0;
+	return chunk;
+}
+
+// has to be called after the length of the chunk changed
+static void rope_update_chunk(struct rope_chunk *chunk)
+{
+	rope_augment.propagate(&chunk->rb_node, NULL);
+}
+
+// inserts chunk (with its final length) after prev or at the beginning if prev is NULL
+static void rope_insert_chunk_after(struct rope *rope, struct rope_chunk *prev, struct rope_chunk *chunk)
+{
+	struct rb_node *parent;
+	enum rb_direction dir = RB_LEFT;
+	if (!prev) {
+		parent = rope->_tree.root;
+	} else if (!prev->rb_node.right) {
+		parent = &prev->rb_node;
+		dir = RB_RIGHT;
+	} else {
+		parent = prev->rb_node.right;
+	}
+	// the leftmost node of the subtree
+	while (dir == RB_LEFT && parent && parent->left) {
+		parent = parent->left;
+	}
+	chunk->subtree_length = chunk->length;
+	rb_insert_node_augmented(&rope->_tree, &chunk->rb_node, parent, dir, &rope_augment);
+}
+
+static void rope_remove_chunk(struct rope *rope, struct rope_chunk *chunk)
+{
+	rb_remove_node_augmented(&rope->_tree, &chunk->rb_node, &rope_augment);
+	allocator_free(rope->_allocator, chunk, ROPE_CHUNK_SIZE);
+}
+
+// moves the next chunk into chunk if it fits
+static bool rope_merge_with_next(struct rope *rope, struct rope_chunk *chunk)
+{
+	struct rb_node *next_node = rb_next(&chunk->rb_node);
+	if (!next_node) {
+		return false;
+	}
+	struct rope_chunk *next = to_chunk(next_node);
+	if (chunk->length + next->length > CHUNK_CAPACITY) {
+		return false;
+	}
+	memcpy(chunk->data + chunk->length, next->data, next->length);
+	chunk->length += next->length;
+	next->length = 0;
+	rope_update_chunk(next);
+	rope_update_chunk(chunk);
+	rope_remove_chunk(rope, next);
+	return true;
+}
+
+// returns the chunk which contains the character at pos and the offset of pos in the chunk
+// (pos == rope_length() returns the last chunk and its length, an empty rope has no chunks and returns NULL)
+static struct rope_chunk *rope_seek(const struct rope *rope, size_t pos, size_t *offset)
+{
+	struct rb_node *cur = rope->_tree.root;
+	struct rope_chunk *last = NULL;
+	while (cur) {
+		struct rb_node *left = cur->left;
+		size_t left_length = left ? to_chunk(left)->subtree_length : 0;
+		if (pos < left_length) {
+			cur = left;
+			continue;
+		}
+		pos -= left_length;
+		struct rope_chunk *chunk = to_chunk(cur);
+		if (pos < chunk->length) {
+			*offset = pos;
+			return chunk;
+		}
+		pos -= chunk->length;
+		last = chunk;
+		cur = cur->right;
+	}
+	// only reached for pos == rope_length()
+	*offset = last ? last->length : 0;
+	return last;
+}
+
+static void rope_free_subtree(struct rope *rope, struct rb_node *node)
+{
+	// the height of the tree is logarithmic
+	while (node) {
+		rope_free_subtree(rope, node->left);
+		struct rb_node *right = node->right;
+		allocator_free(rope->_allocator, to_chunk(node), ROPE_CHUNK_SIZE);
+		node = right;
+	}
+}
+
+void rope_init(struct rope *rope)
+{
+	rope_init_with_allocator(rope, NULL);
+}
+
+void rope_init_with_allocator(struct rope *rope, struct allocator *allocator)
+{
+	rope->_tree = RB_EMPTY_TREE;
+	rope->_allocator = allocator;
+}
+
+void rope_destroy(struct rope *rope)
+{
+	rope_free_subtree(rope, rope->_tree.root);
+	rope->_tree = RB_EMPTY_TREE;
+}
+
+void rope_clear(struct rope *rope)
+{
+	rope_destroy(rope);
+}
+
+size_t rope_length(const struct rope *rope)
+{
+	struct rb_node *root = rope->_tree.root;
+	return root ? to_chunk(root)->subtree_length : 0;
+}
+
+char rope_char_at(const struct rope *rope, size_t pos)
+{
+	assert(pos < rope_length(rope));
+	size_t offset;
+	struct rope_chunk *chunk = rope_seek(rope, pos, &offset);
+	return chunk->data[offset];
+}
+
+void (rope_append_chars)(struct rope *rope, const char *chars, size_t n)
+{
+	rope_insert_chars(rope, rope_length(rope), chars, n);
+}
+
+void rope_append_view(struct rope *rope, struct strview view)
+{
+	rope_insert_chars(rope, rope_length(rope), view.characters, view.length);
+}
+
+void rope_append_cstr(struct rope *rope, const char *cstr)
+{
+	rope_insert_chars(rope, rope_length(rope), cstr, strlen(cstr));
+}
+
+void (rope_insert_chars)(struct rope *rope, size_t pos, const char *chars, size_t n)
+{
+	assert(pos <= rope_length(rope));
+	if (n == 0) {
+		return;
+	}
+	size_t offset;
+	struct rope_chunk *chunk = rope_seek(rope, pos, &offset);
+	if (chunk && chunk->length + n <= CHUNK_CAPACITY) {
+		memmove(chunk->data + offset + n, chunk->data + offset, chunk->length - offset);
+		memcpy(chunk->data + offset, chars, n);
+		chunk->length += n;
+		rope_update_chunk(chunk);
+		return;
+	}
+
+	// the rest of the chunk goes after the new characters, fill the chunk and then as many new chunks as needed
+	char tail[CHUNK_CAPACITY];
+	size_t tail_length = 0;
+	if (chunk) {
+		tail_length = chunk->length - offset;
+		memcpy(tail, chunk->data + offset, tail_length);
+		chunk->length = offset;
+	}
+	const char *sources[2] = {chars, tail};
+	size_t source_lengths[2] = {n, tail_length};
+	unsigned int source = 0;
+	struct rope_chunk *prev = NULL;
+	bool is_new = !chunk;
+	for (;;) {
+		if (is_new) {
+			chunk = rope_new_chunk(rope);
+		}
+		while (source < 2 && chunk->length < CHUNK_CAPACITY) {
+			size_t k = min_size(source_lengths[source], CHUNK_CAPACITY - chunk->length);
+			memcpy(chunk->data + chunk->length, sources[source], k);
+			chunk->length += k;
+			sources[source] += k;
+			source_lengths[source] -= k;
+			if (source_lengths[source] == 0) {
+				source++;
+			}
+		}
+		if (is_new) {
+			rope_insert_chunk_after(rope, prev, chunk);
+		} else {
+			rope_update_chunk(chunk);
+		}
+		if (source == 2) {
+			break;
+		}
+		prev = chunk;
+		is_new = true;
+	}
+	rope_merge_with_next(rope, chunk);
+}
+
+void rope_insert_view(struct rope *rope, size_t pos, struct strview view)
+{
+	rope_insert_chars(rope, pos, view.characters, view.length);
+}
+
+void rope_insert_cstr(struct rope *rope, size_t pos, const char *cstr)
+{
+	rope_insert_chars(rope, pos, cstr, strlen(cstr));
+}
+
+void rope_erase(struct rope *rope, size_t pos, size_t len)
+{
+	size_t length = rope_length(rope);
+	assert(pos <= length);
+	if (len > length - pos) {
+		len = length - pos;
+	}
+	if (len == 0) {
+		return;
+	}
+	size_t offset;
+	struct rope_chunk *chunk = rope_seek(rope, pos, &offset);
+	while (len > 0) {
+		size_t n = min_size(len, chunk->length - offset);
+		struct rb_node *next = rb_next(&chunk->rb_node);
+		if (n == chunk->length) {
+			rope_remove_chunk(rope, chunk);
+		} else {
+			memmove(chunk->data + offset, chunk->data + offset + n, chunk->length - offset - n);
+			chunk->length -= n;
+			rope_update_chunk(chunk);
+		}
+		len -= n;
+		chunk = next ? to_chunk(next) : NULL;
+		offset = 0;
+	}
+	// the chunks on both sides of the erased characters might fit into their neighbors now
+	chunk = rope_seek(rope, pos == 0 ? 0 : pos - 1, &offset);
+	if (!chunk) {
+		return;
+	}
+	struct rb_node *prev = rb_prev(&chunk->rb_node);
+	if (prev && rope_merge_with_next(rope, to_chunk(prev))) {
+		chunk = to_chunk(prev);
+	}
+	if (!rope_merge_with_next(rope, chunk)) {
+		struct rb_node *next = rb_next(&chunk->rb_node);
+		if (!next) {
+			return;
+		}
+		chunk = to_chunk(next);
+	}
+	rope_merge_with_next(rope, chunk);
+}
+
+void (rope_replace_chars)(struct rope *rope, size_t pos, size_t len, const char *chars, size_t n)
+{
+	size_t length = rope_length(rope);
+	assert(pos <= length);
+	if (len > length - pos) {
+		len = length - pos;
+	}
+	// overwrite the common part in place, then insert or erase the difference
+	size_t common = min_size(len, n);
+	size_t offset;
+	struct rope_chunk *chunk = rope_seek(rope, pos, &offset);
+	for (size_t i = 0; i < common;) {
+		size_t k = min_size(common - i, chunk->length - offset);
+		memcpy(chunk->data + offset, chars + i, k);
+		i += k;
+		struct rb_node *next = rb_next(&chunk->rb_node);
+		chunk = next ? to_chunk(next) : NULL;
+		offset = 0;
+	}
+	if (len > n) {
+		rope_erase(rope, pos + n, len - n);
+	} else if (n > len) {
+		rope_insert_chars(rope, pos + len, chars + len, n - len);
+	}
+}
+
+void rope_replace_view(struct rope *rope, size_t pos, size_t len, struct strview view)
+{
+	rope_replace_chars(rope, pos, len, view.characters, view.length);
+}
+
+void rope_replace_cstr(struct rope *rope, size_t pos, size_t len, const char *cstr)
+{
+	rope_replace_chars(rope, pos, len, cstr, strlen(cstr));
+}
+
+dstr_t rope_substring(const struct rope *rope, size_t start, size_t length)
+{
+	struct rope_iter iter;
+	rope_iter_start(&iter, rope, start, length);
+	dstr_t result = dstr_with_capacity(iter._remaining);
+	struct strview piece;
+	while (rope_iter_next(&iter, &piece)) {
+		dstr_append_view(&result, piece);
+	}
+	return result;
+}
+
+dstr_t rope_to_dstr(const struct rope *rope)
+{
+	return rope_substring(rope, 0, ROPE_NPOS);
+}
+
+void rope_iter_start(struct rope_iter *iter, const struct rope *rope, size_t start, size_t length)
+{
+	size_t total = rope_length(rope);
+	assert(start <= total);
+	if (length > total - start) {
+		length = total - start;
+	}
+	size_t offset = 0;
+	const struct rope_chunk *chunk = length ? rope_seek(rope, start, &offset) : NULL;
+	iter->_node = chunk ? &chunk->rb_node : NULL;
+	iter->_offset = offset;
+	iter->_remaining = length;
+}
+
+bool rope_iter_next(struct rope_iter *iter, struct strview *piece)
+{
+	if (iter->_remaining == 0) {
+		return false;
+	}
+	const struct rope_chunk *chunk = to_chunk(iter->_node);
+	size_t n = min_size(chunk->length - iter->_offset, iter->_remaining);
+	piece->characters = chunk->data + iter->_offset;
+	piece->length = n;
+	iter->_remaining -= n;
+	iter->_offset = 0;
+	iter->_node = iter->_remaining ? rb_next(iter->_node) : NULL;
+	return true;
+}
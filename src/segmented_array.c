@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "segmented_array.h"
+
+static size_t segment_size(const struct _segmented_array *arr, size_t k, size_t elem_size)
+{
+	return ((size_t)1 << (k + arr->shift)) * elem_size;
+}
+
+static void free_segment(struct _segmented_array *arr, void **segments, size_t k, size_t elem_size)
+{
+	allocator_free(arr->allocator, segments[k], segment_size(arr, k, elem_size));
+	segments[k] = NULL;
+}
+
+void _segmented_array_init(struct _segmented_array *arr, size_t elem_size, struct allocator *allocator)
+{
+	memset(arr, 0, sizeof(*arr));
+	size_t n = SEGMENTED_ARRAY_FIRST_SEGMENT_SIZE / elem_size;
+	arr->shift = n == 0 ? 0 : ilog2(n);
+	arr->allocator = allocator;
+}
+
+void _segmented_array_destroy(struct _segmented_array *arr, size_t elem_size)
+{
+	for (size_t k = 0; k < SEGMENTED_ARRAY_MAX_SEGMENTS; k++) {
+		if (arr->back[k]) {
+			free_segment(arr, arr->back, k, elem_size);
+		}
+		if (arr->front[k]) {
+			free_segment(arr, arr->front, k, elem_size);
+		}
+	}
+	arr->back_begin = arr->back_end = arr->front_begin = arr->front_end = 0;
+}
+
+static void shrink_side(struct _segmented_array *arr, void **segments, size_t begin, size_t end, size_t elem_size)
+{
+	size_t first = _segmented_array_segment(arr, begin);
+	size_t last = end == begin ? first : _segmented_array_segment(arr, end - 1);
+	for (size_t k = 0; k < SEGMENTED_ARRAY_MAX_SEGMENTS; k++) {
+		if (segments[k] && (begin == end || k < first || k > last)) {
+			free_segment(arr, segments, k, elem_size);
+		}
+	}
+}
+
+void _segmented_array_shrink_to_fit(struct _segmented_array *arr, size_t elem_size)
+{
+	shrink_side(arr, arr->back, arr->back_begin, arr->back_end, elem_size);
+	shrink_side(arr, arr->front, arr->front_begin, arr->front_end, elem_size);
+}
+
+void _segmented_array_alloc_segment(struct _segmented_array *arr, void **segments, size_t k, size_t elem_size)
+{
+	if (unlikely(k >= SEGMENTED_ARRAY_MAX_SEGMENTS)) {
+		abort();
+	}
+	segments[k] = allocator_alloc(arr->allocator, segment_size(arr, k, elem_size));
+}
+
+// the end (back == true) or beginning of the array is the oldest element of the other side
+void *_segmented_array_pop_other_side(struct _segmented_array *arr, bool back, size_t elem_size)
+{
+	void **segments = back ? arr->front : arr->back;
+	size_t pos = back ? arr->front_begin++ : arr->back_begin++;
+	size_t k = _segmented_array_segment(arr, pos);
+	// the previous segment of the other side does not contain any elements anymore
+	if (k > 0 && pos == _segmented_array_segment_start(arr, k) && segments[k - 1]) {
+		free_segment(arr, segments, k - 1, elem_size);
+	}
+	return _segmented_array_pos(arr, !back, pos, elem_size);
+}
+
+void *_segmented_array_contiguous(const struct _segmented_array *arr, size_t i, size_t elem_size, size_t *n)
+{
+	_fortify_check(i < _segmented_array_length(arr));
+	size_t front_length = arr->front_end - arr->front_begin;
+	if (i < front_length) {
+		// the following elements are at the preceding positions
+		size_t pos = arr->front_end - 1 - i;
+		size_t segment_start = _segmented_array_segment_start(arr, _segmented_array_segment(arr, pos));
+		*n = pos - (segment_start > arr->front_begin ? segment_start : arr->front_begin) + 1;
+		return _segmented_array_pos(arr, false, pos, elem_size);
+	}
+	size_t pos = arr->back_begin + (i - front_length);
+	size_t segment_end = _segmented_array_segment_start(arr, _segmented_array_segment(arr, pos) + 1);
+	*n = (segment_end < arr->back_end ? segment_end : arr->back_end) - pos;
+	return _segmented_array_pos(arr, true, pos, elem_size);
+}
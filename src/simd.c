@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdatomic.h>
+#include <threads.h>
+#include "simd.h"
+
+#ifdef SIMD_X86
+
+static atomic_int simd_limit = _SIMD_AVX2;
+static enum _simd_level cpu_level;
+
+static void init_simd(void)
+{
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+		cpu_level = _SIMD_AVX2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		cpu_level = _SIMD_SSE2;
+	} else {
+		cpu_level = _SIMD_NONE;
+	}
+}
+
+enum _simd_level _simd_level(void)
+{
+	static once_flag once = ONCE_FLAG_INIT;
+	call_once(&once, init_simd);
+	enum _simd_level limit = atomic_load_explicit(&simd_limit, memory_order_relaxed);
+	return cpu_level < limit ? cpu_level : limit;
+}
+
+#else
+
+static atomic_int simd_limit = _SIMD_NONE;
+
+enum _simd_level _simd_level(void)
+{
+	return _SIMD_NONE;
+}
+
+#endif
+
+enum _simd_level _simd_limit(enum _simd_level limit)
+{
+	return atomic_exchange_explicit(&simd_limit, limit, memory_order_relaxed);
+}
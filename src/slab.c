@@ -0,0 +1,483 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#define _GNU_SOURCE
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include "compiler.h"
+#include "config.h"
+#include "slab.h"
+
+#ifdef HAVE_MMAP
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#define SLAB_MIN_SLOT_SIZE 16
+#define SLAB_SPANS_PER_SUPERPAGE (SLAB_SUPERPAGE_SIZE / SLAB_SPAN_SIZE)
+#define SLAB_MAX_SLOTS_PER_SPAN (SLAB_SPAN_SIZE / SLAB_MIN_SLOT_SIZE)
+// number of cached bytes per size class and thread (but at least SLAB_MIN_CACHED_SLOTS slots)
+#define SLAB_CACHED_BYTES (16 * 1024)
+#define SLAB_MIN_CACHED_SLOTS 8
+#define SLAB_MAX_CACHED_SLOTS 128
+#define SLAB_NO_SIZE_CLASS UINT16_MAX
+
+struct slab_span {
+	// spans of the same size class with free slots (or the next span in the list of free spans)
+	struct slab_span *prev;
+	struct slab_span *next;
+	void *free_list; // freed slots, linked through their first word
+	char *start;
+	uint32_t slot_size;
+	uint32_t num_slots;
+	uint32_t num_allocated; // including the slots in the thread caches
+	uint32_t num_untouched; // slots at the end which were never allocated (not in the free list)
+	uint16_t size_class;
+	bool partial; // in the list of spans with free slots
+	uint64_t bitmap[SLAB_MAX_SLOTS_PER_SPAN / 64];
+};
+
+// the first span of each superpage (the rest of it are guard pages)
+struct slab_superpage_metadata {
+	struct slab_span spans[SLAB_SPANS_PER_SUPERPAGE - 1];
+};
+
+_Static_assert(sizeof(struct slab_superpage_metadata) <= SLAB_SPAN_SIZE, "");
+_Static_assert(SLAB_SUPERPAGE_SIZE % SLAB_SPAN_SIZE == 0, "");
+
+struct slab_spinlock {
+	atomic_bool locked;
+};
+
+struct slab_size_class {
+	_Alignas(64) struct slab_spinlock lock;
+	struct slab_span *partial;
+};
+
+struct slab_cache_bin {
+	void *head; // linked through the first word of the slots
+	uint32_t count;
+	uint32_t limit; // zero until the bin is used for the first time
+};
+
+struct slab_thread_cache {
+	struct slab_cache_bin bins[SLAB_NUM_SIZE_CLASSES];
+	bool registered;
+};
+
+static struct slab_size_class size_classes[SLAB_NUM_SIZE_CLASSES];
+static struct slab_spinlock span_lock;
+static struct slab_span *free_spans;
+
+static thread_local struct slab_thread_cache thread_cache;
+static once_flag init_once = ONCE_FLAG_INIT;
+static tss_t thread_cache_key;
+
+static void slab_lock(struct slab_spinlock *lock)
+{
+	while (atomic_exchange_explicit(&lock->locked, true, memory_order_acquire)) {
+		while (atomic_load_explicit(&lock->locked, memory_order_relaxed)) {
+			thrd_yield();
+		}
+	}
+}
+
+static void slab_unlock(struct slab_spinlock *lock)
+{
+	atomic_store_explicit(&lock->locked, false, memory_order_release);
+}
+
+static inline unsigned int slab_size_class(size_t size)
+{
+	if (size <= 128) {
+		return size <= SLAB_MIN_SLOT_SIZE ? 0 : (size - 1) / 16;
+	} else if (size <= 512) {
+		return 8 + (size - 129) / 32;
+	}
+	return 20 + (size - 513) / 64;
+}
+
+static uint32_t slab_slot_size(unsigned int size_class)
+{
+	if (size_class < 8) {
+		return (size_class + 1) * 16;
+	} else if (size_class < 20) {
+		return 128 + (size_class - 7) * 32;
+	}
+	return 512 + (size_class - 19) * 64;
+}
+
+_Static_assert(20 + (SLAB_MAX_SIZE - 513) / 64 == SLAB_NUM_SIZE_CLASSES - 1, "");
+
+static uint32_t slab_cache_limit(unsigned int size_class)
+{
+	uint32_t limit = SLAB_CACHED_BYTES / slab_slot_size(size_class);
+	if (limit < SLAB_MIN_CACHED_SLOTS) {
+		return SLAB_MIN_CACHED_SLOTS;
+	}
+	return limit > SLAB_MAX_CACHED_SLOTS ? SLAB_MAX_CACHED_SLOTS : limit;
+}
+
+static void slab_thread_exit(void *arg)
+{
+	(void)arg;
+	slab_thread_flush();
+	// register again if another destructor allocates after this
+	thread_cache.registered = false;
+}
+
+static void slab_init(void)
+{
+	if (tss_create(&thread_cache_key, slab_thread_exit) != thrd_success) {
+		abort();
+	}
+}
+
+// make sure the thread cache is flushed when the thread exits
+static void slab_register_thread(void)
+{
+	call_once(&init_once, slab_init);
+	if (tss_set(thread_cache_key, &thread_cache) != thrd_success) {
+		abort();
+	}
+	thread_cache.registered = true;
+}
+
+static char *slab_map_superpage(void)
+{
+#ifdef HAVE_MMAP
+	char *p = mmap(NULL, 2 * SLAB_SUPERPAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) {
+		return NULL;
+	}
+	size_t head = -(uintptr_t)p & (SLAB_SUPERPAGE_SIZE - 1);
+	if (head != 0) {
+		munmap(p, head);
+	}
+	munmap(p + head + SLAB_SUPERPAGE_SIZE, SLAB_SUPERPAGE_SIZE - head);
+	p += head;
+	// guard pages between the metadata and the first span
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t metadata_size = (sizeof(struct slab_superpage_metadata) + page_size - 1) & ~(page_size - 1);
+	if (metadata_size < SLAB_SPAN_SIZE) {
+		mprotect(p + metadata_size, SLAB_SPAN_SIZE - metadata_size, PROT_NONE);
+	}
+	return p;
+#else
+	return aligned_alloc(SLAB_SUPERPAGE_SIZE, SLAB_SUPERPAGE_SIZE);
+#endif
+}
+
+// return the memory of an empty span to the operating system (it is mapped again on the next access)
+static void slab_decommit_span(struct slab_span *span)
+{
+#ifdef HAVE_MMAP
+	madvise(span->start, SLAB_SPAN_SIZE, MADV_DONTNEED);
+#else
+	(void)span;
+#endif
+}
+
+static struct slab_span *slab_span_of(void *ptr)
+{
+	uintptr_t superpage = (uintptr_t)ptr & ~(uintptr_t)(SLAB_SUPERPAGE_SIZE - 1);
+	size_t index = ((uintptr_t)ptr - superpage) / SLAB_SPAN_SIZE;
+	if (unlikely(index == 0)) {
+		abort(); // not a slab allocation
+	}
+	return &((struct slab_superpage_metadata *)superpage)->spans[index - 1];
+}
+
+static struct slab_span *slab_new_span(void)
+{
+	slab_lock(&span_lock);
+	if (!free_spans) {
+		char *superpage = slab_map_superpage();
+		if (unlikely(!superpage)) {
+			abort();
+		}
+		struct slab_superpage_metadata *metadata = (struct slab_superpage_metadata *)superpage;
+		for (size_t i = SLAB_SPANS_PER_SUPERPAGE - 1; i > 0; i--) {
+			struct slab_span *span = &metadata->spans[i - 1];
+			span->start = superpage + i * SLAB_SPAN_SIZE;
+			span->size_class = SLAB_NO_SIZE_CLASS;
+			span->next = free_spans;
+			free_spans = span;
+		}
+	}
+	struct slab_span *span = free_spans;
+	free_spans = span->next;
+	slab_unlock(&span_lock);
+	return span;
+}
+
+static void slab_release_span(struct slab_span *span)
+{
+	span->size_class = SLAB_NO_SIZE_CLASS;
+	slab_decommit_span(span);
+	slab_lock(&span_lock);
+	span->next = free_spans;
+	free_spans = span;
+	slab_unlock(&span_lock);
+}
+
+static void slab_partial_push(struct slab_size_class *class, struct slab_span *span)
+{
+	span->prev = NULL;
+	span->next = class->partial;
+	if (class->partial) {
+		class->partial->prev = span;
+	}
+	class->partial = span;
+	span->partial = true;
+}
+
+static void slab_partial_remove(struct slab_size_class *class, struct slab_span *span)
+{
+	if (span->prev) {
+		span->prev->next = span->next;
+	} else {
+		class->partial = span->next;
+	}
+	if (span->next) {
+		span->next->prev = span->prev;
+	}
+	span->partial = false;
+}
+
+// the size class lock must be held
+static void *slab_span_alloc(struct slab_size_class *class, unsigned int size_class)
+{
+	struct slab_span *span = class->partial;
+	if (!span) {
+		span = slab_new_span();
+		span->slot_size = slab_slot_size(size_class);
+		span->num_slots = SLAB_SPAN_SIZE / span->slot_size;
+		span->num_allocated = 0;
+		span->num_untouched = span->num_slots;
+		span->free_list = NULL;
+		span->size_class = size_class;
+		memset(span->bitmap, 0, sizeof(span->bitmap));
+		slab_partial_push(class, span);
+	}
+	char *p;
+	if (span->free_list) {
+		p = span->free_list;
+		span->free_list = *(void **)p;
+	} else {
+		p = span->start + (size_t)(span->num_slots - span->num_untouched) * span->slot_size;
+		span->num_untouched--;
+	}
+	size_t slot = (size_t)(p - span->start) / span->slot_size;
+	span->bitmap[slot / 64] |= (uint64_t)1 << (slot % 64);
+	if (++span->num_allocated == span->num_slots) {
+		slab_partial_remove(class, span);
+	}
+	return p;
+}
+
+// the size class lock must be held, aborts on invalid pointers and double frees
+static void slab_span_free(struct slab_size_class *class, unsigned int size_class, char *p)
+{
+	struct slab_span *span = slab_span_of(p);
+	size_t offset = (size_t)(p - span->start);
+	if (unlikely(span->size_class != size_class || offset % span->slot_size != 0)) {
+		abort();
+	}
+	size_t slot = offset / span->slot_size;
+	uint64_t bit = (uint64_t)1 << (slot % 64);
+	if (unlikely(!(span->bitmap[slot / 64] & bit))) {
+		abort();
+	}
+	span->bitmap[slot / 64] &= ~bit;
+	*(void **)p = span->free_list;
+	span->free_list = p;
+	if (!span->partial) {
+		slab_partial_push(class, span);
+	}
+	// keep the last span with free slots to avoid mapping and unmapping a span over and over
+	if (--span->num_allocated == 0 && (span->prev || span->next)) {
+		slab_partial_remove(class, span);
+		slab_release_span(span);
+	}
+}
+
+// return count slots from the bin to the spans
+static void slab_flush_bin(struct slab_cache_bin *bin, unsigned int size_class, uint32_t count)
+{
+	struct slab_size_class *class = &size_classes[size_class];
+	slab_lock(&class->lock);
+	for (uint32_t i = 0; i < count; i++) {
+		char *p = bin->head;
+		bin->head = *(void **)p;
+		slab_span_free(class, size_class, p);
+	}
+	bin->count -= count;
+	slab_unlock(&class->lock);
+}
+
+static _attr_noinline void *slab_alloc_slow(struct slab_cache_bin *bin, unsigned int size_class)
+{
+	if (unlikely(!thread_cache.registered)) {
+		slab_register_thread();
+	}
+	if (bin->limit == 0) {
+		bin->limit = slab_cache_limit(size_class);
+	}
+	// keep one slot for the caller and fill half of the cache
+	struct slab_size_class *class = &size_classes[size_class];
+	slab_lock(&class->lock);
+	void *ret = slab_span_alloc(class, size_class);
+	for (uint32_t i = 0; i < bin->limit / 2; i++) {
+		void *p = slab_span_alloc(class, size_class);
+		*(void **)p = bin->head;
+		bin->head = p;
+	}
+	slab_unlock(&class->lock);
+	bin->count += bin->limit / 2;
+	return ret;
+}
+
+static _attr_noinline void slab_free_slow(struct slab_cache_bin *bin, unsigned int size_class, void *ptr)
+{
+	if (unlikely(!thread_cache.registered)) {
+		slab_register_thread();
+	}
+	if (bin->limit == 0) {
+		bin->limit = slab_cache_limit(size_class);
+	}
+	if (bin->count >= bin->limit) {
+		slab_flush_bin(bin, size_class, bin->count / 2);
+	}
+	*(void **)ptr = bin->head;
+	bin->head = ptr;
+	bin->count++;
+}
+
+void *slab_alloc(size_t size)
+{
+	if (unlikely(size > SLAB_MAX_SIZE)) {
+		void *p = malloc(size);
+		if (unlikely(!p)) {
+			abort();
+		}
+		return p;
+	}
+	unsigned int size_class = slab_size_class(size);
+	struct slab_cache_bin *bin = &thread_cache.bins[size_class];
+	void *p = bin->head;
+	if (likely(p)) {
+		bin->head = *(void **)p;
+		bin->count--;
+		return p;
+	}
+	return slab_alloc_slow(bin, size_class);
+}
+
+void slab_free(void *ptr, size_t size)
+{
+	if (unlikely(size > SLAB_MAX_SIZE)) {
+		free(ptr);
+		return;
+	}
+	if (unlikely(!ptr)) {
+		return;
+	}
+	unsigned int size_class = slab_size_class(size);
+	struct slab_cache_bin *bin = &thread_cache.bins[size_class];
+	if (likely(bin->count < bin->limit)) {
+		*(void **)ptr = bin->head;
+		bin->head = ptr;
+		bin->count++;
+		return;
+	}
+	slab_free_slow(bin, size_class, ptr);
+}
+
+void *slab_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+	if (!ptr) {
+		return new_size == 0 ? NULL : slab_alloc(new_size);
+	}
+	if (new_size == 0) {
+		slab_free(ptr, old_size);
+		return NULL;
+	}
+	if (old_size > SLAB_MAX_SIZE && new_size > SLAB_MAX_SIZE) {
+		void *p = realloc(ptr, new_size);
+		if (unlikely(!p)) {
+			abort();
+		}
+		return p;
+	}
+	if (old_size <= SLAB_MAX_SIZE && new_size <= SLAB_MAX_SIZE &&
+	    slab_size_class(old_size) == slab_size_class(new_size)) {
+		return ptr;
+	}
+	void *p = slab_alloc(new_size);
+	memcpy(p, ptr, old_size < new_size ? old_size : new_size);
+	slab_free(ptr, old_size);
+	return p;
+}
+
+void slab_thread_flush(void)
+{
+	for (unsigned int i = 0; i < SLAB_NUM_SIZE_CLASSES; i++) {
+		struct slab_cache_bin *bin = &thread_cache.bins[i];
+		if (bin->count != 0) {
+			slab_flush_bin(bin, i, bin->count);
+		}
+	}
+}
+
+static void *slab_allocator_allocate(struct allocator *allocator, size_t size)
+{
+	(void)allocator;
+	return slab_alloc(size);
+}
+
+static void *slab_allocator_reallocate(struct allocator *allocator, void *ptr, size_t old_size, size_t new_size)
+{
+	(void)allocator;
+	return slab_realloc(ptr, old_size, new_size);
+}
+
+static void slab_allocator_deallocate(struct allocator *allocator, void *ptr, size_t size)
+{
+	(void)allocator;
+	slab_free(ptr, size);
+}
+
+static struct allocator slab_allocator_instance = {
+	.allocate = slab_allocator_allocate,
+	.reallocate = slab_allocator_reallocate,
+	.deallocate = slab_allocator_deallocate,
+};
+
+struct allocator *slab_allocator(void)
+{
+	return &slab_allocator_instance;
+}
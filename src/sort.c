@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sort.h"
+
+DEFINE_RADIX_SORTFUNC(_radix_sort_u32, uint32_t, uint32_t, *a)
+DEFINE_RADIX_SORTFUNC(_radix_sort_u64, uint64_t, uint64_t, *a)
+DEFINE_RADIX_SORTFUNC(_radix_sort_i32, int32_t, uint32_t, radix_key_i32(*a))
+DEFINE_RADIX_SORTFUNC(_radix_sort_i64, int64_t, uint64_t, radix_key_i64(*a))
+DEFINE_RADIX_SORTFUNC(_radix_sort_float, float, uint32_t, radix_key_float(*a))
+DEFINE_RADIX_SORTFUNC(_radix_sort_double, double, uint64_t, radix_key_double(*a))
+
+void radix_sort_u32(uint32_t *arr, size_t n)
+{
+	_radix_sort_u32(arr, n);
+}
+
+void radix_sort_u64(uint64_t *arr, size_t n)
+{
+	_radix_sort_u64(arr, n);
+}
+
+void radix_sort_i32(int32_t *arr, size_t n)
+{
+	_radix_sort_i32(arr, n);
+}
+
+void radix_sort_i64(int64_t *arr, size_t n)
+{
+	_radix_sort_i64(arr, n);
+}
+
+void radix_sort_float(float *arr, size_t n)
+{
+	_radix_sort_float(arr, n);
+}
+
+void radix_sort_double(double *arr, size_t n)
+{
+	_radix_sort_double(arr, n);
+}
@@ -0,0 +1,770 @@
+/*
+ * Copyright (C) 2024 Fabian Hügel
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ * of the Software, and to permit persons to whom the Software is furnished to do
+ * so, subject to the following conditions:
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compiler.h"
+#include "string_btree.h"
+
+// TODO the split point is chosen by count, choosing it by size (and looking for a short separator close to the
+//      middle) would improve the fill factor for keys with very different lengths
+// TODO nodes are only merged if the result fits into one node, there is no redistribution between siblings
+
+#define NODE_SIZE      STRING_BTREE_NODE_SIZE
+#define MAX_KEY_SIZE   STRING_BTREE_MAX_KEY_SIZE
+#define HEAP_ALIGNMENT 8
+
+_Static_assert(NODE_SIZE <= USHRT_MAX, "node offsets have to fit into an unsigned short");
+_Static_assert(NODE_SIZE % HEAP_ALIGNMENT == 0, "node size must be a multiple of the heap alignment");
+// a full node has to contain at least three entries, so that a split never produces an empty node
+_Static_assert(sizeof(struct _string_btree_node) + 2 * MAX_KEY_SIZE +
+	       3 * (sizeof(struct _string_btree_slot) + STRING_BTREE_MAX_VALUE_SIZE + MAX_KEY_SIZE + HEAP_ALIGNMENT) <
+	       NODE_SIZE, "node size is too small for the maximum key and value size");
+
+typedef struct _string_btree_node node_t;
+
+static size_t round_up(size_t size)
+{
+	return (size + HEAP_ALIGNMENT - 1) & ~(size_t)(HEAP_ALIGNMENT - 1);
+}
+
+static uint32_t key_head(const unsigned char *key, size_t length)
+{
+	uint32_t head = 0;
+	for (size_t i = 0; i < sizeof(head); i++) {
+		head <<= 8;
+		if (i < length) {
+			head |= key[i];
+		}
+	}
+	return head;
+}
+
+static size_t common_prefix_length(const unsigned char *a, size_t a_length, const unsigned char *b, size_t b_length)
+{
+	size_t n = a_length < b_length ? a_length : b_length;
+	size_t i = 0;
+	while (i < n && a[i] == b[i]) {
+		i++;
+	}
+	return i;
+}
+
+static size_t node_payload_size(const node_t *node, const struct string_btree_info *info)
+{
+	return node->leaf ? info->value_size : sizeof(node_t *);
+}
+
+static size_t entry_size(size_t suffix_length, size_t payload_size)
+{
+	return sizeof(struct _string_btree_slot) + round_up(payload_size + suffix_length);
+}
+
+static unsigned char *node_bytes(const node_t *node, unsigned int offset)
+{
+	return (unsigned char *)node + offset;
+}
+
+static void *node_payload(const node_t *node, unsigned int idx)
+{
+	return node_bytes(node, node->slots[idx].offset);
+}
+
+static const unsigned char *node_suffix(const node_t *node, unsigned int idx, const struct string_btree_info *info)
+{
+	return node_bytes(node, node->slots[idx].offset + node_payload_size(node, info));
+}
+
+static const unsigned char *node_lower_fence(const node_t *node)
+{
+	return node_bytes(node, node->lower_fence_offset);
+}
+
+static const unsigned char *node_upper_fence(const node_t *node)
+{
+	return node_bytes(node, node->upper_fence_offset);
+}
+
+static node_t *node_get_child(const node_t *node, unsigned int idx)
+{
+	if (idx == node->num_items) {
+		return node->upper;
+	}
+	return *(node_t **)node_payload(node, idx);
+}
+
+static void node_set_child(node_t *node, unsigned int idx, node_t *child)
+{
+	if (idx == node->num_items) {
+		node->upper = child;
+	} else {
+		*(node_t **)node_payload(node, idx) = child;
+	}
+}
+
+static size_t node_get_key(const node_t *node, unsigned int idx, unsigned char *buf,
+			   const struct string_btree_info *info)
+{
+	size_t suffix_length = node->slots[idx].length;
+	memcpy(buf, node_lower_fence(node), node->prefix_length);
+	memcpy(buf + node->prefix_length, node_suffix(node, idx, info), suffix_length);
+	return node->prefix_length + suffix_length;
+}
+
+static size_t node_used_space(const node_t *node)
+{
+	return sizeof(*node) + node->num_items * sizeof(node->slots[0]) + node->heap_size;
+}
+
+static size_t node_contiguous_free_space(const node_t *node)
+{
+	return node->heap_start - (sizeof(*node) + node->num_items * sizeof(node->slots[0]));
+}
+
+static unsigned int node_heap_alloc(node_t *node, size_t size)
+{
+	size = round_up(size);
+	node->heap_start -= size;
+	node->heap_size += size;
+	return node->heap_start;
+}
+
+static void node_init(node_t *node, bool leaf)
+{
+	node->num_items = 0;
+	node->prefix_length = 0;
+	node->heap_start = NODE_SIZE;
+	node->heap_size = 0;
+	node->lower_fence_offset = NODE_SIZE;
+	node->lower_fence_length = 0;
+	node->upper_fence_offset = NODE_SIZE;
+	node->upper_fence_length = 0;
+	node->leaf = leaf;
+	node->upper = NULL;
+}
+
+static node_t *node_new(bool leaf)
+{
+	node_t *node = malloc(NODE_SIZE);
+	node_init(node, leaf);
+	return node;
+}
+
+/* must be called on an empty node */
+static void node_set_fences(node_t *node, const unsigned char *lower, size_t lower_length,
+			    const unsigned char *upper, size_t upper_length)
+{
+	node->lower_fence_offset = node_heap_alloc(node, lower_length);
+	node->lower_fence_length = lower_length;
+	memcpy(node_bytes(node, node->lower_fence_offset), lower, lower_length);
+	node->upper_fence_offset = node_heap_alloc(node, upper_length);
+	node->upper_fence_length = upper_length;
+	memcpy(node_bytes(node, node->upper_fence_offset), upper, upper_length);
+	node->prefix_length = 0;
+	if (upper_length != 0) {
+		node->prefix_length = common_prefix_length(lower, lower_length, upper, upper_length);
+	}
+}
+
+static int node_compare(const node_t *node, unsigned int idx, const unsigned char *suffix, size_t length,
+			uint32_t head, const struct string_btree_info *info)
+{
+	const struct _string_btree_slot *slot = &node->slots[idx];
+	if (head != slot->head) {
+		return head < slot->head ? -1 : 1;
+	}
+	if (length > sizeof(head) || slot->length > sizeof(head)) {
+		size_t n = length < slot->length ? length : slot->length;
+		int cmp = memcmp(suffix, node_suffix(node, idx, info), n);
+		if (cmp != 0) {
+			return cmp;
+		}
+	}
+	return (length > slot->length) - (length < slot->length);
+}
+
+/* the key has to be inside the range of the node (which is guaranteed when descending from the root) */
+static unsigned int node_lower_bound(const node_t *node, const unsigned char *key, size_t length, bool *found,
+				     const struct string_btree_info *info)
+{
+	const unsigned char *suffix = key + node->prefix_length;
+	size_t suffix_length = length - node->prefix_length;
+	uint32_t head = key_head(suffix, suffix_length);
+	unsigned int start = 0;
+	unsigned int end = node->num_items;
+	while (start < end) {
+		unsigned int mid = (start + end) / 2;
+		int cmp = node_compare(node, mid, suffix, suffix_length, head, info);
+		if (cmp == 0) {
+			*found = true;
+			return mid;
+		}
+		if (cmp > 0) {
+			start = mid + 1;
+		} else {
+			end = mid;
+		}
+	}
+	*found = false;
+	return start;
+}
+
+/* the caller has to make sure that there is enough space */
+static void node_insert_at(node_t *node, unsigned int idx, const unsigned char *key, size_t length,
+			   const void *payload, const struct string_btree_info *info)
+{
+	size_t payload_size = node_payload_size(node, info);
+	size_t suffix_length = length - node->prefix_length;
+	// assert(entry_size(suffix_length, payload_size) <= node_contiguous_free_space(node));
+	memmove(&node->slots[idx + 1], &node->slots[idx], (node->num_items - idx) * sizeof(node->slots[0]));
+	unsigned int offset = node_heap_alloc(node, payload_size + suffix_length);
+	if (payload_size != 0) {
+		memcpy(node_bytes(node, offset), payload, payload_size);
+	}
+	memcpy(node_bytes(node, offset + payload_size), key + node->prefix_length, suffix_length);
+	node->slots[idx].head = key_head(key + node->prefix_length, suffix_length);
+	node->slots[idx].offset = offset;
+	node->slots[idx].length = suffix_length;
+	node->num_items++;
+}
+
+static void node_remove_at(node_t *node, unsigned int idx, const struct string_btree_info *info)
+{
+	// the heap space is reclaimed by the next compaction
+	node->heap_size -= round_up(node_payload_size(node, info) + node->slots[idx].length);
+	memmove(&node->slots[idx], &node->slots[idx + 1], (node->num_items - idx - 1) * sizeof(node->slots[0]));
+	node->num_items--;
+}
+
+/* appends the entries [from, to) of src to dest */
+static void node_copy_entries(node_t *dest, const node_t *src, unsigned int from, unsigned int to,
+			      const struct string_btree_info *info)
+{
+	unsigned char key[MAX_KEY_SIZE];
+	for (unsigned int i = from; i < to; i++) {
+		size_t length = node_get_key(src, i, key, info);
+		node_insert_at(dest, dest->num_items, key, length, node_payload(src, i), info);
+	}
+}
+
+static void node_compact(node_t *node, const struct string_btree_info *info)
+{
+	_Alignas(node_t) unsigned char buf[NODE_SIZE];
+	node_t *tmp = (node_t *)buf;
+	memcpy(tmp, node, NODE_SIZE);
+	node_init(node, tmp->leaf);
+	node_set_fences(node, node_lower_fence(tmp), tmp->lower_fence_length,
+			node_upper_fence(tmp), tmp->upper_fence_length);
+	node_copy_entries(node, tmp, 0, tmp->num_items, info);
+	node->upper = tmp->upper;
+}
+
+static bool node_reserve(node_t *node, size_t size, const struct string_btree_info *info)
+{
+	if (node_contiguous_free_space(node) >= size) {
+		return true;
+	}
+	if (NODE_SIZE - node_used_space(node) < size) {
+		return false;
+	}
+	node_compact(node, info);
+	return true;
+}
+
+void _string_btree_init(struct _string_btree *tree)
+{
+	tree->root = NULL;
+	tree->height = 0;
+}
+
+static void node_destroy(node_t *node, const struct string_btree_info *info)
+{
+	if (node->leaf) {
+		if (info->destroy_value) {
+			for (unsigned int i = 0; i < node->num_items; i++) {
+				info->destroy_value(node_payload(node, i));
+			}
+		}
+	} else {
+		for (unsigned int i = 0; i <= node->num_items; i++) {
+			node_destroy(node_get_child(node, i), info);
+		}
+	}
+	free(node);
+}
+
+void _string_btree_destroy(struct _string_btree *tree, const struct string_btree_info *info)
+{
+	if (tree->height != 0) {
+		node_destroy(tree->root, info);
+	}
+	_string_btree_init(tree);
+}
+
+void *_string_btree_find(const struct _string_btree *tree, const char *key, size_t length,
+			 const struct string_btree_info *info)
+{
+	if (tree->height == 0 || length > MAX_KEY_SIZE) {
+		return NULL;
+	}
+	const node_t *node = tree->root;
+	bool found;
+	while (!node->leaf) {
+		unsigned int idx = node_lower_bound(node, (const unsigned char *)key, length, &found, info);
+		node = node_get_child(node, idx + found);
+	}
+	unsigned int idx = node_lower_bound(node, (const unsigned char *)key, length, &found, info);
+	return found ? node_payload(node, idx) : NULL;
+}
+
+static void node_split(struct _string_btree *tree, node_t *node, struct _string_btree_pos *path,
+		       unsigned int depth, const struct string_btree_info *info)
+{
+	// assert(node->num_items >= 3);
+	unsigned int mid = node->num_items / 2;
+	unsigned char separator[MAX_KEY_SIZE];
+	size_t separator_length;
+	if (node->leaf) {
+		// use the shortest separator s with left < s <= right (suffix truncation)
+		unsigned char left[MAX_KEY_SIZE];
+		size_t left_length = node_get_key(node, mid - 1, left, info);
+		size_t right_length = node_get_key(node, mid, separator, info);
+		separator_length = common_prefix_length(left, left_length, separator, right_length) + 1;
+	} else {
+		separator_length = node_get_key(node, mid, separator, info);
+	}
+
+	node_t *parent = depth == 0 ? NULL : path[depth - 1].node;
+	if (parent && !node_reserve(parent, entry_size(separator_length - parent->prefix_length, sizeof(node_t *)),
+				    info)) {
+		// make room in the parent first, the caller starts over at the root
+		node_split(tree, parent, path, depth - 1, info);
+		return;
+	}
+
+	_Alignas(node_t) unsigned char buf[NODE_SIZE];
+	node_t *tmp = (node_t *)buf;
+	memcpy(tmp, node, NODE_SIZE);
+	node_t *right = node_new(tmp->leaf);
+	node_init(node, tmp->leaf);
+	node_set_fences(node, node_lower_fence(tmp), tmp->lower_fence_length, separator, separator_length);
+	node_set_fences(right, separator, separator_length, node_upper_fence(tmp), tmp->upper_fence_length);
+	node_copy_entries(node, tmp, 0, mid, info);
+	if (tmp->leaf) {
+		node_copy_entries(right, tmp, mid, tmp->num_items, info);
+	} else {
+		// the middle separator moves up into the parent
+		node->upper = node_get_child(tmp, mid);
+		node_copy_entries(right, tmp, mid + 1, tmp->num_items, info);
+		right->upper = tmp->upper;
+	}
+
+	if (!parent) {
+		node_t *root = node_new(false);
+		node_insert_at(root, 0, separator, separator_length, &node, info);
+		root->upper = right;
+		tree->root = root;
+		tree->height++;
+		return;
+	}
+	unsigned int idx = path[depth - 1].idx;
+	node_insert_at(parent, idx, separator, separator_length, &node, info);
+	// the child pointer that pointed to the old node now has to point to the right half
+	node_set_child(parent, idx + 1, right);
+}
+
+bool _string_btree_insert(struct _string_btree *tree, const char *_key, size_t length, const void *value,
+			  bool update, const struct string_btree_info *info)
+{
+	if (length > MAX_KEY_SIZE) {
+		return false;
+	}
+	const unsigned char *key = (const unsigned char *)_key;
+	if (tree->height == 0) {
+		tree->root = node_new(true);
+		tree->height = 1;
+	}
+	for (;;) {
+		struct _string_btree_pos path[32];
+		unsigned int depth = 0;
+		node_t *node = tree->root;
+		bool found;
+		while (!node->leaf) {
+			unsigned int idx = node_lower_bound(node, key, length, &found, info);
+			path[depth].node = node;
+			path[depth].idx = idx + found;
+			depth++;
+			node = node_get_child(node, idx + found);
+		}
+		unsigned int idx = node_lower_bound(node, key, length, &found, info);
+		if (found) {
+			if (update) {
+				void *payload = node_payload(node, idx);
+				if (info->destroy_value) {
+					info->destroy_value(payload);
+				}
+				memcpy(payload, value, info->value_size);
+			}
+			return false;
+		}
+		if (node_reserve(node, entry_size(length - node->prefix_length, info->value_size), info)) {
+			node_insert_at(node, idx, key, length, value, info);
+			return true;
+		}
+		node_split(tree, node, path, depth, info);
+	}
+}
+
+/* merges the child at idx + 1 into the child at idx if the result fits into one node */
+static bool node_try_merge(node_t *parent, unsigned int idx, const struct string_btree_info *info)
+{
+	node_t *left = node_get_child(parent, idx);
+	node_t *right = node_get_child(parent, idx + 1);
+	const unsigned char *lower = node_lower_fence(left);
+	const unsigned char *upper = node_upper_fence(right);
+	size_t prefix_length = 0;
+	if (right->upper_fence_length != 0) {
+		prefix_length = common_prefix_length(lower, left->lower_fence_length, upper, right->upper_fence_length);
+	}
+	size_t payload_size = node_payload_size(left, info);
+	size_t size = sizeof(node_t) + round_up(left->lower_fence_length) + round_up(right->upper_fence_length);
+	for (unsigned int i = 0; i < left->num_items; i++) {
+		size += entry_size(left->prefix_length + left->slots[i].length - prefix_length, payload_size);
+	}
+	for (unsigned int i = 0; i < right->num_items; i++) {
+		size += entry_size(right->prefix_length + right->slots[i].length - prefix_length, payload_size);
+	}
+	if (!left->leaf) {
+		size += entry_size(parent->prefix_length + parent->slots[idx].length - prefix_length, payload_size);
+	}
+	if (size > NODE_SIZE) {
+		return false;
+	}
+
+	_Alignas(node_t) unsigned char buf[NODE_SIZE];
+	node_t *tmp = (node_t *)buf;
+	node_init(tmp, left->leaf);
+	node_set_fences(tmp, lower, left->lower_fence_length, upper, right->upper_fence_length);
+	node_copy_entries(tmp, left, 0, left->num_items, info);
+	if (!left->leaf) {
+		// the separator from the parent moves down
+		unsigned char separator[MAX_KEY_SIZE];
+		size_t separator_length = node_get_key(parent, idx, separator, info);
+		node_insert_at(tmp, tmp->num_items, separator, separator_length, &left->upper, info);
+	}
+	node_copy_entries(tmp, right, 0, right->num_items, info);
+	tmp->upper = right->upper;
+	memcpy(left, tmp, NODE_SIZE);
+	free(right);
+
+	node_set_child(parent, idx + 1, left);
+	node_remove_at(parent, idx, info);
+	return true;
+}
+
+bool _string_btree_delete(struct _string_btree *tree, const char *_key, size_t length, void *ret_value,
+			  const struct string_btree_info *info)
+{
+	const unsigned char *key = (const unsigned char *)_key;
+	if (tree->height == 0 || length > MAX_KEY_SIZE) {
+		return false;
+	}
+	struct _string_btree_pos path[32];
+	unsigned int depth = 0;
+	node_t *node = tree->root;
+	bool found;
+	while (!node->leaf) {
+		unsigned int idx = node_lower_bound(node, key, length, &found, info);
+		path[depth].node = node;
+		path[depth].idx = idx + found;
+		depth++;
+		node = node_get_child(node, idx + found);
+	}
+	unsigned int idx = node_lower_bound(node, key, length, &found, info);
+	if (!found) {
+		return false;
+	}
+	if (ret_value) {
+		memcpy(ret_value, node_payload(node, idx), info->value_size);
+	}
+	node_remove_at(node, idx, info);
+
+	while (depth > 0 && node_used_space(node) < NODE_SIZE / 4) {
+		node_t *parent = path[depth - 1].node;
+		idx = path[depth - 1].idx;
+		// merge with the right sibling if there is one, otherwise with the left one
+		if (idx == parent->num_items) {
+			if (idx == 0) {
+				// no siblings, but the parent might be able to merge
+				node = parent;
+				depth--;
+				continue;
+			}
+			idx--;
+		}
+		if (!node_try_merge(parent, idx, info)) {
+			break;
+		}
+		node = parent;
+		depth--;
+	}
+
+	while (!tree->root->leaf && tree->root->num_items == 0) {
+		node_t *root = tree->root;
+		tree->root = root->upper;
+		tree->height--;
+		free(root);
+	}
+	if (tree->root->leaf && tree->root->num_items == 0) {
+		free(tree->root);
+		_string_btree_init(tree);
+	}
+	return true;
+}
+
+static void *iter_load(struct string_btree_iter *iter, const struct string_btree_info *info)
+{
+	struct _string_btree_pos *pos = &iter->path[iter->depth - 1];
+	iter->key_length = node_get_key(pos->node, pos->idx, (unsigned char *)iter->key, info);
+	iter->key[iter->key_length] = '\0';
+	return node_payload(pos->node, pos->idx);
+}
+
+/* in a leaf idx is the next item, in an inner node it is the child to visit next */
+static void *iter_forward(struct string_btree_iter *iter, const struct string_btree_info *info)
+{
+	for (;;) {
+		struct _string_btree_pos *pos = &iter->path[iter->depth - 1];
+		if (!pos->node->leaf) {
+			node_t *child = node_get_child(pos->node, pos->idx);
+			pos = &iter->path[iter->depth++];
+			pos->node = child;
+			pos->idx = 0;
+			continue;
+		}
+		if (pos->idx < pos->node->num_items) {
+			return iter_load(iter, info);
+		}
+		do {
+			if (--iter->depth == 0) {
+				return NULL;
+			}
+			pos = &iter->path[iter->depth - 1];
+		} while (pos->idx == pos->node->num_items);
+		pos->idx++;
+	}
+}
+
+/* in a leaf idx is one past the next item, in an inner node it is the child to visit next */
+static void *iter_backward(struct string_btree_iter *iter, const struct string_btree_info *info)
+{
+	for (;;) {
+		struct _string_btree_pos *pos = &iter->path[iter->depth - 1];
+		if (!pos->node->leaf) {
+			node_t *child = node_get_child(pos->node, pos->idx);
+			pos = &iter->path[iter->depth++];
+			pos->node = child;
+			pos->idx = child->num_items;
+			continue;
+		}
+		if (pos->idx > 0) {
+			pos->idx--;
+			return iter_load(iter, info);
+		}
+		do {
+			if (--iter->depth == 0) {
+				return NULL;
+			}
+			pos = &iter->path[iter->depth - 1];
+		} while (pos->idx == 0);
+		pos->idx--;
+	}
+}
+
+void *_string_btree_iter_start(struct string_btree_iter *iter, const struct _string_btree *tree, bool rightmost,
+			       const struct string_btree_info *info)
+{
+	iter->tree = tree;
+	iter->depth = 0;
+	if (tree->height == 0) {
+		return NULL;
+	}
+	iter->depth = 1;
+	iter->path[0].node = tree->root;
+	iter->path[0].idx = rightmost ? tree->root->num_items : 0;
+	return rightmost ? iter_backward(iter, info) : iter_forward(iter, info);
+}
+
+void *_string_btree_iter_start_at(struct string_btree_iter *iter, const struct _string_btree *tree,
+				  const char *_key, size_t length, enum btree_iter_start_at_mode mode,
+				  const struct string_btree_info *info)
+{
+	const unsigned char *key = (const unsigned char *)_key;
+	iter->tree = tree;
+	iter->depth = 0;
+	if (tree->height == 0) {
+		return NULL;
+	}
+	unsigned char buf[MAX_KEY_SIZE];
+	if (length > MAX_KEY_SIZE) {
+		// such a key cannot be in the tree, but the bounds still make sense (with a truncated key)
+		if (mode == BTREE_ITER_FIND_KEY) {
+			return NULL;
+		}
+		memcpy(buf, key, MAX_KEY_SIZE);
+		key = buf;
+		length = MAX_KEY_SIZE;
+		mode = (mode == BTREE_ITER_UPPER_BOUND_INCLUSIVE || mode == BTREE_ITER_UPPER_BOUND_EXCLUSIVE) ?
+			BTREE_ITER_UPPER_BOUND_INCLUSIVE : BTREE_ITER_LOWER_BOUND_EXCLUSIVE;
+	}
+	node_t *node = tree->root;
+	bool found;
+	for (;;) {
+		struct _string_btree_pos *pos = &iter->path[iter->depth++];
+		pos->node = node;
+		pos->idx = node_lower_bound(node, key, length, &found, info);
+		if (node->leaf) {
+			break;
+		}
+		pos->idx += found;
+		node = node_get_child(node, pos->idx);
+	}
+	struct _string_btree_pos *pos = &iter->path[iter->depth - 1];
+	switch (mode) {
+	case BTREE_ITER_FIND_KEY:
+		if (!found) {
+			iter->depth = 0;
+			return NULL;
+		}
+		return iter_load(iter, info);
+	case BTREE_ITER_LOWER_BOUND_INCLUSIVE:
+		return iter_forward(iter, info);
+	case BTREE_ITER_LOWER_BOUND_EXCLUSIVE:
+		pos->idx += found;
+		return iter_forward(iter, info);
+	case BTREE_ITER_UPPER_BOUND_INCLUSIVE:
+		if (found) {
+			return iter_load(iter, info);
+		}
+		return iter_backward(iter, info);
+	case BTREE_ITER_UPPER_BOUND_EXCLUSIVE:
+		return iter_backward(iter, info);
+	}
+	return NULL;
+}
+
+void *_string_btree_iter_next(struct string_btree_iter *iter, const struct string_btree_info *info)
+{
+	if (iter->depth == 0) {
+		return NULL;
+	}
+	iter->path[iter->depth - 1].idx++;
+	return iter_forward(iter, info);
+}
+
+void *_string_btree_iter_prev(struct string_btree_iter *iter, const struct string_btree_info *info)
+{
+	if (iter->depth == 0) {
+		return NULL;
+	}
+	return iter_backward(iter, info);
+}
+
+static int compare_keys(const unsigned char *a, size_t a_length, const unsigned char *b, size_t b_length)
+{
+	int cmp = memcmp(a, b, a_length < b_length ? a_length : b_length);
+	if (cmp != 0) {
+		return cmp;
+	}
+	return (a_length > b_length) - (a_length < b_length);
+}
+
+static bool node_check(const node_t *node, unsigned int height, const struct string_btree_info *info)
+{
+	const unsigned char *lower = node_lower_fence(node);
+	const unsigned char *upper = node_upper_fence(node);
+	if (node->leaf != (height == 1)) {
+		return false;
+	}
+	if (node_used_space(node) > NODE_SIZE || node->heap_start < sizeof(*node) + node->num_items * sizeof(node->slots[0])) {
+		return false;
+	}
+	size_t prefix_length = 0;
+	if (node->upper_fence_length != 0) {
+		prefix_length = common_prefix_length(lower, node->lower_fence_length, upper, node->upper_fence_length);
+	}
+	if (node->prefix_length != prefix_length) {
+		return false;
+	}
+	unsigned char prev[MAX_KEY_SIZE];
+	size_t prev_length = 0;
+	for (unsigned int i = 0; i < node->num_items; i++) {
+		unsigned char key[MAX_KEY_SIZE];
+		size_t length = node_get_key(node, i, key, info);
+		uint32_t head = key_head(key + node->prefix_length, length - node->prefix_length);
+		if (node->slots[i].head != head) {
+			return false;
+		}
+		if (i > 0 && compare_keys(prev, prev_length, key, length) >= 0) {
+			return false;
+		}
+		if (node->lower_fence_length != 0 &&
+		    compare_keys(lower, node->lower_fence_length, key, length) > 0) {
+			return false;
+		}
+		if (node->upper_fence_length != 0 &&
+		    compare_keys(key, length, upper, node->upper_fence_length) >= 0) {
+			return false;
+		}
+		if (!node->leaf) {
+			// the fences of the children have to match the separators
+			const node_t *left = node_get_child(node, i);
+			const node_t *right = node_get_child(node, i + 1);
+			if (compare_keys(node_upper_fence(left), left->upper_fence_length, key, length) != 0 ||
+			    compare_keys(node_lower_fence(right), right->lower_fence_length, key, length) != 0) {
+				return false;
+			}
+		}
+		memcpy(prev, key, length);
+		prev_length = length;
+	}
+	if (!node->leaf) {
+		for (unsigned int i = 0; i <= node->num_items; i++) {
+			if (!node_check(node_get_child(node, i), height - 1, info)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool _string_btree_debug_check(const struct _string_btree *tree, const struct string_btree_info *info)
+{
+	if (tree->height == 0) {
+		return tree->root == NULL;
+	}
+	const node_t *root = tree->root;
+	if (root->lower_fence_length != 0 || root->upper_fence_length != 0 || root->num_items == 0) {
+		return false;
+	}
+	return node_check(root, tree->height, info);
+}
@@ -1,24 +1,131 @@
+#include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "array.h"
+#include "dstring.h"
+#include "hashtable.h"
 #include "mem_arena.h"
+#include "random.h"
+
+#define NUM_REQUESTS 100000
+
+struct entry {
+	uint32_t key;
+	uint32_t value;
+};
+
+DEFINE_HASHTABLE(itable, uint32_t, struct entry, 8, *key == entry->key)
+
+static uint32_t integer_hash(uint32_t x)
+{
+	x = ((x >> 16) ^ x) * 0x45d9f3b;
+	x = ((x >> 16) ^ x) * 0x45d9f3b;
+	return (x >> 16) ^ x;
+}
+
+// a typical request: split the input into tokens, count them in a table and build a response string
+// (allocator is NULL for malloc)
+static size_t handle_request(struct random_state *rng, struct allocator *allocator)
+{
+	size_t n = 16 + random_next_u32(rng) % 256;
+	array_t(dstr_t) tokens = array_new_with_allocator(dstr_t, 0, allocator);
+	array_t(uint32_t) numbers = array_new_with_allocator(uint32_t, 0, allocator);
+	for (size_t i = 0; i < n; i++) {
+		uint32_t x = random_next_u32(rng) % 1024;
+		dstr_t token = dstr_with_allocator(allocator, 0);
+		do {
+			dstr_append_char(&token, '0' + x % 10);
+			x /= 10;
+		} while (x);
+		array_add(tokens, token);
+	}
+	struct itable table;
+	itable_init_with_allocator(&table, 16, allocator);
+	array_foreach_value(tokens, token) {
+		uint32_t x = 0;
+		for (size_t i = dstr_length(token); i > 0; i--) {
+			x = 10 * x + (token[i - 1] - '0');
+		}
+		array_add(numbers, x);
+		struct entry *entry = itable_lookup(&table, x, integer_hash(x));
+		if (!entry) {
+			entry = itable_insert(&table, x, integer_hash(x));
+			entry->key = x;
+			entry->value = 0;
+		}
+		entry->value++;
+	}
+	dstr_t response = dstr_with_allocator(allocator, 0);
+	for (size_t i = 0; i < n; i++) {
+		dstr_append_dstr(&response, tokens[i]);
+		dstr_append_char(&response, '0' + itable_lookup(&table, numbers[i], integer_hash(numbers[i]))->value % 10);
+		dstr_append_char(&response, ',');
+	}
+	size_t length = dstr_length(response);
+	if (!allocator) {
+		dstr_free(&response);
+		itable_destroy(&table);
+		array_free(numbers);
+		array_foreach_value(tokens, token) {
+			dstr_free(&token);
+		}
+		array_free(tokens);
+	}
+	return length;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	long s = end->tv_sec - start->tv_sec;
+	long ns = end->tv_nsec - start->tv_nsec;
+	return ns / 1000000000.0 + s;
+}
+
+static void run(const char *name, struct mem_arena *arena)
+{
+	struct random_state rng;
+	random_state_init(&rng, 1);
+	size_t total = 0;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (size_t i = 0; i < NUM_REQUESTS; i++) {
+		total += handle_request(&rng, arena ? mem_arena_allocator(arena) : NULL);
+		if (arena) {
+			mem_arena_reset(arena);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double t = elapsed(&start, &end);
+	printf("%-18s %.3fs (%.0f ns per request, %zu bytes of output)\n", name, t, t * 1e9 / NUM_REQUESTS, total);
+}
+
+static void test(void)
+{
+	struct mem_arena arena;
+	mem_arena_init(&arena, 0);
+	char *p = mem_arena_alloc_aligned(&arena, 1, 1);
+	char *q = mem_arena_alloc(&arena, 1);
+	assert((uintptr_t)q % _Alignof(max_align_t) == 0 && q > p);
+	struct mem_arena_savepoint savepoint = mem_arena_save(&arena);
+	for (size_t size = 1; size < 1000000; size *= 3) {
+		memset(mem_arena_alloc_aligned(&arena, size, 64), 0xff, size);
+	}
+	mem_arena_rewind(&arena, savepoint);
+	assert(mem_arena_alloc(&arena, 1) == q + _Alignof(max_align_t));
+	mem_arena_destroy(&arena);
+}
 
 int main(void)
 {
+	test();
 	struct mem_arena arena;
-	mem_arena_init(&arena);
-	void *p;
-	p = mem_arena_alloc(&arena, 1);
-	printf("%p\n", p);
-	p = mem_arena_alloc(&arena, 2);
-	printf("%p\n", p);
-	p = mem_arena_alloc(&arena, 3);
-	printf("%p\n", p);
-	p = mem_arena_alloc(&arena, 4096);
-	printf("%p\n", p);
-	p = mem_arena_alloc(&arena, 12345);
-	printf("%p\n", p);
-	p = mem_arena_alloc(&arena, 123456);
-	printf("%p\n", p);
-	p = mem_arena_alloc(&arena, 1);
-	printf("%p\n", p);
+	run("malloc", NULL);
+	mem_arena_init(&arena, 0);
+	run("arena", &arena);
+	mem_arena_destroy(&arena);
+	mem_arena_init(&arena, MEM_ARENA_HUGE_PAGES);
+	run("arena (huge pages)", &arena);
 	mem_arena_destroy(&arena);
 }
@@ -0,0 +1,220 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "multiqueue.h"
+#include "random.h"
+
+#define PREFILL 1000000
+#define OPS_PER_THREAD 2000000
+#define SHARDS_PER_THREAD 4
+
+DEFINE_MULTIQUEUE(u64mq, uint64_t, *a < *b)
+DEFINE_BINHEAP(u64heap, uint64_t, *a < *b)
+
+// the baseline: a single binary heap protected by a mutex
+struct locked_heap {
+	pthread_mutex_t mutex;
+	uint64_t *heap;
+	size_t num_items;
+};
+
+static void locked_heap_insert(struct locked_heap *h, uint64_t value)
+{
+	pthread_mutex_lock(&h->mutex);
+	h->heap[h->num_items] = value;
+	u64heap_insert(h->heap, h->num_items);
+	h->num_items++;
+	pthread_mutex_unlock(&h->mutex);
+}
+
+static bool locked_heap_extract_first(struct locked_heap *h, uint64_t *ret)
+{
+	pthread_mutex_lock(&h->mutex);
+	bool found = h->num_items != 0;
+	if (found) {
+		*ret = u64heap_extract_first(h->heap, h->num_items);
+		h->num_items--;
+	}
+	pthread_mutex_unlock(&h->mutex);
+	return found;
+}
+
+struct thread_data {
+	pthread_t thread;
+	unsigned int tid;
+	bool use_multiqueue;
+	struct u64mq *mq;
+	struct locked_heap *heap;
+	pthread_barrier_t *barrier;
+	uint64_t inserted_sum;
+	uint64_t extracted_sum;
+	size_t num_extracted;
+};
+
+static void *thread_main(void *arg)
+{
+	struct thread_data *data = arg;
+	struct random_state rng;
+	random_state_init(&rng, data->tid + 1);
+	pthread_barrier_wait(data->barrier);
+
+	// every extracted task schedules a new task with a later priority (like a scheduler)
+	for (size_t i = 0; i < OPS_PER_THREAD; i++) {
+		uint64_t value;
+		bool found = data->use_multiqueue ? u64mq_extract_first(data->mq, &value) :
+			locked_heap_extract_first(data->heap, &value);
+		if (found) {
+			data->extracted_sum += value;
+			data->num_extracted++;
+		} else {
+			value = 0;
+		}
+		value += random_next_u32(&rng) % 65536;
+		if (data->use_multiqueue) {
+			u64mq_insert(data->mq, value);
+		} else {
+			locked_heap_insert(data->heap, value);
+		}
+		data->inserted_sum += value;
+	}
+	return NULL;
+}
+
+static double elapsed(struct timespec *start, struct timespec *end)
+{
+	long s = end->tv_sec - start->tv_sec;
+	long ns = end->tv_nsec - start->tv_nsec;
+	return ns / 1000000000.0 + s;
+}
+
+static void run(unsigned int num_threads, bool use_multiqueue)
+{
+	struct u64mq mq;
+	struct locked_heap heap;
+	u64mq_init(&mq, SHARDS_PER_THREAD * num_threads);
+	pthread_mutex_init(&heap.mutex, NULL);
+	heap.heap = malloc((PREFILL + (size_t)num_threads * OPS_PER_THREAD) * sizeof(heap.heap[0]));
+	assert(heap.heap);
+	heap.num_items = 0;
+
+	struct random_state rng;
+	random_state_init(&rng, 12345);
+	uint64_t inserted_sum = 0;
+	for (size_t i = 0; i < PREFILL; i++) {
+		uint64_t value = random_next_u32(&rng);
+		if (use_multiqueue) {
+			u64mq_insert(&mq, value);
+		} else {
+			locked_heap_insert(&heap, value);
+		}
+		inserted_sum += value;
+	}
+
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, num_threads + 1);
+	struct thread_data *threads = calloc(num_threads, sizeof(threads[0]));
+	assert(threads);
+	for (unsigned int i = 0; i < num_threads; i++) {
+		threads[i].tid = i;
+		threads[i].use_multiqueue = use_multiqueue;
+		threads[i].mq = &mq;
+		threads[i].heap = &heap;
+		threads[i].barrier = &barrier;
+		int err = pthread_create(&threads[i].thread, NULL, thread_main, &threads[i]);
+		assert(err == 0);
+	}
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	pthread_barrier_wait(&barrier);
+	uint64_t extracted_sum = 0;
+	size_t num_extracted = 0;
+	for (unsigned int i = 0; i < num_threads; i++) {
+		pthread_join(threads[i].thread, NULL);
+		inserted_sum += threads[i].inserted_sum;
+		extracted_sum += threads[i].extracted_sum;
+		num_extracted += threads[i].num_extracted;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double t = elapsed(&start, &end);
+	size_t ops = (size_t)num_threads * OPS_PER_THREAD;
+	printf("%-10s %2u threads: %.2fs %6.1fMops/s\n", use_multiqueue ? "multiqueue" : "mutex heap", num_threads,
+	       t, 2 * ops / t / 1000000);
+
+	// every item must be extracted exactly once
+	uint64_t value;
+	while (use_multiqueue ? u64mq_extract_first(&mq, &value) : locked_heap_extract_first(&heap, &value)) {
+		extracted_sum += value;
+		num_extracted++;
+	}
+	assert(num_extracted == PREFILL + ops);
+	assert(extracted_sum == inserted_sum);
+	assert(u64mq_num_items(&mq) == 0);
+
+	free(threads);
+	pthread_barrier_destroy(&barrier);
+	free(heap.heap);
+	pthread_mutex_destroy(&heap.mutex);
+	u64mq_destroy(&mq);
+}
+
+// average distance between the rank of an extracted item and the rank of the true minimum
+static void rank_error(unsigned int num_shards)
+{
+	size_t n = 1000000;
+	struct u64mq mq;
+	u64mq_init(&mq, num_shards);
+	struct random_state rng;
+	random_state_init(&rng, 1);
+	uint64_t *values = malloc(n * sizeof(values[0]));
+	assert(values);
+	for (size_t i = 0; i < n; i++) {
+		values[i] = i;
+	}
+	for (size_t i = n - 1; i > 0; i--) {
+		size_t j = random_next_u64(&rng) % (i + 1);
+		uint64_t tmp = values[i];
+		values[i] = values[j];
+		values[j] = tmp;
+	}
+	for (size_t i = 0; i < n; i++) {
+		u64mq_insert(&mq, values[i]);
+	}
+	// values[] now tracks which items were extracted to compute the rank
+	size_t *fenwick = calloc(n + 1, sizeof(fenwick[0]));
+	assert(fenwick);
+	double total = 0;
+	for (size_t i = 0; i < n; i++) {
+		uint64_t value;
+		bool found = u64mq_extract_first(&mq, &value);
+		assert(found);
+		// number of smaller items that were already extracted
+		size_t smaller = 0;
+		for (size_t k = value; k > 0; k -= k & -k) {
+			smaller += fenwick[k];
+		}
+		total += value - smaller;
+		for (size_t k = value + 1; k <= n; k += k & -k) {
+			fenwick[k]++;
+		}
+	}
+	printf("%3u shards: average rank error %.2f\n", num_shards, total / n);
+	free(fenwick);
+	free(values);
+	u64mq_destroy(&mq);
+}
+
+int main(void)
+{
+	rank_error(4);
+	rank_error(16);
+	rank_error(64);
+	puts("");
+	for (unsigned int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+		run(num_threads, false);
+		run(num_threads, true);
+	}
+}
@@ -0,0 +1,189 @@
+#ifndef __MULTIQUEUE_INCLUDE__
+#define __MULTIQUEUE_INCLUDE__
+
+// relaxed concurrent priority queue (MultiQueue)
+// The queue consists of several binary heaps (shards), each protected by its own spinlock. Insert adds the item
+// to a random shard, extract_first takes the smaller minimum of two randomly chosen shards. The extracted item is
+// not necessarily the global minimum, but its rank is small in expectation (O(number of shards)).
+// Use a few shards per thread (e.g. 2-4) so that the threads rarely compete for the same lock.
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <threads.h>
+#include "compiler.h"
+#include "heap.h"
+#include "spinlock.h"
+
+static _attr_unused uint64_t _multiqueue_random(void)
+{
+	static atomic_uint_fast64_t seed_counter = 0;
+	static thread_local uint64_t state = 0;
+	if (unlikely(state == 0)) {
+		// splitmix64 of a per-thread counter
+		uint64_t z = atomic_fetch_add_explicit(&seed_counter, 1, memory_order_relaxed) + 0x9e3779b97f4a7c15;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+		state = (z ^ (z >> 31)) | 1;
+	}
+	// xorshift64
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+#define DEFINE_MULTIQUEUE(name, type, ...)				\
+	DEFINE_BINHEAP(_##name##_heap, type, __VA_ARGS__)		\
+									\
+	struct _##name##_shard {					\
+		struct ticketlock lock;					\
+		atomic_size_t num_items; /* written while holding the lock */ \
+		size_t capacity;					\
+		type *heap;						\
+	} __attribute__((aligned(64)));					\
+									\
+	struct name {							\
+		struct _##name##_shard *shards;				\
+		unsigned int num_shards;				\
+	};								\
+									\
+	static _attr_unused void name##_init(struct name *queue, unsigned int num_shards) \
+	{								\
+		num_shards = num_shards < 2 ? 2 : num_shards;		\
+		queue->shards = aligned_alloc(64, num_shards * sizeof(queue->shards[0])); \
+		if (!queue->shards) {					\
+			abort();					\
+		}							\
+		queue->num_shards = num_shards;				\
+		for (unsigned int i = 0; i < num_shards; i++) {		\
+			ticketlock_init(&queue->shards[i].lock);	\
+			atomic_init(&queue->shards[i].num_items, 0);	\
+			queue->shards[i].capacity = 0;			\
+			queue->shards[i].heap = NULL;			\
+		}							\
+	}								\
+									\
+	/* must not be called concurrently with other functions */	\
+	static _attr_unused void name##_destroy(struct name *queue)	\
+	{								\
+		for (unsigned int i = 0; i < queue->num_shards; i++) {	\
+			free(queue->shards[i].heap);			\
+		}							\
+		free(queue->shards);					\
+		queue->shards = NULL;					\
+		queue->num_shards = 0;					\
+	}								\
+									\
+	/* only exact if there are no concurrent modifications */	\
+	static _attr_unused size_t name##_num_items(struct name *queue)	\
+	{								\
+		size_t n = 0;						\
+		for (unsigned int i = 0; i < queue->num_shards; i++) {	\
+			n += atomic_load_explicit(&queue->shards[i].num_items, memory_order_relaxed); \
+		}							\
+		return n;						\
+	}								\
+									\
+	static inline struct _##name##_shard *_##name##_random_shard(struct name *queue) \
+	{								\
+		uint64_t r = _multiqueue_random();			\
+		return &queue->shards[(uint32_t)r * (uint64_t)queue->num_shards >> 32]; \
+	}								\
+									\
+	static _attr_unused void name##_insert(struct name *queue, type value) \
+	{								\
+		struct _##name##_shard *shard;				\
+		do {							\
+			shard = _##name##_random_shard(queue);		\
+		} while (!ticketlock_try_lock(&shard->lock));		\
+		size_t n = atomic_load_explicit(&shard->num_items, memory_order_relaxed); \
+		if (unlikely(n == shard->capacity)) {			\
+			shard->capacity = shard->capacity ? 2 * shard->capacity : 64; \
+			shard->heap = realloc(shard->heap, shard->capacity * sizeof(shard->heap[0])); \
+			if (!shard->heap) {				\
+				abort();				\
+			}						\
+		}							\
+		shard->heap[n] = value;					\
+		_##name##_heap_insert(shard->heap, n);			\
+		atomic_store_explicit(&shard->num_items, n + 1, memory_order_relaxed); \
+		ticketlock_unlock(&shard->lock);			\
+	}								\
+									\
+	static inline void _##name##_extract_locked(struct _##name##_shard *shard, type *ret) \
+	{								\
+		size_t n = atomic_load_explicit(&shard->num_items, memory_order_relaxed); \
+		*ret = _##name##_heap_extract_first(shard->heap, n);	\
+		atomic_store_explicit(&shard->num_items, n - 1, memory_order_relaxed); \
+	}								\
+									\
+	/* removes an item that is (approximately) the smallest one, returns false if the queue is empty */ \
+	static _attr_unused bool name##_extract_first(struct name *queue, type *ret) \
+	{								\
+		for (unsigned int attempt = 0; ; attempt++) {		\
+			struct _##name##_shard *a = _##name##_random_shard(queue); \
+			struct _##name##_shard *b = _##name##_random_shard(queue); \
+			if (attempt >= 2 * queue->num_shards) {		\
+				/* the queue is probably (almost) empty, check all shards */ \
+				unsigned int i = 0;			\
+				for (; i < queue->num_shards; i++) {	\
+					if (atomic_load_explicit(&queue->shards[i].num_items, \
+								 memory_order_relaxed) != 0) { \
+						break;			\
+					}				\
+				}					\
+				if (i == queue->num_shards) {		\
+					return false;			\
+				}					\
+				a = &queue->shards[i];			\
+				attempt = 0;				\
+			}						\
+			if (atomic_load_explicit(&a->num_items, memory_order_relaxed) == 0) { \
+				a = b;					\
+			} else if (a != b && atomic_load_explicit(&b->num_items, memory_order_relaxed) != 0) { \
+				/* take the smaller minimum of both shards (if both locks are free) */ \
+				if (!ticketlock_try_lock(&a->lock)) {	\
+					a = b;				\
+				} else if (ticketlock_try_lock(&b->lock)) { \
+					struct _##name##_shard *other = b; \
+					if (atomic_load_explicit(&b->num_items, memory_order_relaxed) != 0 && \
+					    (atomic_load_explicit(&a->num_items, memory_order_relaxed) == 0 || \
+					     __##name##_heap_less_than(&b->heap[0], &a->heap[0]))) { \
+						other = a;		\
+						a = b;			\
+					}				\
+					bool found = atomic_load_explicit(&a->num_items, \
+									  memory_order_relaxed) != 0; \
+					if (found) {			\
+						_##name##_extract_locked(a, ret); \
+					}				\
+					ticketlock_unlock(&other->lock); \
+					ticketlock_unlock(&a->lock);	\
+					if (found) {			\
+						return true;		\
+					}				\
+					continue;			\
+				} else {				\
+					ticketlock_unlock(&a->lock);	\
+					continue;			\
+				}					\
+			}						\
+			if (atomic_load_explicit(&a->num_items, memory_order_relaxed) == 0 || \
+			    !ticketlock_try_lock(&a->lock)) {		\
+				continue;				\
+			}						\
+			bool found = atomic_load_explicit(&a->num_items, memory_order_relaxed) != 0; \
+			if (found) {					\
+				_##name##_extract_locked(a, ret);	\
+			}						\
+			ticketlock_unlock(&a->lock);			\
+			if (found) {					\
+				return true;				\
+			}						\
+		}							\
+	}
+
+#endif
@@ -6,6 +6,7 @@
 #include <assert.h>
 #include "array.h"
 #include "heap.h"
+#include "parallel_sort.h"
 #include "random.h"
 #include "sort.h"
 
@@ -44,7 +45,7 @@ static int int_is_sorted(int *arr, size_t n)
 
 static int (*int_cmp_ptr)(const void *a, const void *b) = int_cmp;
 
-DEFINE_SORTFUNC(integer_sort, int, 16, int_cmp_ptr(a, b))
+DEFINE_SORTFUNC(integer_sort, int, int_cmp_ptr(a, b))
 DEFINE_BINHEAP(intheap, int, int_cmp_ptr(a, b) > 0)
 
 static unsigned long long ns_elapsed(struct timespec *start, struct timespec *end)
@@ -255,7 +256,80 @@ static void int_benchmark(void)
 	}
 }
 
+static int u64_cmp(const void *_a, const void *_b)
+{
+	uint64_t a = *(const uint64_t *)_a;
+	uint64_t b = *(const uint64_t *)_b;
+	return (a > b) - (a < b);
+}
+
+DEFINE_SORTFUNC(u64_sort, uint64_t, (*a > *b) - (*a < *b))
+
+static void u64_benchmark(void)
+{
+	// timestamps in nanoseconds over one day (the high bits are shared)
+	size_t n = (size_t)1 << 24;
+	array_t(uint64_t) arr_proto = NULL;
+	array_reserve(arr_proto, n);
+	random_state_init(&global_rng, 0xdeadbeef);
+	for (size_t i = 0; i < n; i++) {
+		array_add(arr_proto, 1700000000000000000 + random_next_u64(&global_rng) % 86400000000000);
+	}
+	array_t(uint64_t) arr = NULL;
+	for (unsigned int algorithm = 0; algorithm < 3; algorithm++) {
+		array_clear(arr);
+		array_add_array(arr, arr_proto);
+		struct timespec start, end;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+		switch (algorithm) {
+		case 0: qsort(arr, n, sizeof(arr[0]), u64_cmp); break;
+		case 1: array_sort_typed(arr, u64_sort); break;
+		case 2: array_sort_typed(arr, radix_sort_u64); break;
+		}
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
+		for (size_t i = 1; i < n; i++) {
+			assert(arr[i - 1] <= arr[i]);
+		}
+		static const char *names[] = {"qsort", "pdqsort", "radix sort"};
+		printf(" u64 2^24  %-10s %7.2f ms\n", names[algorithm], ns_elapsed(&start, &end) / 1000000.0);
+	}
+	array_free(arr);
+	array_free(arr_proto);
+}
+
+DEFINE_PARALLEL_SORTFUNC(parallel_integer_sort, int, (*a > *b) - (*a < *b))
+
+static void parallel_benchmark(void)
+{
+	size_t n = (size_t)1 << 25;
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned int max_threads = cpus > 8 ? (unsigned int)cpus : 8;
+	array_t(int) arr_proto = create_int_array(n, ARRAY_RANDOM);
+	array_t(int) arr = NULL;
+	double single_thread = 0;
+	for (unsigned int num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+		array_clear(arr);
+		array_add_array(arr, arr_proto);
+		struct timespec start, end;
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		parallel_integer_sort(arr, n, num_threads);
+		clock_gettime(CLOCK_MONOTONIC, &end);
+		assert(int_is_sorted(arr, n));
+		double t = ns_elapsed(&start, &end) / 1000000.0;
+		if (num_threads == 1) {
+			single_thread = t;
+		}
+		printf(" int 2^25  %3u threads %8.2f ms (speedup %.2f)\n", num_threads, t, single_thread / t);
+	}
+	array_free(arr);
+	array_free(arr_proto);
+}
+
 int main (void)
 {
 	int_benchmark();
+	putchar('\n');
+	u64_benchmark();
+	putchar('\n');
+	parallel_benchmark();
 }
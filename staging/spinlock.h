@@ -34,7 +34,7 @@ static void ticketlock_unlock(struct ticketlock *lock)
 static bool ticketlock_try_lock(struct ticketlock *lock)
 {
 	unsigned int expected = atomic_load_explicit(&lock->cur, memory_order_acquire);
-	return atomic_compare_exchange_strong_explicit(&lock->next, &expected, lock->next + 1,
+	return atomic_compare_exchange_strong_explicit(&lock->next, &expected, expected + 1,
 						       memory_order_acq_rel, memory_order_relaxed);
 }
 
@@ -0,0 +1,344 @@
+#include <stdalign.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "allocator.h"
+#include "array.h"
+#include "btree.h"
+#include "dbuf.h"
+#include "dstring.h"
+#include "hashtable.h"
+#include "macros.h"
+#include "soa_array.h"
+#include "testing.h"
+
+// remembers the size of every allocation in front of it to check the sizes which are passed to deallocate
+struct counting_allocator {
+	struct allocator allocator;
+	size_t num_allocations;
+	size_t bytes_allocated;
+	size_t num_calls;
+	bool size_mismatch;
+};
+
+#define HEADER_SIZE alignof(max_align_t)
+
+static void *counting_allocate(struct allocator *allocator, size_t size)
+{
+	struct counting_allocator *a = container_of(allocator, struct counting_allocator, allocator);
+	unsigned char *p = malloc(HEADER_SIZE + size);
+	if (!p) {
+		return NULL;
+	}
+	memcpy(p, &size, sizeof(size));
+	a->num_allocations++;
+	a->bytes_allocated += size;
+	a->num_calls++;
+	return p + HEADER_SIZE;
+}
+
+static void counting_deallocate(struct allocator *allocator, void *ptr, size_t size)
+{
+	struct counting_allocator *a = container_of(allocator, struct counting_allocator, allocator);
+	unsigned char *p = (unsigned char *)ptr - HEADER_SIZE;
+	size_t allocated_size;
+	memcpy(&allocated_size, p, sizeof(allocated_size));
+	if (allocated_size != size) {
+		a->size_mismatch = true;
+	}
+	a->num_allocations--;
+	a->bytes_allocated -= allocated_size;
+	a->num_calls++;
+	free(p);
+}
+
+static void *counting_reallocate(struct allocator *allocator, void *ptr, size_t old_size, size_t new_size)
+{
+	struct counting_allocator *a = container_of(allocator, struct counting_allocator, allocator);
+	unsigned char *p = (unsigned char *)ptr - HEADER_SIZE;
+	size_t allocated_size;
+	memcpy(&allocated_size, p, sizeof(allocated_size));
+	if (allocated_size != old_size) {
+		a->size_mismatch = true;
+	}
+	p = realloc(p, HEADER_SIZE + new_size);
+	if (!p) {
+		return NULL;
+	}
+	memcpy(p, &new_size, sizeof(new_size));
+	a->bytes_allocated += new_size - allocated_size;
+	a->num_calls++;
+	return p + HEADER_SIZE;
+}
+
+static void counting_allocator_init(struct counting_allocator *a, bool with_reallocate)
+{
+	a->allocator.allocate = counting_allocate;
+	a->allocator.reallocate = with_reallocate ? counting_reallocate : NULL;
+	a->allocator.deallocate = counting_deallocate;
+	a->num_allocations = 0;
+	a->bytes_allocated = 0;
+	a->num_calls = 0;
+	a->size_mismatch = false;
+}
+
+static bool check_nothing_allocated(struct counting_allocator *a)
+{
+	CHECK(!a->size_mismatch);
+	CHECK(a->num_allocations == 0);
+	CHECK(a->bytes_allocated == 0);
+	return true;
+}
+
+SIMPLE_TEST(allocator_array)
+{
+	for (int with_reallocate = 0; with_reallocate < 2; with_reallocate++) {
+		struct counting_allocator a;
+		counting_allocator_init(&a, with_reallocate);
+		array_t(uint64_t) arr = array_new_with_allocator(uint64_t, 0, &a.allocator);
+		CHECK(arr && array_length(arr) == 0 && array_capacity(arr) == 0);
+		CHECK(a.num_allocations == 1);
+		CHECK((uintptr_t)arr % alignof(max_align_t) == 0);
+		for (uint64_t i = 0; i < 1000; i++) {
+			array_add(arr, i);
+		}
+		CHECK(a.num_allocations == 1);
+		CHECK(a.bytes_allocated >= 1000 * sizeof(arr[0]));
+		array_t(uint64_t) copy = array_copy(arr);
+		CHECK(a.num_allocations == 2);
+		CHECK((uintptr_t)copy % alignof(max_align_t) == 0);
+		CHECK(array_equal(arr, copy));
+		array_truncate(copy, 10);
+		array_shrink_to_fit(copy);
+		CHECK(array_capacity(copy) == 10);
+		array_free(copy);
+		CHECK(a.num_allocations == 1);
+		array_free(arr);
+		CHECK(!arr);
+		CHECK(check_nothing_allocated(&a));
+		CHECK(a.num_calls > 3);
+
+		// shrinking to a capacity of zero keeps the allocator (e.g. for arena-backed arrays)
+		arr = array_new_with_allocator(uint64_t, 16, &a.allocator);
+		array_shrink_to_fit(arr);
+		CHECK(arr && array_capacity(arr) == 0);
+		CHECK(a.num_allocations == 1);
+		array_add(arr, 1);
+		array_resize(arr, 0);
+		CHECK(arr && array_length(arr) == 0 && array_capacity(arr) == 0);
+		size_t num_calls = a.num_calls;
+		for (uint64_t i = 0; i < 100; i++) {
+			array_add(arr, i);
+		}
+		CHECK(a.num_calls > num_calls);
+		CHECK(a.num_allocations == 1);
+		array_free(arr);
+		CHECK(check_nothing_allocated(&a));
+
+		// the default allocator is used again after freeing
+		num_calls = a.num_calls;
+		array_add(arr, 1);
+		array_free(arr);
+		CHECK(a.num_calls == num_calls);
+	}
+	return true;
+}
+
+SIMPLE_TEST(allocator_dstring)
+{
+	for (int with_reallocate = 0; with_reallocate < 2; with_reallocate++) {
+		struct counting_allocator a;
+		counting_allocator_init(&a, with_reallocate);
+		dstr_t s = dstr_with_allocator(&a.allocator, 0);
+		CHECK(s && dstr_length(s) == 0 && s[0] == '\0');
+		CHECK(a.num_allocations == 1);
+		dstr_append_cstr(&s, "abc");
+		CHECK(strcmp(s, "abc") == 0);
+		for (size_t i = 0; i < 100000; i++) {
+			dstr_append_char(&s, 'a' + i % 26);
+		}
+		CHECK(dstr_length(s) == 100003);
+		CHECK(a.num_allocations == 1);
+		dstr_t copy = dstr_copy(s);
+		CHECK(a.num_allocations == 2);
+		CHECK(dstr_equal_dstr(s, copy));
+		// shrink from a big to a medium string and back
+		dstr_resize(&copy, 3);
+		CHECK(dstr_length(copy) == 3 && dstr_capacity(copy) == 3);
+		CHECK(strcmp(copy, "abc") == 0);
+		dstr_append_cstr(&copy, "def");
+		CHECK(strcmp(copy, "abcdef") == 0);
+		dstr_reserve(&copy, 1 << 17);
+		CHECK(strcmp(copy, "abcdef") == 0);
+		char *cstr = dstr_to_cstr(&copy);
+		CHECK(strcmp(cstr, "abcdef") == 0);
+		free(cstr);
+		CHECK(a.num_allocations == 1);
+		dstr_free(&s);
+		CHECK(check_nothing_allocated(&a));
+
+		dstr_t big = dstr_with_allocator(&a.allocator, 100000);
+		CHECK(dstr_capacity(big) == 100000);
+		dstr_append_cstr(&big, "xyz");
+		CHECK(strcmp(big, "xyz") == 0);
+		dstr_shrink_to_fit(&big);
+		CHECK(strcmp(big, "xyz") == 0 && dstr_capacity(big) == 3);
+		dstr_free(&big);
+		CHECK(check_nothing_allocated(&a));
+
+		// shrinking to a capacity of zero keeps the allocator (e.g. for arena-backed strings)
+		dstr_t empty = dstr_with_allocator(&a.allocator, 100);
+		dstr_shrink_to_fit(&empty);
+		CHECK(dstr_length(empty) == 0 && dstr_capacity(empty) == 0 && empty[0] == '\0');
+		CHECK(a.num_allocations == 1);
+		size_t num_calls = a.num_calls;
+		dstr_append_cstr(&empty, "abc");
+		dstr_resize(&empty, 0);
+		CHECK(dstr_length(empty) == 0 && empty[0] == '\0');
+		dstr_append_cstr(&empty, "def");
+		CHECK(strcmp(empty, "def") == 0);
+		CHECK(a.num_calls >= num_calls + 3);
+		CHECK(a.num_allocations == 1);
+		dstr_free(&empty);
+		CHECK(check_nothing_allocated(&a));
+	}
+	return true;
+}
+
+SIMPLE_TEST(allocator_dbuf)
+{
+	struct counting_allocator a;
+	counting_allocator_init(&a, true);
+	struct dbuf dbuf;
+	dbuf_init_with_allocator(&dbuf, &a.allocator);
+	CHECK(a.num_allocations == 0);
+	for (size_t i = 0; i < 10000; i++) {
+		dbuf_add_str(&dbuf, "abc");
+	}
+	CHECK(dbuf_size(&dbuf) == 30000);
+	CHECK(a.num_allocations == 1);
+	struct dbuf copy = dbuf_copy(&dbuf);
+	CHECK(a.num_allocations == 2);
+	CHECK(memcmp(dbuf_buffer(&copy), dbuf_buffer(&dbuf), dbuf_size(&dbuf)) == 0);
+	dbuf_resize(&copy, 0);
+	CHECK(a.num_allocations == 1);
+	size_t capacity = dbuf_capacity(&dbuf);
+	void *buffer = dbuf_finalize(&dbuf);
+	allocator_free(&a.allocator, buffer, capacity);
+	CHECK(check_nothing_allocated(&a));
+	// dbuf keeps its allocator after dbuf_finalize
+	dbuf_add_byte(&dbuf, 1);
+	CHECK(a.num_allocations == 1);
+	dbuf_destroy(&dbuf);
+	dbuf_destroy(&copy);
+	CHECK(check_nothing_allocated(&a));
+	return true;
+}
+
+static uint64_t mix(uint64_t x)
+{
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111eb;
+	return x ^ (x >> 31);
+}
+
+struct entry {
+	uint64_t key;
+	uint64_t value;
+};
+
+DEFINE_HASHTABLE(u64map, uint64_t, struct entry, 8, *key == entry->key)
+
+SIMPLE_TEST(allocator_hashtable)
+{
+	struct counting_allocator a;
+	counting_allocator_init(&a, false);
+	struct u64map map;
+	u64map_init_with_allocator(&map, 0, &a.allocator);
+	CHECK(a.num_allocations == 1);
+	for (uint64_t i = 0; i < 10000; i++) {
+		struct entry *entry = u64map_insert(&map, i, mix(i));
+		entry->key = i;
+		entry->value = 2 * i;
+	}
+	CHECK(a.num_allocations == 1);
+	for (uint64_t i = 0; i < 10000; i++) {
+		struct entry *entry = u64map_lookup(&map, i, mix(i));
+		CHECK(entry && entry->value == 2 * i);
+	}
+	for (uint64_t i = 0; i < 9990; i++) {
+		CHECK(u64map_remove(&map, i, mix(i), NULL));
+	}
+	u64map_resize(&map, 16);
+	CHECK(u64map_capacity(&map) < 10000);
+	for (uint64_t i = 9990; i < 10000; i++) {
+		struct entry *entry = u64map_lookup(&map, i, mix(i));
+		CHECK(entry && entry->value == 2 * i);
+	}
+	CHECK(a.num_allocations == 1);
+	u64map_destroy(&map);
+	CHECK(check_nothing_allocated(&a));
+	return true;
+}
+
+DEFINE_BTREE_SET(u64set, uint64_t, NULL, 15, (a < b) ? -1 : (a > b))
+
+SIMPLE_TEST(allocator_btree)
+{
+	struct counting_allocator a;
+	counting_allocator_init(&a, true);
+	struct u64set set;
+	u64set_init_with_allocator(&set, &a.allocator);
+	CHECK(a.num_allocations == 0);
+	for (uint64_t i = 0; i < 100000; i++) {
+		CHECK(u64set_insert(&set, mix(i)));
+	}
+	CHECK(a.num_allocations > 1);
+	for (uint64_t i = 0; i < 100000; i += 2) {
+		CHECK(u64set_delete(&set, mix(i), NULL));
+	}
+	CHECK(!a.size_mismatch);
+	struct _btree copy = _btree_debug_copy(&set._impl, &u64set_info);
+	size_t num_allocations = a.num_allocations;
+	for (uint64_t i = 1; i < 100000; i += 2) {
+		CHECK(u64set_delete(&set, mix(i), NULL));
+	}
+	CHECK(set._impl.height == 0);
+	CHECK(a.num_allocations == num_allocations / 2);
+	_btree_destroy(&copy, &u64set_info);
+	CHECK(check_nothing_allocated(&a));
+
+	for (uint64_t i = 0; i < 1000; i++) {
+		CHECK(u64set_insert(&set, i));
+	}
+	u64set_destroy(&set);
+	CHECK(check_nothing_allocated(&a));
+	return true;
+}
+
+DEFINE_SOA_ARRAY(points, (uint32_t, key), (double, value))
+DEFINE_SOA_SORT(points_sort_by_key, points, key, (*a > *b) - (*a < *b))
+
+SIMPLE_TEST(allocator_soa_array)
+{
+	struct counting_allocator a;
+	counting_allocator_init(&a, true);
+	struct points p;
+	points_init_with_allocator(&p, &a.allocator);
+	for (uint32_t i = 0; i < 1000; i++) {
+		points_push(&p, mix(i) % 100, i);
+	}
+	CHECK(a.num_allocations == 2);
+	// the temporary buffers of the sort also come from the allocator (two per column and two for the sort)
+	size_t num_calls = a.num_calls;
+	points_sort_by_key(&p);
+	CHECK(a.num_calls == num_calls + 2 * 2 + 4);
+	CHECK(a.num_allocations == 2 && !a.size_mismatch);
+	for (size_t i = 1; i < points_length(&p); i++) {
+		CHECK(p.key[i - 1] <= p.key[i]);
+	}
+	points_destroy(&p);
+	CHECK(check_nothing_allocated(&a));
+	return true;
+}
@@ -14,6 +14,12 @@
 
 // TODO test fortify failures
 
+// the header only stores the length and the capacity (the allocator of array_new_with_allocator is stored in front
+// of it), so arrays without an allocator do not pay for it
+#ifndef __FORTIFY_ENABLED
+_Static_assert(sizeof(_arr) == 2 * sizeof(size_t), "");
+#endif
+
 static _attr_unused void print_array(int *arr, bool print_reverse)
 {
 	size_t len = array_length(arr);
@@ -534,3 +540,70 @@ SIMPLE_TEST(array)
 #endif
 	return true;
 }
+
+// (check_array_content cannot be used because the inline storage is not allocated with malloc)
+static bool check_iota(const int *arr, size_t length)
+{
+	CHECK(array_length(arr) == length);
+	CHECK(array_capacity(arr) >= length);
+	for (size_t i = 0; i < length; i++) {
+		CHECK(arr[i] == (int)i);
+	}
+	return true;
+}
+
+struct small_array_owner {
+	array_small_storage(int, 4) storage;
+	array_t(int) arr;
+};
+
+SIMPLE_TEST(array_small)
+{
+	array_small_storage(int, 8) storage;
+	array_t(int) arr = array_new_small(storage);
+	CHECK(arr == storage._items);
+	CHECK(array_length(arr) == 0 && array_capacity(arr) == 8);
+	for (int i = 0; i < 8; i++) {
+		array_add(arr, i);
+	}
+	CHECK(arr == storage._items);
+	CHECK(check_iota(arr, 8));
+
+	// shrinking keeps the inline storage
+	array_shrink_to_fit(arr);
+	array_resize(arr, 4);
+	CHECK(arr == storage._items);
+	CHECK(check_iota(arr, 4));
+	for (int i = 4; i < 8; i++) {
+		array_add(arr, i);
+	}
+
+	// growing beyond the inline capacity moves the elements to the heap
+	array_add(arr, 8);
+	CHECK(arr != storage._items);
+	CHECK(array_capacity(arr) > 8);
+	CHECK(check_iota(arr, 9));
+	array_free(arr);
+	CHECK(!arr);
+
+	arr = array_new_small(storage);
+	int *p = array_insertn(arr, 0, 20);
+	CHECK(p == arr && array_length(arr) == 20 && arr != storage._items);
+	array_free(arr);
+
+	arr = array_new_small(storage);
+	array_add(arr, 1);
+	array_t(int) copy = array_copy(arr);
+	CHECK(copy != arr && array_equal(copy, arr));
+	array_free(copy);
+	array_free(arr);
+
+	struct small_array_owner owner;
+	owner.arr = array_new_small(owner.storage);
+	for (int i = 0; i < 100; i++) {
+		array_add(owner.arr, i);
+	}
+	CHECK(array_length(owner.arr) == 100 && owner.arr[99] == 99);
+	array_free(owner.arr);
+	return true;
+}
@@ -0,0 +1,189 @@
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "array.h"
+#include "array_ops.h"
+#include "random.h"
+#include "simd.h"
+#include "testing.h"
+
+#define COMPARE(cmp, a, b)						\
+	((cmp) == ARRAY_CMP_EQ ? (a) == (b) :				\
+	 (cmp) == ARRAY_CMP_NE ? (a) != (b) :				\
+	 (cmp) == ARRAY_CMP_LT ? (a) < (b) :				\
+	 (cmp) == ARRAY_CMP_LE ? (a) <= (b) :				\
+	 (cmp) == ARRAY_CMP_GT ? (a) > (b) :				\
+	 (a) >= (b))
+
+// small values (lots of duplicates) or any value of the type, floats get a NaN now and then
+#define DEFINE_CHECK(name, type, sum_type, is_float)			\
+	static type random_##name(struct random_state *rng, bool small)	\
+	{								\
+		uint64_t r = random_next_u64(rng);			\
+		if (is_float && r % 64 == 0) {				\
+			return (type)NAN;				\
+		}							\
+		if (small || is_float) {				\
+			return (type)((int64_t)(r % 16) - 8);		\
+		}							\
+		return (type)r;						\
+	}								\
+									\
+	static bool check_##name(struct random_state *rng, size_t n)	\
+	{								\
+		bool small = random_next_u32(rng) % 2;			\
+		array_t(type) a = NULL;					\
+		bool has_nan = false;					\
+		for (size_t i = 0; i < n; i++) {			\
+			type x = random_##name(rng, small);		\
+			has_nan |= x != x;				\
+			array_add(a, x);				\
+		}							\
+									\
+		if (n != 0 && !has_nan) {				\
+			type min = a[0], max = a[0];			\
+			sum_type sum = 0;				\
+			for (size_t i = 0; i < n; i++) {		\
+				min = a[i] < min ? a[i] : min;		\
+				max = a[i] > max ? a[i] : max;		\
+				/* the integer sums wrap around */	\
+				sum = is_float ? (sum_type)((double)sum + (double)a[i]) : \
+					(sum_type)((uint64_t)sum + (uint64_t)a[i]); \
+			}						\
+			CHECK(array_min(a) == min);			\
+			CHECK(array_max(a) == max);			\
+			CHECK(array_sum(a) == sum);			\
+		}							\
+									\
+		for (enum array_cmp cmp = ARRAY_CMP_EQ; cmp <= ARRAY_CMP_GE; cmp++) { \
+			type value = n != 0 && random_next_u32(rng) % 2 ? a[random_next_u64(rng) % n] : \
+				random_##name(rng, small);		\
+			size_t first = n;				\
+			size_t count = 0;				\
+			for (size_t i = 0; i < n; i++) {		\
+				if (COMPARE(cmp, a[i], value)) {	\
+					first = first == n ? i : first;	\
+					count++;			\
+				}					\
+			}						\
+			CHECK(array_find(a, cmp, value) == first);	\
+			CHECK(array_count(a, cmp, value) == count);	\
+									\
+			array_t(type) b = array_copy(a);		\
+			CHECK(array_filter(b, cmp, value) == count);	\
+			CHECK(array_length(b) == count);		\
+			size_t k = 0;					\
+			for (size_t i = 0; i < n; i++) {		\
+				if (COMPARE(cmp, a[i], value)) {	\
+					CHECK(memcmp(&b[k], &a[i], sizeof(type)) == 0); \
+					k++;				\
+				}					\
+			}						\
+			array_free(b);					\
+		}							\
+		array_free(a);						\
+		return true;						\
+	}
+
+DEFINE_CHECK(i32, int32_t, int64_t, false)
+DEFINE_CHECK(u32, uint32_t, uint64_t, false)
+DEFINE_CHECK(i64, int64_t, int64_t, false)
+DEFINE_CHECK(u64, uint64_t, uint64_t, false)
+DEFINE_CHECK(f32, float, double, true)
+DEFINE_CHECK(f64, double, double, true)
+
+struct triple {
+	uint32_t a, b, c;
+};
+
+static bool check_gather(struct random_state *rng, size_t n)
+{
+	array_t(uint32_t) i32 = NULL;
+	array_t(uint64_t) i64 = NULL;
+	array_t(struct triple) t = NULL;
+	array_t(uint32_t) idx32 = NULL;
+	array_t(uint64_t) idx64 = NULL;
+	for (size_t i = 0; i < n; i++) {
+		array_add(i32, (uint32_t)i);
+		array_add(i64, (uint64_t)i << 32);
+		array_add(t, ((struct triple){i, i + 1, i + 2}));
+	}
+	size_t m = n == 0 ? 0 : random_next_u32(rng) % (2 * n);
+	for (size_t i = 0; i < m; i++) {
+		uint32_t j = random_next_u64(rng) % n;
+		array_add(idx32, j);
+		array_add(idx64, j);
+	}
+
+	array_t(uint32_t) out32 = NULL;
+	array_t(uint64_t) out64 = NULL;
+	array_t(struct triple) out_t = NULL;
+	array_add(out32, 12345);
+	array_gather(out32, i32, idx32);
+	array_gather(out64, i64, idx64);
+	array_gather(out_t, t, idx32);
+	array_gather(out_t, t, idx64);
+	CHECK(array_length(out32) == m + 1 && out32[0] == 12345);
+	CHECK(array_length(out64) == m);
+	CHECK(array_length(out_t) == 2 * m);
+	for (size_t i = 0; i < m; i++) {
+		CHECK(out32[i + 1] == idx32[i]);
+		CHECK(out64[i] == (uint64_t)idx32[i] << 32);
+		CHECK(out_t[i].a == idx32[i] && out_t[i].c == idx32[i] + 2);
+		CHECK(out_t[m + i].b == idx32[i] + 1);
+	}
+
+	// gather from the destination array (which might be reallocated)
+	array_gather(i32, i32, idx64);
+	CHECK(array_length(i32) == n + m);
+	for (size_t i = 0; i < m; i++) {
+		CHECK(i32[n + i] == idx32[i]);
+	}
+
+	array_free(i32);
+	array_free(i64);
+	array_free(t);
+	array_free(idx32);
+	array_free(idx64);
+	array_free(out32);
+	array_free(out64);
+	array_free(out_t);
+	return true;
+}
+
+RANDOM_TEST(array_ops, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	// check the scalar, SSE2 and AVX2 implementations (if the CPU supports them)
+	for (int level = _SIMD_NONE; level <= _SIMD_AVX2; level++) {
+		_simd_limit(level);
+		for (size_t i = 0; i < 220; i++) {
+			// all short lengths (the tails of the vector loops) and a few long arrays
+			size_t n = i < 200 ? i : random_next_u32(&rng) % 10000;
+			CHECK(check_i32(&rng, n));
+			CHECK(check_u32(&rng, n));
+			CHECK(check_i64(&rng, n));
+			CHECK(check_u64(&rng, n));
+			CHECK(check_f32(&rng, n));
+			CHECK(check_f64(&rng, n));
+		}
+	}
+	_simd_limit(_SIMD_AVX2);
+
+	for (size_t i = 0; i < 100; i++) {
+		CHECK(check_gather(&rng, i < 50 ? i : random_next_u32(&rng) % 10000));
+	}
+
+	// the lanes of the count are flushed every 65536 vectors
+	array_t(int32_t) a = NULL;
+	int32_t *zeros = array_addn_zero(a, 3000000);
+	zeros[1234567] = 1;
+	CHECK(array_count_eq(a, 0) == 2999999);
+	CHECK(array_find_ge(a, 1) == 1234567);
+	CHECK(array_find_eq(a, 2) == 3000000);
+	array_free(a);
+	return true;
+}
@@ -117,6 +117,13 @@ static btree_key_t get_key(btree_key_t *keys, size_t x)
 }
 #endif
 
+static int compare_size_t(const void *_a, const void *_b)
+{
+	size_t a = *(const size_t *)_a;
+	size_t b = *(const size_t *)_b;
+	return (a < b) ? -1 : (a > b);
+}
+
 // TODO split this up into multiple test functions?
 // (would probably have to make keys global with pthread_once)
 
@@ -542,6 +549,69 @@ static bool btree_set_test(uint64_t random)
 
 	CHECK(btree._impl.height == 0);
 
+	btable_init(&btable, N);
+	for (size_t round = 0; round < 64; round++) {
+		const size_t BATCH_SIZE = 512;
+		size_t xs[BATCH_SIZE];
+		for (size_t i = 0; i < BATCH_SIZE; i++) {
+			xs[i] = random_next_u64(&rng) % LIMIT;
+		}
+		if (round % 8 != 7) {
+			qsort(xs, BATCH_SIZE, sizeof(xs[0]), compare_size_t);
+		}
+#ifdef STRING_MAP
+		btree_item_t items[BATCH_SIZE];
+#else
+		btree_key_t items[BATCH_SIZE];
+#endif
+		size_t num_new = 0;
+		for (size_t i = 0; i < BATCH_SIZE; i++) {
+			btree_key_t key = get_key(keys, xs[i]);
+#ifdef STRING_MAP
+			items[i] = (btree_item_t){.key = key, .value = xs[i]};
+#else
+			items[i] = key;
+#endif
+			if (!btable_lookup(&btable, key, get_hash(key))) {
+				*btable_insert(&btable, key, get_hash(key)) = key;
+				num_new++;
+			}
+		}
+		CHECK(btree_insert_batch(&btree, items, BATCH_SIZE) == num_new);
+		CHECK(btree_check(&btree, &btree_info));
+		for (size_t i = 0; i < BATCH_SIZE; i++) {
+#ifdef STRING_MAP
+			btree_value_t *value = btree_find(&btree, items[i].key);
+			CHECK(value && *value == xs[i]);
+#else
+			CHECK(btree_find(&btree, items[i]));
+#endif
+		}
+	}
+	{
+		size_t count = 0;
+		btree_iter_t iter;
+#ifdef STRING_MAP
+		btree_key_t key;
+		for (btree_value_t *value = btree_iter_start_leftmost(&iter, &btree, &key);
+		     value;
+		     value = btree_iter_next(&iter, &key)) {
+			CHECK(btable_lookup(&btable, key, get_hash(key)));
+			count++;
+		}
+#else
+		for (const btree_key_t *key = btree_iter_start_leftmost(&iter, &btree);
+		     key;
+		     key = btree_iter_next(&iter)) {
+			CHECK(btable_lookup(&btable, *key, get_hash(*key)));
+			count++;
+		}
+#endif
+		CHECK(count == btable_num_entries(&btable));
+	}
+	btree_destroy(&btree);
+	btable_destroy(&btable);
+
 	destroy_keys(keys, num_keys);
 
 	return true;
@@ -0,0 +1,226 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "disk_btree.h"
+#include "random.h"
+#include "testing.h"
+
+DEFINE_DISK_BTREE_SET(dset, uint64_t, a < b ? -1 : a > b)
+DEFINE_DISK_BTREE_MAP(dmap, uint32_t, uint64_t, a < b ? -1 : a > b)
+
+static bool create_temp_file(char *path)
+{
+	strcpy(path, "/tmp/adlib_disk_btree_XXXXXX");
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		return false;
+	}
+	close(fd);
+	return true;
+}
+
+/* the keys are even, so key + 1 and key - 1 are never in the tree */
+static bool check_set(const char *path, const uint64_t *keys, size_t n)
+{
+	CHECK(dset_build(path, keys, n));
+	struct dset set;
+	CHECK(dset_open(&set, path));
+	CHECK(dset_num_items(&set) == n);
+
+	for (size_t i = 0; i < n; i++) {
+		const uint64_t *key = dset_find(&set, keys[i]);
+		CHECK(key && *key == keys[i]);
+		CHECK(!dset_find(&set, keys[i] + 1));
+		CHECK(!dset_find(&set, keys[i] - 1));
+	}
+
+	dset_iter_t iter;
+	size_t i = 0;
+	for (const uint64_t *key = dset_iter_start_leftmost(&iter, &set); key; key = dset_iter_next(&iter)) {
+		CHECK(i < n && *key == keys[i]);
+		i++;
+	}
+	CHECK(i == n);
+	CHECK(!dset_iter_next(&iter));
+	for (const uint64_t *key = dset_iter_start_rightmost(&iter, &set); key; key = dset_iter_prev(&iter)) {
+		CHECK(i > 0 && *key == keys[--i]);
+	}
+	CHECK(i == 0);
+
+	for (i = 0; i < n; i++) {
+		const uint64_t *key = dset_iter_start_at(&iter, &set, keys[i], BTREE_ITER_FIND_KEY);
+		CHECK(key && *key == keys[i]);
+		key = dset_iter_next(&iter);
+		CHECK(i == n - 1 ? !key : *key == keys[i + 1]);
+		CHECK(!dset_iter_start_at(&iter, &set, keys[i] + 1, BTREE_ITER_FIND_KEY));
+
+		key = dset_iter_start_at(&iter, &set, keys[i], BTREE_ITER_LOWER_BOUND_INCLUSIVE);
+		CHECK(key && *key == keys[i]);
+		key = dset_iter_start_at(&iter, &set, keys[i], BTREE_ITER_LOWER_BOUND_EXCLUSIVE);
+		CHECK(i == n - 1 ? !key : *key == keys[i + 1]);
+		key = dset_iter_start_at(&iter, &set, keys[i] + 1, BTREE_ITER_LOWER_BOUND_INCLUSIVE);
+		CHECK(i == n - 1 ? !key : *key == keys[i + 1]);
+		key = dset_iter_start_at(&iter, &set, keys[i] - 1, BTREE_ITER_LOWER_BOUND_EXCLUSIVE);
+		CHECK(key && *key == keys[i]);
+
+		key = dset_iter_start_at(&iter, &set, keys[i], BTREE_ITER_UPPER_BOUND_INCLUSIVE);
+		CHECK(key && *key == keys[i]);
+		key = dset_iter_start_at(&iter, &set, keys[i], BTREE_ITER_UPPER_BOUND_EXCLUSIVE);
+		CHECK(i == 0 ? !key : *key == keys[i - 1]);
+		key = dset_iter_start_at(&iter, &set, keys[i] - 1, BTREE_ITER_UPPER_BOUND_INCLUSIVE);
+		CHECK(i == 0 ? !key : *key == keys[i - 1]);
+		key = dset_iter_start_at(&iter, &set, keys[i] + 1, BTREE_ITER_UPPER_BOUND_EXCLUSIVE);
+		CHECK(key && *key == keys[i]);
+		key = dset_iter_prev(&iter);
+		CHECK(i == 0 ? !key : *key == keys[i - 1]);
+	}
+
+	dset_close(&set);
+	return true;
+}
+
+RANDOM_TEST(disk_btree, random_seed, 2)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	char path[64];
+	CHECK(create_temp_file(path));
+
+	size_t max_keys = 200000;
+	uint64_t *keys = malloc(max_keys * sizeof(keys[0]));
+	keys[0] = 2 + 2 * (random_next_u32(&rng) % 16);
+	for (size_t i = 1; i < max_keys; i++) {
+		keys[i] = keys[i - 1] + 2 + 2 * (random_next_u32(&rng) % 16);
+	}
+
+	size_t leaf_capacity = dset_info.leaf_capacity;
+	size_t sizes[] = {0, 1, 2, leaf_capacity - 1, leaf_capacity, leaf_capacity + 1, 3 * leaf_capacity + 7,
+			  max_keys};
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		CHECK(check_set(path, keys, sizes[i]));
+	}
+
+	struct dset set;
+	CHECK(dset_open(&set, path));
+	CHECK(set._impl.height == 3);
+	dset_close(&set);
+
+	// the items have to be sorted and unique
+	dset_builder_t builder;
+	CHECK(dset_builder_start(&builder, path));
+	CHECK(dset_builder_add(&builder, 2));
+	CHECK(!dset_builder_add(&builder, 2));
+	CHECK(errno == EINVAL);
+	CHECK(!dset_builder_add(&builder, 4));
+	CHECK(!dset_builder_finish(&builder));
+	CHECK(!dset_open(&set, path));
+
+	// a map file cannot be opened as a set (different item size)
+	CHECK(dmap_builder_start(&builder, path));
+	for (uint32_t i = 0; i < max_keys; i++) {
+		CHECK(dmap_builder_add(&builder, 3 * i, keys[i]));
+	}
+	CHECK(dmap_builder_finish(&builder));
+	CHECK(!dset_open(&set, path));
+	CHECK(errno == EINVAL);
+
+	struct dmap map = DISK_BTREE_EMPTY;
+	CHECK(dmap_open(&map, path));
+	CHECK(dmap_num_items(&map) == max_keys);
+	for (uint32_t i = 0; i < max_keys; i++) {
+		const uint64_t *value = dmap_find(&map, 3 * i);
+		CHECK(value && *value == keys[i]);
+		CHECK(!dmap_find(&map, 3 * i + 1));
+	}
+	dmap_iter_t iter;
+	uint32_t key;
+	size_t i = 0;
+	for (const uint64_t *value = dmap_iter_start_leftmost(&iter, &map, &key); value;
+	     value = dmap_iter_next(&iter, &key)) {
+		CHECK(key == 3 * i && *value == keys[i]);
+		i++;
+	}
+	CHECK(i == max_keys);
+	const uint64_t *value = dmap_iter_start_at(&iter, &map, 3 * 1000 + 2, &key, BTREE_ITER_UPPER_BOUND_INCLUSIVE);
+	CHECK(value && key == 3 * 1000 && *value == keys[1000]);
+	value = dmap_iter_start_rightmost(&iter, &map, &key);
+	CHECK(value && key == 3 * (max_keys - 1) && *value == keys[max_keys - 1]);
+	dmap_close(&map);
+
+	free(keys);
+	unlink(path);
+	return true;
+}
+
+static bool write_at(const char *path, const void *data, size_t size, off_t offset)
+{
+	int fd = open(path, O_WRONLY);
+	CHECK(fd >= 0);
+	CHECK(pwrite(fd, data, size, offset) == (ssize_t)size);
+	close(fd);
+	return true;
+}
+
+SIMPLE_TEST(disk_btree_corrupt)
+{
+	char path[64];
+	CHECK(create_temp_file(path));
+	size_t n = 100000;
+	uint64_t *keys = malloc(n * sizeof(keys[0]));
+	for (size_t i = 0; i < n; i++) {
+		keys[i] = 2 * i;
+	}
+	CHECK(dset_build(path, keys, n));
+	struct dset set;
+	CHECK(dset_open(&set, path));
+	struct _disk_btree_header header = *(const struct _disk_btree_header *)set._impl.map;
+	dset_close(&set);
+	CHECK(header.height >= 2);
+
+	// a child page number after the end of the file
+	uint32_t child = UINT32_MAX;
+	size_t children_offset = (dset_info.inner_capacity * dset_info.key_size + 3) & ~(size_t)3;
+	off_t root_offset = (off_t)header.root * DISK_BTREE_PAGE_SIZE;
+	CHECK(write_at(path, &child, sizeof(child), root_offset + sizeof(struct _disk_btree_page) + children_offset));
+	CHECK(dset_open(&set, path));
+	dset_iter_t iter;
+	CHECK(!dset_find(&set, keys[0]));
+	CHECK(!dset_iter_start_at(&iter, &set, keys[0], BTREE_ITER_LOWER_BOUND_INCLUSIVE));
+	CHECK(dset_find(&set, keys[n - 1]));
+	dset_close(&set);
+
+	// too many items in the first and the last leaf
+	CHECK(dset_build(path, keys, n));
+	uint16_t num_items = UINT16_MAX;
+	CHECK(write_at(path, &num_items, sizeof(num_items), DISK_BTREE_PAGE_SIZE));
+	CHECK(write_at(path, &num_items, sizeof(num_items), (off_t)header.num_leaves * DISK_BTREE_PAGE_SIZE));
+	CHECK(dset_open(&set, path));
+	CHECK(!dset_find(&set, keys[0]));
+	CHECK(!dset_find(&set, keys[n - 1]));
+	CHECK(dset_find(&set, keys[n / 2]));
+	CHECK(!dset_iter_start_leftmost(&iter, &set));
+	CHECK(!dset_iter_start_rightmost(&iter, &set));
+	size_t count = 0;
+	for (const uint64_t *key = dset_iter_start_at(&iter, &set, keys[n / 2], BTREE_ITER_FIND_KEY); key;
+	     key = dset_iter_next(&iter)) {
+		count++;
+	}
+	CHECK(count > 0 && count < n / 2);
+	dset_close(&set);
+
+	// the root has to be an inner node
+	CHECK(dset_build(path, keys, n));
+	header.root = 1;
+	CHECK(write_at(path, &header, sizeof(header), 0));
+	CHECK(!dset_open(&set, path));
+	CHECK(errno == EINVAL);
+
+	free(keys);
+	unlink(path);
+	return true;
+}
@@ -3,6 +3,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include "dstring.h"
+#include "random.h"
+#include "simd.h"
 #include "testing.h"
 
 #ifdef HAVE_MALLOC_USABLE_SIZE
@@ -2465,6 +2467,14 @@ SIMPLE_TEST(dstring_reserve)
 	dstr_reserve(&dstr, UINT16_MAX + 1);
 	CHECK(sanity_check(dstr));
 	dstr_free(&dstr);
+	// a length of UINT8_MAX must not be stored in a small header
+	dstr = dstr_with_capacity(UINT8_MAX);
+	for (size_t i = 0; i < UINT8_MAX; i++) {
+		dstr_append_char(&dstr, 'a');
+	}
+	CHECK(dstr_length(dstr) == UINT8_MAX);
+	CHECK(sanity_check(dstr));
+	dstr_free(&dstr);
 	return true;
 }
 
@@ -3195,6 +3205,145 @@ SIMPLE_TEST(strview_split)
 	return true;
 }
 
+static bool in_set(const char *set, char c)
+{
+	for (; *set != '\0'; set++) {
+		if (*set == c) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static size_t naive_find_of(struct strview view, const char *set, bool reject, bool reverse, size_t pos)
+{
+	size_t i = reverse ? (pos < view.length ? pos + 1 : view.length) : pos;
+	while (reverse ? i-- > 0 : i < view.length) {
+		if (in_set(set, view.characters[i]) != reject) {
+			return i;
+		}
+		i += !reverse;
+	}
+	return STRVIEW_NPOS;
+}
+
+static size_t naive_find(struct strview haystack, struct strview needle, size_t pos)
+{
+	for (size_t i = pos; i + needle.length <= haystack.length; i++) {
+		if (memcmp(haystack.characters + i, needle.characters, needle.length) == 0) {
+			return i;
+		}
+	}
+	return STRVIEW_NPOS;
+}
+
+static bool check_split_any(struct strview view, const char *delimiters, size_t max)
+{
+	struct strview_list list = strview_split_any(view, delimiters, max);
+	size_t start = 0;
+	for (size_t i = 0; i < list.count; i++) {
+		size_t end = naive_find_of(view, delimiters, false, false, start);
+		end = end == STRVIEW_NPOS ? view.length : end;
+		CHECK(list.strings[i].characters == view.characters + start && list.strings[i].length == end - start);
+		start = end + 1;
+	}
+	CHECK(list.count == max || start == view.length + 1);
+	strview_list_free(&list);
+	return true;
+}
+
+RANDOM_TEST(strview_find_simd, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	static char buf[5000];
+	// a few characters to have lots of matches, '\0' and some bytes >= 128
+	static const char alphabet[] = "ab\xff\x80\x7f\x00 \t";
+
+	// check the scalar, SSE2 and AVX2 implementations (if the CPU supports them)
+	for (int level = _SIMD_NONE; level <= _SIMD_AVX2; level++) {
+		_simd_limit(level);
+		for (size_t i = 0; i < 300; i++) {
+			// all short lengths (the tails of the vector loops) and a few long strings
+			size_t n = i < 200 ? i : random_next_u32(&rng) % sizeof(buf);
+			uint32_t r = random_next_u32(&rng);
+			for (size_t k = 0; k < n; k++) {
+				buf[k] = r % 4 == 0 ? (char)random_next_u32(&rng) :
+					alphabet[random_next_u32(&rng) % (sizeof(alphabet) - 1)];
+			}
+			struct strview view = strview_from_chars(buf, n);
+
+			// up to 12 characters (more than the SSE2 version handles), some of them duplicates
+			char set[13];
+			size_t set_length = random_next_u32(&rng) % 13;
+			for (size_t k = 0; k < set_length; k++) {
+				char c = r % 2 == 0 ? (char)random_next_u32(&rng) :
+					alphabet[random_next_u32(&rng) % (sizeof(alphabet) - 1)];
+				set[k] = c == '\0' ? 'a' : c;
+			}
+			set[set_length] = '\0';
+			size_t pos = random_next_u32(&rng) % (n + 2);
+			if (r % 8 == 1) {
+				pos = STRVIEW_NPOS;
+			}
+			if (pos <= n) {
+				CHECK(strview_find_first_of(view, set, pos) == naive_find_of(view, set, false, false, pos));
+				CHECK(strview_find_first_not_of(view, set, pos) == naive_find_of(view, set, true, false, pos));
+			}
+			CHECK(strview_find_last_of(view, set, pos) == naive_find_of(view, set, false, true, pos));
+			CHECK(strview_find_last_not_of(view, set, pos) == naive_find_of(view, set, true, true, pos));
+			CHECK(check_split_any(view, set, r % 16 == 2 ? random_next_u32(&rng) % 4 : SIZE_MAX));
+
+			// needles from the string (found) and random ones (mostly not found)
+			size_t needle_length = random_next_u32(&rng) % 8;
+			struct strview needle;
+			if (r % 2 == 0 && n >= needle_length) {
+				needle = strview_substring(view, random_next_u32(&rng) % (n - needle_length + 1), needle_length);
+			} else {
+				static char needle_buf[8];
+				for (size_t k = 0; k < needle_length; k++) {
+					needle_buf[k] = alphabet[random_next_u32(&rng) % (sizeof(alphabet) - 1)];
+				}
+				needle = strview_from_chars(needle_buf, needle_length);
+			}
+			pos = random_next_u32(&rng) % (n + 1);
+			CHECK(strview_find(view, needle, pos) == naive_find(view, needle, pos));
+		}
+
+		// few matches far away from the start and the end (to get past the scalar prefix)
+		for (size_t i = 0; i < 200; i++) {
+			size_t n = random_next_u32(&rng) % sizeof(buf);
+			memset(buf, 'x', n);
+			for (size_t k = random_next_u32(&rng) % 3; k > 0 && n > 0; k--) {
+				buf[random_next_u32(&rng) % n] = (char)(0x80 | random_next_u32(&rng));
+			}
+			struct strview view = strview_from_chars(buf, n);
+			static const char *sets[] = {"x", "xa", "x\xff\x80 ", "abcdefghijklmnopqrstuvwx"};
+			const char *set = sets[i % 4];
+			CHECK(strview_find_first_not_of(view, set, 0) == naive_find_of(view, set, true, false, 0));
+			CHECK(strview_find_last_not_of(view, set, STRVIEW_NPOS) ==
+			      naive_find_of(view, set, true, true, STRVIEW_NPOS));
+			for (size_t k = 0; k < n; k++) {
+				buf[k] = buf[k] == 'x' ? 'y' : 'x';
+			}
+			CHECK(strview_find_first_of(view, "x", 0) == naive_find_of(view, "x", false, false, 0));
+			CHECK(strview_find_last_of(view, "x", STRVIEW_NPOS) ==
+			      naive_find_of(view, "x", false, true, STRVIEW_NPOS));
+			CHECK(check_split_any(view, "x\t", SIZE_MAX));
+		}
+
+		// a candidate at every position
+		size_t n = sizeof(buf);
+		memset(buf, 'a', n);
+		struct strview view = strview_from_chars(buf, n);
+		CHECK(strview_find_cstr(view, "aabaa", 0) == STRVIEW_NPOS);
+		buf[n - 3] = 'b';
+		CHECK(strview_find_cstr(view, "aabaa", 0) == n - 5);
+	}
+	_simd_limit(_SIMD_AVX2);
+	return true;
+}
+
 #if _FORTIFY_SOURCE >= 1 && (defined(HAVE_BUILTIN_DYNAMIC_OBJECT_SIZE) || defined(HAVE_BUILTIN_OBJECT_SIZE))
 
 NEGATIVE_SIMPLE_TEST(fortify_from_chars)
@@ -1,4 +1,5 @@
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include "heap.h"
@@ -108,3 +109,164 @@ SIMPLE_TEST(heap)
 
 	return true;
 }
+
+DEFINE_DHEAP(int3heap, int, 3, *a < *b)
+DEFINE_DHEAP(int4heap, int, 4, *a < *b)
+DEFINE_DHEAP(int8heap, int, 8, *a < *b)
+
+#define DEFINE_DHEAP_TEST(name)						\
+	static bool name##_random_test(int *arr, size_t n, struct random_state *rng) \
+	{								\
+		for (size_t i = 0; i < n; i++) {			\
+			arr[i] = (int)random_next_u64_in_range(rng, 0, (3 * (n + 1)) / 4); \
+		}							\
+		name##_heapify(arr, n);					\
+		CHECK(name##_is_heap(arr, n));				\
+		int last = INT_MIN;					\
+		for (size_t i = 0; i < n; i++) {			\
+			int min = name##_extract_first(arr, n - i);	\
+			CHECK(last <= min);				\
+			last = min;					\
+			arr[n - 1 - i] = min;				\
+			CHECK(name##_is_heap(arr, n - i - 1));		\
+		}							\
+		for (size_t i = 0; i < n; i++) {			\
+			arr[i] = (int)random_next_u64(rng);		\
+			name##_insert(arr, i);				\
+			CHECK(name##_is_heap_until(arr, i + 1) == i + 1); \
+		}							\
+		for (size_t i = 0; i < n; i++) {			\
+			int old = arr[i];				\
+			arr[i] = (int)random_next_u64(rng);		\
+			if (arr[i] > old) {				\
+				name##_sift_down(arr, n, i);		\
+			} else {					\
+				name##_sift_up(arr, n, i);		\
+			}						\
+		}							\
+		CHECK(name##_is_heap(arr, n));				\
+		name##_sort(arr, n);					\
+		for (size_t i = 1; i < n; i++) {			\
+			CHECK(arr[i - 1] >= arr[i]);			\
+		}							\
+		name##_heapify(arr, n);					\
+		for (size_t i = 0; i < n; i++) {			\
+			size_t idx = random_next_u64_in_range(rng, 0, n - i - 1); \
+			name##_delete(arr, n - i, idx);			\
+			CHECK(name##_is_heap(arr, n - i - 1));		\
+		}							\
+		return true;						\
+	}
+
+DEFINE_DHEAP_TEST(int3heap)
+DEFINE_DHEAP_TEST(int4heap)
+DEFINE_DHEAP_TEST(int8heap)
+
+RANDOM_TEST(dheap_random, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	const size_t n = 600;
+	int *arr = int4heap_alloc(n);
+	CHECK(arr);
+	// the children of the root (and all other sibling groups) start at a cache line boundary
+	CHECK((uintptr_t)&arr[1] % DHEAP_CACHE_LINE_SIZE == 0);
+	for (size_t i = 0; i <= n; i++) {
+		CHECK(int3heap_random_test(arr, i, &rng));
+		CHECK(int4heap_random_test(arr, i, &rng));
+		CHECK(int8heap_random_test(arr, i, &rng));
+	}
+	int4heap_free(arr);
+	int8heap_free(NULL);
+	return true;
+}
+
+struct heap_entry {
+	int key;
+	size_t index;
+};
+
+static void set_heap_entry_index(struct heap_entry **entry, size_t index)
+{
+	(*entry)->index = index;
+}
+
+DEFINE_ADDRESSABLE_HEAP(entryheap, struct heap_entry *, set_heap_entry_index, (*a)->key < (*b)->key)
+
+static bool check_entry_indices(struct heap_entry **arr, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		CHECK(arr[i]->index == i);
+	}
+	return entryheap_is_heap(arr, n);
+}
+
+RANDOM_TEST(addressable_heap, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	const size_t num_entries = 1024;
+	struct heap_entry *entries = malloc(num_entries * sizeof(entries[0]));
+	struct heap_entry **arr = malloc(num_entries * sizeof(arr[0]));
+	for (size_t i = 0; i < num_entries; i++) {
+		entries[i].key = (int)random_next_u64_in_range(&rng, 0, 1000);
+		arr[i] = &entries[i];
+	}
+	entryheap_heapify(arr, num_entries);
+	CHECK(check_entry_indices(arr, num_entries));
+
+	size_t n = num_entries;
+	for (size_t round = 0; round < 20000; round++) {
+		struct heap_entry *entry = &entries[random_next_u64_in_range(&rng, 0, num_entries - 1)];
+		bool in_heap = entry->index < n && arr[entry->index] == entry;
+		switch (random_next_u32(&rng) % 5) {
+		case 0:
+			if (in_heap) {
+				entry->key -= (int)random_next_u64_in_range(&rng, 0, 100);
+				entryheap_decrease_key(arr, n, entry->index);
+			}
+			break;
+		case 1:
+			if (in_heap) {
+				entry->key += (int)random_next_u64_in_range(&rng, 0, 100);
+				entryheap_increase_key(arr, n, entry->index);
+			}
+			break;
+		case 2:
+			if (in_heap) {
+				entry->key = (int)random_next_u64_in_range(&rng, 0, 1000);
+				entryheap_update(arr, n, entry->index);
+			}
+			break;
+		case 3:
+			if (in_heap) {
+				CHECK(entryheap_delete(arr, n, entry->index) == entry);
+				n--;
+				entry->index = SIZE_MAX;
+			} else {
+				arr[n] = entry;
+				entryheap_insert(arr, n);
+				n++;
+			}
+			break;
+		case 4:
+			if (n != 0) {
+				struct heap_entry *first = arr[0];
+				for (size_t i = 0; i < n; i++) {
+					CHECK(first->key <= arr[i]->key);
+				}
+				CHECK(entryheap_extract_first(arr, n) == first);
+				n--;
+				first->index = SIZE_MAX;
+			}
+			break;
+		}
+		if (round % 64 == 0) {
+			CHECK(check_entry_indices(arr, n));
+		}
+	}
+	CHECK(check_entry_indices(arr, n));
+	free(entries);
+	free(arr);
+	return true;
+}
@@ -0,0 +1,188 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "interval_tree.h"
+#include "macros.h"
+#include "random.h"
+#include "testing.h"
+
+#define to_interval(ptr) container_of(ptr, struct interval_tree_node, rb_node)
+
+static bool check_subtree(const struct rb_node *node, uint64_t *ret_subtree_last)
+{
+	const struct interval_tree_node *interval = to_interval(node);
+	uint64_t max = interval->last;
+	for (unsigned int i = 0; i < 2; i++) {
+		const struct rb_node *child = node->children[i];
+		if (!child) {
+			continue;
+		}
+		CHECK(rb_parent(child) == node);
+		CHECK(i == RB_LEFT ? to_interval(child)->start <= interval->start :
+		      to_interval(child)->start >= interval->start);
+		uint64_t subtree_last;
+		CHECK(check_subtree(child, &subtree_last));
+		if (subtree_last > max) {
+			max = subtree_last;
+		}
+	}
+	CHECK(interval->_subtree_last == max);
+	*ret_subtree_last = max;
+	return true;
+}
+
+static bool check_tree(const struct interval_tree *tree)
+{
+	uint64_t subtree_last;
+	return !tree->tree.root || check_subtree(tree->tree.root, &subtree_last);
+}
+
+static bool check_query(const struct interval_tree *tree, const struct interval_tree_node *intervals,
+			const bool *in_tree, size_t n, uint64_t start, uint64_t last)
+{
+	size_t expected = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (in_tree[i] && intervals[i].start <= last && start <= intervals[i].last) {
+			expected++;
+		}
+	}
+	size_t found = 0;
+	uint64_t prev_start = 0;
+	interval_tree_foreach_overlap(tree, start, last, cur) {
+		CHECK(cur->start <= last && start <= cur->last);
+		CHECK(in_tree[cur - intervals]);
+		CHECK(cur->start >= prev_start);
+		prev_start = cur->start;
+		found++;
+	}
+	CHECK(found == expected);
+	return true;
+}
+
+RANDOM_TEST(interval_tree, random_seed, 2)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	const size_t n = 4096;
+	const uint64_t max_start = 100000;
+	struct interval_tree_node *intervals = malloc(n * sizeof(intervals[0]));
+	bool *in_tree = calloc(n, sizeof(in_tree[0]));
+	struct interval_tree tree = INTERVAL_TREE_EMPTY;
+	CHECK(!interval_tree_iter_first(&tree, 0, UINT64_MAX));
+
+	for (size_t i = 0; i < n; i++) {
+		intervals[i].start = random_next_u64(&rng) % max_start;
+		uint64_t length = random_next_bool(&rng) ? random_next_u64(&rng) % 100 : random_next_u64(&rng) % 5000;
+		intervals[i].last = intervals[i].start + length;
+		interval_tree_insert(&tree, &intervals[i]);
+		in_tree[i] = true;
+		if (i % 256 == 0) {
+			CHECK(check_tree(&tree));
+		}
+	}
+	CHECK(check_tree(&tree));
+	CHECK(check_query(&tree, intervals, in_tree, n, 0, UINT64_MAX));
+
+	for (unsigned int round = 0; round < 8; round++) {
+		for (unsigned int i = 0; i < 64; i++) {
+			uint64_t start = random_next_u64(&rng) % (max_start + 6000);
+			uint64_t last = start + random_next_u64(&rng) % (i % 2 == 0 ? 10 : 1000);
+			CHECK(check_query(&tree, intervals, in_tree, n, start, last));
+		}
+		// remove some intervals and insert some of them again
+		for (size_t i = 0; i < n / 4; i++) {
+			size_t idx = random_next_u64(&rng) % n;
+			if (in_tree[idx]) {
+				interval_tree_remove(&tree, &intervals[idx]);
+			} else {
+				interval_tree_insert(&tree, &intervals[idx]);
+			}
+			in_tree[idx] = !in_tree[idx];
+		}
+		CHECK(check_tree(&tree));
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		if (in_tree[i]) {
+			interval_tree_remove(&tree, &intervals[i]);
+		}
+		if (i % 256 == 0) {
+			CHECK(check_tree(&tree));
+		}
+	}
+	CHECK(!tree.tree.root);
+
+	free(intervals);
+	free(in_tree);
+	return true;
+}
+
+static int compare_interval_ptrs(const void *_a, const void *_b)
+{
+	const struct interval_tree_node *a = *(const struct interval_tree_node **)_a;
+	const struct interval_tree_node *b = *(const struct interval_tree_node **)_b;
+	return (a->start > b->start) - (a->start < b->start);
+}
+
+RANDOM_TEST(interval_tree_build_sorted, random_seed, 2)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	const size_t n = 4096;
+	const uint64_t max_start = 100000;
+	struct interval_tree_node *intervals = malloc(n * sizeof(intervals[0]));
+	struct interval_tree_node **sorted = malloc(n * sizeof(sorted[0]));
+	bool *in_tree = calloc(n, sizeof(in_tree[0]));
+	for (size_t i = 0; i < n; i++) {
+		intervals[i].start = random_next_u64(&rng) % max_start;
+		uint64_t length = random_next_bool(&rng) ? random_next_u64(&rng) % 100 : random_next_u64(&rng) % 5000;
+		intervals[i].last = intervals[i].start + length;
+	}
+
+	// build two trees from sorted snapshots (the first half and the second half of the intervals)
+	struct interval_tree trees[2] = {INTERVAL_TREE_EMPTY, INTERVAL_TREE_EMPTY};
+	interval_tree_build_sorted(&trees[0], sorted, 0);
+	CHECK(!trees[0].tree.root);
+	for (unsigned int t = 0; t < 2; t++) {
+		size_t count = 0;
+		for (size_t i = t * n / 2; i < (t + 1) * n / 2; i++) {
+			sorted[count++] = &intervals[i];
+		}
+		qsort(sorted, count, sizeof(sorted[0]), compare_interval_ptrs);
+		interval_tree_build_sorted(&trees[t], sorted, count);
+		CHECK(check_tree(&trees[t]));
+	}
+	for (size_t i = 0; i < n / 2; i++) {
+		in_tree[i] = true;
+	}
+	for (unsigned int i = 0; i < 128; i++) {
+		uint64_t start = random_next_u64(&rng) % (max_start + 6000);
+		uint64_t last = start + random_next_u64(&rng) % (i % 2 == 0 ? 10 : 1000);
+		CHECK(check_query(&trees[0], intervals, in_tree, n, start, last));
+	}
+
+	interval_tree_union(&trees[0], &trees[1]);
+	CHECK(!trees[1].tree.root);
+	CHECK(check_tree(&trees[0]));
+	for (size_t i = 0; i < n; i++) {
+		in_tree[i] = true;
+	}
+	for (unsigned int i = 0; i < 128; i++) {
+		uint64_t start = random_next_u64(&rng) % (max_start + 6000);
+		uint64_t last = start + random_next_u64(&rng) % (i % 2 == 0 ? 10 : 1000);
+		CHECK(check_query(&trees[0], intervals, in_tree, n, start, last));
+	}
+
+	// the built tree is a valid red-black tree, so it can be modified as usual
+	for (size_t i = 0; i < n; i += 2) {
+		interval_tree_remove(&trees[0], &intervals[i]);
+		in_tree[i] = false;
+	}
+	CHECK(check_tree(&trees[0]));
+	CHECK(check_query(&trees[0], intervals, in_tree, n, 0, UINT64_MAX));
+
+	free(intervals);
+	free(sorted);
+	free(in_tree);
+	return true;
+}
@@ -0,0 +1,144 @@
+#include <stdint.h>
+#include <string.h>
+#include "array.h"
+#include "dstring.h"
+#include "mem_arena.h"
+#include "random.h"
+#include "testing.h"
+
+static bool is_aligned(const void *p, size_t alignment)
+{
+	return (uintptr_t)p % alignment == 0;
+}
+
+RANDOM_TEST(mem_arena_alloc, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	struct mem_arena arena;
+	mem_arena_init(&arena, random_seed % 2 ? MEM_ARENA_HUGE_PAGES : 0);
+
+	// fill all allocations with a pattern and check that they do not overlap
+	unsigned char *ptrs[1000];
+	size_t sizes[1000];
+	for (size_t i = 0; i < 1000; i++) {
+		size_t alignment = (size_t)1 << random_next_u32(&rng) % 8;
+		size_t size = random_next_u32(&rng) % (random_next_u32(&rng) % 8 == 0 ? 2 * MEM_ARENA_LARGE_THRESHOLD : 100);
+		ptrs[i] = alignment == _Alignof(max_align_t) ? mem_arena_alloc(&arena, size) :
+			mem_arena_alloc_aligned(&arena, size, alignment);
+		sizes[i] = size;
+		CHECK(ptrs[i]);
+		CHECK(is_aligned(ptrs[i], alignment));
+		memset(ptrs[i], i & 0xff, size);
+	}
+	for (size_t i = 0; i < 1000; i++) {
+		for (size_t j = 0; j < sizes[i]; j++) {
+			CHECK(ptrs[i][j] == (i & 0xff));
+		}
+	}
+	mem_arena_destroy(&arena);
+	return true;
+}
+
+SIMPLE_TEST(mem_arena_zero_size)
+{
+	// allocations of 0 bytes are not NULL, also if the arena has no chunk yet or after a reset
+	struct mem_arena arena;
+	mem_arena_init(&arena, 0);
+	CHECK(mem_arena_alloc(&arena, 0) != NULL);
+	mem_arena_reset(&arena);
+	CHECK(mem_arena_alloc_aligned(&arena, 0, 64) != NULL);
+	mem_arena_destroy(&arena);
+	CHECK(mem_arena_alloc(&arena, 0) != NULL);
+	mem_arena_destroy(&arena);
+	return true;
+}
+
+SIMPLE_TEST(mem_arena_savepoint)
+{
+	struct mem_arena arena;
+	mem_arena_init(&arena, 0);
+	char *p = mem_arena_alloc(&arena, 10);
+	struct mem_arena_savepoint savepoint = mem_arena_save(&arena);
+	char *q = mem_arena_alloc(&arena, 10);
+	CHECK(q > p);
+
+	// rewinding makes the same memory available again (also after the arena got new chunks)
+	mem_arena_rewind(&arena, savepoint);
+	CHECK(mem_arena_alloc(&arena, 10) == q);
+	for (size_t i = 0; i < 1000; i++) {
+		memset(mem_arena_alloc(&arena, 1000), 0, 1000);
+	}
+	memset(mem_arena_alloc(&arena, 10 * MEM_ARENA_LARGE_THRESHOLD), 0, 10 * MEM_ARENA_LARGE_THRESHOLD);
+	mem_arena_rewind(&arena, savepoint);
+	CHECK(arena._large == NULL);
+	CHECK(mem_arena_alloc(&arena, 10) == q);
+
+	// nested savepoints
+	struct mem_arena_savepoint savepoint2 = mem_arena_save(&arena);
+	char *r = mem_arena_alloc(&arena, 10);
+	CHECK(mem_arena_alloc(&arena, 2 * MEM_ARENA_LARGE_THRESHOLD));
+	struct mem_arena_savepoint savepoint3 = mem_arena_save(&arena);
+	CHECK(mem_arena_alloc(&arena, 2 * MEM_ARENA_LARGE_THRESHOLD));
+	mem_arena_rewind(&arena, savepoint3);
+	CHECK(arena._large != NULL);
+	mem_arena_rewind(&arena, savepoint2);
+	CHECK(arena._large == NULL);
+	CHECK(mem_arena_alloc(&arena, 10) == r);
+	char *large = mem_arena_alloc(&arena, 2 * MEM_ARENA_LARGE_THRESHOLD);
+	memset(large, 0, 2 * MEM_ARENA_LARGE_THRESHOLD);
+	mem_arena_rewind(&arena, savepoint);
+	CHECK(arena._large == NULL);
+
+	// reset keeps the chunks
+	for (size_t i = 0; i < 1000; i++) {
+		CHECK(mem_arena_alloc(&arena, 1000));
+	}
+	mem_arena_reset(&arena);
+	CHECK(arena._current == NULL);
+	struct _mem_arena_chunk *spare = arena._spare;
+	CHECK(spare);
+	CHECK(mem_arena_alloc(&arena, 1));
+	CHECK(arena._current == spare);
+	mem_arena_destroy(&arena);
+	CHECK(!arena._current && !arena._spare && !arena._large);
+	return true;
+}
+
+SIMPLE_TEST(mem_arena_allocator)
+{
+	struct mem_arena arena;
+	mem_arena_init(&arena, 0);
+	struct allocator *allocator = mem_arena_allocator(&arena);
+
+	// a growing array is extended in place as long as it is the most recent allocation
+	array_t(uint32_t) arr = array_new_with_allocator(uint32_t, 1, allocator);
+	array_add(arr, 0);
+	uint32_t *first = arr;
+	for (uint32_t i = 1; i < 100; i++) {
+		array_add(arr, i);
+	}
+	CHECK(arr == first);
+	dstr_t s = dstr_with_allocator(allocator, 0);
+	for (uint32_t i = 0; i < 100000; i++) {
+		array_add(arr, i);
+		dstr_append_char(&s, 'a' + i % 26);
+	}
+	for (uint32_t i = 0; i < 100000; i++) {
+		CHECK(arr[100 + i] == i);
+		CHECK(s[i] == 'a' + i % 26);
+	}
+	CHECK(s[100000] == '\0');
+	// both are large allocations now which are released immediately
+	CHECK(arena._large != NULL);
+	array_free(arr);
+	dstr_free(&s);
+	CHECK(arena._large == NULL);
+
+	// freeing the most recent allocation gives the memory back
+	void *p = allocator_alloc(allocator, 100);
+	allocator_free(allocator, p, 100);
+	CHECK(allocator_alloc(allocator, 100) == p);
+	mem_arena_destroy(&arena);
+	return true;
+}
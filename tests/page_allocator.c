@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <string.h>
+#include "array.h"
+#include "config.h"
+#include "dbuf.h"
+#include "dstring.h"
+#include "page_allocator.h"
+#include "testing.h"
+
+#define THRESHOLD (64 * 1024)
+
+static bool check_u32(const uint32_t *arr, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		CHECK(arr[i] == (uint32_t)(i * 2654435761u));
+	}
+	return true;
+}
+
+SIMPLE_TEST(page_allocator_alloc)
+{
+	for (unsigned int flags = 0; flags <= PAGE_ALLOCATOR_HUGE_PAGES; flags++) {
+		struct page_allocator pages;
+		page_allocator_init(&pages, THRESHOLD, flags);
+		struct allocator *allocator = page_allocator(&pages);
+
+		// growing from below to above the threshold, then in big steps and back
+		size_t sizes[] = {1000, THRESHOLD, THRESHOLD + 1, 300000, 5000000, 12345678, 400000, 70000, 100, 1};
+		size_t old_size = 0;
+		unsigned char *p = NULL;
+		for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+			size_t size = sizes[i];
+			p = allocator_realloc(allocator, p, old_size, size);
+			CHECK((uintptr_t)p % _Alignof(max_align_t) == 0);
+#if defined(HAVE_MMAP) && defined(HAVE_MADV_HUGEPAGE)
+			if (flags & PAGE_ALLOCATOR_HUGE_PAGES && size > THRESHOLD) {
+				CHECK((uintptr_t)p % PAGE_ALLOCATOR_HUGE_PAGE_SIZE == 0);
+			}
+#endif
+			size_t n = old_size < size ? old_size : size;
+			for (size_t j = 0; j < n; j++) {
+				CHECK(p[j] == (unsigned char)(j * 7));
+			}
+			for (size_t j = n; j < size; j++) {
+				p[j] = j * 7;
+			}
+			old_size = size;
+		}
+		allocator_free(allocator, p, old_size);
+
+		p = allocator_alloc(allocator, 10 * THRESHOLD);
+		memset(p, 1, 10 * THRESHOLD);
+		allocator_free(allocator, p, 10 * THRESHOLD);
+	}
+	return true;
+}
+
+SIMPLE_TEST(page_allocator_containers)
+{
+	struct page_allocator pages;
+	page_allocator_init(&pages, THRESHOLD, PAGE_ALLOCATOR_HUGE_PAGES);
+
+	size_t n = 4 * 1024 * 1024;
+	array_t(uint32_t) arr = array_new_with_allocator(uint32_t, 0, page_allocator(&pages));
+	for (size_t i = 0; i < n; i++) {
+		array_add(arr, i * 2654435761u);
+	}
+	CHECK(check_u32(arr, n));
+	array_truncate(arr, n / 3);
+	array_shrink_to_fit(arr);
+	CHECK(check_u32(arr, n / 3));
+	array_truncate(arr, 10);
+	array_shrink_to_fit(arr);
+	CHECK(check_u32(arr, 10));
+	array_free(arr);
+
+	struct dbuf dbuf;
+	dbuf_init_with_allocator(&dbuf, page_allocator(&pages));
+	unsigned char chunk[4096];
+	for (size_t i = 0; i < 4096; i++) {
+		memset(chunk, i & 0xff, sizeof(chunk));
+		memcpy(dbuf_add_uninitialized(&dbuf, sizeof(chunk)), chunk, sizeof(chunk));
+	}
+	CHECK(dbuf_size(&dbuf) == 4096 * sizeof(chunk));
+	const unsigned char *buf = dbuf_buffer(&dbuf);
+	for (size_t i = 0; i < 4096; i++) {
+		CHECK(buf[i * sizeof(chunk)] == (i & 0xff) && buf[(i + 1) * sizeof(chunk) - 1] == (i & 0xff));
+	}
+	dbuf_truncate(&dbuf, 1000);
+	dbuf_shrink_to_fit(&dbuf);
+	CHECK(dbuf_capacity(&dbuf) == 1000 && ((const unsigned char *)dbuf_buffer(&dbuf))[999] == 0);
+	dbuf_destroy(&dbuf);
+
+	dstr_t s = dstr_with_allocator(page_allocator(&pages), 0);
+	for (size_t i = 0; i < 1000000; i++) {
+		dstr_append_char(&s, 'a' + i % 26);
+	}
+	CHECK(dstr_length(s) == 1000000 && s[999999] == 'a' + 999999 % 26 && s[1000000] == '\0');
+	dstr_free(&s);
+	return true;
+}
@@ -0,0 +1,118 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parallel_sort.h"
+#include "random.h"
+#include "testing.h"
+
+DEFINE_PARALLEL_SORTFUNC(parallel_int_sort, int, (*a > *b) - (*a < *b))
+
+struct record {
+	uint64_t key;
+	uint32_t id;
+};
+
+DEFINE_PARALLEL_SORTFUNC(parallel_record_sort, struct record, (a->key > b->key) - (a->key < b->key))
+
+static int int_cmp(const void *_a, const void *_b)
+{
+	int a = *(const int *)_a;
+	int b = *(const int *)_b;
+	return (a > b) - (a < b);
+}
+
+RANDOM_TEST(parallel_sort, random_seed, 2)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	size_t max_n = 8 * PARALLEL_SORT_MIN_RUN_SIZE + 123;
+	int *arr = malloc(max_n * sizeof(arr[0]));
+	int *expected = malloc(max_n * sizeof(expected[0]));
+	static const unsigned int thread_counts[] = {1, 2, 3, 4, 7, 8, 64};
+	for (size_t t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+		for (unsigned int kind = 0; kind < 4; kind++) {
+			size_t n = kind == 0 ? random_next_u32(&rng) % 1000 : max_n - random_next_u32(&rng) % 1000;
+			for (size_t i = 0; i < n; i++) {
+				switch (kind) {
+				case 0:
+				case 1: arr[i] = (int)random_next_u32(&rng); break;
+				case 2: arr[i] = random_next_u32(&rng) % 3; break; // many duplicates
+				case 3: arr[i] = (int)(n - i); break;
+				}
+			}
+			memcpy(expected, arr, n * sizeof(arr[0]));
+			qsort(expected, n, sizeof(expected[0]), int_cmp);
+			parallel_int_sort(arr, n, thread_counts[t]);
+			CHECK(memcmp(arr, expected, n * sizeof(arr[0])) == 0);
+		}
+	}
+	free(arr);
+	free(expected);
+
+	size_t n = 4 * PARALLEL_SORT_MIN_RUN_SIZE;
+	struct record *records = malloc(n * sizeof(records[0]));
+	uint64_t id_sum = 0;
+	for (size_t i = 0; i < n; i++) {
+		records[i].key = random_next_u64(&rng);
+		records[i].id = (uint32_t)i;
+		id_sum += i;
+	}
+	parallel_record_sort(records, n, 0);
+	for (size_t i = 0; i < n; i++) {
+		CHECK(i == 0 || records[i - 1].key <= records[i].key);
+		id_sum -= records[i].id;
+	}
+	CHECK(id_sum == 0);
+	free(records);
+	return true;
+}
+
+// checks the balance of the merge phase for keys with few distinct values
+SIMPLE_TEST(parallel_sort_splits)
+{
+	const unsigned int t = 8;
+	const size_t n = t * 10000;
+	int *arr = malloc(n * sizeof(arr[0]));
+	for (int num_values = 1; num_values <= 4; num_values++) {
+		struct _parallel_int_sort_ctx ctx = {
+			.arr = arr,
+			.num_threads = t,
+			.bounds = malloc((t + 1) * sizeof(size_t)),
+			.splits = malloc(((size_t)t + 1) * t * sizeof(size_t)),
+		};
+		for (unsigned int r = 0; r <= t; r++) {
+			ctx.bounds[r] = n / t * r;
+		}
+		for (size_t i = 0; i < n; i++) {
+			arr[i] = (int)(i * 7919 % n) % num_values;
+		}
+		for (unsigned int r = 0; r < t; r++) {
+			_parallel_int_sort_seq(arr + ctx.bounds[r], n / t);
+		}
+		_parallel_int_sort_compute_splits(&ctx);
+		size_t total = 0;
+		for (unsigned int p = 0; p < t; p++) {
+			size_t slice_size = 0;
+			for (unsigned int r = 0; r < t; r++) {
+				size_t start = ctx.splits[(size_t)p * t + r];
+				size_t end = ctx.splits[(size_t)(p + 1) * t + r];
+				CHECK(start <= end);
+				slice_size += end - start;
+			}
+			CHECK(slice_size <= 2 * n / t);
+			total += slice_size;
+		}
+		CHECK(total == n);
+		free(ctx.bounds);
+		free(ctx.splits);
+
+		parallel_int_sort(arr, n, t);
+		for (size_t i = 1; i < n; i++) {
+			CHECK(arr[i - 1] <= arr[i]);
+		}
+	}
+	free(arr);
+	return true;
+}
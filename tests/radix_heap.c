@@ -0,0 +1,82 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "heap.h"
+#include "radix_heap.h"
+#include "random.h"
+#include "testing.h"
+
+DEFINE_RADIX_HEAP(radixheap, uint32_t)
+DEFINE_BINHEAP(u64heap, uint64_t, *a < *b)
+
+static bool check_extract(struct radixheap *heap, uint64_t *ref, size_t n, const uint64_t *keys)
+{
+	uint64_t key;
+	uint32_t value;
+	uint64_t min = ref[0];
+	CHECK(radixheap_first_key(heap) == min);
+	CHECK(radixheap_extract_first(heap, &key, &value));
+	CHECK(key == min);
+	CHECK(keys[value] == key);
+	CHECK(u64heap_extract_first(ref, n) == min);
+	return true;
+}
+
+RANDOM_TEST(radix_heap_random, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	size_t max_items = 1 << 14;
+	size_t num_ops = 1 << 17;
+	// the key of each inserted value (values are indices into this array)
+	uint64_t *keys = malloc(num_ops * sizeof(keys[0]));
+	uint64_t *ref = malloc(num_ops * sizeof(ref[0]));
+	struct radixheap heap;
+	radixheap_init(&heap);
+	CHECK(radixheap_empty(&heap));
+	CHECK(!radixheap_extract_first(&heap, NULL, NULL));
+
+	// small increments (with duplicates) and occasional huge jumps
+	uint64_t max_step = random_next_bool(&rng) ? 16 : UINT64_MAX / num_ops / 4;
+	size_t n = 0;
+	uint64_t last = 0;
+	for (size_t i = 0; i < num_ops; i++) {
+		if (n < max_items && (n == 0 || random_next_u32(&rng) % 3 != 0)) {
+			uint64_t key = last + random_next_u64_in_range(&rng, 0, max_step);
+			if (random_next_u32(&rng) % 1024 == 0) {
+				key = last + random_next_u64_in_range(&rng, 0, UINT64_MAX / 4096);
+			}
+			keys[i] = key;
+			radixheap_insert(&heap, key, i);
+			ref[n] = key;
+			u64heap_insert(ref, n);
+			n++;
+		} else {
+			last = ref[0];
+			CHECK(check_extract(&heap, ref, n, keys));
+			n--;
+		}
+		CHECK(radixheap_num_items(&heap) == n);
+	}
+	while (n > 0) {
+		CHECK(check_extract(&heap, ref, n, keys));
+		n--;
+	}
+	CHECK(radixheap_empty(&heap));
+	CHECK(!radixheap_extract_first(&heap, NULL, NULL));
+
+	// the heap can be reused after becoming empty
+	radixheap_insert(&heap, UINT64_MAX, 1);
+	radixheap_insert(&heap, UINT64_MAX, 2);
+	uint64_t key;
+	uint32_t value;
+	CHECK(radixheap_extract_first(&heap, &key, &value) && key == UINT64_MAX && (value == 1 || value == 2));
+	CHECK(radixheap_num_items(&heap) == 1);
+	radixheap_destroy(&heap);
+	CHECK(radixheap_empty(&heap));
+
+	free(keys);
+	free(ref);
+	return true;
+}
@@ -231,6 +231,302 @@ RANDOM_TEST(random_insert_find_remove, random_seed, 2)
 	return true;
 }
 
+DEFINE_RB_TREE(thing_tree, struct thing, rb_node, int, key, a < b ? -1 : a > b)
+
+RANDOM_TEST(generated_api, random_seed, 2)
+{
+	struct rb_tree tree = RB_EMPTY_TREE;
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	const int max_key = 4096;
+	struct thing *things[4096] = {0};
+	for (unsigned int i = 0; i < 100000; i++) {
+		int key = random_next_u32(&rng) % max_key;
+		struct thing *thing = malloc(sizeof(*thing));
+		thing->key = key;
+		if (random_next_bool(&rng)) {
+			CHECK(thing_tree_insert(&tree, thing) == !things[key]);
+		} else {
+			struct thing *result = thing_tree_find_or_insert(&tree, thing);
+			CHECK(result == (things[key] ? things[key] : thing));
+		}
+		if (things[key]) {
+			free(thing);
+		} else {
+			things[key] = thing;
+		}
+		CHECK(thing_tree_find(&tree, key) == things[key]);
+
+		key = (int)(random_next_u32(&rng) % (max_key + 2)) - 1;
+		struct thing *lower = NULL;
+		struct thing *upper = NULL;
+		for (int k = key < 0 ? 0 : key; k < max_key; k++) {
+			if (things[k] && !lower) {
+				lower = things[k];
+			}
+			if (things[k] && k > key) {
+				upper = things[k];
+				break;
+			}
+		}
+		CHECK(thing_tree_lower_bound(&tree, key) == lower);
+		CHECK(thing_tree_upper_bound(&tree, key) == upper);
+
+		key = random_next_u32(&rng) % max_key;
+		thing = thing_tree_delete(&tree, key);
+		CHECK(thing == things[key]);
+		CHECK(!thing_tree_find(&tree, key));
+		free(thing);
+		things[key] = NULL;
+
+		if (i % 1024 == 0) {
+			CHECK(check_tree(&tree));
+		}
+	}
+	CHECK(check_tree(&tree));
+
+	int prev = -1;
+	for (struct thing *thing = thing_tree_first(&tree); thing; thing = thing_tree_next(thing)) {
+		CHECK(thing->key > prev && things[thing->key] == thing);
+		prev = thing->key;
+		things[thing->key] = NULL;
+	}
+	for (int k = 0; k < max_key; k++) {
+		CHECK(!things[k]);
+	}
+	rb_destroy_tree(&tree);
+	return true;
+}
+
+struct counted_thing {
+	int key;
+	unsigned int size; // number of nodes in the subtree
+	struct rb_node rb_node;
+};
+
+#define to_counted_thing(ptr) container_of(ptr, struct counted_thing, rb_node)
+
+static unsigned int subtree_size(const struct rb_node *node)
+{
+	return node ? to_counted_thing(node)->size : 0;
+}
+
+static unsigned int compute_size(const struct counted_thing *thing)
+{
+	return 1 + subtree_size(thing->rb_node.left) + subtree_size(thing->rb_node.right);
+}
+
+DEFINE_RB_AUGMENT_CALLBACKS(size_augment, struct counted_thing, rb_node, unsigned int, size, compute_size)
+
+static bool check_sizes(const struct rb_node *node)
+{
+	if (!node) {
+		return true;
+	}
+	CHECK(to_counted_thing(node)->size == compute_size(to_counted_thing(node)));
+	CHECK(check_sizes(node->left));
+	CHECK(check_sizes(node->right));
+	return true;
+}
+
+static struct counted_thing *select_nth(const struct rb_tree *tree, unsigned int n)
+{
+	const struct rb_node *cur = tree->root;
+	while (cur) {
+		unsigned int left_size = subtree_size(cur->left);
+		if (n == left_size) {
+			return to_counted_thing(cur);
+		}
+		if (n < left_size) {
+			cur = cur->left;
+		} else {
+			n -= left_size + 1;
+			cur = cur->right;
+		}
+	}
+	return NULL;
+}
+
+RANDOM_TEST(augmented, random_seed, 2)
+{
+	struct rb_tree tree = RB_EMPTY_TREE;
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	const int max_key = 2048;
+	struct counted_thing *things[2048] = {0};
+	for (unsigned int i = 0; i < 50000; i++) {
+		int key = random_next_u32(&rng) % max_key;
+		if (things[key]) {
+			rb_remove_node_augmented(&tree, &things[key]->rb_node, &size_augment);
+			free(things[key]);
+			things[key] = NULL;
+		} else {
+			struct rb_node *parent = NULL;
+			struct rb_node *cur = tree.root;
+			enum rb_direction dir = RB_LEFT;
+			while (cur) {
+				parent = cur;
+				dir = key < to_counted_thing(cur)->key ? RB_LEFT : RB_RIGHT;
+				cur = cur->children[dir];
+			}
+			things[key] = malloc(sizeof(*things[key]));
+			things[key]->key = key;
+			things[key]->size = 1;
+			rb_insert_node_augmented(&tree, &things[key]->rb_node, parent, dir, &size_augment);
+		}
+		if (i % 512 == 0) {
+			CHECK(check_sizes(tree.root));
+			unsigned int n = 0;
+			for (int k = 0; k < max_key; k++) {
+				if (things[k]) {
+					CHECK(select_nth(&tree, n++) == things[k]);
+				}
+			}
+			CHECK(subtree_size(tree.root) == n);
+			CHECK(!select_nth(&tree, n));
+		}
+	}
+	CHECK(check_sizes(tree.root));
+	for (int k = 0; k < max_key; k++) {
+		if (things[k]) {
+			rb_remove_node_augmented(&tree, &things[k]->rb_node, &size_augment);
+			free(things[k]);
+			CHECK(check_sizes(tree.root));
+		}
+	}
+	CHECK(!tree.root);
+	return true;
+}
+
+RANDOM_TEST(cached, random_seed, 2)
+{
+	struct rb_tree_cached tree = RB_EMPTY_TREE_CACHED;
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	const int max_key = 1024;
+	struct thing *things[1024] = {0};
+	for (unsigned int i = 0; i < 100000; i++) {
+		int key = random_next_u32(&rng) % max_key;
+		if (things[key]) {
+			rb_remove_node_cached(&tree, &things[key]->rb_node);
+			free(things[key]);
+			things[key] = NULL;
+		} else {
+			struct rb_node *parent = NULL;
+			struct rb_node *cur = tree.tree.root;
+			enum rb_direction dir = RB_LEFT;
+			while (cur) {
+				parent = cur;
+				dir = key < to_thing(cur)->key ? RB_LEFT : RB_RIGHT;
+				cur = cur->children[dir];
+			}
+			things[key] = malloc(sizeof(*things[key]));
+			things[key]->key = key;
+			rb_insert_node_cached(&tree, &things[key]->rb_node, parent, dir);
+		}
+		CHECK(rb_first_cached(&tree) == rb_first(&tree.tree));
+		if (i % 1024 == 0) {
+			CHECK(check_tree(&tree.tree));
+		}
+	}
+	CHECK(check_tree(&tree.tree));
+	rb_destroy_tree(&tree.tree);
+	return true;
+}
+
+static int compare_things(const struct rb_node *a, const struct rb_node *b)
+{
+	int x = to_thing(a)->key;
+	int y = to_thing(b)->key;
+	return x < y ? -1 : x > y;
+}
+
+static unsigned int num_duplicates;
+
+static void free_duplicate(struct rb_node *node)
+{
+	num_duplicates++;
+	free(to_thing(node));
+}
+
+static bool check_keys(const struct rb_tree *tree, const int *keys, size_t n)
+{
+	size_t i = 0;
+	rb_foreach(tree, cur) {
+		CHECK(i < n && to_thing(cur)->key == keys[i]);
+		i++;
+	}
+	CHECK(i == n);
+	return true;
+}
+
+RANDOM_TEST(build_sorted_union, random_seed, 2)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	const size_t max_nodes = 20000;
+	struct rb_node **nodes = malloc(max_nodes * sizeof(nodes[0]));
+	int *keys = malloc(max_nodes * sizeof(keys[0]));
+	for (size_t n = 0; n < max_nodes; n = n < 300 ? n + 1 : n * 3) {
+		struct rb_tree tree = RB_EMPTY_TREE;
+		for (size_t i = 0; i < n; i++) {
+			struct thing *thing = malloc(sizeof(*thing));
+			thing->key = 3 * i;
+			keys[i] = thing->key;
+			nodes[i] = &thing->rb_node;
+		}
+		rb_build_sorted(&tree, nodes, n);
+		CHECK(check_tree(&tree));
+		CHECK(check_keys(&tree, keys, n));
+
+		// the odd keys are not in the tree yet
+		struct rb_tree other = RB_EMPTY_TREE;
+		size_t m = 0;
+		for (size_t i = 0; i < 2 * n + 2; i++) {
+			if (random_next_u32(&rng) % 4 == 0) {
+				struct thing *thing = malloc(sizeof(*thing));
+				thing->key = (int)i * 3 / 2 - 1;
+				nodes[m++] = &thing->rb_node;
+			}
+		}
+		rb_build_sorted(&other, nodes, m);
+		CHECK(check_tree(&other));
+		num_duplicates = 0;
+		rb_union(&tree, &other, compare_things, free_duplicate);
+		CHECK(!other.root);
+		CHECK(check_tree(&tree));
+		size_t num_nodes = 0;
+		int prev = -2;
+		rb_foreach(&tree, cur) {
+			CHECK(to_thing(cur)->key > prev);
+			prev = to_thing(cur)->key;
+			num_nodes++;
+		}
+		CHECK(num_nodes + num_duplicates == n + m);
+
+		// keep the duplicates
+		for (size_t i = 0; i < n; i++) {
+			struct thing *thing = malloc(sizeof(*thing));
+			thing->key = 3 * i;
+			nodes[i] = &thing->rb_node;
+		}
+		rb_build_sorted(&other, nodes, n);
+		rb_union(&tree, &other, compare_things, NULL);
+		size_t num_nodes2 = 0;
+		prev = -2;
+		rb_foreach(&tree, cur) {
+			CHECK(to_thing(cur)->key >= prev);
+			prev = to_thing(cur)->key;
+			num_nodes2++;
+		}
+		CHECK(num_nodes2 == num_nodes + n);
+		rb_destroy_tree(&tree);
+	}
+	free(nodes);
+	free(keys);
+	return true;
+}
+
 #if 0
 	char buf[128];
 	while (fgets(buf, sizeof(buf), stdin)) {
@@ -0,0 +1,115 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "dstring.h"
+#include "random.h"
+#include "rope.h"
+#include "testing.h"
+
+static bool check_rope(const struct rope *rope, const dstr_t expected)
+{
+	size_t length = dstr_length(expected);
+	CHECK(rope_length(rope) == length);
+
+	// adjacent chunks are merged if they fit into one
+	struct rope_iter iter;
+	struct strview piece;
+	size_t pos = 0;
+	size_t prev_length = ROPE_CHUNK_SIZE;
+	rope_iter_start(&iter, rope, 0, ROPE_NPOS);
+	while (rope_iter_next(&iter, &piece)) {
+		CHECK(piece.length > 0);
+		CHECK(prev_length + piece.length > ROPE_CHUNK_SIZE - 64);
+		CHECK(pos + piece.length <= length);
+		CHECK(memcmp(piece.characters, expected + pos, piece.length) == 0);
+		pos += piece.length;
+		prev_length = piece.length;
+	}
+	CHECK(pos == length);
+	CHECK(!rope_iter_next(&iter, &piece));
+	return true;
+}
+
+static void random_chars(struct random_state *rng, char *buf, size_t n)
+{
+	for (size_t i = 0; i < n; i++) {
+		buf[i] = 'a' + random_next_u32(rng) % 26;
+	}
+}
+
+RANDOM_TEST(rope, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	static char buf[3 * ROPE_CHUNK_SIZE];
+
+	struct rope rope;
+	rope_init(&rope);
+	dstr_t expected = dstr_new();
+	CHECK(check_rope(&rope, expected));
+	rope_erase(&rope, 0, ROPE_NPOS);
+	CHECK(rope_length(&rope) == 0);
+
+	rope_append_cstr(&rope, "Hello {name}!");
+	rope_replace_cstr(&rope, 6, 6, "World");
+	rope_insert_cstr(&rope, 5, ",");
+	dstr_t str = rope_to_dstr(&rope);
+	CHECK(dstr_equal_cstr(str, "Hello, World!"));
+	dstr_free(&str);
+	CHECK(rope_char_at(&rope, 7) == 'W');
+	rope_clear(&rope);
+	CHECK(rope_length(&rope) == 0);
+
+	for (unsigned int i = 0; i < 4000; i++) {
+		uint32_t r = random_next_u32(&rng);
+		size_t length = dstr_length(expected);
+		size_t pos = random_next_u64(&rng) % (length + 1);
+		// mostly short edits and a few which span multiple chunks
+		size_t n = r % 8 == 0 ? random_next_u32(&rng) % sizeof(buf) : random_next_u32(&rng) % 64;
+		size_t len = r % 8 == 1 ? random_next_u32(&rng) % sizeof(buf) : random_next_u32(&rng) % 64;
+		if (r % 64 == 2) {
+			len = ROPE_NPOS;
+		}
+		random_chars(&rng, buf, n);
+		// the rope cuts off lengths at the end, dstr_erase and dstr_replace_chars don't
+		size_t clamped_len = len > length - pos ? length - pos : len;
+		switch ((r >> 8) % 5) {
+		case 0:
+			rope_append_chars(&rope, buf, n);
+			dstr_append_chars(&expected, buf, n);
+			break;
+		case 1:
+		case 2:
+			rope_insert_chars(&rope, pos, buf, n);
+			dstr_insert_chars(&expected, pos, buf, n);
+			break;
+		case 3:
+			rope_erase(&rope, pos, len);
+			dstr_erase(&expected, pos, clamped_len);
+			break;
+		case 4:
+			rope_replace_chars(&rope, pos, len, buf, n);
+			dstr_replace_chars(&expected, pos, clamped_len, buf, n);
+			break;
+		}
+		CHECK(check_rope(&rope, expected));
+
+		length = dstr_length(expected);
+		if (length > 0) {
+			pos = random_next_u64(&rng) % length;
+			CHECK(rope_char_at(&rope, pos) == expected[pos]);
+		}
+		pos = random_next_u64(&rng) % (length + 1);
+		len = r % 16 == 3 ? ROPE_NPOS : random_next_u32(&rng) % (3 * ROPE_CHUNK_SIZE);
+		dstr_t substring = rope_substring(&rope, pos, len);
+		CHECK(dstr_equal_view(substring, dstr_substring_view(expected, pos, len)));
+		dstr_free(&substring);
+	}
+
+	str = rope_to_dstr(&rope);
+	CHECK(dstr_equal_dstr(str, expected));
+	dstr_free(&str);
+	rope_destroy(&rope);
+	dstr_free(&expected);
+	return true;
+}
@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "random.h"
+#include "segmented_array.h"
+#include "testing.h"
+
+DEFINE_SEGMENTED_ARRAY(u64arr, uint64_t)
+
+struct big {
+	uint64_t value;
+	char padding[1000];
+};
+
+DEFINE_SEGMENTED_ARRAY(bigarr, struct big)
+
+// the reference is a plain array which starts in the middle
+struct reference {
+	uint64_t *items;
+	size_t begin;
+	size_t end;
+};
+
+static bool check_content(struct u64arr *arr, struct reference *ref)
+{
+	CHECK(u64arr_length(arr) == ref->end - ref->begin);
+	for (size_t i = 0; i < u64arr_length(arr); i++) {
+		CHECK(*u64arr_at(arr, i) == ref->items[ref->begin + i]);
+	}
+	// the contiguous runs cover all elements
+	size_t i = 0;
+	while (i < u64arr_length(arr)) {
+		size_t n;
+		uint64_t *p = u64arr_contiguous(arr, i, &n);
+		CHECK(n >= 1 && i + n <= u64arr_length(arr));
+		for (size_t j = 0; j < n; j++) {
+			CHECK(p[j] == ref->items[ref->begin + i + j]);
+		}
+		i += n;
+	}
+	return true;
+}
+
+RANDOM_TEST(segmented_array, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	size_t max_ops = 200000;
+	struct reference ref = {malloc(2 * max_ops * sizeof(uint64_t)), max_ops, max_ops};
+	struct u64arr arr;
+	u64arr_init(&arr);
+
+	for (size_t op = 0; op < max_ops; op++) {
+		uint32_t r = random_next_u32(&rng);
+		// phases which mostly grow the array at the back or front, or shrink it from either end
+		uint32_t phase = (op / 10000) % 4;
+		if (r % 4 != 0 ? phase < 2 : phase >= 2) {
+			uint64_t value = random_next_u64(&rng);
+			if (r % 3 == 0 || (phase == 1 && r % 3 != 2)) {
+				u64arr_push_front(&arr, value);
+				ref.items[--ref.begin] = value;
+			} else {
+				u64arr_push_back(&arr, value);
+				ref.items[ref.end++] = value;
+			}
+		} else if (ref.begin != ref.end) {
+			if (r % 2 == 0) {
+				CHECK(u64arr_pop_front(&arr) == ref.items[ref.begin++]);
+			} else {
+				CHECK(u64arr_pop_back(&arr) == ref.items[--ref.end]);
+			}
+			if (ref.begin == ref.end) {
+				ref.begin = ref.end = max_ops;
+			}
+		}
+		if (op % 10000 == 0) {
+			CHECK(check_content(&arr, &ref));
+		}
+		if (op % 33333 == 0) {
+			u64arr_shrink_to_fit(&arr);
+		}
+	}
+	CHECK(check_content(&arr, &ref));
+	if (u64arr_length(&arr) != 0) {
+		CHECK(*u64arr_first(&arr) == ref.items[ref.begin]);
+		CHECK(*u64arr_last(&arr) == ref.items[ref.end - 1]);
+	}
+	u64arr_clear(&arr);
+	CHECK(u64arr_length(&arr) == 0);
+	u64arr_push_back(&arr, 1);
+	CHECK(*u64arr_at(&arr, 0) == 1);
+	u64arr_destroy(&arr);
+	free(ref.items);
+	return true;
+}
+
+SIMPLE_TEST(segmented_array_stable)
+{
+	struct bigarr arr;
+	bigarr_init(&arr);
+	size_t n = 10000;
+	struct big **ptrs = malloc(2 * n * sizeof(ptrs[0]));
+	for (size_t i = 0; i < n; i++) {
+		ptrs[2 * i] = bigarr_add_back(&arr);
+		ptrs[2 * i]->value = i;
+		ptrs[2 * i + 1] = bigarr_add_front(&arr);
+		ptrs[2 * i + 1]->value = n + i;
+	}
+	// growing the array does not move any elements
+	for (size_t i = 0; i < n; i++) {
+		CHECK(ptrs[2 * i]->value == i);
+		CHECK(ptrs[2 * i + 1]->value == n + i);
+		CHECK(bigarr_at(&arr, n + i) == ptrs[2 * i]);
+		CHECK(bigarr_at(&arr, n - 1 - i) == ptrs[2 * i + 1]);
+	}
+	// removing elements from the other side releases the segments on the way
+	for (size_t i = 0; i < 2 * n; i++) {
+		CHECK(bigarr_pop_back(&arr).value == (i < n ? n - 1 - i : i));
+	}
+	CHECK(bigarr_length(&arr) == 0);
+	bigarr_destroy(&arr);
+	free(ptrs);
+	return true;
+}
@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+#include "btree.h"
+#include "dstring.h"
+#include "random.h"
+#include "slab.h"
+#include "testing.h"
+
+static bool check_pattern(const unsigned char *p, size_t size, unsigned char c)
+{
+	for (size_t i = 0; i < size; i++) {
+		CHECK(p[i] == c);
+	}
+	return true;
+}
+
+RANDOM_TEST(slab_alloc, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	// fill all allocations with a pattern and check that they do not overlap
+	enum { N = 20000 };
+	unsigned char **ptrs = malloc(N * sizeof(ptrs[0]));
+	size_t *sizes = malloc(N * sizeof(sizes[0]));
+	for (size_t i = 0; i < N; i++) {
+		uint32_t r = random_next_u32(&rng);
+		size_t size = r % 16 == 0 ? random_next_u32(&rng) % (2 * SLAB_MAX_SIZE) : random_next_u32(&rng) % 256;
+		ptrs[i] = slab_alloc(size);
+		sizes[i] = size;
+		CHECK(ptrs[i]);
+		CHECK((uintptr_t)ptrs[i] % _Alignof(max_align_t) == 0);
+		memset(ptrs[i], i & 0xff, size);
+	}
+	for (size_t i = 0; i < N; i++) {
+		CHECK(check_pattern(ptrs[i], sizes[i], i & 0xff));
+	}
+
+	// free half of the allocations in random order, resize the others
+	for (size_t i = N - 1; i > 0; i--) {
+		size_t j = random_next_u32(&rng) % (i + 1);
+		unsigned char *p = ptrs[i];
+		size_t size = sizes[i];
+		ptrs[i] = ptrs[j];
+		sizes[i] = sizes[j];
+		ptrs[j] = p;
+		sizes[j] = size;
+	}
+	for (size_t i = 0; i < N / 2; i++) {
+		slab_free(ptrs[i], sizes[i]);
+	}
+	for (size_t i = N / 2; i < N; i++) {
+		unsigned char c = ptrs[i][0];
+		size_t new_size = 1 + random_next_u32(&rng) % (random_next_u32(&rng) % 8 == 0 ? 2 * SLAB_MAX_SIZE : 512);
+		ptrs[i] = slab_realloc(ptrs[i], sizes[i], new_size);
+		if (sizes[i] != 0) {
+			CHECK(check_pattern(ptrs[i], sizes[i] < new_size ? sizes[i] : new_size, c));
+		}
+		sizes[i] = new_size;
+		memset(ptrs[i], i & 0xff, new_size);
+	}
+	for (size_t i = N / 2; i < N; i++) {
+		CHECK(check_pattern(ptrs[i], sizes[i], i & 0xff));
+		slab_free(ptrs[i], sizes[i]);
+	}
+	slab_thread_flush();
+	free(ptrs);
+	free(sizes);
+	return true;
+}
+
+SIMPLE_TEST(slab_reuse)
+{
+	// the most recently freed slot of a size class is reused first
+	void *p = slab_alloc(100);
+	slab_free(p, 100);
+	CHECK(slab_alloc(112) == p);
+	void *q = slab_realloc(p, 112, 97);
+	CHECK(q == p);
+	q = slab_realloc(p, 97, 200);
+	CHECK(q != p);
+	slab_free(q, 200);
+	slab_free(NULL, 10);
+	CHECK(slab_realloc(NULL, 0, 0) == NULL);
+
+	// all slots of a span can be freed and allocated again
+	void *ptrs[2 * SLAB_SPAN_SIZE / 16];
+	for (size_t round = 0; round < 3; round++) {
+		for (size_t i = 0; i < 2 * SLAB_SPAN_SIZE / 16; i++) {
+			ptrs[i] = slab_alloc(16);
+			memset(ptrs[i], 0xff, 16);
+		}
+		for (size_t i = 0; i < 2 * SLAB_SPAN_SIZE / 16; i++) {
+			slab_free(ptrs[i], 16);
+		}
+		slab_thread_flush();
+	}
+	return true;
+}
+
+struct thread_arg {
+	void **ptrs;
+	size_t num_ptrs;
+	uint64_t seed;
+	bool ok;
+};
+
+static int thread_main(void *_arg)
+{
+	struct thread_arg *arg = _arg;
+	struct random_state rng;
+	random_state_init(&rng, arg->seed);
+	// free the allocations of the main thread
+	for (size_t i = 0; i < arg->num_ptrs; i++) {
+		slab_free(arg->ptrs[i], 48);
+	}
+	void *ptrs[256] = {0};
+	size_t sizes[256] = {0};
+	arg->ok = true;
+	for (size_t i = 0; i < 100000; i++) {
+		size_t j = random_next_u32(&rng) % 256;
+		if (ptrs[j]) {
+			arg->ok &= *(uint64_t *)ptrs[j] == j;
+			slab_free(ptrs[j], sizes[j]);
+		}
+		sizes[j] = 8 + random_next_u32(&rng) % 1024;
+		ptrs[j] = slab_alloc(sizes[j]);
+		*(uint64_t *)ptrs[j] = j;
+	}
+	for (size_t j = 0; j < 256; j++) {
+		slab_free(ptrs[j], sizes[j]);
+	}
+	// the thread cache is flushed on exit
+	return 0;
+}
+
+SIMPLE_TEST(slab_threads)
+{
+	enum { THREADS = 4, PTRS_PER_THREAD = 10000 };
+	void **ptrs = malloc(THREADS * PTRS_PER_THREAD * sizeof(ptrs[0]));
+	for (size_t i = 0; i < THREADS * PTRS_PER_THREAD; i++) {
+		ptrs[i] = slab_alloc(48);
+	}
+	thrd_t threads[THREADS];
+	struct thread_arg args[THREADS];
+	for (size_t i = 0; i < THREADS; i++) {
+		args[i] = (struct thread_arg){ptrs + i * PTRS_PER_THREAD, PTRS_PER_THREAD, i + 1, false};
+		CHECK(thrd_create(&threads[i], thread_main, &args[i]) == thrd_success);
+	}
+	for (size_t i = 0; i < THREADS; i++) {
+		CHECK(thrd_join(threads[i], NULL) == thrd_success);
+		CHECK(args[i].ok);
+	}
+	// the memory freed by the other threads is reused
+	for (size_t i = 0; i < THREADS * PTRS_PER_THREAD; i++) {
+		ptrs[i] = slab_alloc(48);
+	}
+	for (size_t i = 0; i < THREADS * PTRS_PER_THREAD; i++) {
+		slab_free(ptrs[i], 48);
+	}
+	free(ptrs);
+	return true;
+}
+
+DEFINE_BTREE_SET(slab_u64set, uint64_t, NULL, 31, (a < b) ? -1 : (a > b))
+
+SIMPLE_TEST(slab_containers)
+{
+	struct slab_u64set set;
+	slab_u64set_init_with_allocator(&set, slab_allocator());
+	for (uint64_t i = 0; i < 100000; i++) {
+		CHECK(slab_u64set_insert(&set, i * 0x9e3779b97f4a7c15));
+	}
+	for (uint64_t i = 0; i < 100000; i += 2) {
+		CHECK(slab_u64set_delete(&set, i * 0x9e3779b97f4a7c15, NULL));
+	}
+	for (uint64_t i = 0; i < 100000; i++) {
+		CHECK((slab_u64set_find(&set, i * 0x9e3779b97f4a7c15) != NULL) == (i % 2 != 0));
+	}
+	slab_u64set_destroy(&set);
+
+	dstr_t s = dstr_with_allocator(slab_allocator(), 0);
+	for (size_t i = 0; i < 10000; i++) {
+		dstr_append_char(&s, 'a' + i % 26);
+	}
+	CHECK(dstr_length(s) == 10000);
+	CHECK(s[9999] == 'a' + 9999 % 26);
+	dstr_free(&s);
+	return true;
+}
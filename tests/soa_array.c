@@ -0,0 +1,106 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include "random.h"
+#include "soa_array.h"
+#include "testing.h"
+
+struct record {
+	uint64_t id;
+	double score;
+	uint8_t flags;
+	char name[13];
+};
+
+DEFINE_SOA_ARRAY(records, (uint64_t, id), (double, score), (uint8_t, flags), (struct record, full))
+DEFINE_SOA_SORT(records_sort_by_score, records, score, (*a > *b) - (*a < *b))
+DEFINE_SOA_SORT(records_sort_by_flags, records, flags, (int)*a - (int)*b)
+
+// field names which are also used as names inside the generated functions
+DEFINE_SOA_ARRAY(clashing, (int, soa), (int, _i), (int, length))
+
+static bool check_row(struct records *r, size_t i)
+{
+	CHECK(r->id[i] == r->full[i].id);
+	CHECK(r->score[i] == r->full[i].score);
+	CHECK(r->flags[i] == r->full[i].flags);
+	return true;
+}
+
+RANDOM_TEST(soa_array, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+	struct records r;
+	records_init(&r);
+	CHECK(records_length(&r) == 0 && records_capacity(&r) == 0);
+
+	size_t n = 50000;
+	for (size_t i = 0; i < n; i++) {
+		struct record rec = {i, (double)(random_next_u32(&rng) % 1000), random_next_u32(&rng) % 4, "name"};
+		records_push(&r, rec.id, rec.score, rec.flags, rec);
+		CHECK(records_capacity(&r) >= records_length(&r));
+	}
+	CHECK(records_length(&r) == n);
+	for (size_t i = 0; i < n; i++) {
+		CHECK(r.id[i] == i);
+		CHECK(check_row(&r, i));
+	}
+
+	// sort by score, then (stable) by flags
+	records_sort_by_score(&r);
+	for (size_t i = 1; i < n; i++) {
+		CHECK(r.score[i - 1] <= r.score[i]);
+		CHECK(r.score[i - 1] < r.score[i] || r.id[i - 1] < r.id[i]);
+	}
+	records_sort_by_flags(&r);
+	for (size_t i = 0; i < n; i++) {
+		CHECK(check_row(&r, i));
+		if (i > 0) {
+			CHECK(r.flags[i - 1] <= r.flags[i]);
+			CHECK(r.flags[i - 1] < r.flags[i] || r.score[i - 1] <= r.score[i]);
+		}
+	}
+
+	// deleting rows keeps the rows consistent
+	for (size_t i = 0; i < n / 2; i++) {
+		records_fast_delete(&r, random_next_u32(&rng) % records_length(&r));
+		records_pop(&r);
+	}
+	CHECK(records_length(&r) == n - 2 * (n / 2));
+	records_shrink_to_fit(&r);
+	CHECK(records_capacity(&r) == records_length(&r));
+	for (size_t i = 0; i < records_length(&r); i++) {
+		CHECK(check_row(&r, i));
+	}
+
+	records_reserve(&r, 1000);
+	CHECK(records_capacity(&r) >= records_length(&r) + 1000);
+	size_t i = records_add(&r);
+	r.id[i] = 1;
+	r.score[i] = 2;
+	r.flags[i] = 3;
+	r.full[i] = (struct record){1, 2, 3, ""};
+	CHECK(check_row(&r, i));
+	records_truncate(&r, 1);
+	CHECK(records_length(&r) == 1);
+	records_clear(&r);
+	CHECK(records_length(&r) == 0);
+	records_destroy(&r);
+	CHECK(records_capacity(&r) == 0);
+	return true;
+}
+
+SIMPLE_TEST(soa_array_field_names)
+{
+	struct clashing c;
+	clashing_init(&c);
+	for (int i = 0; i < 100; i++) {
+		clashing_push(&c, i, 2 * i, 3 * i);
+	}
+	CHECK(clashing_length(&c) == 100);
+	for (int i = 0; i < 100; i++) {
+		CHECK(c.soa[i] == i && c._i[i] == 2 * i && c.length[i] == 3 * i);
+	}
+	clashing_destroy(&c);
+	return true;
+}
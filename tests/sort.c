@@ -0,0 +1,346 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "array.h"
+#include "random.h"
+#include "sort.h"
+#include "testing.h"
+
+DEFINE_SORTFUNC(int_sort, int, (*a > *b) - (*a < *b))
+
+struct record {
+	uint64_t key;
+	uint32_t id;
+	char payload[20];
+};
+
+DEFINE_SORTFUNC(record_sort, struct record, (a->key > b->key) - (a->key < b->key))
+
+static int int_cmp(const void *_a, const void *_b)
+{
+	int a = *(const int *)_a;
+	int b = *(const int *)_b;
+	return (a > b) - (a < b);
+}
+
+enum pattern {
+	PATTERN_RANDOM,
+	PATTERN_SORTED,
+	PATTERN_REVERSE,
+	PATTERN_EQUAL,
+	PATTERN_FEW_UNIQUE,
+	PATTERN_ORGAN_PIPE,
+	PATTERN_SAWTOOTH,
+	PATTERN_SORTED_TAIL,
+	PATTERN_REVERSE_WITH_EQUAL,
+	__PATTERN_COUNT
+};
+
+static void fill(int *arr, size_t n, enum pattern pattern, struct random_state *rng)
+{
+	for (size_t i = 0; i < n; i++) {
+		switch (pattern) {
+		case PATTERN_RANDOM:             arr[i] = (int)random_next_u32(rng); break;
+		case PATTERN_SORTED:             arr[i] = (int)i; break;
+		case PATTERN_REVERSE:            arr[i] = (int)(n - i); break;
+		case PATTERN_EQUAL:              arr[i] = 42; break;
+		case PATTERN_FEW_UNIQUE:         arr[i] = random_next_u32(rng) % 4; break;
+		case PATTERN_ORGAN_PIPE:         arr[i] = (int)(i < n / 2 ? i : n - i); break;
+		case PATTERN_SAWTOOTH:           arr[i] = (int)(i % 97); break;
+		case PATTERN_SORTED_TAIL:        arr[i] = i < n - n / 16 ? (int)i : (int)random_next_u32(rng); break;
+		case PATTERN_REVERSE_WITH_EQUAL: arr[i] = (int)((n - i) / 2); break;
+		case __PATTERN_COUNT:            break;
+		}
+	}
+}
+
+RANDOM_TEST(sort_patterns, random_seed, 2)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	static const size_t sizes[] = {0, 1, 2, 3, 23, 24, 25, 127, 128, 129, 1000, 100000};
+	int *arr = malloc(100000 * sizeof(arr[0]));
+	int *expected = malloc(100000 * sizeof(expected[0]));
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		size_t n = sizes[s];
+		for (enum pattern pattern = 0; pattern < __PATTERN_COUNT; pattern++) {
+			fill(arr, n, pattern, &rng);
+			memcpy(expected, arr, n * sizeof(arr[0]));
+			qsort(expected, n, sizeof(expected[0]), int_cmp);
+			int_sort(arr, n);
+			CHECK(memcmp(arr, expected, n * sizeof(arr[0])) == 0);
+		}
+	}
+	free(arr);
+	free(expected);
+	return true;
+}
+
+// interleaved ascending runs must not degrade the partitioning
+SIMPLE_TEST(sort_interleaved_runs)
+{
+	size_t n = 1 << 16;
+	int *arr = malloc(n * sizeof(arr[0]));
+	for (size_t i = 0; i < n; i++) {
+		arr[i] = i % 2 == 0 ? (int)i : (int)(n + i);
+	}
+	int_sort(arr, n);
+	for (size_t i = 1; i < n; i++) {
+		CHECK(arr[i - 1] <= arr[i]);
+	}
+	free(arr);
+	return true;
+}
+
+RANDOM_TEST(sort_typed_array, random_seed, 2)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	array_t(struct record) records = NULL;
+	size_t n = 50000;
+	uint64_t id_sum = 0;
+	for (size_t i = 0; i < n; i++) {
+		struct record r = {.key = random_next_u64(&rng) % (n / 4), .id = (uint32_t)i};
+		memset(r.payload, (int)(r.key % 256), sizeof(r.payload));
+		array_add(records, r);
+		id_sum += i;
+	}
+	array_sort_typed(records, record_sort);
+	CHECK(array_length(records) == n);
+	for (size_t i = 0; i < n; i++) {
+		if (i > 0) {
+			CHECK(records[i - 1].key <= records[i].key);
+		}
+		CHECK(records[i].payload[0] == (char)(records[i].key % 256));
+		id_sum -= records[i].id;
+	}
+	CHECK(id_sum == 0);
+	array_free(records);
+
+	array_t(int) ints = NULL;
+	array_sort_typed(ints, int_sort);
+	array_add(ints, 3);
+	array_add(ints, 1);
+	array_add(ints, 2);
+	array_sort_typed(ints, int_sort);
+	CHECK(ints[0] == 1 && ints[1] == 2 && ints[2] == 3);
+	array_free(ints);
+	return true;
+}
+
+struct event {
+	uint64_t timestamp;
+	uint32_t id;
+};
+
+DEFINE_RADIX_SORTFUNC(event_radix_sort, struct event, uint64_t, a->timestamp)
+
+static int u64_cmp(const void *_a, const void *_b)
+{
+	uint64_t a = *(const uint64_t *)_a;
+	uint64_t b = *(const uint64_t *)_b;
+	return (a > b) - (a < b);
+}
+
+static int i32_cmp(const void *_a, const void *_b)
+{
+	int32_t a = *(const int32_t *)_a;
+	int32_t b = *(const int32_t *)_b;
+	return (a > b) - (a < b);
+}
+
+static int double_cmp(const void *_a, const void *_b)
+{
+	double a = *(const double *)_a;
+	double b = *(const double *)_b;
+	return (a > b) - (a < b);
+}
+
+RANDOM_TEST(radix_sort, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	static const size_t sizes[] = {0, 1, 2, 100, 255, 256, 257, 5000, 100000};
+	size_t max_n = 100000;
+	uint64_t *u64 = malloc(max_n * sizeof(u64[0]));
+	uint64_t *u64_expected = malloc(max_n * sizeof(u64[0]));
+	int32_t *i32 = malloc(max_n * sizeof(i32[0]));
+	int32_t *i32_expected = malloc(max_n * sizeof(i32[0]));
+	double *dbl = malloc(max_n * sizeof(dbl[0]));
+	double *dbl_expected = malloc(max_n * sizeof(dbl[0]));
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		size_t n = sizes[s];
+		// timestamps (shared high bits), full range keys and few unique keys
+		uint64_t base = random_next_u64(&rng) >> 8;
+		unsigned int kind = random_next_u32(&rng) % 3;
+		for (size_t i = 0; i < n; i++) {
+			switch (kind) {
+			case 0: u64[i] = base + random_next_u32(&rng) % 1000000; break;
+			case 1: u64[i] = random_next_u64(&rng); break;
+			case 2: u64[i] = base + random_next_u32(&rng) % 4; break;
+			}
+			i32[i] = (int32_t)random_next_u32(&rng) >> (random_next_u32(&rng) % 32);
+			dbl[i] = ((double)(int64_t)random_next_u64(&rng)) / (1 + random_next_u32(&rng) % 1000);
+		}
+		if (n > 2) {
+			dbl[0] = -0.0;
+			dbl[1] = 0.0;
+			dbl[2] = -1.0 / 0.0;
+		}
+		memcpy(u64_expected, u64, n * sizeof(u64[0]));
+		memcpy(i32_expected, i32, n * sizeof(i32[0]));
+		memcpy(dbl_expected, dbl, n * sizeof(dbl[0]));
+		qsort(u64_expected, n, sizeof(u64[0]), u64_cmp);
+		qsort(i32_expected, n, sizeof(i32[0]), i32_cmp);
+		qsort(dbl_expected, n, sizeof(dbl[0]), double_cmp);
+		radix_sort_u64(u64, n);
+		radix_sort_i32(i32, n);
+		radix_sort_double(dbl, n);
+		CHECK(memcmp(u64, u64_expected, n * sizeof(u64[0])) == 0);
+		CHECK(memcmp(i32, i32_expected, n * sizeof(i32[0])) == 0);
+		for (size_t i = 0; i < n; i++) {
+			CHECK(dbl[i] == dbl_expected[i]);
+		}
+
+		// the remaining kernels use the same code, compare against the results above
+		uint32_t *u32 = (uint32_t *)i32;
+		for (size_t i = 0; i < n; i++) {
+			u32[i] = (uint32_t)u64[n - 1 - i];
+			i32_expected[i] = (int32_t)(u64[i] >> 32);
+		}
+		radix_sort_u32(u32, n);
+		for (size_t i = 1; i < n; i++) {
+			CHECK(u32[i - 1] <= u32[i]);
+		}
+		int64_t *i64 = (int64_t *)u64;
+		radix_sort_i64(i64, n);
+		for (size_t i = 1; i < n; i++) {
+			CHECK(i64[i - 1] <= i64[i]);
+		}
+		float *flt = (float *)i32_expected;
+		for (size_t i = 0; i < n; i++) {
+			flt[i] = (float)dbl_expected[n - 1 - i];
+		}
+		radix_sort_float(flt, n);
+		for (size_t i = 1; i < n; i++) {
+			CHECK(flt[i - 1] <= flt[i]);
+		}
+	}
+	free(u64);
+	free(u64_expected);
+	free(i32);
+	free(i32_expected);
+	free(dbl);
+	free(dbl_expected);
+
+	// structs are sorted stably by their key
+	array_t(struct event) events = NULL;
+	for (uint32_t i = 0; i < 50000; i++) {
+		struct event e = {.timestamp = 1700000000000 + random_next_u32(&rng) % 10000, .id = i};
+		array_add(events, e);
+	}
+	array_sort_typed(events, event_radix_sort);
+	for (size_t i = 1; i < array_length(events); i++) {
+		CHECK(events[i - 1].timestamp <= events[i].timestamp);
+		CHECK(events[i - 1].timestamp < events[i].timestamp || events[i - 1].id < events[i].id);
+	}
+	array_free(events);
+	return true;
+}
+
+struct pair {
+	uint32_t key;
+	uint32_t pos;
+};
+
+DEFINE_STABLE_SORTFUNC(pair_stable_sort, struct pair, (a->key > b->key) - (a->key < b->key))
+DEFINE_K_WAY_MERGE(pair_merge, struct pair, (a->key > b->key) - (a->key < b->key))
+
+static bool check_stable_sorted(const struct pair *arr, size_t n)
+{
+	for (size_t i = 1; i < n; i++) {
+		CHECK(arr[i - 1].key <= arr[i].key);
+		CHECK(arr[i - 1].key < arr[i].key || arr[i - 1].pos < arr[i].pos);
+	}
+	return true;
+}
+
+RANDOM_TEST(stable_sort, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	static const size_t sizes[] = {0, 1, 2, 63, 64, 65, 1000, 100000};
+	array_t(struct pair) arr = NULL;
+	for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+		size_t n = sizes[s];
+		for (unsigned int kind = 0; kind < 6; kind++) {
+			array_clear(arr);
+			size_t run_length = 1 + random_next_u32(&rng) % 1000;
+			for (size_t i = 0; i < n; i++) {
+				uint32_t key = 0;
+				switch (kind) {
+				case 0: key = random_next_u32(&rng); break;
+				case 1: key = random_next_u32(&rng) % 8; break;
+				case 2: key = (uint32_t)i; break;
+				case 3: key = (uint32_t)(n - i) / 3; break; // descending with duplicates
+				case 4: key = (uint32_t)(i % run_length); break; // concatenated sorted runs
+				case 5: key = i % 100 == 0 ? random_next_u32(&rng) : (uint32_t)i; break;
+				}
+				array_add(arr, ((struct pair){.key = key, .pos = (uint32_t)i}));
+			}
+			array_sort_typed(arr, pair_stable_sort);
+			CHECK(array_length(arr) == n);
+			CHECK(check_stable_sorted(arr, n));
+		}
+	}
+	array_free(arr);
+	return true;
+}
+
+RANDOM_TEST(k_way_merge, random_seed, 4)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	static const size_t ks[] = {0, 1, 2, 5, 300};
+	for (size_t s = 0; s < sizeof(ks) / sizeof(ks[0]); s++) {
+		size_t k = ks[s];
+		struct pair **runs = malloc((k + 1) * sizeof(runs[0]));
+		size_t *lengths = malloc((k + 1) * sizeof(lengths[0]));
+		size_t total = 0;
+		// pos is the position in the concatenation of all runs, so a stable merge keeps it increasing for
+		// equal keys
+		for (size_t r = 0; r < k; r++) {
+			lengths[r] = random_next_bool(&rng) ? random_next_u32(&rng) % 1000 : 0;
+			runs[r] = malloc((lengths[r] + 1) * sizeof(runs[r][0]));
+			for (size_t i = 0; i < lengths[r]; i++) {
+				runs[r][i].key = random_next_u32(&rng) % 500;
+			}
+			pair_stable_sort(runs[r], lengths[r]);
+			for (size_t i = 0; i < lengths[r]; i++) {
+				runs[r][i].pos = (uint32_t)(total + i);
+			}
+			total += lengths[r];
+		}
+		struct pair *out = malloc((total + 1) * sizeof(out[0]));
+		CHECK(pair_merge(out, runs, lengths, k) == total);
+		CHECK(check_stable_sorted(out, total));
+		uint64_t pos_sum = 0;
+		for (size_t i = 0; i < total; i++) {
+			pos_sum += out[i].pos;
+		}
+		CHECK(pos_sum == (uint64_t)total * (total - (total != 0)) / 2);
+		for (size_t r = 0; r < k; r++) {
+			free(runs[r]);
+		}
+		free(out);
+		free(lengths);
+		free(runs);
+	}
+	return true;
+}
@@ -0,0 +1,298 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "random.h"
+#include "string_btree.h"
+#include "testing.h"
+
+DEFINE_STRING_BTREE_MAP(smap, uint32_t, NULL)
+DEFINE_STRING_BTREE_SET(sset)
+
+struct key {
+	char *string;
+	size_t length;
+};
+
+static int compare_keys(const void *_a, const void *_b)
+{
+	const struct key *a = _a;
+	const struct key *b = _b;
+	int cmp = memcmp(a->string, b->string, a->length < b->length ? a->length : b->length);
+	if (cmp != 0) {
+		return cmp;
+	}
+	return (a->length > b->length) - (a->length < b->length);
+}
+
+/* generates sorted unique keys with lots of common prefixes (like paths) */
+static struct key *create_keys(struct random_state *rng, size_t *num_keys)
+{
+	static const char *dirs[] = {"/usr/share/doc/", "/usr/share/man/man1/", "/usr/lib/", "/var/log/", "/"};
+	size_t n = *num_keys;
+	struct key *keys = malloc(n * sizeof(keys[0]));
+	for (size_t i = 0; i < n; i++) {
+		char buf[STRING_BTREE_MAX_KEY_SIZE + 1];
+		unsigned int r = random_next_u32(rng);
+		int len;
+		switch (r % 8) {
+		case 0:
+			// short keys (including the empty key)
+			len = snprintf(buf, sizeof(buf), "%.*s", (int)(r >> 8) % 3, "xyz");
+			break;
+		case 1: {
+			// long keys
+			size_t l = random_next_u32(rng) % STRING_BTREE_MAX_KEY_SIZE;
+			memset(buf, 'a' + r % 3, l);
+			buf[l] = '\0';
+			if (l > 0) {
+				buf[random_next_u32(rng) % l] = 'b';
+			}
+			len = l;
+			break;
+		}
+		default:
+			len = snprintf(buf, sizeof(buf), "%spackage-%u/file%u.txt", dirs[r % 5],
+				       random_next_u32(rng) % 512, random_next_u32(rng) % 64);
+			break;
+		}
+		keys[i].string = malloc(len + 1);
+		memcpy(keys[i].string, buf, len + 1);
+		keys[i].length = len;
+	}
+	qsort(keys, n, sizeof(keys[0]), compare_keys);
+	size_t j = 0;
+	for (size_t i = 0; i < n; i++) {
+		if (j != 0 && compare_keys(&keys[j - 1], &keys[i]) == 0) {
+			free(keys[i].string);
+			continue;
+		}
+		keys[j++] = keys[i];
+	}
+	*num_keys = j;
+	return keys;
+}
+
+static void destroy_keys(struct key *keys, size_t num_keys)
+{
+	for (size_t i = 0; i < num_keys; i++) {
+		free(keys[i].string);
+	}
+	free(keys);
+}
+
+static bool iter_matches(smap_iter_t *iter, const struct key *key, uint32_t *value, uint32_t expected)
+{
+	CHECK(value);
+	CHECK(*value == expected);
+	CHECK(iter->key_length == key->length);
+	CHECK(memcmp(iter->key, key->string, key->length) == 0);
+	CHECK(iter->key[key->length] == '\0');
+	return true;
+}
+
+RANDOM_TEST(string_btree, random_seed, 2)
+{
+	struct random_state rng;
+	random_state_init(&rng, random_seed);
+
+	size_t num_keys = 1 << 15;
+	struct key *keys = create_keys(&rng, &num_keys);
+	uint32_t *order = malloc(num_keys * sizeof(order[0]));
+	for (size_t i = 0; i < num_keys; i++) {
+		order[i] = i;
+	}
+	for (size_t i = num_keys - 1; i > 0; i--) {
+		size_t j = random_next_u64(&rng) % (i + 1);
+		uint32_t tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	struct smap smap = STRING_BTREE_EMPTY;
+	smap_init(&smap);
+	CHECK(!smap_find(&smap, "", 0));
+	CHECK(!smap_delete(&smap, "", 0, NULL));
+
+	for (size_t i = 0; i < num_keys; i++) {
+		struct key *key = &keys[order[i]];
+		CHECK(smap_insert(&smap, key->string, key->length, order[i]));
+		CHECK(!smap_insert(&smap, key->string, key->length, 0));
+		uint32_t *value = smap_find(&smap, key->string, key->length);
+		CHECK(value && *value == order[i]);
+		if (i % 1024 == 0) {
+			CHECK(_string_btree_debug_check(&smap._impl, &smap_info));
+		}
+	}
+	CHECK(_string_btree_debug_check(&smap._impl, &smap_info));
+	CHECK(smap._impl.height > 1);
+
+	for (size_t i = 0; i < num_keys; i++) {
+		uint32_t *value = smap_find(&smap, keys[i].string, keys[i].length);
+		CHECK(value && *value == i);
+		CHECK(!smap_set(&smap, keys[i].string, keys[i].length, i + 1));
+	}
+
+	smap_iter_t iter;
+	size_t i = 0;
+	for (uint32_t *value = smap_iter_start_leftmost(&iter, &smap); value; value = smap_iter_next(&iter)) {
+		CHECK(i < num_keys);
+		CHECK(iter_matches(&iter, &keys[i], value, i + 1));
+		i++;
+	}
+	CHECK(i == num_keys);
+	CHECK(!smap_iter_next(&iter));
+	for (uint32_t *value = smap_iter_start_rightmost(&iter, &smap); value; value = smap_iter_prev(&iter)) {
+		CHECK(i > 0);
+		i--;
+		CHECK(iter_matches(&iter, &keys[i], value, i + 1));
+	}
+	CHECK(i == 0);
+
+	for (i = 0; i < num_keys; i += 1 + random_next_u32(&rng) % 16) {
+		struct key *key = &keys[i];
+		uint32_t *value = smap_iter_start_at(&iter, &smap, key->string, key->length, BTREE_ITER_FIND_KEY);
+		CHECK(iter_matches(&iter, key, value, i + 1));
+		value = smap_iter_next(&iter);
+		CHECK(i == num_keys - 1 ? !value : iter_matches(&iter, &keys[i + 1], value, i + 2));
+		if (value) {
+			// an iterator that ran past the end is finished, so this only works if next found an item
+			value = smap_iter_prev(&iter);
+			CHECK(iter_matches(&iter, key, value, i + 1));
+		}
+
+		value = smap_iter_start_at(&iter, &smap, key->string, key->length, BTREE_ITER_LOWER_BOUND_INCLUSIVE);
+		CHECK(iter_matches(&iter, key, value, i + 1));
+		value = smap_iter_start_at(&iter, &smap, key->string, key->length, BTREE_ITER_LOWER_BOUND_EXCLUSIVE);
+		CHECK(i == num_keys - 1 ? !value : iter_matches(&iter, &keys[i + 1], value, i + 2));
+		value = smap_iter_start_at(&iter, &smap, key->string, key->length, BTREE_ITER_UPPER_BOUND_INCLUSIVE);
+		CHECK(iter_matches(&iter, key, value, i + 1));
+		value = smap_iter_start_at(&iter, &smap, key->string, key->length, BTREE_ITER_UPPER_BOUND_EXCLUSIVE);
+		CHECK(i == 0 ? !value : iter_matches(&iter, &keys[i - 1], value, i));
+
+		if (key->length < STRING_BTREE_MAX_KEY_SIZE) {
+			// the key with an additional null byte is between keys[i] and keys[i + 1]
+			char buf[STRING_BTREE_MAX_KEY_SIZE];
+			memcpy(buf, key->string, key->length);
+			buf[key->length] = '\0';
+			CHECK(!smap_find(&smap, buf, key->length + 1));
+			value = smap_iter_start_at(&iter, &smap, buf, key->length + 1, BTREE_ITER_FIND_KEY);
+			CHECK(!value);
+			value = smap_iter_start_at(&iter, &smap, buf, key->length + 1, BTREE_ITER_LOWER_BOUND_INCLUSIVE);
+			CHECK(i == num_keys - 1 ? !value : iter_matches(&iter, &keys[i + 1], value, i + 2));
+			value = smap_iter_start_at(&iter, &smap, buf, key->length + 1, BTREE_ITER_UPPER_BOUND_INCLUSIVE);
+			CHECK(iter_matches(&iter, key, value, i + 1));
+		}
+	}
+
+	for (i = 0; i < num_keys / 2; i++) {
+		struct key *key = &keys[order[i]];
+		uint32_t value;
+		CHECK(smap_delete(&smap, key->string, key->length, &value));
+		CHECK(value == order[i] + 1);
+		CHECK(!smap_delete(&smap, key->string, key->length, &value));
+		CHECK(!smap_find(&smap, key->string, key->length));
+		if (i % 1024 == 0) {
+			CHECK(_string_btree_debug_check(&smap._impl, &smap_info));
+		}
+	}
+	CHECK(_string_btree_debug_check(&smap._impl, &smap_info));
+	for (i = 0; i < num_keys; i++) {
+		struct key *key = &keys[order[i]];
+		uint32_t *value = smap_find(&smap, key->string, key->length);
+		CHECK(i < num_keys / 2 ? !value : value && *value == order[i] + 1);
+	}
+	i = 0;
+	for (uint32_t *value = smap_iter_start_leftmost(&iter, &smap); value; value = smap_iter_next(&iter)) {
+		i++;
+	}
+	CHECK(i == num_keys - num_keys / 2);
+
+	for (i = num_keys / 2; i < num_keys; i++) {
+		struct key *key = &keys[order[i]];
+		CHECK(smap_delete(&smap, key->string, key->length, NULL));
+		if (i % 1024 == 0) {
+			CHECK(_string_btree_debug_check(&smap._impl, &smap_info));
+		}
+	}
+	CHECK(smap._impl.height == 0);
+	CHECK(!smap_iter_start_leftmost(&iter, &smap));
+
+	for (i = 0; i < num_keys; i++) {
+		CHECK(smap_insert(&smap, keys[i].string, keys[i].length, i));
+	}
+	CHECK(_string_btree_debug_check(&smap._impl, &smap_info));
+	smap_destroy(&smap);
+	CHECK(smap._impl.height == 0);
+
+	struct sset sset;
+	sset_init(&sset);
+	for (i = 0; i < num_keys; i++) {
+		struct key *key = &keys[order[i]];
+		CHECK(sset_insert(&sset, key->string, key->length));
+		CHECK(!sset_insert(&sset, key->string, key->length));
+	}
+	CHECK(_string_btree_debug_check(&sset._impl, &sset_info));
+	sset_iter_t sset_iter;
+	i = 0;
+	for (const char *key = sset_iter_start_leftmost(&sset_iter, &sset); key; key = sset_iter_next(&sset_iter)) {
+		CHECK(sset_iter.key_length == keys[i].length && memcmp(key, keys[i].string, keys[i].length) == 0);
+		i++;
+	}
+	CHECK(i == num_keys);
+	for (i = 0; i < num_keys; i++) {
+		CHECK(sset_find(&sset, keys[i].string, keys[i].length));
+		if (i % 2 == 0) {
+			CHECK(sset_delete(&sset, keys[i].string, keys[i].length));
+		}
+	}
+	CHECK(_string_btree_debug_check(&sset._impl, &sset_info));
+	for (i = 0; i < num_keys; i++) {
+		CHECK(sset_find(&sset, keys[i].string, keys[i].length) == (i % 2 != 0));
+	}
+	sset_destroy(&sset);
+
+	free(order);
+	destroy_keys(keys, num_keys);
+	return true;
+}
+
+SIMPLE_TEST(string_btree_long_keys)
+{
+	// e.g. long URLs: keys longer than the maximum are rejected instead of being truncated
+	static char key[1500];
+	memset(key, 'u', sizeof(key));
+	struct smap smap;
+	smap_init(&smap);
+	CHECK(smap_insert(&smap, key, STRING_BTREE_MAX_KEY_SIZE, 1));
+	CHECK(!smap_insert(&smap, key, STRING_BTREE_MAX_KEY_SIZE + 1, 2));
+	CHECK(!smap_insert(&smap, key, sizeof(key), 3));
+	CHECK(!smap_set(&smap, key, sizeof(key), 4));
+	CHECK(!smap_find(&smap, key, sizeof(key)));
+	CHECK(!smap_delete(&smap, key, sizeof(key), NULL));
+	uint32_t *value = smap_find(&smap, key, STRING_BTREE_MAX_KEY_SIZE);
+	CHECK(value && *value == 1);
+	// fill a few nodes with long keys to check the splits as well
+	for (unsigned int i = 0; i < 256; i++) {
+		key[0] = (char)i;
+		CHECK(!smap_insert(&smap, key, sizeof(key), i));
+		CHECK(smap_insert(&smap, key, STRING_BTREE_MAX_KEY_SIZE - 1, i));
+	}
+	CHECK(_string_btree_debug_check(&smap._impl, &smap_info));
+	smap_iter_t iter;
+	size_t count = 0;
+	for (value = smap_iter_start_leftmost(&iter, &smap); value; value = smap_iter_next(&iter)) {
+		CHECK(iter.key_length <= STRING_BTREE_MAX_KEY_SIZE);
+		count++;
+	}
+	CHECK(count == 1 + 256);
+	smap_destroy(&smap);
+
+	struct sset sset;
+	sset_init(&sset);
+	CHECK(!sset_insert(&sset, key, sizeof(key)));
+	CHECK(!sset_find(&sset, key, sizeof(key)));
+	sset_destroy(&sset);
+	return true;
+}